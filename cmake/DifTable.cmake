@@ -0,0 +1,107 @@
+cmake_minimum_required(VERSION 3.17 FATAL_ERROR)
+include_guard(GLOBAL)
+
+if(NOT CMAKE_CURRENT_LIST_FILE STREQUAL CMAKE_SCRIPT_MODE_FILE)
+    # Running as a module; define the target_dif_tables function.
+    #
+    # Compiles IDA difference files into a header of sorted dif_entry arrays,
+    # one per file, named after the file (Wing1.dif becomes wing1_dif).  The
+    # dif_entry type must be declared before the generated header is included.
+    function(target_dif_tables target output)
+        set(inputs)
+        foreach(dif ${ARGN})
+            get_filename_component(dif ${dif} ABSOLUTE)
+            list(APPEND inputs ${dif})
+        endforeach()
+
+        get_filename_component(output ${output} ABSOLUTE BASE_DIR ${CMAKE_CURRENT_BINARY_DIR})
+        string(REPLACE ";" "|" input_list "${inputs}")
+        add_custom_command(OUTPUT ${output}
+            COMMAND ${CMAKE_COMMAND} --log-level=NOTICE -D OUTPUT=${output} -D INPUTS=${input_list}
+                -P ${CMAKE_CURRENT_FUNCTION_LIST_FILE}
+            DEPENDS ${inputs} ${CMAKE_CURRENT_FUNCTION_LIST_FILE}
+            COMMENT "Generating ${output}..."
+            VERBATIM
+        )
+        target_sources(${target} PRIVATE ${output})
+    endfunction()
+
+    # The rest of this file runs in script mode.
+    return()
+endif()
+
+set(REQUIRED_VARS OUTPUT INPUTS)
+foreach(var ${REQUIRED_VARS})
+    if(NOT DEFINED ${var})
+        message(FATAL_ERROR "Missing ${var}")
+    endif()
+endforeach()
+
+string(REPLACE "|" ";" INPUTS "${INPUTS}")
+
+set(content "// Generated by DifTable.cmake; do not edit.\n")
+foreach(input ${INPUTS})
+    get_filename_component(input_name ${input} NAME)
+    get_filename_component(table_name ${input} NAME_WE)
+    string(TOLOWER ${table_name} table_name)
+
+    file(STRINGS ${input} lines)
+    list(POP_FRONT lines tag)
+    if(NOT tag MATCHES "This difference file has been created by IDA")
+        message(FATAL_ERROR "${input_name} is not an IDA difference file")
+    endif()
+
+    # Each entry is keyed by its zero-padded offset so that a plain string
+    # sort puts the table in offset order.  Entries whose original value is
+    # FFFFFFFF lie past the end of the original file and can't be applied.
+    set(entries)
+    foreach(line ${lines})
+        if(NOT line MATCHES ":")
+            continue()
+        endif()
+        if(NOT line MATCHES "^0*([0-9A-Fa-f]?[0-9A-Fa-f]?[0-9A-Fa-f]?[0-9A-Fa-f]?[0-9A-Fa-f]?[0-9A-Fa-f]?[0-9A-Fa-f]?[0-9A-Fa-f]): +([0-9A-Fa-f]+) +([0-9A-Fa-f][0-9A-Fa-f]?)[ \r]*$")
+            message(FATAL_ERROR "${input_name}: unrecognized line: ${line}")
+        endif()
+
+        set(offset ${CMAKE_MATCH_1})
+        set(original ${CMAKE_MATCH_2})
+        set(replacement ${CMAKE_MATCH_3})
+        string(TOUPPER ${original} original)
+        if(original STREQUAL "FFFFFFFF")
+            continue()
+        endif()
+        if(NOT original MATCHES "^[0-9A-F][0-9A-F]?$")
+            message(FATAL_ERROR "${input_name}: unrecognized line: ${line}")
+        endif()
+
+        string(TOUPPER ${offset} offset)
+        string(LENGTH ${offset} length)
+        while(length LESS 8)
+            string(PREPEND offset "0")
+            math(EXPR length "${length} + 1")
+        endwhile()
+        list(APPEND entries "${offset}:${original}:${replacement}")
+    endforeach()
+
+    if(NOT entries)
+        message(FATAL_ERROR "${input_name} has no applicable entries")
+    endif()
+    list(SORT entries)
+
+    string(APPEND content "\n// ${input_name}\nconstexpr dif_entry ${table_name}_dif[] =\n{\n")
+    set(previous_offset "")
+    foreach(entry ${entries})
+        string(REPLACE ":" ";" fields ${entry})
+        list(GET fields 0 offset)
+        list(GET fields 1 original)
+        list(GET fields 2 replacement)
+        if(offset STREQUAL previous_offset)
+            message(FATAL_ERROR "${input_name}: offset ${offset} appears more than once")
+        endif()
+        set(previous_offset ${offset})
+        string(APPEND content "    { 0x${offset}, 0x${original}, 0x${replacement} },\n")
+    endforeach()
+    string(APPEND content "};\n")
+endforeach()
+
+file(WRITE ${OUTPUT} "${content}")
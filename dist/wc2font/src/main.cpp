@@ -1,18 +1,23 @@
+#include <font/font.h>
+#include <font/glyph_atlas.h>
+#include <font/text.h>
 #include <image/image.h>
 #include <image/resources.h>
+#include <image/sprite.h>
+#include <resource/mapped_file.h>
 
 #include <stdext/array_view.h>
 #include <stdext/file.h>
 #include <stdext/format.h>
-#include <stdext/multi.h>
+#include <stdext/stream.h>
 #include <stdext/utility.h>
 
-#include <array>
 #include <filesystem>
 #include <iostream>
 #include <memory>
-#include <numeric>
 #include <stdexcept>
+#include <string_view>
+#include <vector>
 
 #include <cassert>
 #include <cstddef>
@@ -26,20 +31,14 @@
 
 namespace
 {
-    struct glyph_info
-    {
-        uint16_t file_position;
-        uint8_t width;
-        uint8_t height;
-        std::unique_ptr<std::byte[]> pixels;
-    };
-
     enum : uint32_t
     {
         mode_none               = 0x0,
         mode_extract_glyph      = 0x1,
         mode_extract_all_glyphs = 0x2,
-        mode_extract_font_strip = 0x4
+        mode_extract_font_strip = 0x4,
+        mode_extract_atlas      = 0x8,
+        mode_render_text        = 0x10
     };
 
     struct program_options
@@ -48,6 +47,7 @@ namespace
         const wchar_t* input_path = nullptr;
         const wchar_t* output_path = nullptr;
         const wchar_t* prefix = nullptr;
+        const wchar_t* text_path = nullptr;
         unsigned glyph_index = unsigned(-1);
     };
 
@@ -60,11 +60,11 @@ namespace
     void show_usage(const wchar_t* invocation);
     void diagnose_options(const program_options& options);
 
-    using glyph_array = std::array<glyph_info, 0x100>;
-    glyph_array read_font(stdext::multi_ref<stdext::input_stream, stdext::seekable> input);
-    void extract_glyph(const glyph_info& glyph, stdext::array_view<std::byte> palette_view, const wchar_t* output_path);
-    void extract_all_glyphs(const glyph_array& glyphs, stdext::array_view<std::byte> palette_view, const wchar_t* output_path, const wchar_t* prefix);
-    void extract_font_strip(const glyph_array& glyphs, stdext::array_view<std::byte> palette_view, const wchar_t* output_path);
+    void extract_glyph(const wcdx::font::font& font, unsigned index, stdext::array_view<std::byte> palette_view, const wchar_t* output_path);
+    void extract_all_glyphs(const wcdx::font::font& font, stdext::array_view<std::byte> palette_view, const wchar_t* output_path, const wchar_t* prefix);
+    void extract_font_strip(const wcdx::font::font& font, stdext::array_view<std::byte> palette_view, const wchar_t* output_path);
+    void extract_atlas(const wcdx::font::font& font, stdext::array_view<std::byte> palette_view, const wchar_t* output_path);
+    void render_text(const wcdx::font::font& font, stdext::array_view<std::byte> palette_view, const wchar_t* text_path, const wchar_t* output_path);
 }
 
 int wmain(int argc, wchar_t* argv[])
@@ -87,19 +87,25 @@ int wmain(int argc, wchar_t* argv[])
         auto palette_size = ::SizeofResource(nullptr, palette_resource);
         stdext::array_view<std::byte> palette_view(static_cast<std::byte*>(palette_data), palette_size);
 
-        stdext::file_input_stream file(options.input_path);
-        auto glyphs = read_font(file);
+        wcdx::resource::mapped_file file(options.input_path);
+        wcdx::font::font font(file.data(), file.size());
 
         switch (options.mode)
         {
         case mode_extract_glyph:
-            extract_glyph(glyphs[options.glyph_index], palette_view, options.output_path);
+            extract_glyph(font, options.glyph_index, palette_view, options.output_path);
             break;
         case mode_extract_all_glyphs:
-            extract_all_glyphs(glyphs, palette_view, options.output_path, options.prefix);
+            extract_all_glyphs(font, palette_view, options.output_path, options.prefix);
             break;
         case mode_extract_font_strip:
-            extract_font_strip(glyphs, palette_view, options.output_path);
+            extract_font_strip(font, palette_view, options.output_path);
+            break;
+        case mode_extract_atlas:
+            extract_atlas(font, palette_view, options.output_path);
+            break;
+        case mode_render_text:
+            render_text(font, palette_view, options.text_path, options.output_path);
             break;
         default:
             stdext::unreachable();
@@ -157,7 +163,7 @@ namespace
 
                     wchar_t* endp;
                     options.glyph_index = unsigned(wcstoul(argv[n], &endp, 10));
-                    if (*endp != L'\0')
+                    if (*endp != L'\0' || options.glyph_index >= wcdx::font::glyph_count)
                         throw usage_error("Bad glyph index: " + stdext::to_mbstring(argv[n]));
 
                     diagnose_options(options);
@@ -187,6 +193,26 @@ namespace
                     options.mode |= mode_extract_font_strip;
                     diagnose_options(options);
                 }
+                else if (wcscmp(argv[n], L"-extract-atlas") == 0)
+                {
+                    if ((options.mode & mode_extract_atlas) != 0)
+                        throw usage_error("The -extract-atlas option can only be used once");
+
+                    options.mode |= mode_extract_atlas;
+                    diagnose_options(options);
+                }
+                else if (wcscmp(argv[n], L"-render-text") == 0)
+                {
+                    if ((options.mode & mode_render_text) != 0)
+                        throw usage_error("The -render-text option can only be used once");
+
+                    options.mode |= mode_render_text;
+                    if (++n == argc)
+                        throw usage_error("Missing text path");
+                    options.text_path = argv[n];
+
+                    diagnose_options(options);
+                }
                 else
                     throw usage_error("Unrecognized option: " + stdext::to_mbstring(argv[n]));
             }
@@ -203,7 +229,7 @@ namespace
         if (options.output_path == nullptr)
             throw usage_error("Missing output path");
         if (options.mode == 0)
-            throw usage_error("Missing -extract-glyph, -extract-all-glyphs, or -extract-font-strip");
+            throw usage_error("Missing -extract-glyph, -extract-all-glyphs, -extract-font-strip, -extract-atlas, or -render-text");
         if (options.prefix == nullptr)
             options.prefix = L"";
 
@@ -216,13 +242,16 @@ namespace
             L"    " << invocation << " -o <output_path> -extract-glyph <glyph_index> <input_path>\n"
             L"    " << invocation << " -o <output_path> -extract-all-glyphs [-prefix <name_prefix>] <input_path>\n"
             L"    " << invocation << " -o <output_path> -extract-font-strip <input_path>\n"
+            L"    " << invocation << " -o <output_path> -extract-atlas <input_path>\n"
+            L"    " << invocation << " -o <output_path> -render-text <text_path> <input_path>\n"
             L"\n"
             L"input_path is an extracted font resource for Wing Commander II.  You can get it\n"
             L"by running wcres against fonts.fnt.\n"
             L"\n"
             L"output_path points to a location where data will be written out.  For\n"
-            L"-extract-glyph and -extract-font-strip, this should name a file ending in .png.\n"
-            L"For -extract-all-glyphs, this should name a directory.\n"
+            L"-extract-glyph, -extract-font-strip, -extract-atlas, and -render-text, this\n"
+            L"should name a file ending in .png.  For -extract-all-glyphs, this should name a\n"
+            L"directory.\n"
             L"\n"
             L"The -extract-glyph option extracts a single glyph from the font resource, saving\n"
             L"it as a PNG-encoded image file.  Note that zero-sized glyphs cannot be\n"
@@ -235,6 +264,14 @@ namespace
             L"The -extract-font-strip option extracts all glyphs from the font resource,\n"
             L"concatenating them into a single image.\n"
             L"\n"
+            L"The -extract-atlas option packs all non-zero-sized glyphs from the font\n"
+            L"resource into a compact image, and writes the position and size of every glyph\n"
+            L"as JSON to a file next to it with the extension .json.\n"
+            L"\n"
+            L"The -render-text option draws every line of the text file at text_path with\n"
+            L"the font, one under the other, into a single image.  Each byte of the text\n"
+            L"selects a glyph; use it to preview translated strings.\n"
+            L"\n"
             L"glyph_index is the numeric value of a character in the font.  It can be any\n"
             L"value from 0 to 255, and typically corresponds with the ASCII encoding of the\n"
             L"character.\n"
@@ -266,91 +303,70 @@ namespace
             if (options.prefix)
                 throw usage_error("The -prefix option cannot be used with -extract-font-strip");
         }
-    }
-
-    std::array<glyph_info, 0x100> read_font(stdext::multi_ref<stdext::input_stream, stdext::seekable> input)
-    {
-        auto& stream = input.as<stdext::input_stream>();
-        auto& seeker = input.as<stdext::seekable>();
-
-        auto font_height = stream.read<uint16_t>();
-        stream.skip<uint16_t>();    // color index, duplicative of pixel data
-
-        std::array<glyph_info, 0x100> glyphs;
-
-        for (auto& glyph : glyphs)
+        if ((options.mode & mode_extract_atlas) != 0)
         {
-            glyph.width = stream.read<uint8_t>();
-            glyph.height = uint8_t(font_height);
+            if ((options.mode & ~mode_extract_atlas) != 0)
+                throw usage_error("The -extract-atlas option cannot be used with other extraction modes");
+            if (options.prefix != nullptr)
+                throw usage_error("The -prefix option cannot be used with -extract-atlas");
         }
-
-        for (auto& glyph : glyphs)
-            glyph.file_position = stream.read<uint8_t>();
-
-        for (auto& glyph : glyphs)
-            glyph.file_position |= uint16_t(stream.read<uint8_t>()) << 8;
-
-        for (auto& glyph : glyphs)
+        if ((options.mode & mode_render_text) != 0)
         {
-            assert(seeker.position() == glyph.file_position);
-            size_t pixel_count = glyph.width * glyph.height;
-            if (pixel_count == 0)
-                continue;
-
-            glyph.pixels = std::make_unique<std::byte[]>(pixel_count);
-            stream.read_all(glyph.pixels.get(), pixel_count);
+            if ((options.mode & ~mode_render_text) != 0)
+                throw usage_error("The -render-text option cannot be used with extraction modes");
+            if (options.prefix != nullptr)
+                throw usage_error("The -prefix option cannot be used with -render-text");
         }
-
-        assert(seeker.position() == seeker.end_position());
-        stdext::discard(seeker);
-
-        return glyphs;
     }
 
-    void extract_glyph(const glyph_info& glyph, stdext::array_view<std::byte> palette_view, const wchar_t* output_path)
+    void extract_glyph(const wcdx::font::font& font, unsigned index, stdext::array_view<std::byte> palette_view, const wchar_t* output_path)
     {
-        stdext::memory_input_stream pixels_stream(glyph.pixels.get(), glyph.width * glyph.height);
+        auto glyph = font.glyph(index);
+        if (glyph.pixels == nullptr)
+            throw std::runtime_error(stdext::format_string("Glyph $0 is empty", index));
+
+        stdext::memory_input_stream pixels_stream(glyph.pixels, glyph.width * glyph.height);
         stdext::file_output_stream out(output_path);
         wcdx::image::write_image({ glyph.width, glyph.height }, palette_view, pixels_stream, out);
     }
 
-    void extract_all_glyphs(const glyph_array& glyphs, stdext::array_view<std::byte> palette_view, const wchar_t* output_path, const wchar_t* prefix)
+    void extract_all_glyphs(const wcdx::font::font& font, stdext::array_view<std::byte> palette_view, const wchar_t* output_path, const wchar_t* prefix)
     {
-        size_t index = 0;
-        for (auto& glyph : glyphs)
+        for (unsigned index = 0; index != wcdx::font::glyph_count; ++index)
         {
-            if (glyph.width == 0 || glyph.height == 0)
-            {
-                ++index;
+            auto glyph = font.glyph(index);
+            if (glyph.pixels == nullptr)
                 continue;
-            }
 
-            stdext::memory_input_stream pixels_stream(glyph.pixels.get(), glyph.width * glyph.height);
-            stdext::file_output_stream out(stdext::format_string("$0\\$1$2.png", output_path, prefix, index++).c_str(), stdext::utf8_path_encoding());
-            wcdx::image::write_image({ glyph.width, glyph.height }, palette_view, pixels_stream, out);
+            stdext::memory_input_stream pixels_stream(glyph.pixels, glyph.width * glyph.height);
+            stdext::file_output_stream out(stdext::format_string("$0\\$1$2.png", output_path, prefix, index).c_str(), stdext::utf8_path_encoding());
+            wcdx::image::write_image({ glyph.width, glyph.height }, palette_view, pixels_stream, out, wcdx::image::compression::fast);
         }
     }
 
-    void extract_font_strip(const glyph_array& glyphs, stdext::array_view<std::byte> palette_view, const wchar_t* output_path)
+    void extract_font_strip(const wcdx::font::font& font, stdext::array_view<std::byte> palette_view, const wchar_t* output_path)
     {
-        unsigned width = std::accumulate(glyphs.begin(), glyphs.end(), unsigned(0), [](unsigned acc, const glyph_info& glyph)
-        {
-            return acc + glyph.width;
-        });
-        unsigned height = glyphs[0].height;
+        unsigned width = 0;
+        for (unsigned index = 0; index != wcdx::font::glyph_count; ++index)
+            width += font.glyph(index).width;
+        unsigned height = font.height();
 
         auto pixels = std::make_unique<std::byte[]>(width * height);
         auto p = pixels.get();
-        for (auto& glyph : glyphs)
+        for (unsigned index = 0; index != wcdx::font::glyph_count; ++index)
         {
+            auto glyph = font.glyph(index);
             assert(p + glyph.width <= pixels.get() + width);
-            auto src = glyph.pixels.get();
-            auto dst = p;
-            for (unsigned y = 0; y < glyph.height; ++y)
+            if (glyph.pixels != nullptr)
             {
-                memcpy(dst, src, glyph.width);
-                dst += width;
-                src += glyph.width;
+                auto src = glyph.pixels;
+                auto dst = p;
+                for (unsigned y = 0; y < glyph.height; ++y)
+                {
+                    memcpy(dst, src, glyph.width);
+                    dst += width;
+                    src += glyph.width;
+                }
             }
 
             p += glyph.width;
@@ -360,4 +376,44 @@ namespace
         stdext::file_output_stream out(output_path);
         wcdx::image::write_image({ width, height }, palette_view, pixels_stream, out);
     }
+
+    void extract_atlas(const wcdx::font::font& font, stdext::array_view<std::byte> palette_view, const wchar_t* output_path)
+    {
+        wcdx::font::glyph_atlas atlas(font);
+
+        stdext::memory_input_stream pixels_stream(atlas.pixels(), size_t(atlas.width()) * atlas.height());
+        stdext::file_output_stream out(output_path);
+        wcdx::image::write_image({ atlas.width(), atlas.height() }, palette_view, pixels_stream, out);
+
+        auto json = wcdx::font::format_metrics_json(atlas);
+        stdext::file_output_stream metrics_out(std::filesystem::path(output_path).replace_extension(L".json").c_str());
+        metrics_out.write_all(json.data(), json.size());
+    }
+
+    void render_text(const wcdx::font::font& font, stdext::array_view<std::byte> palette_view, const wchar_t* text_path, const wchar_t* output_path)
+    {
+        wcdx::resource::mapped_file text_file(text_path);
+        std::string_view text(reinterpret_cast<const char*>(text_file.data()), text_file.size());
+
+        std::vector<std::string_view> lines;
+        while (!text.empty())
+        {
+            auto end = text.find('\n');
+            auto line = text.substr(0, end);
+            if (!line.empty() && line.back() == '\r')
+                line.remove_suffix(1);
+            lines.push_back(line);
+            text.remove_prefix(end != std::string_view::npos ? end + 1 : text.size());
+        }
+
+        // Whatever the glyphs don't cover is left transparent.
+        wcdx::font::glyph_atlas atlas(font);
+        auto sheet = wcdx::font::render_text_sheet(atlas, stdext::array_view<const std::string_view>(lines.data(), lines.size()), 1, wcdx::image::transparent_index);
+        if (sheet.width == 0 || sheet.height == 0)
+            throw std::runtime_error("Nothing to render");
+
+        stdext::memory_input_stream pixels_stream(sheet.pixels.get(), size_t(sheet.width) * sheet.height);
+        stdext::file_output_stream out(output_path);
+        wcdx::image::write_image({ sheet.width, sheet.height }, palette_view, pixels_stream, out);
+    }
 }
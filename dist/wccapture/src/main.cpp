@@ -0,0 +1,167 @@
+#include <frame/frame_capture.h>
+#include <image/image.h>
+#include <resource/mapped_file.h>
+
+#include <stdext/array_view.h>
+#include <stdext/file.h>
+#include <stdext/format.h>
+#include <stdext/stream.h>
+#include <stdext/string.h>
+
+#include <filesystem>
+#include <iostream>
+#include <stdexcept>
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <cwchar>
+
+
+namespace
+{
+    struct program_options
+    {
+        const wchar_t* input_path = nullptr;
+        const wchar_t* output_path = nullptr;
+        const wchar_t* prefix = nullptr;
+    };
+
+    class usage_error : public std::runtime_error
+    {
+        using runtime_error::runtime_error;
+    };
+
+    program_options parse_args(int argc, wchar_t* argv[]);
+    void show_usage(const wchar_t* invocation);
+    void extract_frames(const program_options& options);
+}
+
+int wmain(int argc, wchar_t* argv[])
+{
+    std::wstring invocation = argc > 0 ? std::filesystem::path(argv[0]).filename() : "wccapture";
+
+    try
+    {
+        if (argc == 1)
+        {
+            show_usage(invocation.c_str());
+            return EXIT_SUCCESS;
+        }
+
+        auto options = parse_args(argc, argv);
+        extract_frames(options);
+        return EXIT_SUCCESS;
+    }
+    catch (const usage_error& e)
+    {
+        std::cerr << "Error: " << e.what() << '\n';
+        show_usage(invocation.c_str());
+    }
+    catch (const std::exception& e)
+    {
+        stdext::format(stdext::strerr(), "Error: $0\n", e.what());
+    }
+    catch (...)
+    {
+        stdext::format(stdext::strerr(), "Unknown error\n");
+    }
+
+    return EXIT_FAILURE;
+}
+
+namespace
+{
+    program_options parse_args(int argc, wchar_t* argv[])
+    {
+        program_options options;
+
+        for (int n = 1; n < argc; ++n)
+        {
+            if (argv[n][0] == L'-')
+            {
+                if (wcscmp(argv[n], L"-o") == 0)
+                {
+                    if (++n == argc)
+                        throw usage_error("Expected output path for -o");
+                    if (options.output_path != nullptr)
+                        throw usage_error("The -o option can only be used once");
+                    options.output_path = argv[n];
+                }
+                else if (wcscmp(argv[n], L"-prefix") == 0)
+                {
+                    if (++n == argc)
+                        throw usage_error("Expected prefix");
+                    if (options.prefix != nullptr)
+                        throw usage_error("The -prefix option can only be used once");
+                    options.prefix = argv[n];
+                }
+                else
+                    throw usage_error("Unrecognized option: " + stdext::to_mbstring(argv[n]));
+            }
+            else
+            {
+                if (options.input_path != nullptr)
+                    throw usage_error("Unexpected argument: " + stdext::to_mbstring(argv[n]));
+                options.input_path = argv[n];
+            }
+        }
+
+        if (options.input_path == nullptr)
+            throw usage_error("Missing input path");
+        if (options.output_path == nullptr)
+            throw usage_error("Missing output path");
+        if (options.prefix == nullptr)
+            options.prefix = L"";
+
+        return options;
+    }
+
+    void show_usage(const wchar_t* invocation)
+    {
+        std::wcout << L"Usage:\n"
+            L"    " << invocation << " -o <output_path> [-prefix <name_prefix>] <input_path>\n"
+            L"\n"
+            L"input_path is a frame capture written by wcdx.  To record one, set the DWORD\n"
+            L"value RecordFrames under HKEY_CURRENT_USER\\Software\\wcdx to 1; captures are\n"
+            L"saved in the game's working directory.\n"
+            L"\n"
+            L"output_path is a directory to which every frame in the capture is written as\n"
+            L"a PNG-encoded image file.  Files are named according to the number of the\n"
+            L"frame, with an optional prefix.  Frames that the game presented while the\n"
+            L"recorder was falling behind are missing from the capture, and show up as gaps\n"
+            L"in the numbering.\n"
+            L"\n"
+            L"name_prefix is a string that will be prepended to the names of the files that\n"
+            L"will be written to the output directory.\n";
+    }
+
+    void extract_frames(const program_options& options)
+    {
+        wcdx::resource::mapped_file file(options.input_path);
+        stdext::memory_input_stream input(file.data(), file.size());
+        wcdx::frame::capture_reader capture(input);
+
+        auto pixel_count = size_t(capture.width()) * capture.height();
+        std::byte palette[3 * 256];
+        size_t frame_count = 0;
+        while (capture.next())
+        {
+            for (unsigned n = 0; n != 256; ++n)
+            {
+                auto color = capture.palette()[n];
+                palette[3 * n] = std::byte(color >> 16);
+                palette[3 * n + 1] = std::byte(color >> 8);
+                palette[3 * n + 2] = std::byte(color);
+            }
+
+            stdext::array_view<const std::byte> palette_view(palette, std::size(palette));
+            stdext::memory_input_stream pixels(capture.pixels(), pixel_count);
+            stdext::file_output_stream out(stdext::format_string("$0\\$1${2:06}.png", options.output_path, options.prefix, capture.frame_number()).c_str(), stdext::utf8_path_encoding());
+            wcdx::image::write_image({ capture.width(), capture.height() }, palette_view, pixels, out, wcdx::image::compression::fast);
+            ++frame_count;
+        }
+
+        std::cout << frame_count << " frames written\n";
+    }
+}
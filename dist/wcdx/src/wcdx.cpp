@@ -1,12 +1,10 @@
 #include "wcdx.h"
 
-#include <image/image.h>
-#include <image/resources.h>
+#include <metrics/report.h>
 
 #include <stdext/array_view.h>
 #include <stdext/scope_guard.h>
 #include <stdext/file.h>
-#include <stdext/format.h>
 #include <stdext/multi.h>
 #include <stdext/utility.h>
 
@@ -14,8 +12,12 @@
 #include <iterator>
 #include <limits>
 #include <random>
+#include <string>
 #include <system_error>
 
+#include <cstring>
+#include <ctime>
+
 #include <io.h>
 #include <fcntl.h>
 
@@ -30,14 +32,32 @@ namespace
         WM_APP_RENDER = WM_APP
     };
 
+    // Room for a few seconds of full-screen changes if the disk stalls.
+    constexpr size_t CaptureBufferSize = 4 << 20;
+
+    class CrtFileDevice : public wcdx::fileio::file_device
+    {
+    public:
+        explicit CrtFileDevice(int filedesc) : _filedesc(filedesc) { }
+
+    public:
+        int64_t seek(int64_t offset, wcdx::fileio::seek_origin origin) override;
+        int64_t read(void* data, size_t size) override;
+        int64_t write(const void* data, size_t size) override;
+        int64_t length() override;
+
+    private:
+        int _filedesc;
+    };
+
     POINT ConvertTo(POINT point, RECT rect);
     POINT ConvertFrom(POINT point, RECT rect);
     HRESULT GetSavedGamePath(LPCWSTR subdir, LPWSTR path);
     HRESULT GetLocalAppDataPath(LPCWSTR subdir, LPWSTR path);
 
     bool CreateDirectoryRecursive(LPWSTR pathName);
-
-    std::independent_bits_engine<std::mt19937, 1, unsigned int> RandomBit(std::random_device{}());
+    std::string TimestampedFileName(const char* prefix, const char* extension);
+    wcdx::frame::color ToFrameColor(const WcdxColor& color);
 }
 
 WCDXAPI IWcdx* WcdxCreate(LPCWSTR windowTitle, WNDPROC windowProc, BOOL _fullScreen)
@@ -54,10 +74,8 @@ WCDXAPI IWcdx* WcdxCreate(LPCWSTR windowTitle, WNDPROC windowProc, BOOL _fullScr
 
 Wcdx::Wcdx(LPCWSTR title, WNDPROC windowProc, bool _fullScreen)
     : _refCount(1), _monitor(nullptr), _clientWindowProc(windowProc), _frameStyle(WS_OVERLAPPEDWINDOW), _frameExStyle(WS_EX_OVERLAPPEDWINDOW)
-    , _fullScreen(false), _dirty(false), _sizeChanged(false)
-#if DEBUG_SCREENSHOTS
-    , _screenshotFrameCounter(0), _screenshotIndex(0), _screenshotFileIndex(0)
-#endif
+    , _frame(ContentWidth, ContentHeight), _snow(std::random_device{}()), _fullScreen(false), _dirty(false), _sizeChanged(false)
+    , _threadedPresent(false), _presentSequence(0), _renderStop(false), _renderResult(S_OK), _writeMetrics(false)
 {
     // Create the window.
     auto hwnd = ::CreateWindowEx(_frameExStyle,
@@ -74,6 +92,9 @@ Wcdx::Wcdx(LPCWSTR title, WNDPROC windowProc, bool _fullScreen)
     OnSizing(WMSZ_TOP, &_frameRect);
     ::MoveWindow(_window, _frameRect.left, _frameRect.top, _frameRect.right - _frameRect.left, _frameRect.bottom - _frameRect.top, FALSE);
 
+    _threadedPresent = QueryConfigValue(L"ThreadedPresent", 0) != 0;
+    _writeMetrics = QueryConfigValue(L"WriteMetrics", 0) != 0;
+
     // Initialize D3D.
     _d3d = ::Direct3DCreate9(D3D_SDK_VERSION);
 
@@ -86,22 +107,33 @@ Wcdx::Wcdx(LPCWSTR title, WNDPROC windowProc, bool _fullScreen)
     if (FAILED(hr = RecreateDevice(adapter)))
         _com_raise_error(hr);
 
-    WcdxColor defColor = { 0, 0, 0, 0xFF };
-    std::fill_n(_palette, std::size(_palette), defColor);
-
     SetFullScreen(IsDebuggerPresent() ? false : _fullScreen);
 
-#if DEBUG_SCREENSHOTS
-    auto res = ::FindResource(DllInstance, MAKEINTRESOURCE(RESOURCE_ID_WC1PAL), RT_RCDATA);
-    if (res == nullptr)
-        throw std::system_error(::GetLastError(), std::system_category());
-    auto resp = ::LoadResource(DllInstance, res);
-    _screenshotPalette = static_cast<const std::byte*>(::LockResource(resp)) + 0x30;
-    _screenshotPaletteSize = 0x300;
-#endif
+    if (_threadedPresent)
+        StartRenderThread();
+
+    if (QueryConfigValue(L"RecordFrames", 0) != 0)
+        StartRecording();
+
+    if (QueryConfigValue(L"TraceCalls", 0) != 0)
+        StartTracing();
 }
 
-Wcdx::~Wcdx() = default;
+Wcdx::~Wcdx()
+{
+    StopRenderThread();
+
+    // The game doesn't always close its files before exiting.
+    for (auto& entry : _files)
+    {
+        entry.second->flush();
+        _fileStats += entry.second->stats();
+    }
+    _files.clear();
+
+    if (_writeMetrics)
+        WriteMetrics();
+}
 
 HRESULT STDMETHODCALLTYPE Wcdx::QueryInterface(REFIID riid, void** ppvObject)
 {
@@ -143,6 +175,7 @@ ULONG STDMETHODCALLTYPE Wcdx::Release()
 
 HRESULT STDMETHODCALLTYPE Wcdx::SetVisible(BOOL visible)
 {
+    Trace(wcdx::trace::call_id::set_visible);
     ::ShowWindow(_window, visible ? SW_SHOW : SW_HIDE);
     if (visible)
         ::PostMessage(_window, WM_APP_RENDER, 0, 0);
@@ -152,54 +185,80 @@ HRESULT STDMETHODCALLTYPE Wcdx::SetVisible(BOOL visible)
 
 HRESULT STDMETHODCALLTYPE Wcdx::SetPalette(const WcdxColor entries[256])
 {
-    std::copy_n(entries, 256, _palette);
-    _dirty = true;
+    wcdx::metrics::scoped_timer timer(Histogram(Metric::SetPalette));
+    wcdx::frame::color colors[256];
+    std::transform(entries, entries + 256, colors, ToFrameColor);
+    if (_trace != nullptr)
+        _trace->set_palette(colors);
+    _frame.set_palette(colors);
     return S_OK;
 }
 
 HRESULT STDMETHODCALLTYPE Wcdx::UpdatePalette(UINT index, const WcdxColor* entry)
 {
-    _palette[index] = *entry;
-    _dirty = true;
+    wcdx::metrics::scoped_timer timer(Histogram(Metric::UpdatePalette));
+    auto color = ToFrameColor(*entry);
+    if (_trace != nullptr)
+        _trace->update_palette(index, color);
+    _frame.update_palette(index, color);
     return S_OK;
 }
 
 HRESULT STDMETHODCALLTYPE Wcdx::UpdateFrame(INT x, INT y, UINT width, UINT height, UINT pitch, const byte* bits)
 {
-    RECT rect = { x, y, LONG(x + width), LONG(y + height) };
-    RECT clipped =
-    {
-        std::max(rect.left, LONG(0)),
-        std::max(rect.top, LONG(0)),
-        std::min(rect.right, LONG(ContentWidth)),
-        std::min(rect.bottom, LONG(ContentHeight))
-    };
+    wcdx::metrics::scoped_timer timer(Histogram(Metric::UpdateFrame));
+    if (_trace != nullptr)
+        _trace->update_frame(x, y, width, height, pitch, reinterpret_cast<const std::byte*>(bits));
+    _frame.update_frame(x, y, width, height, pitch, reinterpret_cast<const std::byte*>(bits));
+    return S_OK;
+}
 
-    auto src = reinterpret_cast<const std::byte*>(bits);
-    auto dest = _framebuffer + clipped.left + (ContentWidth * clipped.top);
-    width = clipped.right - clipped.left;
-    for (height = clipped.bottom - clipped.top; height-- > 0; )
+HRESULT STDMETHODCALLTYPE Wcdx::Present()
+{
+    Trace(wcdx::trace::call_id::present);
+    wcdx::metrics::scoped_timer timer(Histogram(Metric::Present));
+    if (_recorder != nullptr)
     {
-        std::copy_n(src, width, dest);
-        src += pitch;
-        dest += ContentWidth;
+        wcdx::metrics::scoped_timer recordTimer(Histogram(Metric::RecordFrame));
+        _recorder->record(_frame.pixels(), _frame.palette());
     }
-    _dirty = true;
-    return S_OK;
+
+    return PresentInternal();
 }
 
-HRESULT STDMETHODCALLTYPE Wcdx::Present()
+HRESULT Wcdx::PresentInternal()
 {
     HRESULT hr;
-    if (FAILED(hr = _device->TestCooperativeLevel()))
+    if (!_renderThread.joinable())
     {
-        if (hr != D3DERR_DEVICENOTRESET)
+        if (FAILED(hr = RestoreDevice()))
             return hr;
 
-        if (FAILED(hr = ResetDevice()))
-            return hr;
+        return PresentFrame(_frame);
+    }
+
+    // Failures on the render thread are reported on the next call.  A lost
+    // device is reset here because Reset must happen on the window's thread.
+    hr = _renderResult.exchange(S_OK);
+    if (hr == D3DERR_DEVICENOTRESET)
+    {
+        std::lock_guard<std::recursive_mutex> lock(_deviceMutex);
+        hr = RestoreDevice();
     }
 
+    auto& snapshot = _presentQueue->back();
+    std::copy_n(_frame.pixels(), ContentWidth * ContentHeight, snapshot.pixels.get());
+    std::copy_n(_frame.palette(), std::size(snapshot.palette), snapshot.palette);
+    snapshot.sequence = ++_presentSequence;
+    _presentQueue->publish();
+    ::SetEvent(_renderEvent);
+
+    return hr;
+}
+
+HRESULT Wcdx::PresentFrame(wcdx::frame::frame_converter& frame)
+{
+    HRESULT hr;
     RECT clientRect;
     ::GetClientRect(_window, &clientRect);
 
@@ -208,50 +267,23 @@ HRESULT STDMETHODCALLTYPE Wcdx::Present()
     {
         at_scope_exit([&]{ _device->EndScene(); });
 
-        if (_dirty)
+        // Only the parts of the frame touched by UpdateFrame or by palette
+        // changes are converted; the rest of the surface keeps its contents.
+        auto bounds = frame.dirty_bounds();
+        if (!wcdx::frame::empty(bounds))
         {
             D3DLOCKED_RECT locked;
-            RECT bounds = { 0, 0, ContentWidth, ContentHeight };
-            if (FAILED(hr = _surface->LockRect(&locked, &bounds, D3DLOCK_DISCARD)))
+            RECT lockRect = { bounds.left, bounds.top, bounds.right, bounds.bottom };
+            if (FAILED(hr = _surface->LockRect(&locked, &lockRect, 0)))
                 return hr;
             {
+                wcdx::metrics::scoped_timer timer(Histogram(Metric::ConvertFrame));
                 at_scope_exit([&]{ _surface->UnlockRect(); });
-
-                const std::byte* src = _framebuffer;
-                auto dest = static_cast<WcdxColor*>(locked.pBits);
-                for (int row = 0; row < ContentHeight; ++row)
-                {
-                    std::transform(src, src + ContentWidth, dest, [&](std::byte index)
-                    {
-                        return _palette[uint8_t(index)];
-                    });
-
-                    src += ContentWidth;
-                    dest += locked.Pitch / sizeof(*dest);
-                }
+                frame.convert(locked.pBits, locked.Pitch, bounds);
             }
+            _dirty = true;
         }
 
-#if DEBUG_SCREENSHOTS
-        std::copy_n(_framebuffer, std::size(_framebuffer), _screenshotBuffers[_screenshotIndex]);
-        if (++_screenshotIndex == std::size(_screenshotBuffers))
-            _screenshotIndex = 0;
-
-        if (_screenshotFrameCounter != 0 && --_screenshotFrameCounter == 0)
-        {
-            for (size_t n = 0; n != std::size(_screenshotBuffers); ++n)
-            {
-                auto index = (_screenshotIndex + n) % std::size(_screenshotBuffers);
-                auto& buffer = _screenshotBuffers[index];
-                stdext::array_view<const std::byte> paletteView(_screenshotPalette, _screenshotPaletteSize);
-                stdext::memory_input_stream bufferStream(buffer, sizeof(buffer));
-                stdext::file_output_stream file(stdext::format_string("screenshot${0:03}.png", _screenshotFileIndex).c_str(), stdext::utf8_path_encoding());
-                wcdx::image::write_image({ ContentWidth, ContentHeight }, paletteView, bufferStream, file);
-                ++_screenshotFileIndex;
-            }
-        }
-#endif
-
         RECT activeRect = GetContentRect(clientRect);
         if (_sizeChanged)
         {
@@ -279,6 +311,7 @@ HRESULT STDMETHODCALLTYPE Wcdx::Present()
 
         if (_dirty || _sizeChanged)
         {
+            wcdx::metrics::scoped_timer timer(Histogram(Metric::StretchFrame));
             IDirect3DSurface9Ptr backBuffer;
             if (FAILED(hr = _device->GetBackBuffer(0, 0, D3DBACKBUFFER_TYPE_MONO, &backBuffer)))
                 return hr;
@@ -289,6 +322,7 @@ HRESULT STDMETHODCALLTYPE Wcdx::Present()
         }
     }
 
+    wcdx::metrics::scoped_timer timer(Histogram(Metric::PresentDevice));
     if (FAILED(hr = _device->Present(&clientRect, nullptr, nullptr, nullptr)))
         return hr;
 
@@ -297,11 +331,13 @@ HRESULT STDMETHODCALLTYPE Wcdx::Present()
 
 HRESULT STDMETHODCALLTYPE Wcdx::IsFullScreen()
 {
+    Trace(wcdx::trace::call_id::is_full_screen);
     return _fullScreen ? S_OK : S_FALSE;
 }
 
 HRESULT STDMETHODCALLTYPE Wcdx::ConvertPointToClient(POINT* point)
 {
+    Trace(wcdx::trace::call_id::convert_point_to_client);
     if (point == nullptr)
         return E_POINTER;
 
@@ -315,6 +351,7 @@ HRESULT STDMETHODCALLTYPE Wcdx::ConvertPointToClient(POINT* point)
 
 HRESULT STDMETHODCALLTYPE Wcdx::ConvertPointFromClient(POINT* point)
 {
+    Trace(wcdx::trace::call_id::convert_point_from_client);
     if (point == nullptr)
         return E_POINTER;
 
@@ -328,6 +365,7 @@ HRESULT STDMETHODCALLTYPE Wcdx::ConvertPointFromClient(POINT* point)
 
 HRESULT STDMETHODCALLTYPE Wcdx::ConvertRectToClient(RECT* rect)
 {
+    Trace(wcdx::trace::call_id::convert_rect_to_client);
     if (rect == nullptr)
         return E_POINTER;
 
@@ -343,6 +381,7 @@ HRESULT STDMETHODCALLTYPE Wcdx::ConvertRectToClient(RECT* rect)
 
 HRESULT STDMETHODCALLTYPE Wcdx::ConvertRectFromClient(RECT* rect)
 {
+    Trace(wcdx::trace::call_id::convert_rect_from_client);
     if (rect == nullptr)
         return E_POINTER;
 
@@ -358,6 +397,8 @@ HRESULT STDMETHODCALLTYPE Wcdx::ConvertRectFromClient(RECT* rect)
 
 HRESULT STDMETHODCALLTYPE Wcdx::SavedGameOpen(const wchar_t* subdir, const wchar_t* filename, int oflag, int pmode, int* filedesc)
 {
+    Trace(wcdx::trace::call_id::saved_game_open);
+    wcdx::metrics::scoped_timer timer(Histogram(Metric::OpenFile));
     if (subdir == nullptr || filename == nullptr || filedesc == nullptr)
         return E_POINTER;
 
@@ -389,7 +430,10 @@ HRESULT STDMETHODCALLTYPE Wcdx::SavedGameOpen(const wchar_t* subdir, const wchar
 
             auto error = _wsopen_s(filedesc, path, oflag, _SH_DENYNO, pmode);
             if (*filedesc != -1)
+            {
+                TrackFile(*filedesc, oflag);
                 return S_OK;
+            }
 
             if (error != ENOENT)
                 return E_FAIL;
@@ -427,7 +471,10 @@ HRESULT STDMETHODCALLTYPE Wcdx::SavedGameOpen(const wchar_t* subdir, const wchar
 
     _wsopen_s(filedesc, filename, oflag, _SH_DENYNO, pmode);
     if (*filedesc != -1)
+    {
+        TrackFile(*filedesc, oflag);
         return S_OK;
+    }
 
     *filedesc = -1;
     return E_FAIL;
@@ -435,22 +482,43 @@ HRESULT STDMETHODCALLTYPE Wcdx::SavedGameOpen(const wchar_t* subdir, const wchar
 
 HRESULT STDMETHODCALLTYPE Wcdx::OpenFile(const char* filename, int oflag, int pmode, int* filedesc)
 {
+    Trace(wcdx::trace::call_id::open_file);
+    wcdx::metrics::scoped_timer timer(Histogram(Metric::OpenFile));
     if (filename == nullptr || filedesc == nullptr)
         return E_POINTER;
 
-    return _sopen_s(filedesc, filename, oflag, _SH_DENYNO, pmode) == 0 ? S_OK : E_FAIL;
+    if (_sopen_s(filedesc, filename, oflag, _SH_DENYNO, pmode) != 0)
+        return E_FAIL;
+
+    TrackFile(*filedesc, oflag);
+    return S_OK;
 }
 
 HRESULT STDMETHODCALLTYPE Wcdx::CloseFile(int filedesc)
 {
-    return _close(filedesc) == 0 ? S_OK : E_FAIL;
+    Trace(wcdx::trace::call_id::close_file);
+    wcdx::metrics::scoped_timer timer(Histogram(Metric::CloseFile));
+    bool flushed = true;
+    if (auto i = _files.find(filedesc); i != _files.end())
+    {
+        flushed = i->second->flush();
+        _fileStats += i->second->stats();
+        _files.erase(i);
+    }
+
+    return _close(filedesc) == 0 && flushed ? S_OK : E_FAIL;
 }
 
 HRESULT STDMETHODCALLTYPE Wcdx::WriteFile(int filedesc, long offset, unsigned int size, const void* data)
 {
+    Trace(wcdx::trace::call_id::write_file);
+    wcdx::metrics::scoped_timer timer(Histogram(Metric::WriteFile));
     if (size > 0 && data == nullptr)
         return E_POINTER;
 
+    if (auto file = FindFile(filedesc))
+        return file->write(offset, data, size) != -1 ? S_OK : E_FAIL;
+
     if (offset != -1 && _lseek(filedesc, offset, SEEK_SET) == -1)
         return E_FAIL;
 
@@ -459,9 +527,14 @@ HRESULT STDMETHODCALLTYPE Wcdx::WriteFile(int filedesc, long offset, unsigned in
 
 HRESULT STDMETHODCALLTYPE Wcdx::ReadFile(int filedesc, long offset, unsigned int size, void* data)
 {
+    Trace(wcdx::trace::call_id::read_file);
+    wcdx::metrics::scoped_timer timer(Histogram(Metric::ReadFile));
     if (size > 0 && data == nullptr)
         return E_POINTER;
 
+    if (auto file = FindFile(filedesc))
+        return file->read(offset, data, size) != -1 ? S_OK : E_FAIL;
+
     if (offset != -1 && _lseek(filedesc, offset, SEEK_SET) == -1)
         return E_FAIL;
 
@@ -470,24 +543,52 @@ HRESULT STDMETHODCALLTYPE Wcdx::ReadFile(int filedesc, long offset, unsigned int
 
 HRESULT STDMETHODCALLTYPE Wcdx::SeekFile(int filedesc, long offset, int method, long* position)
 {
+    Trace(wcdx::trace::call_id::seek_file);
+    wcdx::metrics::scoped_timer timer(Histogram(Metric::SeekFile));
     if (position == nullptr)
         return E_POINTER;
 
-    *position = _lseek(filedesc, offset, method);
+    if (auto file = FindFile(filedesc))
+    {
+        wcdx::fileio::seek_origin origin;
+        switch (method)
+        {
+        case SEEK_SET:
+            origin = wcdx::fileio::seek_origin::begin;
+            break;
+        case SEEK_CUR:
+            origin = wcdx::fileio::seek_origin::current;
+            break;
+        case SEEK_END:
+            origin = wcdx::fileio::seek_origin::end;
+            break;
+        default:
+            *position = -1;
+            return E_FAIL;
+        }
+
+        *position = long(file->seek(offset, origin));
+    }
+    else
+        *position = _lseek(filedesc, offset, method);
+
     return *position != -1 ? S_OK : E_FAIL;
 }
 
 HRESULT STDMETHODCALLTYPE Wcdx::FileLength(int filedesc, long *length)
 {
+    Trace(wcdx::trace::call_id::file_length);
     if (length == nullptr)
         return E_POINTER;
 
-    *length = _filelength(filedesc);
+    auto file = FindFile(filedesc);
+    *length = file != nullptr ? long(file->length()) : _filelength(filedesc);
     return S_OK;
 }
 
 HRESULT STDMETHODCALLTYPE Wcdx::ConvertPointToScreen(POINT* point)
 {
+    Trace(wcdx::trace::call_id::convert_point_to_screen);
     HRESULT hr;
     if (FAILED(hr = ConvertPointToClient(point)))
         return hr;
@@ -497,6 +598,7 @@ HRESULT STDMETHODCALLTYPE Wcdx::ConvertPointToScreen(POINT* point)
 
 HRESULT STDMETHODCALLTYPE Wcdx::ConvertPointFromScreen(POINT* point)
 {
+    Trace(wcdx::trace::call_id::convert_point_from_screen);
     if (point == nullptr)
         return E_POINTER;
 
@@ -506,6 +608,7 @@ HRESULT STDMETHODCALLTYPE Wcdx::ConvertPointFromScreen(POINT* point)
 
 HRESULT STDMETHODCALLTYPE Wcdx::ConvertRectToScreen(RECT* rect)
 {
+    Trace(wcdx::trace::call_id::convert_rect_to_screen);
     HRESULT hr;
     if (FAILED(hr = ConvertRectToClient(rect)))
         return E_POINTER;
@@ -516,6 +619,7 @@ HRESULT STDMETHODCALLTYPE Wcdx::ConvertRectToScreen(RECT* rect)
 
 HRESULT STDMETHODCALLTYPE Wcdx::ConvertRectFromScreen(RECT* rect)
 {
+    Trace(wcdx::trace::call_id::convert_rect_from_screen);
     if (rect == nullptr)
         return E_POINTER;
 
@@ -526,6 +630,7 @@ HRESULT STDMETHODCALLTYPE Wcdx::ConvertRectFromScreen(RECT* rect)
 
 HRESULT STDMETHODCALLTYPE Wcdx::QueryValue(const wchar_t* keyname, const wchar_t* valuename, void* data, DWORD* size)
 {
+    Trace(wcdx::trace::call_id::query_value);
     HKEY roots[] = { HKEY_CURRENT_USER, HKEY_LOCAL_MACHINE };
 
     for (auto root : roots)
@@ -546,6 +651,7 @@ HRESULT STDMETHODCALLTYPE Wcdx::QueryValue(const wchar_t* keyname, const wchar_t
 
 HRESULT STDMETHODCALLTYPE Wcdx::SetValue(const wchar_t* keyname, const wchar_t* valuename, DWORD type, const void* data, DWORD size)
 {
+    Trace(wcdx::trace::call_id::set_value);
     HKEY key;
     auto error = ::RegCreateKeyEx(HKEY_CURRENT_USER, keyname, 0, nullptr, 0, KEY_SET_VALUE, nullptr, &key, nullptr);
     if (error != ERROR_SUCCESS)
@@ -558,13 +664,10 @@ HRESULT STDMETHODCALLTYPE Wcdx::SetValue(const wchar_t* keyname, const wchar_t*
 
 HRESULT STDMETHODCALLTYPE Wcdx::FillSnow(byte color_index, INT x, INT y, UINT width, UINT height, UINT pitch, byte* pixels)
 {
-    for (UINT h = 0; h != height; ++h)
-    {
-        auto p = pixels + (y * pitch) + x;
-        for (UINT w = 0; w != width; ++w)
-            *p++ = byte(RandomBit() * color_index);
-        ++y;
-    }
+    Trace(wcdx::trace::call_id::fill_snow);
+    wcdx::metrics::scoped_timer timer(Histogram(Metric::FillSnow));
+    auto p = pixels + (y * pitch) + x;
+    _snow.fill(reinterpret_cast<std::byte*>(p), pitch, width, height, std::byte(color_index));
 
     return S_OK;
 }
@@ -652,6 +755,11 @@ LRESULT CALLBACK Wcdx::FrameWindowProc(HWND hwnd, UINT message, WPARAM wParam, L
                 return 0;
             break;
 
+        case WM_SYSKEYDOWN:
+            if (wcdx->OnSysKeyDown(DWORD(wParam), LOWORD(lParam), HIWORD(lParam)))
+                return 0;
+            break;
+
         case WM_SYSCOMMAND:
             if (wcdx->OnSysCommand(WORD(wParam), LOWORD(lParam), HIWORD(lParam)))
                 return 0;
@@ -692,6 +800,9 @@ void Wcdx::OnWindowPosChanged(WINDOWPOS* windowPos)
     if ((windowPos->flags & SWP_HIDEWINDOW) != 0 || _d3d == nullptr)
         return;
 
+    // CreateDevice can send this message again, hence the recursive mutex.
+    std::lock_guard<std::recursive_mutex> lock(_deviceMutex);
+
     HRESULT hr;
     UINT adapter;
     if (FAILED(hr = UpdateMonitor(adapter)))
@@ -730,6 +841,19 @@ bool Wcdx::OnSysChar(DWORD vkey, WORD repeatCount, WORD flags)
     return false;
 }
 
+bool Wcdx::OnSysKeyDown(DWORD vkey, WORD repeatCount, WORD flags)
+{
+    stdext::discard(repeatCount);
+
+    if (vkey == VK_F11 && ((flags & (KF_REPEAT | KF_ALTDOWN)) == KF_ALTDOWN))
+    {
+        WriteMetrics();
+        return true;
+    }
+
+    return false;
+}
+
 bool Wcdx::OnSysCommand(WORD type, SHORT x, SHORT y)
 {
     stdext::discard(x, y);
@@ -823,9 +947,180 @@ void Wcdx::OnSizing(DWORD windowEdge, RECT* dragRect)
 
 void Wcdx::OnRender()
 {
-    Present();
+    // Redraws aren't calls from the game, so they're left out of the trace,
+    // the capture, and the Present timings.
+    PresentInternal();
+}
+
+void Wcdx::StartRecording()
+{
+    // Captures go in the working directory, named for when recording started.
+    auto filename = TimestampedFileName("capture", "wcap");
+
+    // Recording is a diagnostic aid; failing to start it shouldn't keep the
+    // game from running.
+    try
+    {
+        _captureFile = std::make_unique<stdext::file_output_stream>(filename.c_str(), stdext::utf8_path_encoding());
+        _recorder = std::make_unique<wcdx::frame::frame_recorder>(ContentWidth, ContentHeight, *_captureFile, CaptureBufferSize);
+    }
+    catch (const std::exception&)
+    {
+        _recorder = nullptr;
+        _captureFile = nullptr;
+    }
+}
+
+void Wcdx::StartTracing()
+{
+    auto filename = TimestampedFileName("trace", "wctrace");
+
+    try
+    {
+        _traceFile = std::make_unique<stdext::file_output_stream>(filename.c_str(), stdext::utf8_path_encoding());
+        _trace = std::make_unique<wcdx::trace::trace_writer>(ContentWidth, ContentHeight, *_traceFile);
+    }
+    catch (const std::exception&)
+    {
+        _trace = nullptr;
+        _traceFile = nullptr;
+    }
+}
+
+void Wcdx::StartRenderThread()
+{
+    auto event = ::CreateEvent(nullptr, FALSE, FALSE, nullptr);
+    if (event == nullptr)
+        throw std::system_error(::GetLastError(), std::system_category());
+    _renderEvent.Reset(event, &::CloseHandle);
+
+    _presentQueue = std::make_unique<wcdx::frame::frame_queue>(unsigned(ContentWidth), unsigned(ContentHeight));
+    _renderFrame = std::make_unique<wcdx::frame::frame_converter>(ContentWidth, ContentHeight);
+    _renderThread = std::thread([this]{ RenderThread(); });
 }
 
+void Wcdx::StopRenderThread()
+{
+    if (!_renderThread.joinable())
+        return;
+
+    _renderStop = true;
+    ::SetEvent(_renderEvent);
+    _renderThread.join();
+}
+
+void Wcdx::RenderThread()
+{
+    while (::WaitForSingleObject(_renderEvent, INFINITE) == WAIT_OBJECT_0 && !_renderStop)
+    {
+        std::lock_guard<std::recursive_mutex> lock(_deviceMutex);
+
+        // Frames published while the previous one was being presented are
+        // skipped; only the most recent one is shown.
+        if (_presentQueue->acquire())
+        {
+            auto& snapshot = _presentQueue->front();
+            _renderFrame->assign(snapshot.pixels.get(), snapshot.palette);
+        }
+
+        auto hr = _device->TestCooperativeLevel();
+        if (SUCCEEDED(hr))
+            hr = PresentFrame(*_renderFrame);
+        if (FAILED(hr))
+            _renderResult = hr;
+    }
+}
+
+wcdx::frame::frame_converter& Wcdx::PresentedFrame()
+{
+    return _renderFrame != nullptr ? *_renderFrame : _frame;
+}
+
+DWORD Wcdx::QueryConfigValue(const wchar_t* valuename, DWORD defaultValue)
+{
+    DWORD value;
+    DWORD size = sizeof(value);
+    if (FAILED(QueryValue(L"Software\\wcdx", valuename, &value, &size)) || size != sizeof(value))
+        return defaultValue;
+
+    return value;
+}
+
+void Wcdx::TrackFile(int filedesc, int oflag)
+{
+    // Text mode translates line endings, so byte counts and file offsets
+    // don't line up, and appends ignore the file position; files opened
+    // either way are left unbuffered.
+    if ((oflag & (_O_BINARY | _O_APPEND)) != _O_BINARY)
+        return;
+
+    _files[filedesc] = std::make_unique<wcdx::fileio::buffered_file>(std::make_unique<CrtFileDevice>(filedesc));
+}
+
+wcdx::fileio::buffered_file* Wcdx::FindFile(int filedesc)
+{
+    auto i = _files.find(filedesc);
+    return i != _files.end() ? i->second.get() : nullptr;
+}
+
+void Wcdx::WriteMetrics()
+{
+    wcdx::metrics::named_histogram histograms[size_t(Metric::Count)];
+    for (size_t n = 0; n != size_t(Metric::Count); ++n)
+        histograms[n] = { MetricNames[n], &_metrics[n] };
+
+    auto report = wcdx::metrics::format_report(stdext::array_view<const wcdx::metrics::named_histogram>(histograms, std::size(histograms)));
+
+    auto fileStats = _fileStats;
+    for (auto& entry : _files)
+        fileStats += entry.second->stats();
+
+    char line[160];
+    if (SUCCEEDED(StringCchPrintfA(line, std::size(line), "\nfile cache: %llu read hits, %llu read misses, %lld system calls saved\n",
+        fileStats.read_hits, fileStats.read_misses, fileStats.syscalls_saved())))
+    {
+        report += line;
+    }
+    if (_recorder != nullptr && SUCCEEDED(StringCchPrintfA(line, std::size(line), "frame capture: %u frames recorded, %u dropped\n",
+        _recorder->recorded_count(), _recorder->dropped_count())))
+    {
+        report += line;
+    }
+
+    ::OutputDebugStringA(report.c_str());
+
+    // Reports go in the working directory alongside captures.  Failing to
+    // write one is not worth interrupting the game over.
+    try
+    {
+        stdext::file_output_stream file(TimestampedFileName("metrics", "txt").c_str(), stdext::utf8_path_encoding());
+        file.write_all(report.data(), report.size());
+    }
+    catch (const std::exception&)
+    {
+    }
+}
+
+const char* const Wcdx::MetricNames[] =
+{
+    "SetPalette",
+    "UpdatePalette",
+    "UpdateFrame",
+    "Present",
+    "FillSnow",
+    "OpenFile",
+    "CloseFile",
+    "ReadFile",
+    "WriteFile",
+    "SeekFile",
+    "Present: record",
+    "Present: convert",
+    "Present: stretch",
+    "Present: device",
+    "RestoreDevice",
+    "ResetDevice",
+};
+
 HRESULT Wcdx::UpdateMonitor(UINT& adapter)
 {
     adapter = D3DADAPTER_DEFAULT;
@@ -879,7 +1174,11 @@ HRESULT Wcdx::RecreateDevice(UINT adapter)
         0, 0, D3DPRESENT_INTERVAL_DEFAULT
     };
 
-    if (FAILED(hr = _d3d->CreateDevice(adapter, D3DDEVTYPE_HAL, _window, D3DCREATE_SOFTWARE_VERTEXPROCESSING, &_presentParams, &_device)))
+    DWORD flags = D3DCREATE_SOFTWARE_VERTEXPROCESSING;
+    if (_threadedPresent)
+        flags |= D3DCREATE_MULTITHREADED;
+
+    if (FAILED(hr = _d3d->CreateDevice(adapter, D3DDEVTYPE_HAL, _window, flags, &_presentParams, &_device)))
         return hr;
 
     if (FAILED(hr = CreateIntermediateSurface()))
@@ -888,8 +1187,25 @@ HRESULT Wcdx::RecreateDevice(UINT adapter)
     return S_OK;
 }
 
+HRESULT Wcdx::RestoreDevice()
+{
+    wcdx::metrics::scoped_timer timer(Histogram(Metric::RestoreDevice));
+    HRESULT hr;
+    if (FAILED(hr = _device->TestCooperativeLevel()))
+    {
+        if (hr != D3DERR_DEVICENOTRESET)
+            return hr;
+
+        if (FAILED(hr = ResetDevice()))
+            return hr;
+    }
+
+    return S_OK;
+}
+
 HRESULT Wcdx::ResetDevice()
 {
+    wcdx::metrics::scoped_timer timer(Histogram(Metric::ResetDevice));
     HRESULT hr;
     _surface = nullptr;
     if (FAILED(hr = _device->Reset(&_presentParams)))
@@ -903,7 +1219,7 @@ HRESULT Wcdx::ResetDevice()
 
 HRESULT Wcdx::CreateIntermediateSurface()
 {
-    _dirty = true;
+    PresentedFrame().invalidate();
     return _device->CreateOffscreenPlainSurface(ContentWidth, ContentHeight, D3DFMT_X8R8G8B8, D3DPOOL_DEFAULT, &_surface, nullptr);
 }
 
@@ -1069,4 +1385,47 @@ namespace
         *i = L'\\';
         return result && ::CreateDirectory(pathName, nullptr);
     }
+
+    std::string TimestampedFileName(const char* prefix, const char* extension)
+    {
+        auto now = std::time(nullptr);
+        std::tm local;
+        ::localtime_s(&local, &now);
+        char timestamp[32];
+        std::strftime(timestamp, std::size(timestamp), "%Y%m%d-%H%M%S", &local);
+        return std::string(prefix) + '-' + timestamp + '.' + extension;
+    }
+
+    wcdx::frame::color ToFrameColor(const WcdxColor& color)
+    {
+        // WcdxColor is laid out as X8R8G8B8 in memory.
+        static_assert(sizeof(WcdxColor) == sizeof(wcdx::frame::color));
+
+        wcdx::frame::color result;
+        std::memcpy(&result, &color, sizeof(result));
+        return result;
+    }
+
+    int64_t CrtFileDevice::seek(int64_t offset, wcdx::fileio::seek_origin origin)
+    {
+        int method = origin == wcdx::fileio::seek_origin::begin ? SEEK_SET
+            : origin == wcdx::fileio::seek_origin::current ? SEEK_CUR
+            : SEEK_END;
+        return _lseeki64(_filedesc, offset, method);
+    }
+
+    int64_t CrtFileDevice::read(void* data, size_t size)
+    {
+        return _read(_filedesc, data, unsigned(size));
+    }
+
+    int64_t CrtFileDevice::write(const void* data, size_t size)
+    {
+        return _write(_filedesc, data, unsigned(size));
+    }
+
+    int64_t CrtFileDevice::length()
+    {
+        return _filelengthi64(_filedesc);
+    }
 }
@@ -8,14 +8,29 @@
 
 #include <iwcdx.h>
 
+#include <fileio/buffered_file.h>
+#include <frame/frame_converter.h>
+#include <frame/frame_queue.h>
+#include <frame/frame_recorder.h>
+#include <frame/pixel_ops.h>
+#include <metrics/latency_histogram.h>
+#include <trace/call_trace.h>
+
+#include <stdext/file.h>
+
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+
 #include <cstddef>
+#include <cstdint>
 
 #include <comdef.h>
 #include <d3d9.h>
 
 
-#define DEBUG_SCREENSHOTS 0
-
 class Wcdx : public IWcdx
 {
 public:
@@ -75,18 +90,61 @@ private:
     void OnNCDestroy();
     bool OnNCLButtonDblClk(int hittest, POINTS position);
     bool OnSysChar(DWORD vkey, WORD repeatCount, WORD flags);
+    bool OnSysKeyDown(DWORD vkey, WORD repeatCount, WORD flags);
     bool OnSysCommand(WORD type, SHORT x, SHORT y);
     void OnSizing(DWORD windowEdge, RECT* dragRect);
     void OnRender();
 
+    void StartRecording();
+    void StartTracing();
+    void StartRenderThread();
+    void StopRenderThread();
+    void RenderThread();
+    HRESULT PresentInternal();
+    HRESULT PresentFrame(wcdx::frame::frame_converter& frame);
+    wcdx::frame::frame_converter& PresentedFrame();
+    DWORD QueryConfigValue(const wchar_t* valuename, DWORD defaultValue);
+    void TrackFile(int filedesc, int oflag);
+    void WriteMetrics();
+    wcdx::fileio::buffered_file* FindFile(int filedesc);
+
     HRESULT UpdateMonitor(UINT& adapter);
     HRESULT RecreateDevice(UINT adapter);
+    HRESULT RestoreDevice();
     HRESULT ResetDevice();
     HRESULT CreateIntermediateSurface();
     void SetFullScreen(bool enabled);
     RECT GetContentRect(RECT clientRect);
     void ConfineCursor();
 
+private:
+    // Timed IWcdx methods and phases of presentation.
+    enum class Metric
+    {
+        SetPalette,
+        UpdatePalette,
+        UpdateFrame,
+        Present,
+        FillSnow,
+        OpenFile,
+        CloseFile,
+        ReadFile,
+        WriteFile,
+        SeekFile,
+        RecordFrame,
+        ConvertFrame,
+        StretchFrame,
+        PresentDevice,
+        RestoreDevice,
+        ResetDevice,
+        Count
+    };
+
+    static const char* const MetricNames[size_t(Metric::Count)];
+
+    wcdx::metrics::latency_histogram& Histogram(Metric metric) { return _metrics[size_t(metric)]; }
+    void Trace(wcdx::trace::call_id call) { if (_trace != nullptr) _trace->record(call); }
+
 private:
     ULONG _refCount;
     SmartResource<HWND> _window;
@@ -102,21 +160,46 @@ private:
 
     D3DPRESENT_PARAMETERS _presentParams;
 
-    WcdxColor _palette[256];
-    std::byte _framebuffer[ContentWidth * ContentHeight];
+    wcdx::frame::frame_converter _frame;
+    wcdx::frame::snow_generator _snow;
 
     bool _fullScreen;
     bool _dirty;
-    bool _sizeChanged;
-
-#if DEBUG_SCREENSHOTS
-    int _screenshotFrameCounter;
-    std::byte _screenshotBuffers[10][ContentWidth * ContentHeight];
-    size_t _screenshotIndex;
-    const std::byte* _screenshotPalette;
-    size_t _screenshotPaletteSize;
-    size_t _screenshotFileIndex;
-#endif
+    std::atomic<bool> _sizeChanged;
+
+    // Threaded presentation.  The game thread hands finished frames to the
+    // render thread through _presentQueue; _deviceMutex serializes access to
+    // the device, the surface, and _renderFrame.
+    bool _threadedPresent;
+    std::recursive_mutex _deviceMutex;
+    std::unique_ptr<wcdx::frame::frame_queue> _presentQueue;
+    std::unique_ptr<wcdx::frame::frame_converter> _renderFrame;
+    uint64_t _presentSequence;
+    SmartResource<HANDLE> _renderEvent;
+    std::atomic<bool> _renderStop;
+    std::atomic<HRESULT> _renderResult;
+    std::thread _renderThread;
+
+    // Buffering for game files opened through OpenFile and SavedGameOpen,
+    // keyed by file descriptor.  _fileStats accumulates the counters of
+    // files that have been closed.
+    std::unordered_map<int, std::unique_ptr<wcdx::fileio::buffered_file>> _files;
+    wcdx::fileio::file_cache_stats _fileStats;
+
+    // Always collected; written out with Alt+F11, and at shutdown if the
+    // WriteMetrics setting is on.
+    wcdx::metrics::latency_histogram _metrics[size_t(Metric::Count)];
+    bool _writeMetrics;
+
+    // Frame capture, enabled by the RecordFrames setting.  The recorder
+    // writes to _captureFile from its own thread.
+    std::unique_ptr<stdext::file_output_stream> _captureFile;
+    std::unique_ptr<wcdx::frame::frame_recorder> _recorder;
+
+    // Call tracing, enabled by the TraceCalls setting.  Every IWcdx call the
+    // game makes is written to _traceFile on the game thread as it's made.
+    std::unique_ptr<stdext::file_output_stream> _traceFile;
+    std::unique_ptr<wcdx::trace::trace_writer> _trace;
 };
 
 #endif
@@ -1,18 +1,30 @@
 #include <image/image.h>
+#include <image/image_cache.h>
+#include <image/palette_quantizer.h>
 #include <image/resources.h>
+#include <image/sprite.h>
+#include <parallel/parallel_for.h>
+#include <resource/archive.h>
+#include <resource/mapped_file.h>
 
 #include <stdext/array_view.h>
 #include <stdext/file.h>
-#include <stdext/multi.h>
 #include <stdext/scope_guard.h>
 #include <stdext/string.h>
 #include <stdext/unicode.h>
 
 #include <algorithm>
+#include <chrono>
+#include <exception>
 #include <filesystem>
+#include <functional>
+#include <iomanip>
 #include <iostream>
 #include <limits>
 #include <memory>
+#include <optional>
+#include <stdexcept>
+#include <vector>
 
 #include <cassert>
 #include <cstdlib>
@@ -33,7 +45,6 @@ namespace
 {
     _COM_SMARTPTR_TYPEDEF(IWICImagingFactory, __uuidof(IWICImagingFactory));
     _COM_SMARTPTR_TYPEDEF(IWICBitmap, __uuidof(IWICBitmap));
-    _COM_SMARTPTR_TYPEDEF(IWICPalette, __uuidof(IWICPalette));
     _COM_SMARTPTR_TYPEDEF(IWICBitmapLock, __uuidof(IWICBitmapLock));
     _COM_SMARTPTR_TYPEDEF(IWICStream, __uuidof(IWICStream));
     _COM_SMARTPTR_TYPEDEF(IWICBitmapEncoder, __uuidof(IWICBitmapEncoder));
@@ -47,7 +58,8 @@ namespace
         unspecified,
         extract,
         extract_all,
-        pack
+        pack,
+        cache
     };
 
     enum class game_id
@@ -61,11 +73,6 @@ namespace
         int16_t x, y;
     };
 
-    struct rect
-    {
-        point p1, p2;
-    };
-
     struct program_options
     {
         program_mode invocation_mode = program_mode::unspecified;
@@ -75,6 +82,7 @@ namespace
         const wchar_t* output_path = nullptr;
         const wchar_t* output_prefix = nullptr;
         int index = -1;
+        unsigned thread_count = 0;
     };
 
     class usage_error : public std::runtime_error
@@ -82,15 +90,65 @@ namespace
         using runtime_error::runtime_error;
     };
 
+    // COM, initialized for the lifetime of the object on the thread that
+    // creates it.
+    class com_apartment
+    {
+    public:
+        com_apartment()
+        {
+            HRESULT hr;
+            COM_REQUIRE_SUCCESS(::CoInitializeEx(nullptr, COINIT_MULTITHREADED));
+        }
+        com_apartment(const com_apartment&) = delete;
+        com_apartment& operator = (const com_apartment&) = delete;
+        ~com_apartment() { ::CoUninitialize(); }
+    };
+
+    // What each -pack thread needs to decode its input files.  The factory is
+    // released before COM is shut down.
+    struct wic_thread
+    {
+        wic_thread()
+        {
+            HRESULT hr;
+            COM_REQUIRE_SUCCESS(imaging_factory.CreateInstance(CLSID_WICImagingFactory));
+        }
+
+        com_apartment com;
+        IWICImagingFactoryPtr imaging_factory;
+    };
+
+    // Images are extracted either from an image archive or from an image
+    // cache written by -cache.  Either way, they're read in place from the
+    // mapped file.
+    class image_source
+    {
+    public:
+        explicit image_source(const wchar_t* path);
+
+    public:
+        size_t size() const noexcept { return _cache ? _cache->size() : _archive->size(); }
+        size_t data_size() const noexcept { return _file.size(); }
+
+        wcdx::image::sprite decode(size_t index) const;
+
+    private:
+        wcdx::resource::mapped_file _file;
+        std::optional<wcdx::resource::archive> _archive;
+        std::optional<wcdx::image::image_cache> _cache;
+    };
+
     void parse_args(int argc, const wchar_t* const argv[], program_options& options);
     void show_usage(const wchar_t* invocation);
 
-    void extract_images(stdext::multi_ref<stdext::input_stream, stdext::seekable> input, game_id game, const wchar_t* output_path, const wchar_t* prefix);
-    void extract_image(stdext::multi_ref<stdext::input_stream, stdext::seekable> input, game_id game, int index, const wchar_t* output_path);
-    void extract_image(stdext::input_stream& input, game_id game, const wchar_t* output_path);
-    void pack_images(const std::vector<const wchar_t*>& input_paths, game_id game, const std::vector<point>& reference_points, const wchar_t* output_path);
-    void pack_image(const IWICImagingFactoryPtr& imaging_factory, const IWICPalettePtr& palette, const IWICBitmapFrameDecodePtr& input, point reference_point, stdext::output_stream& output);
-    rect read_image_dimensions(stdext::input_stream& input);
+    void extract_images(const wchar_t* input_path, game_id game, const wchar_t* output_path, const wchar_t* prefix, unsigned thread_count);
+    void extract_image(const wchar_t* input_path, game_id game, int index, const wchar_t* output_path);
+    void write_sprite(const wcdx::image::sprite& image, stdext::array_view<const std::byte> palette, const wchar_t* output_path, wcdx::image::compression level);
+    stdext::array_view<const std::byte> load_palette(game_id game);
+    void pack_images(const std::vector<const wchar_t*>& input_paths, game_id game, const std::vector<point>& reference_points, const wchar_t* output_path, unsigned thread_count);
+    void cache_images(const wchar_t* input_path, const wchar_t* output_path, unsigned thread_count);
+    std::vector<std::vector<std::byte>> pack_input(const IWICImagingFactoryPtr& imaging_factory, const wcdx::image::palette_quantizer& quantizer, const wchar_t* input_path, point reference_point);
 }
 
 int wmain(int argc, wchar_t* argv[])
@@ -110,25 +168,23 @@ int wmain(int argc, wchar_t* argv[])
         switch (options.invocation_mode)
         {
         case program_mode::extract:
-            {
-                stdext::file_input_stream file(options.input_paths.front());
-                extract_image(file, options.game, options.index, options.output_path);
-                break;
-            }
+            extract_image(options.input_paths.front(), options.game, options.index, options.output_path);
+            break;
 
         case program_mode::extract_all:
-            {
-                stdext::file_input_stream file(options.input_paths.front());
-                extract_images(file, options.game, options.output_path, options.output_prefix);
-                break;
-            }
+            extract_images(options.input_paths.front(), options.game, options.output_path, options.output_prefix, options.thread_count);
+            break;
 
         case program_mode::pack:
-            pack_images(options.input_paths, options.game, options.reference_points, options.output_path);
+            pack_images(options.input_paths, options.game, options.reference_points, options.output_path, options.thread_count);
+            break;
+
+        case program_mode::cache:
+            cache_images(options.input_paths.front(), options.output_path, options.thread_count);
             break;
 
         default:
-            throw usage_error("At least one of -extract, -extract_all, and -pack must be specified");
+            throw usage_error("At least one of -extract, -extract-all, -pack, and -cache must be specified");
         }
 
         return EXIT_SUCCESS;
@@ -169,7 +225,7 @@ namespace
                 else if (wcscmp(argv[n], L"-extract") == 0)
                 {
                     if (options.invocation_mode != program_mode::unspecified)
-                        throw usage_error("Only one of -extract, -extract_all, or -pack may be specified");
+                        throw usage_error("Only one of -extract, -extract-all, -pack, or -cache may be specified");
                     options.invocation_mode = program_mode::extract;
 
                     if (++n == argc)
@@ -182,15 +238,33 @@ namespace
                 else if (wcscmp(argv[n], L"-extract-all") == 0)
                 {
                     if (options.invocation_mode != program_mode::unspecified)
-                        throw usage_error("Only one of -extract, -extract_all, or -pack may be specified");
+                        throw usage_error("Only one of -extract, -extract-all, -pack, or -cache may be specified");
                     options.invocation_mode = program_mode::extract_all;
                 }
                 else if (wcscmp(argv[n], L"-pack") == 0)
                 {
                     if (options.invocation_mode != program_mode::unspecified)
-                        throw usage_error("Only one of -extract, -extract_all, or -pack may be specified");
+                        throw usage_error("Only one of -extract, -extract-all, -pack, or -cache may be specified");
                     options.invocation_mode = program_mode::pack;
                 }
+                else if (wcscmp(argv[n], L"-cache") == 0)
+                {
+                    if (options.invocation_mode != program_mode::unspecified)
+                        throw usage_error("Only one of -extract, -extract-all, -pack, or -cache may be specified");
+                    options.invocation_mode = program_mode::cache;
+                }
+                else if (wcscmp(argv[n], L"-threads") == 0)
+                {
+                    if (++n == argc)
+                        throw usage_error("No value for -threads");
+
+                    wchar_t* p;
+                    auto count = wcstoul(argv[n], &p, 10);
+                    if (*p != L'\0' || count == 0)
+                        throw usage_error("Bad value for -threads");
+
+                    options.thread_count = unsigned(count);
+                }
                 else if (wcscmp(argv[n], L"-prefix") == 0)
                 {
                     if (++n == argc)
@@ -299,8 +373,9 @@ namespace
     {
         std::wcout << L"Usage:\n"
             L"    " << invocation << L" -o <output_path> [-wc1 | -wc2] -extract <image_index> <input_path>\n"
-            L"    " << invocation << L" -o <output_path> [-wc1 | -wc2] -extract-all -prefix <name_prefix> <input_path>\n"
-            L"    " << invocation << L" -o <output_path> [-wc1 | -wc2] -pack <input_path> [-ref <x> <y>] ...\n"
+            L"    " << invocation << L" -o <output_path> [-wc1 | -wc2] -extract-all -prefix <name_prefix> [-threads <count>] <input_path>\n"
+            L"    " << invocation << L" -o <output_path> [-wc1 | -wc2] [-threads <count>] -pack <input_path> [-ref <x> <y>] ...\n"
+            L"    " << invocation << L" -o <output_path> [-threads <count>] -cache <input_path>\n"
             L"    " << invocation << L" @<filename>\n"
             L"\n"
             L"image_index gives the zero-based index of the image to be extracted.\n"
@@ -309,7 +384,9 @@ namespace
             L"of a file name.  A new file is created for each image in the input file.  File\n"
             L"names begin with 0.png, with each succeeding file name incrementing the number\n"
             L"by one.  If the -prefix option is given, then the specified sequence of\n"
-            L"characters is prepended to each file name.\n"
+            L"characters is prepended to each file name.  Images are extracted in parallel,\n"
+            L"using one thread per processor unless -threads is given.  The output is the same\n"
+            L"regardless of the number of threads.\n"
             L"\n"
             L"Example:\n"
             L"    " << invocation << L" -o images -extract-all -prefix foo imageset\n"
@@ -328,7 +405,14 @@ namespace
             L"argument giving the coordinates of the image's reference point.  The reference\n"
             L"point represents the logical center of the image for rotation, scaling, and\n"
             L"drawing purposes.  If a reference point is not specified for an image, then it\n"
-            L"is as if -ref 0 0 had been specified.\n"
+            L"is as if -ref 0 0 had been specified.  Input files are converted in parallel,\n"
+            L"one per thread, using one thread per processor unless -threads is given.  The\n"
+            L"output is the same regardless of the number of threads.\n"
+            L"\n"
+            L"The -cache option converts an image set into an image cache, which holds the\n"
+            L"images pre-decoded into rows of runs that can be drawn without further parsing.\n"
+            L"The images are converted in parallel, as for -extract-all.  The -extract and\n"
+            L"-extract-all options accept an image cache as input as well as an image set.\n"
             L"\n"
             L"Options can be specified in a text file instead of on the command line.  To read\n"
             L"options from a text file, pass the path of the text file on the command line\n"
@@ -337,7 +421,28 @@ namespace
             L"spaces.\n";
     }
 
-    void extract_images(stdext::multi_ref<stdext::input_stream, stdext::seekable> input, game_id game, const wchar_t* output_path, const wchar_t* prefix)
+    image_source::image_source(const wchar_t* path)
+        : _file(path)
+    {
+        // An archive starts with its size, which can never be large enough
+        // to read as the cache version.
+        if (wcdx::image::is_image_cache(_file.view()))
+            _cache.emplace(_file.view());
+        else
+            _archive.emplace(_file.view());
+    }
+
+    wcdx::image::sprite image_source::decode(size_t index) const
+    {
+        if (_cache)
+            return wcdx::image::decode_cached_image(_cache->image(index));
+
+        auto image_data = _archive->stored_data(index);
+        stdext::memory_input_stream image_stream(image_data.data(), image_data.size());
+        return wcdx::image::decode_sprite(image_stream);
+    }
+
+    void extract_images(const wchar_t* input_path, game_id game, const wchar_t* output_path, const wchar_t* prefix, unsigned thread_count)
     {
         auto cwd = std::filesystem::current_path();
         if (output_path == nullptr)
@@ -345,61 +450,48 @@ namespace
         if (prefix == nullptr)
             prefix = L"";
 
-        auto& stream = input.as<stdext::input_stream>();
-        auto& seeker = input.as<stdext::seekable>();
+        auto start_time = std::chrono::steady_clock::now();
 
-        auto begin_pos = seeker.position();
-        auto file_size = stream.read<uint32_t>();
-        auto first_offset = stream.read<uint32_t>();
-        if (first_offset % 4 != 0)
-            throw std::runtime_error("Input file is not an image archive");
+        // The images are decoded straight from the mapped file.
+        image_source source(input_path);
+        auto palette = load_palette(game);
 
-        auto image_count = (first_offset - 4) / 4;
-        for (unsigned n = 0; n < image_count; ++n)
+        // Each image is decoded and encoded independently of the others, so
+        // the files written don't depend on which thread handles which image.
+        // As in a serial run, the first failing image (by index) is reported,
+        // and no image past it is started.
+        wcdx::parallel::parallel_for_each_index(source.size(), [&](size_t n)
         {
-            seeker.set_position(begin_pos + 4 + 4 * n);
-            auto image_offset = stream.read<uint32_t>();
-            if (image_offset >= file_size)
-                throw std::runtime_error("Bad image offset");
-
-            seeker.set_position(begin_pos + image_offset);
-            extract_image(stream, game, (std::filesystem::path(output_path) /= prefix + std::to_wstring(n) + L".png").c_str());
-        }
+            auto image = source.decode(n);
+            write_sprite(image, palette, (std::filesystem::path(output_path) /= prefix + std::to_wstring(n) + L".png").c_str(), wcdx::image::compression::fast);
+        }, thread_count);
+
+        auto seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start_time).count();
+        auto megabytes = double(source.data_size()) / (1024 * 1024);
+        std::wcout << L"Extracted " << source.size() << L" images (" << std::fixed << std::setprecision(2) << megabytes << L" MB) in "
+            << seconds << L" s: " << std::setprecision(1) << (double(source.size()) / seconds) << L" images/s, "
+            << std::setprecision(2) << (megabytes / seconds) << L" MB/s\n";
     }
 
-    void extract_image(stdext::multi_ref<stdext::input_stream, stdext::seekable> input, game_id game, int index, const wchar_t* output_path)
+    void extract_image(const wchar_t* input_path, game_id game, int index, const wchar_t* output_path)
     {
-        auto& stream = input.as<stdext::input_stream>();
-        auto& seeker = input.as<stdext::seekable>();
-
         if (output_path == nullptr)
             throw std::runtime_error("No output file specified");
 
-        auto size = stream.read<uint32_t>();
-        auto header_offset = unsigned(4 + 4 * index);
-        if (size <= header_offset)
-            throw std::runtime_error("Invalid index");
-
-        auto first_image_offset = stream.read<uint32_t>();
-        if (first_image_offset <= header_offset)
-            throw std::runtime_error("Invalid index");
-
-        seeker.set_position(header_offset);
-        auto image_offset = stream.read<uint32_t>();
-
-        seeker.set_position(image_offset);
-        extract_image(stream, game, output_path);
+        image_source source(input_path);
+        auto image = source.decode(size_t(index));
+        write_sprite(image, load_palette(game), output_path, wcdx::image::compression::best);
     }
 
-    void extract_image(stdext::input_stream& input, game_id game, const wchar_t* output_path)
+    void write_sprite(const wcdx::image::sprite& image, stdext::array_view<const std::byte> palette, const wchar_t* output_path, wcdx::image::compression level)
     {
-        auto dimensions = read_image_dimensions(input);
-        if (dimensions.p1.x > dimensions.p2.x || dimensions.p1.y > dimensions.p2.y)
-            throw std::runtime_error("Invalid image data");
-
-        auto width = unsigned(dimensions.p2.x - dimensions.p1.x);
-        auto height = unsigned(dimensions.p2.y - dimensions.p1.y);
+        stdext::memory_input_stream pixels(image.pixels.get(), size_t(image.descriptor.width) * image.descriptor.height);
+        stdext::file_output_stream out(output_path);
+        wcdx::image::write_image(image.descriptor, palette, pixels, out, level);
+    }
 
+    stdext::array_view<const std::byte> load_palette(game_id game)
+    {
         WORD resid = game == game_id::wc1 ? RESOURCE_ID_WC1PAL : RESOURCE_ID_WC2PAL;
         size_t palette_offset = game == game_id::wc1 ? 0x30 : 0;
 
@@ -411,238 +503,148 @@ namespace
         auto palette_size = ::SizeofResource(nullptr, res);
         assert(palette_size > palette_offset);
 
-        size_t buffer_size = width * height;
-        auto bitmap_data = std::make_unique<std::byte[]>(buffer_size);
-        std::fill_n(bitmap_data.get(), buffer_size, std::byte(0xFF));
+        return stdext::array_view<const std::byte>(palette_data + palette_offset, palette_size - palette_offset);
+    }
 
-        uint16_t seg_flags;
-        while ((seg_flags = input.read<uint16_t>()) != 0)
-        {
-            auto seg_width = seg_flags >> 1;
+    void pack_images(const std::vector<const wchar_t*>& input_paths, game_id game, const std::vector<point>& reference_points, const wchar_t* output_path, unsigned thread_count)
+    {
+        if (output_path == nullptr)
+            throw std::runtime_error("No output file specified");
 
-            auto x = input.read<int16_t>();
-            auto y = input.read<int16_t>();
+        auto start_time = std::chrono::steady_clock::now();
 
-            x -= dimensions.p1.x;
-            y -= dimensions.p1.y;
+        // The color lookup tables are built once and shared by every thread.
+        wcdx::image::palette_quantizer quantizer(load_palette(game));
 
-            auto segment_data = bitmap_data.get() + (y * width) + x;
-            if ((seg_flags & 1) != 0)
+        // Each input file is decoded once, and all of its frames are encoded
+        // on the thread that decoded it.  As in a serial run, the first
+        // failing input is reported, and no input past it is started.
+        std::vector<std::vector<std::vector<std::byte>>> images(input_paths.size());
+        wcdx::parallel::parallel_for_each_worker(input_paths.size(), [&]() -> std::function<void(size_t)>
+        {
+            // COM is set up by each thread as it takes its first input, so
+            // that any failure is reported against an input.
+            auto wic = std::make_shared<wic_thread>();
+            return [&, wic](size_t n)
             {
-                while (seg_width > 0)
-                {
-                    auto run_flags = input.read<uint8_t>();
-                    auto run_width = run_flags >> 1;
-                    if ((run_flags & 1) != 0)
-                    {
-                        auto color = input.read<std::byte>();
-                        std::fill_n(segment_data, run_width, color);
-                    }
-                    else
-                        input.read_all(segment_data, run_width);
+                images[n] = pack_input(wic->imaging_factory, quantizer, input_paths[n], reference_points[n]);
+            };
+        }, thread_count);
+
+        // With every image encoded, the offset table can be laid out in one
+        // pass and the file written front to back.
+        size_t image_count = 0;
+        for (auto& input_images : images)
+            image_count += input_images.size();
+
+        uint64_t file_size = 4 * (uint64_t(image_count) + 1);
+        for (auto& input_images : images)
+        {
+            for (auto& image : input_images)
+                file_size += image.size();
+        }
+        if (file_size > wcdx::resource::max_resource_offset)
+            throw std::range_error("Image set is too large");
 
-                    seg_width -= run_width;
-                    segment_data += run_width;
-                }
+        stdext::file_output_stream output(output_path);
+        output.write(uint32_t(file_size));
+        auto image_offset = 4 * (uint32_t(image_count) + 1);
+        for (auto& input_images : images)
+        {
+            for (auto& image : input_images)
+            {
+                output.write(image_offset);
+                image_offset += uint32_t(image.size());
             }
-            else
-                input.read_all(segment_data, seg_width);
         }
 
-        stdext::array_view<const std::byte> palette_view(palette_data + palette_offset, palette_size - palette_offset);
-        stdext::memory_input_stream pixels(bitmap_data.get(), buffer_size);
-        stdext::file_output_stream out(output_path);
-        wcdx::image::write_image({ width, height }, palette_view, pixels, out);
-    }
-
-    void pack_images(const std::vector<const wchar_t*>& input_paths, game_id game, const std::vector<point>& reference_points, const wchar_t* output_path)
-    {
-        WORD resid = game == game_id::wc1 ? RESOURCE_ID_WC1PAL : RESOURCE_ID_WC2PAL;
-        size_t offset = game == game_id::wc1 ? 0x30 : 0;
-
-        auto res = ::FindResource(nullptr, MAKEINTRESOURCE(resid), RT_RCDATA);
-        if (res == nullptr)
-            throw std::system_error(::GetLastError(), std::system_category());
-        auto resp = ::LoadResource(nullptr, res);
-        auto palette_data = ::LockResource(resp);
-        WICColor colors[256];
-
-        auto palette_p = static_cast<const BYTE*>(palette_data) + offset;
-        auto color_p = colors;
-        for (size_t n = 0; n < std::size(colors); ++n)
+        for (auto& input_images : images)
         {
-            auto red = *palette_p++;
-            auto green = *palette_p++;
-            auto blue = *palette_p++;
-            *color_p++ = blue | (green << 8) | (red << 16) | (0xFF << 24);
+            for (auto& image : input_images)
+                output.write_all(image.data(), image.size());
         }
-        colors[std::size(colors) - 1] &= 0x00FFFFFF; // last entry transparent
 
-        HRESULT hr;
-        COM_REQUIRE_SUCCESS(::CoInitializeEx(nullptr, COINIT_APARTMENTTHREADED));
-        at_scope_exit(::CoUninitialize);
+        auto seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start_time).count();
+        auto megabytes = double(file_size) / (1024 * 1024);
+        std::wcout << L"Packed " << image_count << L" images (" << std::fixed << std::setprecision(2) << megabytes << L" MB) in "
+            << seconds << L" s: " << std::setprecision(1) << (double(image_count) / seconds) << L" images/s\n";
+    }
 
-        IWICImagingFactoryPtr imaging_factory;
-        COM_REQUIRE_SUCCESS(imaging_factory.CreateInstance(CLSID_WICImagingFactory));
+    void cache_images(const wchar_t* input_path, const wchar_t* output_path, unsigned thread_count)
+    {
+        if (output_path == nullptr)
+            throw std::runtime_error("No output file specified");
 
-        IWICPalettePtr palette;
-        COM_REQUIRE_SUCCESS(imaging_factory->CreatePalette(&palette));
-        COM_REQUIRE_SUCCESS(palette->InitializeCustom(colors, std::size(colors)));
+        auto start_time = std::chrono::steady_clock::now();
 
-        // Figure out how many images we're writing
-        UINT image_count = 0;
-        for (const auto& path : input_paths)
+        // Each image is converted independently of the others, and the cache
+        // is written in index order once they're all done.  As in a serial
+        // run, the first failing image (by index) is reported, and no image
+        // past it is started.
+        wcdx::resource::archive archive(input_path);
+        std::vector<std::vector<std::byte>> images(archive.size());
+        wcdx::parallel::parallel_for_each_index(archive.size(), [&](size_t n)
         {
-            IWICBitmapDecoderPtr decoder;
-            COM_REQUIRE_SUCCESS(imaging_factory->CreateDecoderFromFilename(path, nullptr, GENERIC_READ, WICDecodeMetadataCacheOnDemand, &decoder));
+            auto image_data = archive.stored_data(n);
+            stdext::memory_input_stream image_stream(image_data.data(), image_data.size());
+            images[n] = wcdx::image::encode_cached_image(wcdx::image::decode_sprite(image_stream));
+        }, thread_count);
 
-            UINT frame_count;
-            COM_REQUIRE_SUCCESS(decoder->GetFrameCount(&frame_count));
-            image_count += frame_count;
-        }
+        uint64_t cache_size = wcdx::image::image_cache_header_size + (uint64_t(images.size()) * wcdx::image::image_cache_info_size);
+        for (auto& image : images)
+            cache_size += image.size();
 
-        stdext::file_output_stream output(output_path);
-        output.write(uint32_t(0));  // file size
-        for (size_t n = 0; n < image_count; ++n)
-            output.write(uint32_t(0));  // image offset
-
-        stdext::stream_position offset_position = 4;
-        auto image_position = output.position();
-        output.set_position(offset_position);
-        auto reference_point = reference_points.begin();
-        for (const auto& path : input_paths)
         {
-            IWICBitmapDecoderPtr decoder;
-            COM_REQUIRE_SUCCESS(imaging_factory->CreateDecoderFromFilename(path, nullptr, GENERIC_READ, WICDecodeMetadataCacheOnDemand, &decoder));
-
-            UINT frame_count;
-            COM_REQUIRE_SUCCESS(decoder->GetFrameCount(&frame_count));
-            for (UINT n = 0; n < frame_count; ++n)
-            {
-                IWICBitmapFrameDecodePtr frame;
-                COM_REQUIRE_SUCCESS(decoder->GetFrame(n, &frame));
-
-                output.set_position(offset_position);
-                output.write(uint32_t(image_position));
-                offset_position = output.position();
-                output.set_position(image_position);
-
-                pack_image(imaging_factory, palette, frame, *reference_point, output);
-                image_position = output.position();
-            }
-
-            ++reference_point;
+            stdext::file_output_stream output(output_path);
+            wcdx::image::write_image_cache(stdext::array_view<const std::vector<std::byte>>(images.data(), images.size()), output);
         }
 
-        output.set_position(0);
-        output.write(uint32_t(image_position));
+        auto seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start_time).count();
+        std::wcout << L"Cached " << images.size() << L" images (" << std::fixed << std::setprecision(2) << (double(archive.data().size()) / (1024 * 1024))
+            << L" MB to " << (double(cache_size) / (1024 * 1024)) << L" MB) in " << seconds << L" s: " << std::setprecision(1)
+            << (double(images.size()) / seconds) << L" images/s\n";
     }
 
-    void pack_image(const IWICImagingFactoryPtr& imaging_factory, const IWICPalettePtr& palette, const IWICBitmapFrameDecodePtr& input, point reference_point, stdext::output_stream& output)
+    std::vector<std::vector<std::byte>> pack_input(const IWICImagingFactoryPtr& imaging_factory, const wcdx::image::palette_quantizer& quantizer, const wchar_t* input_path, point reference_point)
     {
         HRESULT hr;
-        IWICFormatConverterPtr converter;
-        COM_REQUIRE_SUCCESS(imaging_factory->CreateFormatConverter(&converter));
-        COM_REQUIRE_SUCCESS(converter->Initialize(input, GUID_WICPixelFormat8bppIndexed, WICBitmapDitherTypeNone, palette, 0.5, WICBitmapPaletteTypeCustom));
-
-        UINT width, height;
-        COM_REQUIRE_SUCCESS(converter->GetSize(&width, &height));
-
-        std::vector<BYTE> pixels(width * height);
-        COM_REQUIRE_SUCCESS(converter->CopyPixels(nullptr, width, pixels.size(), pixels.data()));
-
-        output.write(int16_t(width - 1 - reference_point.x));   // right
-        output.write(int16_t(reference_point.x));               // left
-        output.write(int16_t(reference_point.y));               // top
-        output.write(int16_t(height - 1 - reference_point.y));  // bottom
+        IWICBitmapDecoderPtr decoder;
+        COM_REQUIRE_SUCCESS(imaging_factory->CreateDecoderFromFilename(input_path, nullptr, GENERIC_READ, WICDecodeMetadataCacheOnDemand, &decoder));
 
-        auto p = pixels.data();
-        auto p_first = p;
-        auto p_last = p + pixels.size();
+        UINT frame_count;
+        COM_REQUIRE_SUCCESS(decoder->GetFrameCount(&frame_count));
 
-        // Search for non-transparent pixels
-        while ((p = std::find_if(p, p_last, [](BYTE pixel) { return pixel != 0xFF; })) != p_last)
+        std::vector<std::vector<std::byte>> images;
+        images.reserve(frame_count);
+        std::vector<std::byte> bgra;
+        for (UINT n = 0; n < frame_count; ++n)
         {
-            // Get the location of the segment
-            auto offset = p - p_first;
-            auto x = offset % width;
-            auto y = offset / width;
-
-            // Get the width of the segment
-            auto row_last = p_first + width * (y + 1);
-            auto seg_first = p;
-            auto seg_last = std::find(seg_first, row_last, 0xFF);
-            while (p != seg_last)
-            {
-                // Check for runs in the segment
-                auto run_first = p;
-                auto run_last = p;
-                auto run_length = 0;
-                while ((run_first = std::adjacent_find(run_first, seg_last)) != seg_last)
-                {
-                    run_last = std::find_if(run_first, seg_last, [&](BYTE pixel) { return pixel != *run_first; });
-                    run_length = run_last - run_first;
-                    if (run_length > 3 || (run_length > 2 && run_last == seg_last))
-                        break;
+            IWICBitmapFrameDecodePtr frame;
+            COM_REQUIRE_SUCCESS(decoder->GetFrame(n, &frame));
 
-                    run_first = run_last;
-                }
+            // WIC only unpacks the pixels; mapping them to the palette is
+            // left to the quantizer.
+            IWICFormatConverterPtr converter;
+            COM_REQUIRE_SUCCESS(imaging_factory->CreateFormatConverter(&converter));
+            COM_REQUIRE_SUCCESS(converter->Initialize(frame, GUID_WICPixelFormat32bppBGRA, WICBitmapDitherTypeNone, nullptr, 0.0, WICBitmapPaletteTypeCustom));
 
-                if (p == seg_first && run_first == seg_last)
-                {
-                    // No runs; just write the segment verbatim
-                    auto length = seg_last - seg_first;
-                    output.write(uint16_t(length << 1));
-                    output.write(int16_t(x - reference_point.x));
-                    output.write(int16_t(y - reference_point.y));
-                    output.write_all(p, length);
-                    p = seg_last;
-                }
-                else
-                {
-                    // Break up the segment into runs and intervening verbatim chunks
-                    if (p == seg_first)
-                    {
-                        auto length = seg_last - seg_first;
-                        output.write(uint16_t((length << 1) | 1));
-                        output.write(int16_t(x - reference_point.x));
-                        output.write(int16_t(y - reference_point.y));
-                    }
+            UINT width, height;
+            COM_REQUIRE_SUCCESS(converter->GetSize(&width, &height));
 
-                    if (p != run_first)
-                    {
-                        auto length = run_first - p;
-                        output.write(uint8_t(length << 1));
-                        output.write_all(p, length);
-                        p = run_first;
-                    }
+            auto pixel_count = size_t(width) * height;
+            bgra.resize(4 * pixel_count);
+            COM_REQUIRE_SUCCESS(converter->CopyPixels(nullptr, 4 * width, UINT(bgra.size()), reinterpret_cast<BYTE*>(bgra.data())));
 
-                    if (run_first < run_last)
-                    {
-                        output.write(uint8_t((run_length << 1) | 1));
-                        output.write(*p);
-                        p = run_last;
-                    }
-                }
-            }
+            wcdx::image::sprite image =
+            {
+                { width, height },
+                reference_point.x, reference_point.y,
+                std::make_unique<std::byte[]>(pixel_count)
+            };
+            quantizer.quantize(bgra.data(), pixel_count, image.pixels.get());
+            images.push_back(wcdx::image::encode_sprite(image));
         }
 
-        output.write(uint16_t(0));
-    }
-
-    rect read_image_dimensions(stdext::input_stream& input)
-    {
-        auto right_extent = input.read<int16_t>();
-        auto left_extent = input.read<int16_t>();
-        auto top_extent = input.read<int16_t>();
-        auto bottom_extent = input.read<int16_t>();
-
-        rect dim =
-        {
-            { -left_extent, -top_extent },
-            { right_extent + 1, bottom_extent + 1 }
-        };
-
-        return dim;
+        return images;
     }
 }
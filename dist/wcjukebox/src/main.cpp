@@ -1,26 +1,34 @@
-#include "wcaudio_stream.h"
 #include "wave.h"
 
+#include <audio/wcaudio_stream.h>
+#include <parallel/parallel_for.h>
+
 #include <stdext/array_view.h>
 #include <stdext/file.h>
 #include <stdext/scope_guard.h>
 #include <stdext/string.h>
 #include <stdext/utility.h>
 
+#include <algorithm>
+#include <chrono>
+#include <exception>
 #include <filesystem>
 #include <iomanip>
 #include <iostream>
+#include <memory>
 #include <sstream>
 #include <stdexcept>
 #include <string_view>
 #include <unordered_map>
 #include <utility>
+#include <vector>
 
 #include <cstdlib>
 #include <cstddef>
 
 
 using namespace std::literals;
+using namespace wcdx::audio;
 
 namespace
 {
@@ -37,7 +45,8 @@ namespace
         mode_wav            = 0x080,
         mode_loop           = 0x100,
         mode_single         = 0x200,
-        mode_debug_info     = 0x400
+        mode_debug_info     = 0x400,
+        mode_export_all     = 0x800
     };
 
     struct program_options
@@ -46,6 +55,7 @@ namespace
         int track = -1;
         const wchar_t* stream_path = nullptr;
         const wchar_t* wav_path = nullptr;
+        const wchar_t* export_path = nullptr;
         uint8_t trigger = no_trigger;
         uint8_t intensity = 15; // default for WC1 (selects patrol music)
         int loops = -1;
@@ -61,6 +71,7 @@ namespace
     void diagnose_unrecognized(const wchar_t* str);
     void show_tracks(program_options& options);
     void select_track(program_options& options);
+    void export_tracks(const program_options& options);
     int parse_int(const wchar_t* str);
 }
 
@@ -97,6 +108,24 @@ int wmain(int argc, wchar_t* argv[])
 
                     options.track = parse_int(*++arg);
                 }
+                else if (*arg + 1 == L"export-all"sv)
+                {
+                    if ((options.program_mode & mode_export_all) != 0)
+                        throw usage_error("The -export-all option can only be used once.");
+
+                    options.program_mode |= mode_export_all;
+                    diagnose_mode(options.program_mode);
+
+                    auto game = *++arg;
+                    if (game == L"wc2"sv)
+                        options.program_mode |= mode_wc2;
+                    else if (game != L"wc1"sv)
+                        throw usage_error("The -export-all option must be followed by 'wc1' or 'wc2'.");
+
+                    options.export_path = *++arg;
+                    if (options.export_path == nullptr)
+                        throw usage_error("Expected output directory.");
+                }
                 else if (*arg + 1 == L"trigger"sv)
                 {
                     if ((options.program_mode & mode_trigger) != 0)
@@ -198,7 +227,7 @@ int wmain(int argc, wchar_t* argv[])
             }
         }
 
-        if ((options.program_mode & (mode_track | mode_stream | mode_show_tracks | mode_show_triggers)) == 0)
+        if ((options.program_mode & (mode_track | mode_stream | mode_show_tracks | mode_show_triggers | mode_export_all)) == 0)
             throw usage_error("Missing required options.");
 
         if ((options.program_mode & mode_show_tracks) != 0)
@@ -207,11 +236,16 @@ int wmain(int argc, wchar_t* argv[])
             return EXIT_SUCCESS;
         }
 
+        if ((options.program_mode & mode_export_all) != 0)
+        {
+            export_tracks(options);
+            return EXIT_SUCCESS;
+        }
+
         if ((options.program_mode & mode_track) != 0)
             select_track(options);
 
-        stdext::file_input_stream file(options.stream_path);
-        wcaudio_stream stream(file);
+        wcaudio_stream stream(options.stream_path);
 
         if ((options.program_mode & mode_show_triggers) != 0)
         {
@@ -458,6 +492,7 @@ namespace
             L"  " << invocation << L" [<options>...] -trigger <num> <filename>\n"
             L"  " << invocation << L" -show-tracks (wc1|wc2)\n"
             L"  " << invocation << L" -show-triggers <filename>\n"
+            L"  " << invocation << L" [-intensity <num>] [-loop <num>] -export-all (wc1|wc2) <directory>\n"
             L"\n"
             L"The first form selects a music track to play.  The command must be invoked from\n"
             L"the game directory (the same directory containing the STREAMS directory).  The\n"
@@ -472,6 +507,14 @@ namespace
             L"intensities supported by a given stream file, use the -show-triggers option.\n"
             L"This form may be used with any stream file.\n"
             L"\n"
+            L"The -export-all form writes every track of the given game to a WAV file named\n"
+            L"trackNN.wav in <directory>, rendering tracks in parallel.  Like the first form,\n"
+            L"it must be invoked from the game directory.  Each stream file is read once and\n"
+            L"shared by all of its tracks.  Tracks stop at transition points, as with the\n"
+            L"-single option, and loop as many times as -loop specifies (once through, if\n"
+            L"-loop is not provided).  The -intensity option applies to tracks selected by\n"
+            L"trigger, as it does with -track.\n"
+            L"\n"
             L"Options:\n"
             L"  -o <filename>\n"
             L"    Instead of playing music, write it to a WAV file.\n"
@@ -510,6 +553,8 @@ namespace
             throw usage_error("The -trigger option cannot be used with -track.");
         if ((mode & (mode_track | mode_stream)) == (mode_track | mode_stream))
             throw usage_error("Cannot specify a stream file with -track.");
+        if ((mode & mode_export_all) != 0 && (mode & ~(mode_export_all | mode_wc2 | mode_intensity | mode_loop | mode_single)) != 0)
+            throw usage_error("The -export-all option can only be used with -intensity, -loop, and -single.");
         if ((mode & mode_show_tracks) != 0 && mode != mode_show_tracks)
             throw usage_error("The -show-tracks option cannot be used with other options.");
         if ((mode & mode_show_triggers) != 0 && (mode & ~mode_stream) != mode_show_triggers)
@@ -596,6 +641,79 @@ namespace
         }
     }
 
+    void export_tracks(const program_options& options)
+    {
+        stdext::array_view<const track_desc> track_map;
+        if ((options.program_mode & mode_wc2) == 0)
+            track_map = wc1_track_map;
+        else
+            track_map = wc2_track_map;
+
+        auto start_time = std::chrono::steady_clock::now();
+
+        // Each stream file is parsed once; every track rendered from it plays
+        // through its own wcaudio_stream over the shared tables.
+        std::shared_ptr<const wcaudio_file> files[std::size(stream_filenames)];
+        std::vector<unsigned> tracks;
+        for (unsigned track = 0; track != track_map.size(); ++track)
+        {
+            auto archive = track_map[track].archive;
+            if (archive == stream_archive::invalid)
+                continue;
+
+            if (files[archive] == nullptr)
+                files[archive] = std::make_shared<const wcaudio_file>(stream_filenames[archive]);
+            tracks.push_back(track);
+        }
+
+        std::filesystem::path output_path(options.export_path);
+        std::filesystem::create_directories(output_path);
+
+        // As with a single export, the track plays through once unless told
+        // to loop.
+        auto loops = std::max(options.loops, 0);
+
+        // Tracks are claimed in order by whichever thread is free.  The first
+        // failing track (by number) is reported, and no track past it is
+        // started.
+        std::vector<unsigned> frame_counts(tracks.size());
+        std::vector<uint64_t> byte_counts(tracks.size());
+        wcdx::parallel::parallel_for_each_index(tracks.size(), [&](size_t n)
+        {
+            auto track = tracks[n];
+            auto& desc = track_map[track];
+            auto intensity = options.intensity;
+            if (desc.trigger == no_trigger)
+                intensity = uint8_t(track == 69 ? 47 : track);
+
+            wcaudio_stream stream(files[desc.archive]);
+            auto loops_left = loops;
+            stream.on_loop([&](uint32_t, unsigned) { return loops_left-- != 0; });
+            stream.on_next_track([](uint32_t, unsigned) { return false; });
+            stream.select(desc.trigger, intensity);
+
+            std::wostringstream filename;
+            filename << L"track" << std::setw(2) << std::setfill(L'0') << track << L".wav";
+            stdext::file_output_stream out((output_path / std::move(filename).str()).c_str());
+            write_wave(out, stream, stream.channels(), stream.sample_rate(), stream.bits_per_sample(), stream.buffer_size());
+
+            frame_counts[n] = stream.frame_count();
+            byte_counts[n] = uint64_t(stream.frame_count()) * stream.channels() * ((stream.bits_per_sample() + 7) / 8);
+        });
+
+        uint64_t total_bytes = 0;
+        for (size_t n = 0; n != tracks.size(); ++n)
+        {
+            std::wcout << L"Track " << std::setw(2) << tracks[n] << L": " << frame_counts[n] << L" frames, " << byte_counts[n] << L" bytes\n";
+            total_bytes += byte_counts[n];
+        }
+
+        auto seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start_time).count();
+        auto megabytes = double(total_bytes) / (1024 * 1024);
+        std::wcout << L"Exported " << tracks.size() << L" tracks (" << std::fixed << std::setprecision(2) << megabytes << L" MB) in "
+            << seconds << L" s: " << (megabytes / seconds) << L" MB/s\n";
+    }
+
     int parse_int(const wchar_t* str)
     {
         if (str == nullptr)
@@ -0,0 +1,17 @@
+#ifndef DIF_INCLUDED
+#define DIF_INCLUDED
+#pragma once
+
+#include <cstdint>
+
+
+// One byte of a difference file, compiled at build time by DifTable.cmake.
+// Tables are sorted by offset.
+struct dif_entry
+{
+    uint32_t offset;
+    uint8_t original;
+    uint8_t replacement;
+};
+
+#endif
@@ -1,19 +1,20 @@
-#include "resource_stream.h"
-#include "md5.h"
-#include "res/resources.h"
+#include "dif.h"
+#include "dif_tables.h"
 
+#include <hash/md5.h>
+
+#include <stdext/array_view.h>
 #include <stdext/file.h>
 #include <stdext/multi.h>
-#include <stdext/string_view.h>
-#include <stdext/unicode.h>
+#include <stdext/utility.h>
 
 #include <algorithm>
 #include <iostream>
 #include <map>
-#include <optional>
 #include <string>
 #include <vector>
 
+#include <cassert>
 #include <cstdint>
 #include <cstdio>
 #include <cstdlib>
@@ -47,9 +48,7 @@ struct import_entry_t
 static void show_usage(const wchar_t* invocation);
 
 static bool patch_image(stdext::multi_ref<stdext::stream, stdext::seekable> file_data);
-static bool apply_dif(stdext::multi_ref<stdext::stream, stdext::seekable> file_data, uint32_t hash);
-
-static std::optional<std::string> read_line(stdext::multi_ref<stdext::input_stream, stdext::seekable> is);
+static bool apply_dif(stdext::array_view<std::byte> image, uint32_t hash);
 
 static const import_entry_t import_entry_null = { };
 
@@ -57,6 +56,9 @@ static const char PESignature[] = { 'P', 'E', '\0', '\0' };
 static const uint16_t OptionalHeader_PE32Signature = 0x10B;
 static const uint16_t OptionalHeader_PE32PlusSignature = 0x20B;
 
+// The input is hashed a block at a time as it's read.
+static const size_t read_block_size = 0x10000;
+
 int wmain(int argc, wchar_t* argv[])
 {
     try
@@ -106,18 +108,25 @@ int wmain(int argc, wchar_t* argv[])
             return EXIT_FAILURE;
         }
 
-        // Read the input file into an in-memory buffer.
+        // Read the input file into an in-memory buffer, hashing it on the way.
         std::vector<std::byte> file_buffer;
+        wcdx::hash::md5_hasher hasher;
         {
             stdext::file_input_stream input_file(input_path);
             input_file.seek(stdext::seek_from::end, 0);
             size_t size = size_t(input_file.position());
             file_buffer.resize(size);
             input_file.seek(stdext::seek_from::begin, 0);
-            input_file.read_all(file_buffer.data(), file_buffer.size());
+            for (size_t offset = 0; offset != size; )
+            {
+                auto block_size = std::min(read_block_size, size - offset);
+                input_file.read_all(file_buffer.data() + offset, block_size);
+                hasher.update(file_buffer.data() + offset, block_size);
+                offset += block_size;
+            }
         }
 
-        auto hash = md5_hash(file_buffer.data(), file_buffer.size());
+        auto hash = hasher.finish();
 
         // stdext streams are very good for reading and writing heterogeneous data.
         stdext::memory_stream file_data(file_buffer.data(), file_buffer.size());
@@ -125,7 +134,7 @@ int wmain(int argc, wchar_t* argv[])
         if (!patch_image(file_data))
             return EXIT_FAILURE;
 
-        if (!headers_only && !apply_dif(file_data, hash.a ^ hash.b ^ hash.c ^ hash.d))
+        if (!headers_only && !apply_dif(stdext::array_view<std::byte>(file_buffer.data(), file_buffer.size()), hash.a ^ hash.b ^ hash.c ^ hash.d))
             return EXIT_FAILURE;
 
         stdext::file_output_stream output_file(output_path);
@@ -326,112 +335,36 @@ bool patch_image(stdext::multi_ref<stdext::stream, stdext::seekable> file_data)
     return true;
 }
 
-bool apply_dif(stdext::multi_ref<stdext::stream, stdext::seekable> file_data, uint32_t hash)
+bool apply_dif(stdext::array_view<std::byte> image, uint32_t hash)
 {
-    static const std::map<uint32_t, uint32_t> diffs =
+    static const std::map<uint32_t, stdext::array_view<const dif_entry>> diffs =
     {
-        { 0x8c99fb40, RESOURCE_ID_WING1_DIFF },
-        { 0xfce65eac, RESOURCE_ID_TRANSFER_DIFF },
-        { 0xa6ddc22a, RESOURCE_ID_SM1_DIFF },
-        { 0x74350efd, RESOURCE_ID_SM2_DIFF },
-        { 0x067a8af5, RESOURCE_ID_WING2_DIFF },
-        { 0x91f07afd, RESOURCE_ID_SO1_DIFF },
-        { 0x049f706e, RESOURCE_ID_SO2_DIFF }
+        { 0x8c99fb40, wing1_dif },
+        { 0xfce65eac, transfer_dif },
+        { 0xa6ddc22a, sm1_dif },
+        { 0x74350efd, sm2_dif },
+        { 0x067a8af5, wing2_dif },
+        { 0x91f07afd, so1_dif },
+        { 0x049f706e, so2_dif }
     };
 
-    resource_stream resource;
-    {
-        auto i = diffs.find(hash);
-        if (i == diffs.end())
-            return false;
-
-        resource = resource_stream(i->second);
-    }
-
-    auto line = read_line(resource);
-    if (line == std::nullopt)
+    auto i = diffs.find(hash);
+    if (i == diffs.end())
         return false;
+    auto dif = i->second;
 
-    // Skip the UTF-8 byte order mark, if present
-    auto gen = stdext::make_generator(*line);
-    auto i = stdext::extract_utf32(gen) == stdext::UNICODE_BYTE_ORDER_MARK ? gen.base() : line->begin();
-
-    char tag[] = "This difference file has been created by IDA";
-    if (std::mismatch(i, line->end(), std::begin(tag), std::end(tag)).second != std::end(tag) - 1)
+    // The table is sorted by offset, so only the last entry needs a bounds
+    // check.  Every original byte is verified before anything is written, so
+    // a mismatched image is left as it was.
+    if (dif[dif.size() - 1].offset >= image.size())
         return false;
 
-    while ((line = read_line(resource)) != std::nullopt)
-    {
-        if (line->empty())
-            continue;
-
-        auto n = line->find(':');
-        if (n == std::string::npos)
-            continue;
-        stdext::string_view address_str(line->data(), n);
-
-        n = line->find_first_not_of(' ', n + 1);
-        if (n == std::string::npos)
-            return false;
-        auto m = line->find(' ', n);
-        if (n == std::string::npos)
-            return false;
-        stdext::string_view original_value_str(line->data() + n, m - n);
-
-        n = line->find_first_not_of(' ', m + 1);
-        if (n == std::string::npos)
-            return false;
-        m = line->find(' ', n);
-        if (m == std::string::npos)
-            m = line->length();
-        stdext::string_view replacement_value_str(line->data() + n, m - n);
-
-        if (line->find_first_not_of(' ', m + 1) != std::string::npos)
-            return false;
-
-        if (original_value_str.compare("FFFFFFFF") == 0)
-            continue;
-
-        uint32_t offset = stoul(address_str, nullptr, 16);
-        auto original_value = std::byte(stoul(original_value_str, nullptr, 16));
-        auto replacement_value = std::byte(stoul(replacement_value_str, nullptr, 16));
+    auto data = reinterpret_cast<uint8_t*>(image.data());
+    if (!std::all_of(dif.begin(), dif.end(), [&](const dif_entry& entry) { return data[entry.offset] == entry.original; }))
+        return false;
 
-        auto& stream = file_data.as<stdext::stream>();
-        auto& seekable = file_data.as<stdext::seekable>();
-        seekable.seek(stdext::seek_from::begin, offset);
-        auto value = stream.read<std::byte>();
-        if (value != original_value)
-            return false;
-        seekable.seek(stdext::seek_from::current, -1);
-        stream.write(replacement_value);
-    }
+    for (auto& entry : dif)
+        data[entry.offset] = entry.replacement;
 
     return true;
 }
-
-std::optional<std::string> read_line(stdext::multi_ref<stdext::input_stream, stdext::seekable> is)
-{
-    auto& stream = is.as<stdext::input_stream>();
-    auto& seekable = is.as<stdext::seekable>();
-
-    char ch;
-    if (stream.read(&ch, 1) == 0)
-        return std::nullopt;
-
-    seekable.seek(stdext::seek_from::current, -1);
-    auto position = seekable.position();
-    size_t length = 0;
-    while (stream.read(&ch, 1) == 1 && (ch != '\r') && (ch != '\n'))
-        ++length;
-    seekable.set_position(position);
-
-    std::string line;
-    line.reserve(length);
-    while (stream.read(&ch, 1) == 1 && (ch != '\r') && (ch != '\n'))
-        line += ch;
-
-    if ((ch == '\r') && stream.read(&ch, 1) == 1 && (ch != '\n'))
-        seekable.seek(stdext::seek_from::current, -1);
-
-    return line;
-}
@@ -1,18 +1,27 @@
+#include <parallel/parallel_for.h>
+#include <resource/archive.h>
+#include <resource/lzw.h>
+
+#include <stdext/array_view.h>
 #include <stdext/file.h>
 #include <stdext/string.h>
 #include <stdext/utility.h>
 
 #include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <exception>
 #include <filesystem>
+#include <iomanip>
 #include <iostream>
-#include <stack>
+#include <limits>
 #include <stdexcept>
 #include <string>
 #include <vector>
 
-#include <climits>
 #include <cstdint>
 #include <cstdlib>
+#include <cstring>
 #include <cwchar>
 
 
@@ -42,30 +51,30 @@ namespace
         using runtime_error::runtime_error;
     };
 
-    class bit_input_stream
+    struct packed_resource
+    {
+        uint8_t type = wcdx::resource::resource_type_uncompressed;
+        std::vector<std::byte> data;
+    };
+
+    struct archive_item
     {
-    public:
-        explicit bit_input_stream(stdext::input_stream& stream) noexcept;
-        bit_input_stream(const bit_input_stream&) = delete;
-        bit_input_stream& operator = (const bit_input_stream&) = delete;
-
-    public:
-        template <class Int, STDEXT_REQUIRES(std::is_integral_v<Int>)>
-        Int read(size_t bit_width);
-
-    private:
-        stdext::input_stream* _stream;
-        size_t _src_bit_position = CHAR_BIT;
-        std::byte _src_byte;
+        uint8_t type;
+        stdext::array_view<const std::byte> data;
     };
 
     void show_usage(const wchar_t* invocation);
     void diagnose_options(const program_options& options);
 
-    void extract_all(stdext::file_input_stream& input_file, const wchar_t* output_path);
-    void extract_one(stdext::file_input_stream& input_file, unsigned index, const wchar_t* output_path);
-    void extract_uncompressed(stdext::input_stream& input_file, stdext::output_stream& output_file);
-    void extract_compressed(stdext::input_stream& input_file, stdext::output_stream& output_file);
+    void extract_all(const wchar_t* input_path, const wchar_t* output_path);
+    void extract_one(const wchar_t* input_path, unsigned index, const wchar_t* output_path);
+    void write_resource(const wcdx::resource::archive& archive, unsigned index, const wchar_t* output_path);
+
+    void pack(const std::vector<const wchar_t*>& input_paths, const wchar_t* output_path);
+    void replace_one(const wchar_t* archive_path, unsigned index, const wchar_t* resource_path, const wchar_t* output_path);
+    packed_resource pack_resource(std::vector<std::byte> data);
+    void write_archive(const std::vector<archive_item>& items, const wchar_t* output_path);
+    std::vector<std::byte> read_file(const wchar_t* path);
 }
 
 int wmain(int argc, wchar_t* argv[])
@@ -124,6 +133,14 @@ int wmain(int argc, wchar_t* argv[])
                         throw usage_error("The -replace option can only be used once.");
 
                     options.mode |= mode_replace;
+                    if (++n == argc)
+                        throw usage_error("Missing resource index");
+
+                    wchar_t* endp;
+                    options.index = unsigned(wcstoul(argv[n], &endp, 10));
+                    if (*endp != L'\0')
+                        throw usage_error("Bad resource index: " + stdext::to_mbstring(argv[n]));
+
                     diagnose_options(options);
                 }
                 else if (wcscmp(argv[n], L"-o") == 0)
@@ -140,7 +157,10 @@ int wmain(int argc, wchar_t* argv[])
             }
             else
             {
-                if (options.input_paths.size() > 0 && (options.mode & mode_pack) != mode_pack)
+                // -pack takes any number of input paths, and -replace takes the
+                // archive followed by the new resource.
+                auto max_input_paths = (options.mode & mode_pack) != 0 ? size_t(-1) : (options.mode & mode_replace) != 0 ? 2 : 1;
+                if (options.input_paths.size() == max_input_paths)
                     throw usage_error("Unrecognized argument: " + stdext::to_mbstring(argv[n]));
                 options.input_paths.push_back(argv[n]);
             }
@@ -149,19 +169,30 @@ int wmain(int argc, wchar_t* argv[])
         if (options.input_paths.size() == 0)
             throw usage_error("No input path specified");
 
-        stdext::file_input_stream input_file(options.input_paths.front());
         switch (options.mode & mode_operation_mask)
         {
         case mode_extract:
-            extract_one(input_file, options.index, options.output_path);
+            extract_one(options.input_paths.front(), options.index, options.output_path);
             break;
 
         case mode_extract_all:
-            extract_all(input_file, options.output_path);
+            extract_all(options.input_paths.front(), options.output_path);
             break;
 
         case mode_pack:
+            if (options.output_path == nullptr)
+                throw usage_error("No output path specified");
+
+            pack(options.input_paths, options.output_path);
+            break;
+
         case mode_replace:
+            if (options.output_path == nullptr)
+                throw usage_error("No output path specified");
+            if (options.input_paths.size() != 2)
+                throw usage_error("No replacement resource specified");
+
+            replace_one(options.input_paths[0], options.index, options.input_paths[1], options.output_path);
             break;
 
         default:
@@ -189,45 +220,17 @@ int wmain(int argc, wchar_t* argv[])
 
 namespace
 {
-    bit_input_stream::bit_input_stream(stdext::input_stream& stream) noexcept
-        : _stream(&stream)
-    {
-    }
-
-    template <class Int, STDEXT_REQUIRED(std::is_integral_v<Int>)>
-    Int bit_input_stream::read(size_t bit_width)
-    {
-        Int result = {};
-        size_t dst_bit_position = 0;
-        while (bit_width != 0)
-        {
-            if (_src_bit_position == CHAR_BIT)
-            {
-                _src_byte = _stream->read<std::byte>();
-                _src_bit_position = 0;
-            }
-            size_t bits_used = stdext::min(bit_width, size_t(CHAR_BIT - _src_bit_position));
-            auto byte = (_src_byte >> _src_bit_position) & std::byte((1 << bits_used) - 1);
-            _src_bit_position += bits_used;
-            bit_width -= bits_used;
-            result |= Int(byte) << dst_bit_position;
-            dst_bit_position += bits_used;
-        }
-
-        return result;
-    }
-
     void show_usage(const wchar_t* invocation)
     {
         std::wcout <<
             L"Usage: " << invocation << " -o <output_path> -extract <resource_index> <input_path>\n"
             L"       " << invocation << " -o <output_path> -extract-all <input_path>\n"
             L"       " << invocation << " -o <output_path> -pack <input_path>...\n"
-            L"       " << invocation << " -o <output_path> -replace <resource_index> <input_path>\n"
+            L"       " << invocation << " -o <output_path> -replace <resource_index> <input_path> <resource_path>\n"
             L"\n"
             L"With -extract or -extract-all, extracts resources from files found in the\n"
             L"GAMEDAT folder of wc1 and wc2.  With -pack, creates a new archive from the given\n"
-            L"input files.\n"
+            L"input files.  With -replace, replaces one resource in an existing archive.\n"
             L"\n"
             L"The -extract option extracts a single resource from a file and saves it at\n"
             L"<output_path>.  Resources in a file are numbered starting from 0, with the\n"
@@ -241,7 +244,13 @@ namespace
             L"extracting resources from an archive, the -pack option creates a new archive\n"
             L"at <output_path> from the given <input_path> arguments.  Any number of\n"
             L"<input_path>s may be given.  Resources will be packed in the same order as they\n"
-            L"appear on the command line.\n";
+            L"appear on the command line.  Each resource is compressed, unless compression\n"
+            L"would not make it smaller, in which case it is stored as is.\n"
+            L"\n"
+            L"The -replace option creates a copy of the archive at <input_path> in which\n"
+            L"resource number <resource_index> is replaced with the contents of\n"
+            L"<resource_path>.  The other resources are copied unchanged.  <output_path> may\n"
+            L"be the same as <input_path>.\n";
     }
 
     void diagnose_options(const program_options& options)
@@ -249,131 +258,143 @@ namespace
         stdext::discard(options);
     }
 
-    void extract_all(stdext::file_input_stream& input_file, const wchar_t* output_path)
+    void extract_all(const wchar_t* input_path, const wchar_t* output_path)
     {
-        [[maybe_unused]] auto file_size = input_file.read<uint32_t>();
-        auto first_resource_offset = input_file.read<uint32_t>() & 0x00FFFFFF;
-        auto resource_count = (first_resource_offset - 4) / 4;
+        wcdx::resource::archive archive(input_path);
 
         auto dir = std::filesystem::current_path();
         if (output_path == nullptr)
             output_path = dir.c_str();
 
         std::filesystem::create_directories(output_path);
-        for (uint32_t n = 0; n < resource_count; ++n)
-        {
-            input_file.set_position(0);
-            extract_one(input_file, n, (std::filesystem::path(output_path) /= std::to_wstring(n)).c_str());
-        }
+        for (unsigned n = 0; n != archive.size(); ++n)
+            write_resource(archive, n, (std::filesystem::path(output_path) /= std::to_wstring(n)).c_str());
     }
 
-    void extract_one(stdext::file_input_stream& input_file, unsigned index, const wchar_t* output_path)
+    void extract_one(const wchar_t* input_path, unsigned index, const wchar_t* output_path)
     {
-        auto descriptor_offset = 4 + (4 * index);
-        auto file_size = input_file.read<uint32_t>();
-        auto first_resource_offset = input_file.read<uint32_t>() & 0x00FFFFFF;
-        if (first_resource_offset <= descriptor_offset)
-            throw std::range_error("Resource index " + std::to_string(index) + " out of range");
+        wcdx::resource::archive archive(input_path);
+        write_resource(archive, index, output_path);
+    }
 
-        input_file.set_position(descriptor_offset);
-        auto resource_offset = input_file.read<uint32_t>();
-        auto resource_type = resource_offset >> 24;
-        resource_offset &= 0x00FFFFFF;
-        auto resource_size = input_file.position() == first_resource_offset
-            ? file_size - resource_offset
-            : (input_file.read<uint32_t>() & 0x00FFFFFF) - resource_offset;
+    void write_resource(const wcdx::resource::archive& archive, unsigned index, const wchar_t* output_path)
+    {
+        // Uncompressed resources are written straight from the archive.
+        if (archive.entry(index).type != wcdx::resource::resource_type_compressed)
+        {
+            auto data = archive.stored_data(index);
+            stdext::file_output_stream output_file(output_path);
+            output_file.write_all(data.data(), data.size());
+            return;
+        }
 
-        input_file.set_position(resource_offset);
-        stdext::substream resource_stream(input_file, resource_size);
+        auto data = archive.extract(index);
         stdext::file_output_stream output_file(output_path);
+        output_file.write_all(data.data(), data.size());
+    }
 
-        if (resource_type == 1)
+    void pack(const std::vector<const wchar_t*>& input_paths, const wchar_t* output_path)
+    {
+        auto start_time = std::chrono::steady_clock::now();
+
+        // Resources are read and compressed independently of each other, so
+        // the archive doesn't depend on which thread handles which resource.
+        // As in a serial run, the first failing resource (by index) is
+        // reported, and no resource past it is started.
+        std::vector<packed_resource> resources(input_paths.size());
+        std::atomic<size_t> input_size = 0;
+        wcdx::parallel::parallel_for_each_index(resources.size(), [&](size_t n)
         {
-            resource_size = resource_stream.read<uint32_t>();
-            extract_compressed(resource_stream, output_file);
+            auto data = read_file(input_paths[n]);
+            input_size += data.size();
+            resources[n] = pack_resource(std::move(data));
+        });
+
+        std::vector<archive_item> items;
+        items.reserve(resources.size());
+        size_t output_size = 0;
+        for (auto& resource : resources)
+        {
+            items.push_back({ resource.type, stdext::array_view<const std::byte>(resource.data.data(), resource.data.size()) });
+            output_size += resource.data.size();
         }
-        else
-            extract_uncompressed(resource_stream, output_file);
 
-        if (output_file.position() != resource_size)
-            throw std::runtime_error("Resource size mismatch");
+        write_archive(items, output_path);
+
+        auto seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start_time).count();
+        std::wcout << L"Packed " << resources.size() << L" resources (" << std::fixed << std::setprecision(2)
+            << (double(input_size) / (1024 * 1024)) << L" MB into " << (double(output_size) / (1024 * 1024)) << L" MB) in "
+            << seconds << L" s\n";
     }
 
-    void extract_uncompressed(stdext::input_stream& input_file, stdext::output_stream& output_file)
+    void replace_one(const wchar_t* archive_path, unsigned index, const wchar_t* resource_path, const wchar_t* output_path)
     {
-        std::byte buf[0x1000];
-        size_t bytes;
-        while ((bytes = input_file.read(buf)) != 0)
-            output_file.write_all(buf, bytes);
+        // The archive is read in full before anything is written, so it can
+        // be replaced in place.
+        auto archive_data = read_file(archive_path);
+        wcdx::resource::archive archive(stdext::array_view<const std::byte>(archive_data.data(), archive_data.size()));
+        if (index >= archive.size())
+            throw std::range_error("Resource index " + std::to_string(index) + " out of range");
+
+        // Every resource but the replaced one is copied as is, whatever its
+        // type, along with any padding that follows it.
+        std::vector<archive_item> items;
+        items.reserve(archive.size());
+        for (size_t n = 0; n != archive.size(); ++n)
+            items.push_back({ archive.entry(n).type, archive.stored_data(n) });
+
+        auto resource = pack_resource(read_file(resource_path));
+        items[index] = { resource.type, stdext::array_view<const std::byte>(resource.data.data(), resource.data.size()) };
+
+        write_archive(items, output_path);
     }
 
-    void extract_compressed(stdext::input_stream& input_file, stdext::output_stream& output_file)
+    packed_resource pack_resource(std::vector<std::byte> data)
     {
-        static constexpr size_t min_code_width = 9;
-        static constexpr size_t max_code_width = 12;
-        static constexpr size_t initial_table_size = 0x102;
-        static constexpr uint16_t reset_code = 0x100;
-        static constexpr uint16_t stop_code = 0x101;
-
-        struct entry
-        {
-            uint16_t prev_index;
-            std::byte value;
-        } table[1 << max_code_width];
-        std::stack<std::byte> stack;
-
-        bit_input_stream bit_reader(input_file);
-        auto code = bit_reader.read<uint16_t>(min_code_width);
-        if (code == stop_code)
-            return;
-        if (code != reset_code)
-            throw std::runtime_error("Compressed data stream missing reset code");
+        // Compressed resources start with their uncompressed size.
+        auto compressed = wcdx::resource::lzw_compress(stdext::array_view<const std::byte>(data.data(), data.size()));
+        if (sizeof(uint32_t) + compressed.size() >= data.size())
+            return { wcdx::resource::resource_type_uncompressed, std::move(data) };
+
+        packed_resource resource;
+        resource.type = wcdx::resource::resource_type_compressed;
+        resource.data.resize(sizeof(uint32_t) + compressed.size());
+        auto size = uint32_t(data.size());
+        std::memcpy(resource.data.data(), &size, sizeof(size));
+        std::copy(compressed.begin(), compressed.end(), resource.data.begin() + sizeof(size));
+        return resource;
+    }
 
-        do
+    void write_archive(const std::vector<archive_item>& items, const wchar_t* output_path)
+    {
+        // The archive starts with its own size, followed by the offset of
+        // each resource, and then the resources themselves.
+        std::vector<uint32_t> header(1 + items.size());
+        size_t offset = sizeof(uint32_t) * header.size();
+        for (size_t n = 0; n != items.size(); ++n)
         {
-            size_t code_width = min_code_width;
-            size_t code_width_threshold = 1 << code_width;
-            size_t table_size = initial_table_size;
-            uint16_t prev_code = code;
-            while ((code = bit_reader.read<uint16_t>(code_width)) != reset_code && code != stop_code)
-            {
-                size_t index = code;
-                if (index > table_size)
-                    throw std::range_error("Decompressor table index out of range");
-
-                if (index == table_size)
-                {
-                    if (prev_code == reset_code)
-                        throw std::range_error("Decompressor table index out of range");
-                    index = prev_code;
-                }
+            if (offset > wcdx::resource::max_resource_offset)
+                throw std::runtime_error("Archive is too large");
 
-                while (index > 0xFF)
-                {
-                    stack.push(table[index].value);
-                    index = table[index].prev_index;
-                }
+            header[n + 1] = (uint32_t(items[n].type) << 24) | uint32_t(offset);
+            offset += items[n].data.size();
+        }
 
-                auto first_value = std::byte(index);
-                output_file.write(first_value);
-                for (; !stack.empty(); stack.pop())
-                    output_file.write(stack.top());
+        if (offset > std::numeric_limits<uint32_t>::max())
+            throw std::runtime_error("Archive is too large");
+        header[0] = uint32_t(offset);
 
-                if (prev_code != reset_code)
-                {
-                    table[table_size].prev_index = prev_code;
-                    table[table_size].value = first_value;
-                    if (code == table_size)
-                        output_file.write(first_value);
-                    if (++table_size == code_width_threshold && code_width != max_code_width)
-                    {
-                        ++code_width;
-                        code_width_threshold <<= 1;
-                    }
-                }
+        stdext::file_output_stream output_file(output_path);
+        output_file.write_all(header.data(), header.size());
+        for (auto& item : items)
+            output_file.write_all(item.data.data(), item.data.size());
+    }
 
-                prev_code = code;
-            }
-        } while (code != stop_code);
+    std::vector<std::byte> read_file(const wchar_t* path)
+    {
+        stdext::file_input_stream file(path);
+        std::vector<std::byte> data(size_t(file.end_position()));
+        file.read_all(data.data(), data.size());
+        return data;
     }
 }
@@ -0,0 +1,230 @@
+#ifndef AUDIO_WCAUDIO_STREAM_INCLUDED
+#define AUDIO_WCAUDIO_STREAM_INCLUDED
+#pragma once
+
+#include <resource/mapped_file.h>
+
+#include <stdext/stream.h>
+
+#include <filesystem>
+#include <functional>
+#include <memory>
+#include <utility>
+#include <vector>
+
+#include <cstddef>
+#include <cstdint>
+
+
+namespace wcdx::audio
+{
+    constexpr auto end_of_track = uint32_t(-1);
+    constexpr auto no_trigger = uint8_t(-1);
+
+    struct chunk_header;
+    struct stream_chunk_link;
+    struct stream_trigger_link;
+
+    struct stream_file_header
+    {
+        uint32_t magic;
+        uint32_t version;
+        uint8_t channels;
+        uint8_t bits_per_sample;
+        uint16_t sample_rate;
+        uint32_t buffer_size;
+        uint32_t reserved1;
+        uint32_t chunk_headers_offset;
+        uint32_t chunk_count;
+        uint32_t chunk_link_offset;
+        uint32_t chunk_link_count;
+        uint32_t trigger_link_offset;
+        uint32_t trigger_link_count;
+        uint32_t file_buffer_size;
+        uint32_t file_entry_offset;
+        uint32_t file_entry_count;
+        uint32_t thing5_offset;
+        uint32_t thing5_count;
+        uint32_t thing6_offset;
+        uint32_t thing6_count;
+        uint8_t reserved2[32];
+    };
+
+    // The parsed tables of a stream file, together with the mapped file itself.
+    // Nothing in it changes after it is opened, so any number of wcaudio_streams,
+    // on any number of threads, can play from the same wcaudio_file.
+    class wcaudio_file
+    {
+    public:
+        // Throws std::runtime_error if the file isn't a valid stream.
+        explicit wcaudio_file(const std::filesystem::path& path);
+        wcaudio_file(const wcaudio_file&) = delete;
+        wcaudio_file& operator = (const wcaudio_file&) = delete;
+        ~wcaudio_file();
+
+    public:
+        const stream_file_header& header() const noexcept { return _header; }
+        const std::byte* data() const noexcept { return _file.data(); }
+        unsigned frame_size() const noexcept { return _frame_size; }
+
+        const std::vector<chunk_header>& chunks() const noexcept { return _chunks; }
+        const std::vector<stream_chunk_link>& chunk_links() const noexcept { return _chunk_links; }
+        const std::vector<stream_trigger_link>& trigger_links() const noexcept { return _trigger_links; }
+
+    private:
+        wcdx::resource::mapped_file _file;
+        stream_file_header _header;
+        unsigned _frame_size;
+
+        std::vector<chunk_header> _chunks;
+        std::vector<stream_chunk_link> _chunk_links;
+        std::vector<stream_trigger_link> _trigger_links;
+    };
+
+    class wcaudio_stream : public stdext::input_stream
+    {
+    public:
+        using next_chunk_handler = std::function<void (uint32_t chunk_index, unsigned frame_count)>;
+        using loop_handler = std::function<bool (uint32_t chunk_index, unsigned frame_count)>;
+        using start_track_handler = std::function<void (uint32_t chunk_index)>;
+        using next_track_handler = std::function<bool (uint32_t chunk_index, unsigned frame_count)>;
+        using prev_track_handler = std::function<void (unsigned frame_count)>;
+        using end_of_stream_handler = std::function<void (unsigned frame_count)>;
+
+    public:
+        // Maps the stream file; audio data is read straight from the mapping.
+        explicit wcaudio_stream(const std::filesystem::path& path);
+
+        // Plays from a file that may be shared with other streams.  Each stream
+        // keeps its own position and handlers.
+        explicit wcaudio_stream(std::shared_ptr<const wcaudio_file> file);
+
+        ~wcaudio_stream() override;
+
+    public:
+        uint8_t channels() const;
+        uint8_t bits_per_sample() const;
+        uint16_t sample_rate() const;
+        uint32_t buffer_size() const;
+
+        std::vector<uint8_t> triggers() const;
+        std::vector<uint8_t> intensities() const;
+
+        // The number of frames played since the last call to select.
+        unsigned frame_count() const;
+
+        void select(uint8_t trigger, uint8_t intensity);
+
+        void on_next_chunk(next_chunk_handler handler);
+        void on_loop(loop_handler handler);
+        void on_start_track(start_track_handler handler);
+        void on_next_track(next_track_handler handler);
+        void on_prev_track(prev_track_handler handler);
+        void on_end_of_stream(end_of_stream_handler handler);
+
+    private:
+        size_t do_read(std::byte* buffer, size_t size) override;
+        size_t do_skip(size_t size) override;
+
+        enum class transition_kind : uint8_t
+        {
+            end_of_stream,
+            prev_track,
+            start_track,
+            linked_chunk,
+            next_chunk,
+            wrap
+        };
+
+        struct chunk_transition
+        {
+            transition_kind kind;
+            uint32_t chunk_index;
+        };
+
+        uint32_t next_chunk_index(uint32_t chunk_index, uint8_t trigger, uint8_t intensity);
+        chunk_transition find_transition(uint32_t chunk_index, uint8_t trigger, uint8_t intensity) const;
+        uint32_t follow(const chunk_transition& transition);
+        void build_transitions(uint8_t intensity);
+
+    private:
+        std::shared_ptr<const wcaudio_file> _file;
+
+        next_chunk_handler _next_chunk_handler;
+        loop_handler _loop_handler;
+        start_track_handler _start_track_handler;
+        next_track_handler _next_track_handler;
+        prev_track_handler _prev_track_handler;
+        end_of_stream_handler _end_of_stream_handler;
+
+        // Where playback goes at the end of each chunk with no trigger at the
+        // selected intensity.  Built by select, so that crossing a chunk boundary
+        // doesn't search the chunk's links.
+        std::vector<chunk_transition> _transitions;
+        uint8_t _transitions_intensity = 0;
+
+        uint32_t _current_chunk_index = end_of_track;
+        uint32_t _current_chunk_offset = 0;
+        uint8_t _current_intensity = 0;
+
+        unsigned _frame_count = 0;
+        uint32_t _first_chunk_index = 0;
+    };
+
+    inline uint8_t wcaudio_stream::channels() const
+    {
+        return _file->header().channels;
+    }
+
+    inline uint8_t wcaudio_stream::bits_per_sample() const
+    {
+        return _file->header().bits_per_sample;
+    }
+
+    inline uint16_t wcaudio_stream::sample_rate() const
+    {
+        return _file->header().sample_rate;
+    }
+
+    inline uint32_t wcaudio_stream::buffer_size() const
+    {
+        return _file->header().buffer_size;
+    }
+
+    inline unsigned wcaudio_stream::frame_count() const
+    {
+        return _frame_count;
+    }
+
+    inline void wcaudio_stream::on_next_chunk(next_chunk_handler handler)
+    {
+        _next_chunk_handler = std::move(handler);
+    }
+
+    inline void wcaudio_stream::on_loop(loop_handler handler)
+    {
+        _loop_handler = std::move(handler);
+    }
+
+    inline void wcaudio_stream::on_start_track(start_track_handler handler)
+    {
+        _start_track_handler = std::move(handler);
+    }
+
+    inline void wcaudio_stream::on_next_track(next_track_handler handler)
+    {
+        _next_track_handler = std::move(handler);
+    }
+
+    inline void wcaudio_stream::on_prev_track(prev_track_handler handler)
+    {
+        _prev_track_handler = std::move(handler);
+    }
+
+    inline void wcaudio_stream::on_end_of_stream(end_of_stream_handler handler)
+    {
+        _end_of_stream_handler = std::move(handler);
+    }
+}
+
+#endif
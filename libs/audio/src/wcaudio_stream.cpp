@@ -0,0 +1,303 @@
+#include <audio/wcaudio_stream.h>
+
+#include <stdext/array_view.h>
+#include <stdext/endian.h>
+
+#include <algorithm>
+#include <stdexcept>
+#include <type_traits>
+
+#include <cstdlib>
+#include <cstring>
+
+
+using namespace stdext::literals;
+
+namespace wcdx::audio
+{
+    struct chunk_header
+    {
+        uint32_t start_offset;
+        uint32_t end_offset;
+        uint32_t trigger_link_count;
+        uint32_t trigger_link_index;
+        uint32_t chunk_link_count;
+        uint32_t chunk_link_index;
+    };
+
+#pragma pack(push)
+#pragma pack(1)
+    struct stream_chunk_link
+    {
+        uint8_t intensity;
+        uint32_t chunk_index;
+    };
+
+    struct stream_trigger_link
+    {
+        uint8_t trigger;
+        uint32_t chunk_index;
+    };
+#pragma pack(pop)
+
+    namespace
+    {
+        constexpr uint8_t end_of_stream_trigger = 64;
+        constexpr uint8_t prev_track_trigger = 65;
+    }
+
+    wcaudio_file::wcaudio_file(const std::filesystem::path& path)
+        : _file(path)
+    {
+        auto data = _file.view();
+        if (data.size() < sizeof(_header))
+            throw std::runtime_error("Invalid stream.");
+
+        std::memcpy(&_header, data.data(), sizeof(_header));
+        if (_header.magic != "STRM"_4cc)
+            throw std::runtime_error("Invalid stream.");
+
+        auto read_table = [&](auto& table, uint32_t offset, uint32_t count)
+        {
+            using value_type = typename std::remove_reference_t<decltype(table)>::value_type;
+            if (offset > data.size() || count > (data.size() - offset) / sizeof(value_type))
+                throw std::runtime_error("Invalid stream.");
+
+            table.resize(count);
+            if (count != 0)
+                std::memcpy(table.data(), data.data() + offset, count * sizeof(value_type));
+        };
+
+        read_table(_chunks, _header.chunk_headers_offset, _header.chunk_count);
+        read_table(_chunk_links, _header.chunk_link_offset, _header.chunk_link_count);
+        read_table(_trigger_links, _header.trigger_link_offset, _header.trigger_link_count);
+
+        _frame_size = _header.channels * ((_header.bits_per_sample + 7) / 8);
+        if (_chunks.empty() || _frame_size == 0)
+            throw std::runtime_error("Invalid stream.");
+
+        // Check everything that playback follows up front, so that reads can
+        // trust the tables.
+        for (auto& chunk : _chunks)
+        {
+            if (chunk.start_offset > chunk.end_offset || chunk.end_offset > data.size()
+                || uint64_t(chunk.trigger_link_index) + chunk.trigger_link_count > _trigger_links.size()
+                || uint64_t(chunk.chunk_link_index) + chunk.chunk_link_count > _chunk_links.size())
+            {
+                throw std::runtime_error("Invalid stream.");
+            }
+        }
+
+        for (auto& link : _trigger_links)
+        {
+            if (link.trigger != end_of_stream_trigger && link.trigger != prev_track_trigger && link.chunk_index >= _chunks.size())
+                throw std::runtime_error("Invalid stream.");
+        }
+
+        for (auto& link : _chunk_links)
+        {
+            if (link.chunk_index >= _chunks.size())
+                throw std::runtime_error("Invalid stream.");
+        }
+    }
+
+    wcaudio_file::~wcaudio_file() = default;
+
+    wcaudio_stream::wcaudio_stream(const std::filesystem::path& path)
+        : _file(std::make_shared<const wcaudio_file>(path))
+    {
+    }
+
+    wcaudio_stream::wcaudio_stream(std::shared_ptr<const wcaudio_file> file)
+        : _file(std::move(file))
+    {
+    }
+
+    wcaudio_stream::~wcaudio_stream() = default;
+
+    std::vector<uint8_t> wcaudio_stream::triggers() const
+    {
+        auto& chunk = _file->chunks()[0];
+        stdext::array_view<const stream_trigger_link> trigger_links(_file->trigger_links().data() + chunk.trigger_link_index, chunk.trigger_link_count);
+        std::vector<uint8_t> triggers;
+        triggers.reserve(trigger_links.size());
+        for (auto& link : trigger_links)
+            triggers.push_back(link.trigger);
+        return triggers;
+    }
+
+    std::vector<uint8_t> wcaudio_stream::intensities() const
+    {
+        auto& index_chunk = _file->chunks()[0];
+        stdext::array_view<const stream_chunk_link> chunk_links(_file->chunk_links().data() + index_chunk.chunk_link_index, index_chunk.chunk_link_count);
+        std::vector<uint8_t> intensities;
+        intensities.reserve(chunk_links.size());
+        for (auto& link : chunk_links)
+            intensities.push_back(link.intensity);
+        return intensities;
+    }
+
+    void wcaudio_stream::select(uint8_t trigger, uint8_t intensity)
+    {
+        auto chunk_index = next_chunk_index(0, trigger, intensity);
+        if (chunk_index == end_of_track)
+            return;
+
+        _current_chunk_index = chunk_index;
+        _current_chunk_offset = 0;
+        _current_intensity = intensity;
+
+        _frame_count = 0;
+
+        if (_transitions.empty() || _transitions_intensity != intensity)
+            build_transitions(intensity);
+    }
+
+    size_t wcaudio_stream::do_read(std::byte* buffer, size_t size)
+    {
+        auto data = _file->data();
+        size_t total_bytes = 0;
+        while (size != 0 && _current_chunk_index != end_of_track)
+        {
+            auto& chunk = _file->chunks()[_current_chunk_index];
+            auto chunk_size = chunk.end_offset - chunk.start_offset;
+            auto bytes = std::min(size_t(chunk_size - _current_chunk_offset), size);
+
+            if (buffer != nullptr)
+            {
+                std::memcpy(buffer, data + chunk.start_offset + _current_chunk_offset, bytes);
+                buffer += bytes;
+            }
+
+            size -= bytes;
+            total_bytes += bytes;
+            _current_chunk_offset += uint32_t(bytes);
+            if (_current_chunk_offset == chunk_size)
+            {
+                _frame_count += chunk_size / _file->frame_size();
+                _current_chunk_offset = 0;
+                _current_chunk_index = follow(_transitions[_current_chunk_index]);
+            }
+        }
+
+        return total_bytes;
+    }
+
+    size_t wcaudio_stream::do_skip(size_t size)
+    {
+        return do_read(nullptr, size);
+    }
+
+    uint32_t wcaudio_stream::next_chunk_index(uint32_t chunk_index, uint8_t trigger, uint8_t intensity)
+    {
+        return follow(find_transition(chunk_index, trigger, intensity));
+    }
+
+    auto wcaudio_stream::find_transition(uint32_t chunk_index, uint8_t trigger, uint8_t intensity) const -> chunk_transition
+    {
+        auto& chunks = _file->chunks();
+        const auto& chunk = chunks[chunk_index];
+        auto track_link_first = begin(_file->trigger_links()) + chunk.trigger_link_index;
+        auto track_link_last = track_link_first + chunk.trigger_link_count;
+        for (; track_link_first != track_link_last; ++track_link_first)
+        {
+            switch (track_link_first->trigger)
+            {
+            case end_of_stream_trigger:
+                return { transition_kind::end_of_stream, end_of_track };
+            case prev_track_trigger:
+                return { transition_kind::prev_track, end_of_track };
+            default:
+                if (track_link_first->trigger == trigger)
+                    return { transition_kind::start_track, track_link_first->chunk_index };
+                break;
+            }
+        }
+
+        auto chunk_link_first = begin(_file->chunk_links()) + chunk.chunk_link_index;
+        auto chunk_link_last = chunk_link_first + chunk.chunk_link_count;
+        auto closest_intensity_level = 256;
+        auto closest_intensity_index = end_of_track;
+        for (; chunk_link_first != chunk_link_last; ++chunk_link_first)
+        {
+            auto delta = abs(chunk_link_first->intensity - intensity);
+            if (delta < closest_intensity_level)
+            {
+                closest_intensity_level = delta;
+                closest_intensity_index = chunk_link_first->chunk_index;
+            }
+        }
+
+        if (closest_intensity_index != end_of_track)
+            return { transition_kind::linked_chunk, closest_intensity_index };
+
+        if (++chunk_index == chunks.size())
+            return { transition_kind::wrap, 0 };
+
+        return { transition_kind::next_chunk, chunk_index };
+    }
+
+    uint32_t wcaudio_stream::follow(const chunk_transition& transition)
+    {
+        auto chunk_index = transition.chunk_index;
+        switch (transition.kind)
+        {
+        case transition_kind::end_of_stream:
+            if (_end_of_stream_handler != nullptr)
+                _end_of_stream_handler(_frame_count);
+            return end_of_track;
+
+        case transition_kind::prev_track:
+            if (_prev_track_handler != nullptr)
+                _prev_track_handler(_frame_count);
+            return end_of_track;
+
+        case transition_kind::start_track:
+            if (_start_track_handler != nullptr)
+                _start_track_handler(chunk_index);
+            _first_chunk_index = chunk_index;
+            return chunk_index;
+
+        case transition_kind::linked_chunk:
+            if (_current_chunk_index != end_of_track && chunk_index == _current_chunk_index + 1)
+            {
+                if (_next_chunk_handler != nullptr)
+                    _next_chunk_handler(chunk_index, _frame_count);
+            }
+            else if (_current_chunk_index != end_of_track && chunk_index < _current_chunk_index
+                     && chunk_index >= _first_chunk_index)
+            {
+                if (_loop_handler != nullptr && !_loop_handler(chunk_index, _frame_count))
+                    return end_of_track;
+            }
+            else
+            {
+                if (_next_track_handler != nullptr && !_next_track_handler(chunk_index, _frame_count))
+                    return end_of_track;
+                _first_chunk_index = chunk_index;
+            }
+            return chunk_index;
+
+        case transition_kind::next_chunk:
+            if (_next_chunk_handler != nullptr)
+                _next_chunk_handler(chunk_index, _frame_count);
+            return chunk_index;
+
+        case transition_kind::wrap:
+            _first_chunk_index = 0;
+            if (_next_track_handler != nullptr && !_next_track_handler(chunk_index, _frame_count))
+                return end_of_track;
+            return chunk_index;
+        }
+
+        return end_of_track;
+    }
+
+    void wcaudio_stream::build_transitions(uint8_t intensity)
+    {
+        _transitions.resize(_file->chunks().size());
+        for (uint32_t n = 0; n != _transitions.size(); ++n)
+            _transitions[n] = find_transition(n, no_trigger, intensity);
+        _transitions_intensity = intensity;
+    }
+}
@@ -0,0 +1,114 @@
+#ifndef FILEIO_BUFFERED_FILE_INCLUDED
+#define FILEIO_BUFFERED_FILE_INCLUDED
+#pragma once
+
+#include <memory>
+
+#include <cstddef>
+#include <cstdint>
+
+
+namespace wcdx::fileio
+{
+    enum class seek_origin
+    {
+        begin,
+        current,
+        end
+    };
+
+    // The unbuffered operations underneath a buffered_file; on Windows, a CRT
+    // file descriptor.  Each call counts as one system call.  Failures are
+    // reported by returning -1.
+    class file_device
+    {
+    public:
+        virtual ~file_device() = default;
+
+    public:
+        // Returns the new position.
+        virtual int64_t seek(int64_t offset, seek_origin origin) = 0;
+        // Return the number of bytes transferred.
+        virtual int64_t read(void* data, size_t size) = 0;
+        virtual int64_t write(const void* data, size_t size) = 0;
+        virtual int64_t length() = 0;
+    };
+
+    struct file_cache_stats
+    {
+        uint64_t read_hits = 0;             // reads served without touching the device
+        uint64_t read_misses = 0;
+        uint64_t syscalls = 0;              // device calls actually made
+        uint64_t unbuffered_syscalls = 0;   // device calls the same requests would make without the cache
+
+        int64_t syscalls_saved() const noexcept { return int64_t(unbuffered_syscalls - syscalls); }
+
+        file_cache_stats& operator += (const file_cache_stats& other) noexcept
+        {
+            read_hits += other.read_hits;
+            read_misses += other.read_misses;
+            syscalls += other.syscalls;
+            unbuffered_syscalls += other.unbuffered_syscalls;
+            return *this;
+        }
+    };
+
+    // Buffers access to a file that is read and written in many small pieces.
+    // Reads are served from a block-aligned read-ahead buffer, sequential
+    // writes are coalesced until the next seek, flush, or non-contiguous
+    // write, and the device is only repositioned when its position differs
+    // from the one a request needs.
+    //
+    // Requests mirror the CRT calls they replace: reads may come up short at
+    // the end of the file, and a failed request returns -1.  Because writes
+    // are deferred, a write failure may only be reported by a later request;
+    // call flush() before closing the device to see it.
+    class buffered_file
+    {
+    public:
+        // Pass as the offset of a read or write to use the current position.
+        static constexpr int64_t current_position = -1;
+        static constexpr size_t block_size = 0x4000;
+
+    public:
+        // The device must be positioned at the start of the file.
+        explicit buffered_file(std::unique_ptr<file_device> device);
+        buffered_file(const buffered_file&) = delete;
+        buffered_file& operator = (const buffered_file&) = delete;
+
+    public:
+        int64_t read(int64_t offset, void* data, size_t size);
+        int64_t write(int64_t offset, const void* data, size_t size);
+        int64_t seek(int64_t offset, seek_origin origin);
+        int64_t length();
+        bool flush();
+
+        int64_t position() const noexcept { return _position; }
+        const file_cache_stats& stats() const noexcept { return _stats; }
+
+    private:
+        bool reposition(int64_t offset);
+        bool device_seek(int64_t position);
+        int64_t device_read(void* data, size_t size);
+        int64_t device_write(const void* data, size_t size);
+        bool load_block(int64_t position);
+        bool cached(int64_t position) const noexcept { return position >= _block_start && position - _block_start < int64_t(_block_size); }
+
+    private:
+        std::unique_ptr<file_device> _device;
+        int64_t _position = 0;
+        int64_t _device_position = 0;  // -1 after a failure leaves it unknown
+
+        std::unique_ptr<std::byte[]> _block;
+        int64_t _block_start = 0;
+        size_t _block_size = 0;
+
+        std::unique_ptr<std::byte[]> _pending;
+        int64_t _pending_start = 0;
+        size_t _pending_size = 0;
+
+        file_cache_stats _stats;
+    };
+}
+
+#endif
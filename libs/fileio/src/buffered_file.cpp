@@ -0,0 +1,220 @@
+#include <fileio/buffered_file.h>
+
+#include <algorithm>
+#include <utility>
+
+#include <cstring>
+
+
+namespace wcdx::fileio
+{
+    buffered_file::buffered_file(std::unique_ptr<file_device> device)
+        : _device(std::move(device))
+    {
+    }
+
+    int64_t buffered_file::read(int64_t offset, void* data, size_t size)
+    {
+        _stats.unbuffered_syscalls += offset != current_position ? 2 : 1;
+        if (!reposition(offset) || !flush())
+            return -1;
+
+        auto syscalls = _stats.syscalls;
+        auto out = static_cast<std::byte*>(data);
+        size_t copied = 0;
+        while (copied != size)
+        {
+            if (!cached(_position))
+            {
+                // Large reads go straight into the caller's buffer.
+                if (size - copied >= block_size)
+                {
+                    if (!device_seek(_position))
+                        return -1;
+                    auto count = device_read(out + copied, size - copied);
+                    if (count < 0)
+                        return -1;
+                    copied += size_t(count);
+                    _position += count;
+                    break;
+                }
+
+                if (!load_block(_position))
+                    return -1;
+                if (!cached(_position))
+                    break;  // at or past the end of the file
+            }
+
+            auto available = size_t(_block_start + int64_t(_block_size) - _position);
+            auto count = std::min(available, size - copied);
+            std::memcpy(out + copied, _block.get() + size_t(_position - _block_start), count);
+            copied += count;
+            _position += int64_t(count);
+
+            // A short block ends at the end of the file.
+            if (count == available && _block_size != block_size)
+                break;
+        }
+
+        ++(_stats.syscalls == syscalls ? _stats.read_hits : _stats.read_misses);
+        return int64_t(copied);
+    }
+
+    int64_t buffered_file::write(int64_t offset, const void* data, size_t size)
+    {
+        _stats.unbuffered_syscalls += offset != current_position ? 2 : 1;
+        if (!reposition(offset))
+            return -1;
+
+        if (size == 0)
+            return 0;
+
+        // Anything written within the read-ahead block's span changes what the
+        // block should hold.  A short block also stops being the end of the
+        // file once anything is written past it.
+        if (_block_size != 0 && _block_start < _position + int64_t(size)
+            && (_position < _block_start + int64_t(block_size) || _block_size != block_size))
+        {
+            _block_size = 0;
+        }
+
+        if (_pending_size != 0 && (_position != _pending_start + int64_t(_pending_size) || _pending_size + size > block_size))
+        {
+            if (!flush())
+                return -1;
+        }
+
+        if (size >= block_size)
+        {
+            if (!device_seek(_position))
+                return -1;
+            auto count = device_write(data, size);
+            if (count < 0)
+                return -1;
+            _position += count;
+            return count;
+        }
+
+        if (_pending == nullptr)
+            _pending = std::make_unique<std::byte[]>(block_size);
+        if (_pending_size == 0)
+            _pending_start = _position;
+        std::memcpy(_pending.get() + _pending_size, data, size);
+        _pending_size += size;
+        _position += int64_t(size);
+        return int64_t(size);
+    }
+
+    int64_t buffered_file::seek(int64_t offset, seek_origin origin)
+    {
+        ++_stats.unbuffered_syscalls;
+        if (!flush())
+            return -1;
+
+        // Seeks relative to a known position only move the logical position;
+        // the device catches up when a request actually needs it to.
+        int64_t position;
+        switch (origin)
+        {
+        case seek_origin::begin:
+            position = offset;
+            break;
+
+        case seek_origin::current:
+            position = _position + offset;
+            break;
+
+        default:
+            ++_stats.syscalls;
+            position = _device->seek(offset, seek_origin::end);
+            _device_position = position;
+            break;
+        }
+
+        if (position < 0)
+            return -1;
+
+        _position = position;
+        return position;
+    }
+
+    int64_t buffered_file::length()
+    {
+        ++_stats.unbuffered_syscalls;
+        if (!flush())
+            return -1;
+
+        ++_stats.syscalls;
+        return _device->length();
+    }
+
+    bool buffered_file::flush()
+    {
+        if (_pending_size == 0)
+            return true;
+
+        // Pending data is dropped even if it can't be written; the failure is
+        // reported once, here.
+        auto size = std::exchange(_pending_size, 0);
+        if (!device_seek(_pending_start))
+            return false;
+
+        return device_write(_pending.get(), size) == int64_t(size);
+    }
+
+    bool buffered_file::reposition(int64_t offset)
+    {
+        if (offset == current_position)
+            return true;
+        if (offset < 0)
+            return false;
+
+        _position = offset;
+        return true;
+    }
+
+    bool buffered_file::device_seek(int64_t position)
+    {
+        if (position == _device_position)
+            return true;
+
+        ++_stats.syscalls;
+        _device_position = _device->seek(position, seek_origin::begin);
+        return _device_position >= 0;
+    }
+
+    int64_t buffered_file::device_read(void* data, size_t size)
+    {
+        ++_stats.syscalls;
+        auto count = _device->read(data, size);
+        _device_position = count >= 0 ? _device_position + count : -1;
+        return count;
+    }
+
+    int64_t buffered_file::device_write(const void* data, size_t size)
+    {
+        ++_stats.syscalls;
+        auto count = _device->write(data, size);
+        _device_position = count >= 0 ? _device_position + count : -1;
+        return count;
+    }
+
+    bool buffered_file::load_block(int64_t position)
+    {
+        if (_block == nullptr)
+            _block = std::make_unique<std::byte[]>(block_size);
+
+        _block_size = 0;
+        auto start = position - position % int64_t(block_size);
+        if (!device_seek(start))
+            return false;
+
+        auto count = device_read(_block.get(), block_size);
+        if (count < 0)
+            return false;
+
+        _block_start = start;
+        _block_size = size_t(count);
+        return true;
+    }
+}
@@ -0,0 +1,52 @@
+#ifndef FONT_FONT_INCLUDED
+#define FONT_FONT_INCLUDED
+#pragma once
+
+#include <memory>
+
+#include <cstddef>
+#include <cstdint>
+
+
+namespace wcdx::font
+{
+    constexpr size_t glyph_count = 0x100;
+
+    // Glyph pixels are palette indices; index 0 is background.
+    constexpr std::byte background_index = std::byte(0);
+
+    struct glyph_view
+    {
+        unsigned width;
+        unsigned height;
+        const std::byte* pixels;    // packed rows; null for empty glyphs
+    };
+
+    // A Wing Commander II font resource, as extracted from fonts.fnt by wcres.
+    // The resource starts with the font's height and a color index, then
+    // lists every glyph's width, then the low and high bytes of every glyph's
+    // offset, and ends with the glyphs' pixels.  All glyphs share the font's
+    // height.
+    //
+    // The pixels of every glyph are held in a single allocation.
+    class font
+    {
+    public:
+        // Throws std::runtime_error if the data isn't a valid font.
+        font(const std::byte* data, size_t size);
+        font(const font&) = delete;
+        font& operator = (const font&) = delete;
+
+    public:
+        unsigned height() const noexcept { return _height; }
+        glyph_view glyph(unsigned index) const noexcept;
+
+    private:
+        unsigned _height;
+        uint8_t _widths[glyph_count];
+        uint32_t _offsets[glyph_count];     // into _pixels
+        std::unique_ptr<std::byte[]> _pixels;
+    };
+}
+
+#endif
@@ -0,0 +1,58 @@
+#ifndef FONT_GLYPH_ATLAS_INCLUDED
+#define FONT_GLYPH_ATLAS_INCLUDED
+#pragma once
+
+#include <font/font.h>
+
+#include <memory>
+#include <string>
+
+#include <cstddef>
+#include <cstdint>
+
+
+namespace wcdx::font
+{
+    // Where a glyph lives in an atlas, and how far it moves the pen.
+    struct glyph_metrics
+    {
+        uint16_t x;
+        uint16_t y;
+        uint16_t width;
+        uint16_t height;
+        uint16_t advance;
+    };
+
+    // Every glyph of a font packed into one 8-bit image.  Glyphs are sorted
+    // by height and placed left to right on shelves as tall as the first
+    // glyph on them, with padding pixels of background between glyphs.  The
+    // atlas is square-ish: its width is the smallest power of two that would
+    // hold every glyph's padded area, or the widest glyph if that's wider.
+    class glyph_atlas
+    {
+    public:
+        explicit glyph_atlas(const font& font, unsigned padding = 1);
+        glyph_atlas(const glyph_atlas&) = delete;
+        glyph_atlas& operator = (const glyph_atlas&) = delete;
+
+    public:
+        unsigned width() const noexcept { return _width; }
+        unsigned height() const noexcept { return _height; }
+        unsigned line_height() const noexcept { return _line_height; }
+        const std::byte* pixels() const noexcept { return _pixels.get(); }
+        const glyph_metrics& metrics(unsigned index) const noexcept { return _metrics[index]; }
+
+    private:
+        unsigned _width = 0;
+        unsigned _height = 0;
+        unsigned _line_height;
+        glyph_metrics _metrics[glyph_count] = { };
+        std::unique_ptr<std::byte[]> _pixels;
+    };
+
+    // Describes the atlas dimensions and the metrics of every non-empty glyph
+    // as a JSON object, to accompany an image of the atlas.
+    std::string format_metrics_json(const glyph_atlas& atlas);
+}
+
+#endif
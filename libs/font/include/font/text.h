@@ -0,0 +1,44 @@
+#ifndef FONT_TEXT_INCLUDED
+#define FONT_TEXT_INCLUDED
+#pragma once
+
+#include <memory>
+#include <string_view>
+
+#include <cstddef>
+
+
+namespace stdext
+{
+    template <class T> class array_view;
+}
+
+namespace wcdx::font
+{
+    class glyph_atlas;
+
+    // Text is drawn one byte per glyph, with the top of every glyph on the
+    // line's top edge; the games' fonts have no baseline or kerning.
+
+    unsigned measure_text(const glyph_atlas& atlas, std::string_view text) noexcept;
+
+    // Draws text with its top-left corner at (x, y) into a width x height
+    // 8-bit target, clipping to the target's edges.  Background pixels of the
+    // glyphs are skipped, so whatever was in the target shows through.
+    void draw_text(const glyph_atlas& atlas, std::string_view text, int x, int y, std::byte* target, size_t pitch, unsigned width, unsigned height) noexcept;
+
+    struct text_sheet
+    {
+        unsigned width;
+        unsigned height;
+        std::unique_ptr<std::byte[]> pixels;
+    };
+
+    // Renders a batch of strings, one per line, into a single image that is
+    // just large enough to hold them.  Lines are spacing pixels apart, and
+    // pixels not covered by a glyph are set to fill.  The image is allocated
+    // once, up front; nothing is allocated per line or per glyph.
+    text_sheet render_text_sheet(const glyph_atlas& atlas, stdext::array_view<const std::string_view> lines, unsigned spacing, std::byte fill);
+}
+
+#endif
@@ -0,0 +1,63 @@
+#include <font/font.h>
+
+#include <stdexcept>
+
+#include <cassert>
+#include <cstring>
+
+
+namespace wcdx::font
+{
+    namespace
+    {
+        constexpr size_t font_header_size = 4 + (3 * glyph_count);
+
+        [[noreturn]] void invalid_font()
+        {
+            throw std::runtime_error("Invalid font");
+        }
+    }
+
+    font::font(const std::byte* data, size_t size)
+    {
+        if (size < font_header_size)
+            invalid_font();
+
+        _height = unsigned(uint8_t(data[0])) | (unsigned(uint8_t(data[1])) << 8);
+        // data[2..3] is a color index, duplicative of the pixel data.
+        auto widths = data + 4;
+        auto offsets_lo = widths + glyph_count;
+        auto offsets_hi = offsets_lo + glyph_count;
+
+        size_t total = 0;
+        for (size_t n = 0; n != glyph_count; ++n)
+        {
+            _widths[n] = uint8_t(widths[n]);
+            _offsets[n] = uint32_t(total);
+
+            auto glyph_size = size_t(_widths[n]) * _height;
+            auto position = size_t(uint8_t(offsets_lo[n])) | (size_t(uint8_t(offsets_hi[n])) << 8);
+            if (glyph_size != 0 && (position < font_header_size || position > size || size - position < glyph_size))
+                invalid_font();
+            total += glyph_size;
+        }
+
+        _pixels = std::make_unique<std::byte[]>(total);
+        for (size_t n = 0; n != glyph_count; ++n)
+        {
+            auto position = size_t(uint8_t(offsets_lo[n])) | (size_t(uint8_t(offsets_hi[n])) << 8);
+            auto glyph_size = size_t(_widths[n]) * _height;
+            if (glyph_size != 0)
+                std::memcpy(_pixels.get() + _offsets[n], data + position, glyph_size);
+        }
+    }
+
+    glyph_view font::glyph(unsigned index) const noexcept
+    {
+        assert(index < glyph_count);
+        if (_widths[index] == 0 || _height == 0)
+            return { _widths[index], _height, nullptr };
+
+        return { _widths[index], _height, _pixels.get() + _offsets[index] };
+    }
+}
@@ -0,0 +1,97 @@
+#include <font/glyph_atlas.h>
+
+#include <frame/pixel_ops.h>
+
+#include <algorithm>
+#include <iterator>
+#include <numeric>
+
+#include <cstdio>
+
+
+namespace wcdx::font
+{
+    glyph_atlas::glyph_atlas(const font& font, unsigned padding)
+        : _line_height(font.height())
+    {
+        unsigned order[glyph_count];
+        std::iota(std::begin(order), std::end(order), 0);
+        auto end = std::remove_if(std::begin(order), std::end(order), [&](unsigned index)
+        {
+            auto glyph = font.glyph(index);
+            return glyph.width == 0 || glyph.height == 0;
+        });
+        std::stable_sort(std::begin(order), end, [&](unsigned a, unsigned b)
+        {
+            return font.glyph(a).height > font.glyph(b).height;
+        });
+
+        size_t area = 0;
+        unsigned widest = 0;
+        for (auto i = std::begin(order); i != end; ++i)
+        {
+            auto glyph = font.glyph(*i);
+            area += size_t(glyph.width + padding) * (glyph.height + padding);
+            widest = std::max(widest, glyph.width + padding);
+        }
+
+        auto side = unsigned(1);
+        while (size_t(side) * side < area)
+            side <<= 1;
+        _width = std::max(side, widest);
+
+        // Shelves: a glyph that doesn't fit on the current one starts the next.
+        unsigned x = 0;
+        unsigned y = 0;
+        unsigned shelf_height = 0;
+        for (auto i = std::begin(order); i != end; ++i)
+        {
+            auto glyph = font.glyph(*i);
+            if (x + glyph.width + padding > _width)
+            {
+                x = 0;
+                y += shelf_height;
+                shelf_height = 0;
+            }
+
+            _metrics[*i] = { uint16_t(x), uint16_t(y), uint16_t(glyph.width), uint16_t(glyph.height), uint16_t(glyph.width) };
+            x += glyph.width + padding;
+            shelf_height = std::max(shelf_height, glyph.height + padding);
+        }
+        _height = y + shelf_height;
+
+        _pixels = std::make_unique<std::byte[]>(size_t(_width) * _height);
+        std::fill_n(_pixels.get(), size_t(_width) * _height, background_index);
+        for (auto i = std::begin(order); i != end; ++i)
+        {
+            auto glyph = font.glyph(*i);
+            auto& m = _metrics[*i];
+            frame::copy_rows(glyph.pixels, glyph.width, _pixels.get() + (size_t(_width) * m.y) + m.x, _width, glyph.width, glyph.height);
+        }
+    }
+
+    std::string format_metrics_json(const glyph_atlas& atlas)
+    {
+        std::string json;
+        char buffer[128];
+        std::snprintf(buffer, std::size(buffer), "{\n  \"width\": %u,\n  \"height\": %u,\n  \"line_height\": %u,\n  \"glyphs\": [",
+            atlas.width(), atlas.height(), atlas.line_height());
+        json += buffer;
+
+        const char* separator = "\n";
+        for (unsigned index = 0; index != glyph_count; ++index)
+        {
+            auto& m = atlas.metrics(index);
+            if (m.width == 0)
+                continue;
+
+            std::snprintf(buffer, std::size(buffer), "%s    { \"index\": %u, \"x\": %u, \"y\": %u, \"width\": %u, \"height\": %u, \"advance\": %u }",
+                separator, index, unsigned(m.x), unsigned(m.y), unsigned(m.width), unsigned(m.height), unsigned(m.advance));
+            json += buffer;
+            separator = ",\n";
+        }
+
+        json += "\n  ]\n}\n";
+        return json;
+    }
+}
@@ -0,0 +1,69 @@
+#include <font/text.h>
+#include <font/glyph_atlas.h>
+
+#include <frame/pixel_ops.h>
+
+#include <stdext/array_view.h>
+
+#include <algorithm>
+
+#include <cstdint>
+
+
+namespace wcdx::font
+{
+    unsigned measure_text(const glyph_atlas& atlas, std::string_view text) noexcept
+    {
+        unsigned width = 0;
+        for (auto ch : text)
+            width += atlas.metrics(uint8_t(ch)).advance;
+
+        return width;
+    }
+
+    void draw_text(const glyph_atlas& atlas, std::string_view text, int x, int y, std::byte* target, size_t pitch, unsigned width, unsigned height) noexcept
+    {
+        auto pen = int64_t(x);
+        for (auto ch : text)
+        {
+            if (pen >= int64_t(width))
+                break;
+
+            auto& m = atlas.metrics(uint8_t(ch));
+            auto left = int(std::max(pen, int64_t(INT32_MIN)));
+            auto clipped = frame::clip_block(left, y, m.width, m.height, width, height);
+            pen += m.advance;
+            if (frame::empty(clipped))
+                continue;
+
+            auto src = atlas.pixels() + (size_t(m.y) + size_t(clipped.top - y)) * atlas.width() + m.x + size_t(clipped.left - left);
+            auto dest = target + (size_t(clipped.top) * pitch) + size_t(clipped.left);
+            frame::copy_rows_transparent(src, atlas.width(), dest, pitch,
+                size_t(clipped.right - clipped.left), size_t(clipped.bottom - clipped.top), background_index);
+        }
+    }
+
+    text_sheet render_text_sheet(const glyph_atlas& atlas, stdext::array_view<const std::string_view> lines, unsigned spacing, std::byte fill)
+    {
+        text_sheet sheet = { 0, 0, nullptr };
+        for (auto line : lines)
+            sheet.width = std::max(sheet.width, measure_text(atlas, line));
+
+        auto line_advance = atlas.line_height() + spacing;
+        if (lines.size() != 0)
+            sheet.height = (unsigned(lines.size()) * line_advance) - spacing;
+
+        auto size = size_t(sheet.width) * sheet.height;
+        sheet.pixels = std::make_unique<std::byte[]>(size);
+        std::fill_n(sheet.pixels.get(), size, fill);
+
+        int y = 0;
+        for (auto line : lines)
+        {
+            draw_text(atlas, line, 0, y, sheet.pixels.get(), sheet.width, sheet.width, sheet.height);
+            y += int(line_advance);
+        }
+
+        return sheet;
+    }
+}
@@ -0,0 +1,90 @@
+#ifndef FRAME_DIRTY_REGION_INCLUDED
+#define FRAME_DIRTY_REGION_INCLUDED
+#pragma once
+
+#include <utility>
+#include <vector>
+
+#include <cstddef>
+#include <cstdint>
+
+
+namespace wcdx::frame
+{
+    struct rect
+    {
+        int left;
+        int top;
+        int right;
+        int bottom;
+    };
+
+    inline bool empty(const rect& r) noexcept
+    {
+        return r.left >= r.right || r.top >= r.bottom;
+    }
+
+    // Tracks the parts of a frame that need to be converted again, as one
+    // horizontal span per row.  Game updates are mostly small rectangles
+    // (gauges, cursors, comm windows) so a span per row is exact for the common
+    // case and never costs more than the rectangle list it replaces.
+    class dirty_region
+    {
+    public:
+        dirty_region(unsigned width, unsigned height);
+
+    public:
+        unsigned width() const noexcept { return _width; }
+        unsigned height() const noexcept { return unsigned(_spans.size()); }
+
+        bool empty() const noexcept { return frame::empty(_bounds); }
+        const rect& bounds() const noexcept { return _bounds; }
+
+        // Input is clipped to the frame.
+        void add(const rect& r) noexcept;
+        void add_span(unsigned row, unsigned left, unsigned right) noexcept;
+        void add_all() noexcept;
+        void clear() noexcept;
+
+        // Returns the dirty span of a row as { left, right }; left == right if the
+        // row is clean.
+        std::pair<unsigned, unsigned> row_span(unsigned row) const noexcept
+        {
+            return { _spans[row].left, _spans[row].right };
+        }
+
+        // Calls f(row, left, right) for each row that has a dirty span.
+        template <class F>
+        void for_each_span(F&& f) const;
+
+        // Number of pixels covered by the region.
+        size_t area() const noexcept;
+
+    private:
+        struct span
+        {
+            uint16_t left;
+            uint16_t right;
+        };
+
+        std::vector<span> _spans;
+        unsigned _width;
+        rect _bounds;
+    };
+
+    template <class F>
+    void dirty_region::for_each_span(F&& f) const
+    {
+        if (empty())
+            return;
+
+        for (auto row = unsigned(_bounds.top); row != unsigned(_bounds.bottom); ++row)
+        {
+            auto& s = _spans[row];
+            if (s.left < s.right)
+                f(row, unsigned(s.left), unsigned(s.right));
+        }
+    }
+}
+
+#endif
@@ -0,0 +1,82 @@
+#ifndef FRAME_FRAME_CAPTURE_INCLUDED
+#define FRAME_FRAME_CAPTURE_INCLUDED
+#pragma once
+
+#include <frame/palette_expand.h>
+
+#include <memory>
+#include <vector>
+
+#include <cstddef>
+#include <cstdint>
+
+
+namespace stdext
+{
+    class input_stream;
+}
+
+namespace wcdx::frame
+{
+    // A capture file starts with a header:
+    //
+    //      uint32_t magic;         // "WCAP"
+    //      uint16_t version;       // capture_version
+    //      uint16_t width;
+    //      uint16_t height;
+    //      uint16_t reserved;
+    //
+    // followed by one record per frame:
+    //
+    //      uint32_t size;          // of the rest of the record
+    //      uint32_t frame;         // sequence number; gaps mark dropped frames
+    //      uint64_t timestamp;     // microseconds since recording started
+    //      uint16_t span_count;
+    //      palette spans...
+    //      frame delta...
+    //
+    // Each palette span is a uint8_t first index and a uint8_t count less one,
+    // followed by that many colors.  Spans and the delta are both relative to
+    // the previous record, and the first record is relative to a zeroed frame
+    // and palette.  All values are little-endian.
+    constexpr uint32_t capture_magic = 0x50414357;  // "WCAP"
+    constexpr uint16_t capture_version = 1;
+    constexpr size_t capture_header_size = 12;
+    constexpr size_t capture_record_header_size = 18;
+
+    // Replays a capture one frame at a time.
+    class capture_reader
+    {
+    public:
+        // Reads the header; throws std::runtime_error if it isn't a capture.
+        explicit capture_reader(stdext::input_stream& input);
+        capture_reader(const capture_reader&) = delete;
+        capture_reader& operator = (const capture_reader&) = delete;
+
+    public:
+        unsigned width() const noexcept { return _width; }
+        unsigned height() const noexcept { return _height; }
+
+        // Advances to the next frame, returning false at the end of the
+        // capture.  Throws std::runtime_error if the record is damaged or
+        // cut short.
+        bool next();
+
+        uint32_t frame_number() const noexcept { return _frame_number; }
+        uint64_t timestamp() const noexcept { return _timestamp; }
+        const std::byte* pixels() const noexcept { return _pixels.get(); }
+        const color* palette() const noexcept { return _palette; }
+
+    private:
+        stdext::input_stream& _input;
+        unsigned _width;
+        unsigned _height;
+        std::unique_ptr<std::byte[]> _pixels;
+        color _palette[256] = { };
+        uint32_t _frame_number = 0;
+        uint64_t _timestamp = 0;
+        std::vector<std::byte> _record;
+    };
+}
+
+#endif
@@ -0,0 +1,76 @@
+#ifndef FRAME_FRAME_CONVERTER_INCLUDED
+#define FRAME_FRAME_CONVERTER_INCLUDED
+#pragma once
+
+#include <frame/dirty_region.h>
+#include <frame/palette_expand.h>
+#include <frame/palette_usage.h>
+
+#include <memory>
+
+#include <cstddef>
+
+
+namespace wcdx::frame
+{
+    // Holds the game's indexed frame and palette and converts only what changed
+    // since the last conversion into a 32-bit target.  Palette changes are
+    // mapped through a palette_usage to the pixels that reference the changed
+    // entries; unused entries cost nothing, and when most of the frame is
+    // affected the whole frame is converted instead.
+    class frame_converter
+    {
+    public:
+        frame_converter(unsigned width, unsigned height);
+        frame_converter(const frame_converter&) = delete;
+        frame_converter& operator = (const frame_converter&) = delete;
+
+    public:
+        unsigned width() const noexcept { return _dirty.width(); }
+        unsigned height() const noexcept { return _dirty.height(); }
+        const std::byte* pixels() const noexcept { return _pixels.get(); }
+        const color* palette() const noexcept { return _palette; }
+
+        void set_palette(const color entries[256]) noexcept;
+        void update_palette(unsigned index, color entry) noexcept;
+        void update_frame(int x, int y, unsigned width, unsigned height, size_t pitch, const std::byte* bits) noexcept;
+
+        // Replaces the whole frame and palette, marking only what differs from
+        // the current contents as dirty.  Used to catch up with frames handed
+        // over from another thread.
+        void assign(const std::byte* pixels, const color palette[256]) noexcept;
+
+        // Forces the next conversion to cover the whole frame, e.g. after the
+        // target surface has been recreated.
+        void invalidate() noexcept;
+
+        bool dirty() const noexcept { return !_dirty.empty() || !_palette_dirty.empty() || _changed_indices.any(); }
+
+        // Folds pending palette changes into the dirty region and returns its
+        // bounds.  The result is empty if nothing needs to be converted.
+        rect dirty_bounds();
+
+        // Converts the dirty region into a target whose first pixel is at the
+        // top-left corner of target_rect, which must contain dirty_bounds().
+        // Pixels outside the dirty region are left untouched.
+        void convert(void* bits, size_t pitch, const rect& target_rect);
+
+    private:
+        void resolve_palette_changes();
+
+    private:
+        std::unique_ptr<std::byte[]> _pixels;
+        color _palette[256];
+        palette_usage _usage;
+        palette_usage::index_set _changed_indices;
+
+        // Spans that must be converted in full.
+        dirty_region _dirty;
+
+        // Rows that only need the pixels selected by _palette_mask converted.
+        dirty_region _palette_dirty;
+        color _palette_mask[256];
+    };
+}
+
+#endif
@@ -0,0 +1,37 @@
+#ifndef FRAME_FRAME_DELTA_INCLUDED
+#define FRAME_FRAME_DELTA_INCLUDED
+#pragma once
+
+#include <cstddef>
+
+
+namespace wcdx::frame
+{
+    // A frame delta is the XOR of a frame with the one before it, run-length
+    // coded as a sequence of tokens.  Each token starts with a byte holding
+    // its kind in the top two bits and its length less one in the low six;
+    // a length field of 63 is followed by the length less 64 as a LEB128
+    // number.  Skip tokens cover pixels that didn't change, fill tokens XOR
+    // their one data byte into every pixel they cover, and literal tokens
+    // carry one data byte per pixel.  Pixels past the last token are
+    // unchanged.
+    //
+    // Encoding against a zeroed frame produces a delta that stands on its own.
+
+    // No delta of a frame of the given size is larger than this.
+    constexpr size_t max_frame_delta_size(size_t size) noexcept
+    {
+        return 2 * size + 16;
+    }
+
+    // Writes the delta from previous to current into out, which must have
+    // room for max_frame_delta_size(size) bytes, and returns its size.
+    size_t encode_frame_delta(const std::byte* previous, const std::byte* current, size_t size, std::byte* out) noexcept;
+
+    // Applies a delta to frame, turning the frame it was encoded against into
+    // the frame it was encoded from.  Throws std::runtime_error if the delta
+    // is malformed or runs past the end of the frame.
+    void apply_frame_delta(std::byte* frame, size_t size, const std::byte* delta, size_t delta_size);
+}
+
+#endif
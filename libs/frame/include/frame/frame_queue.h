@@ -0,0 +1,87 @@
+#ifndef FRAME_FRAME_QUEUE_INCLUDED
+#define FRAME_FRAME_QUEUE_INCLUDED
+#pragma once
+
+#include <frame/palette_expand.h>
+
+#include <atomic>
+#include <memory>
+
+#include <cstddef>
+#include <cstdint>
+
+
+namespace wcdx::frame
+{
+    // Lock-free single-producer, single-consumer handoff of the latest value.
+    // The producer fills back() and publishes it; the consumer picks up the most
+    // recently published value, and anything published in between is dropped.
+    // Neither side ever waits on the other.
+    template <class T>
+    class triple_buffer
+    {
+    public:
+        template <class... Args>
+        explicit triple_buffer(const Args&... args)
+            : _slots{ T(args...), T(args...), T(args...) }
+        {
+        }
+
+        triple_buffer(const triple_buffer&) = delete;
+        triple_buffer& operator = (const triple_buffer&) = delete;
+
+    public:
+        // Producer side
+        T& back() noexcept { return _slots[_back]; }
+        void publish() noexcept;
+
+        // Consumer side
+        bool acquire() noexcept;
+        T& front() noexcept { return _slots[_front]; }
+        const T& front() const noexcept { return _slots[_front]; }
+
+    private:
+        static constexpr uint8_t index_mask = 0x3;
+        static constexpr uint8_t fresh = 0x4;
+
+        T _slots[3];
+        alignas(64) std::atomic<uint8_t> _shared = 2;
+        alignas(64) uint8_t _back = 0;
+        alignas(64) uint8_t _front = 1;
+    };
+
+    template <class T>
+    void triple_buffer<T>::publish() noexcept
+    {
+        _back = _shared.exchange(uint8_t(_back | fresh), std::memory_order_acq_rel) & index_mask;
+    }
+
+    template <class T>
+    bool triple_buffer<T>::acquire() noexcept
+    {
+        if ((_shared.load(std::memory_order_relaxed) & fresh) == 0)
+            return false;
+
+        _front = _shared.exchange(_front, std::memory_order_acq_rel) & index_mask;
+        return true;
+    }
+
+    // An indexed frame together with the palette it was presented with.
+    struct frame_snapshot
+    {
+        frame_snapshot(unsigned width, unsigned height)
+            : width(width), height(height), pixels(std::make_unique<std::byte[]>(size_t(width) * height))
+        {
+        }
+
+        unsigned width;
+        unsigned height;
+        std::unique_ptr<std::byte[]> pixels;
+        color palette[256] = { };
+        uint64_t sequence = 0;
+    };
+
+    using frame_queue = triple_buffer<frame_snapshot>;
+}
+
+#endif
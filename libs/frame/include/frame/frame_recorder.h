@@ -0,0 +1,85 @@
+#ifndef FRAME_FRAME_RECORDER_INCLUDED
+#define FRAME_FRAME_RECORDER_INCLUDED
+#pragma once
+
+#include <frame/palette_expand.h>
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <exception>
+#include <memory>
+#include <mutex>
+#include <thread>
+
+#include <cstddef>
+#include <cstdint>
+
+
+namespace stdext
+{
+    class output_stream;
+}
+
+namespace wcdx::frame
+{
+    // Records presented frames to a capture (see frame_capture.h).  The
+    // presenting thread only encodes the changes since the last recorded frame
+    // and copies them into a bounded ring; a background thread writes the
+    // ring out.  If the writer falls behind far enough that a record doesn't
+    // fit, the frame is dropped rather than waiting, and the next record is
+    // encoded against the last one that made it.
+    class frame_recorder
+    {
+    public:
+        // Writes the capture header immediately.  The output must outlive the
+        // recorder and is only touched by the writer thread after that.
+        frame_recorder(unsigned width, unsigned height, stdext::output_stream& output, size_t buffer_size);
+        frame_recorder(const frame_recorder&) = delete;
+        frame_recorder& operator = (const frame_recorder&) = delete;
+        ~frame_recorder();
+
+    public:
+        void record(const std::byte* pixels, const color palette[256]) noexcept;
+
+        // Writes everything recorded so far and stops the writer thread.
+        // Rethrows the first error the writer ran into.
+        void finish();
+
+        uint32_t recorded_count() const noexcept { return _recorded_count; }
+        uint32_t dropped_count() const noexcept { return _dropped_count; }
+
+    private:
+        void write_thread();
+
+    private:
+        unsigned _width;
+        unsigned _height;
+        stdext::output_stream& _output;
+        std::chrono::steady_clock::time_point _start;
+
+        // Producer state
+        std::unique_ptr<std::byte[]> _previous;
+        color _previous_palette[256] = { };
+        std::unique_ptr<std::byte[]> _scratch;
+        uint32_t _frame_number = 0;
+        uint32_t _recorded_count = 0;
+        uint32_t _dropped_count = 0;
+
+        // Ring of encoded records.  _head and _tail count bytes ever written
+        // and ever consumed, so the ring is empty when they're equal.
+        std::unique_ptr<std::byte[]> _ring;
+        size_t _ring_size;
+        alignas(64) std::atomic<uint64_t> _head = 0;
+        alignas(64) std::atomic<uint64_t> _tail = 0;
+
+        std::mutex _mutex;
+        std::condition_variable _wake;
+        std::atomic<bool> _stop = false;
+        std::atomic<bool> _failed = false;
+        std::exception_ptr _error;
+        std::thread _thread;
+    };
+}
+
+#endif
@@ -0,0 +1,36 @@
+#ifndef FRAME_PALETTE_EXPAND_INCLUDED
+#define FRAME_PALETTE_EXPAND_INCLUDED
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+
+namespace wcdx::frame
+{
+    // Pixels are expanded to X8R8G8B8, which is the little-endian layout of WcdxColor.
+    using color = uint32_t;
+
+    enum class expand_path
+    {
+        scalar,
+        sse2,
+        avx2
+    };
+
+    // Expands count 8-bit palette indices at src into 32-bit pixels at dest.
+    void expand_pixels(const std::byte* src, color* dest, size_t count, const color palette[256]) noexcept;
+
+    // As expand_pixels, but only writes pixels whose index has a non-zero entry
+    // in mask; every other destination pixel is left as it was.
+    void expand_pixels_masked(const std::byte* src, color* dest, size_t count, const color palette[256], const color mask[256]) noexcept;
+
+    // The best path supported by the running processor is selected on first use.
+    // Selecting a path that the processor doesn't support falls back to the best
+    // supported path.  Exposed so that benchmarks can compare the kernels.
+    expand_path active_expand_path() noexcept;
+    expand_path select_expand_path(expand_path path) noexcept;
+    bool expand_path_supported(expand_path path) noexcept;
+}
+
+#endif
@@ -0,0 +1,81 @@
+#ifndef FRAME_PALETTE_USAGE_INCLUDED
+#define FRAME_PALETTE_USAGE_INCLUDED
+#pragma once
+
+#include <bitset>
+#include <vector>
+
+#include <cstddef>
+#include <cstdint>
+
+
+namespace wcdx::frame
+{
+    // Counts how often each palette index appears on each row of an indexed
+    // frame, so that a palette change can be mapped back to the rows (and the
+    // number of pixels) it affects without scanning the frame.
+    class palette_usage
+    {
+    public:
+        using index_set = std::bitset<256>;
+
+    public:
+        palette_usage(unsigned width, unsigned height);
+
+    public:
+        unsigned width() const noexcept { return _width; }
+        unsigned height() const noexcept { return _height; }
+
+        // Recounts the whole frame.
+        void reset(const std::byte* pixels) noexcept;
+
+        // Accounts for count pixels on the given row changing from old_pixels to
+        // new_pixels.  Must be called before the frame itself is overwritten.
+        void replace(unsigned row, const std::byte* old_pixels, const std::byte* new_pixels, size_t count) noexcept;
+
+        size_t pixel_count(unsigned index) const noexcept { return _totals[index]; }
+        size_t pixel_count(const index_set& indices) const noexcept;
+
+        // Number of rows that reference at least one of the given indices.
+        unsigned row_count(const index_set& indices) const;
+
+        // Calls f(row) for each row that references at least one of the given
+        // indices, in ascending order.
+        template <class F>
+        void for_each_row(const index_set& indices, F&& f) const;
+
+    private:
+        static constexpr unsigned word_bits = 64;
+
+        void rows_using(const index_set& indices, std::vector<uint64_t>& rows) const;
+        void increment(unsigned row, uint8_t index) noexcept;
+        void decrement(unsigned row, uint8_t index) noexcept;
+
+    private:
+        unsigned _width;
+        unsigned _height;
+        unsigned _row_words;
+        std::vector<uint16_t> _row_counts;  // [row][index]
+        std::vector<uint64_t> _row_masks;   // [index][row / word_bits]
+        size_t _totals[256];
+    };
+
+    template <class F>
+    void palette_usage::for_each_row(const index_set& indices, F&& f) const
+    {
+        std::vector<uint64_t> rows;
+        rows_using(indices, rows);
+        for (unsigned word = 0; word != _row_words; ++word)
+        {
+            for (auto bits = rows[word]; bits != 0; bits &= bits - 1)
+            {
+                unsigned bit = 0;
+                while ((bits & (uint64_t(1) << bit)) == 0)
+                    ++bit;
+                f(word * word_bits + bit);
+            }
+        }
+    }
+}
+
+#endif
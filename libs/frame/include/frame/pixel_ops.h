@@ -0,0 +1,55 @@
+#ifndef FRAME_PIXEL_OPS_INCLUDED
+#define FRAME_PIXEL_OPS_INCLUDED
+#pragma once
+
+#include <frame/dirty_region.h>
+#include <frame/palette_expand.h>
+
+#include <cstddef>
+#include <cstdint>
+
+
+namespace wcdx::frame
+{
+    // Clips a width x height block placed at (x, y) to a target of
+    // target_width x target_height pixels.  The result is empty if the block
+    // falls entirely outside the target.
+    rect clip_block(int x, int y, unsigned width, unsigned height, unsigned target_width, unsigned target_height) noexcept;
+
+    // Copies height rows of width 8-bit pixels.  Rows that are packed in both
+    // source and destination are copied in one piece.
+    void copy_rows(const std::byte* src, size_t src_pitch, std::byte* dest, size_t dest_pitch, size_t width, size_t height) noexcept;
+
+    // As copy_rows, but source pixels equal to transparent are skipped,
+    // leaving the destination pixel as it was.  Used to compose sprites.
+    void copy_rows_transparent(const std::byte* src, size_t src_pitch, std::byte* dest, size_t dest_pitch, size_t width, size_t height,
+        std::byte transparent) noexcept;
+
+    // Fills blocks with static: every pixel is independently either the given
+    // color or zero.  Random bits come from a counter-based generator, which
+    // hashes a running count instead of stepping a state, so many 32-bit words
+    // (128 pixels for SSE2, 256 for AVX2) are produced at once.  Every row
+    // starts on a fresh word, and the output for a given seed is the same on
+    // every path.
+    class snow_generator
+    {
+    public:
+        explicit snow_generator(uint32_t seed) noexcept;
+
+    public:
+        void fill(std::byte* pixels, size_t pitch, unsigned width, unsigned height, std::byte color) noexcept;
+
+        // The number of 32-bit words generated so far.
+        uint32_t position() const noexcept { return _counter; }
+
+    private:
+        uint32_t _key;
+        uint32_t _counter = 0;
+    };
+
+    // Paths are selected as for expand_pixels, independently of it.
+    expand_path active_pixel_path() noexcept;
+    expand_path select_pixel_path(expand_path path) noexcept;
+}
+
+#endif
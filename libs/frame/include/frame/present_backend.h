@@ -0,0 +1,54 @@
+#ifndef FRAME_PRESENT_BACKEND_INCLUDED
+#define FRAME_PRESENT_BACKEND_INCLUDED
+#pragma once
+
+#include <frame/palette_expand.h>
+
+#include <memory>
+
+#include <cstddef>
+#include <cstdint>
+
+
+namespace wcdx::frame
+{
+    class frame_converter;
+
+    // Where presented frames end up.  Presenting brings the backend's copy of
+    // the frame up to date with whatever is dirty in the converter.
+    class present_backend
+    {
+    public:
+        virtual ~present_backend() = default;
+
+    public:
+        // Returns false if the frame couldn't be shown; the converter's dirty
+        // region is kept so that the next attempt catches up.
+        virtual bool present(frame_converter& frame) = 0;
+    };
+
+    // Presents into a 32-bit surface in memory, with no window or device
+    // behind it.  Used to run and measure the presentation pipeline where
+    // Direct3D isn't available.
+    class software_backend : public present_backend
+    {
+    public:
+        software_backend(unsigned width, unsigned height);
+
+    public:
+        bool present(frame_converter& frame) override;
+
+        unsigned width() const noexcept { return _width; }
+        unsigned height() const noexcept { return _height; }
+        const color* pixels() const noexcept { return _pixels.get(); }
+        uint64_t presented_count() const noexcept { return _presented_count; }
+
+    private:
+        unsigned _width;
+        unsigned _height;
+        std::unique_ptr<color[]> _pixels;
+        uint64_t _presented_count = 0;
+    };
+}
+
+#endif
@@ -0,0 +1,56 @@
+#include "cpu_features.h"
+
+#if WCDX_FRAME_X86 && defined(_MSC_VER)
+#include <intrin.h>
+#include <immintrin.h>
+#endif
+
+
+namespace wcdx::frame
+{
+#if WCDX_FRAME_X86 && defined(_MSC_VER)
+    bool cpu_has_sse2() noexcept
+    {
+        int info[4];
+        __cpuid(info, 1);
+        return (info[3] & (1 << 26)) != 0;
+    }
+
+    bool cpu_has_avx2() noexcept
+    {
+        int info[4];
+        __cpuid(info, 0);
+        if (info[0] < 7)
+            return false;
+
+        // The OS must also save the YMM registers across context switches.
+        __cpuid(info, 1);
+        constexpr int osxsave_avx = (1 << 27) | (1 << 28);
+        if ((info[2] & osxsave_avx) != osxsave_avx || (_xgetbv(0) & 0x6) != 0x6)
+            return false;
+
+        __cpuidex(info, 7, 0);
+        return (info[1] & (1 << 5)) != 0;
+    }
+#elif WCDX_FRAME_X86
+    bool cpu_has_sse2() noexcept
+    {
+        return __builtin_cpu_supports("sse2");
+    }
+
+    bool cpu_has_avx2() noexcept
+    {
+        return __builtin_cpu_supports("avx2");
+    }
+#else
+    bool cpu_has_sse2() noexcept
+    {
+        return false;
+    }
+
+    bool cpu_has_avx2() noexcept
+    {
+        return false;
+    }
+#endif
+}
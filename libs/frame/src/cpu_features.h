@@ -0,0 +1,18 @@
+#ifndef FRAME_CPU_FEATURES_INCLUDED
+#define FRAME_CPU_FEATURES_INCLUDED
+#pragma once
+
+#if defined(_M_IX86) || defined(_M_X64) || defined(__i386__) || defined(__x86_64__)
+#define WCDX_FRAME_X86 1
+#else
+#define WCDX_FRAME_X86 0
+#endif
+
+
+namespace wcdx::frame
+{
+    bool cpu_has_sse2() noexcept;
+    bool cpu_has_avx2() noexcept;
+}
+
+#endif
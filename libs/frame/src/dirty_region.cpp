@@ -0,0 +1,85 @@
+#include <frame/dirty_region.h>
+
+#include <algorithm>
+#include <limits>
+
+#include <cassert>
+
+
+namespace wcdx::frame
+{
+    namespace
+    {
+        constexpr rect empty_rect = { 0, 0, 0, 0 };
+    }
+
+    dirty_region::dirty_region(unsigned width, unsigned height)
+        : _spans(height, span{ 0, 0 }), _width(width), _bounds(empty_rect)
+    {
+        assert(width <= std::numeric_limits<uint16_t>::max());
+    }
+
+    void dirty_region::add(const rect& r) noexcept
+    {
+        auto left = std::max(r.left, 0);
+        auto top = std::max(r.top, 0);
+        auto right = std::min(r.right, int(_width));
+        auto bottom = std::min(r.bottom, int(_spans.size()));
+        if (left >= right || top >= bottom)
+            return;
+
+        for (auto row = top; row != bottom; ++row)
+            add_span(unsigned(row), unsigned(left), unsigned(right));
+    }
+
+    void dirty_region::add_span(unsigned row, unsigned left, unsigned right) noexcept
+    {
+        assert(row < _spans.size() && right <= _width);
+        if (left >= right)
+            return;
+
+        auto& s = _spans[row];
+        if (s.left >= s.right)
+            s = { uint16_t(left), uint16_t(right) };
+        else
+        {
+            s.left = std::min(s.left, uint16_t(left));
+            s.right = std::max(s.right, uint16_t(right));
+        }
+
+        if (empty())
+            _bounds = { int(left), int(row), int(right), int(row + 1) };
+        else
+        {
+            _bounds.left = std::min(_bounds.left, int(left));
+            _bounds.top = std::min(_bounds.top, int(row));
+            _bounds.right = std::max(_bounds.right, int(right));
+            _bounds.bottom = std::max(_bounds.bottom, int(row + 1));
+        }
+    }
+
+    void dirty_region::add_all() noexcept
+    {
+        std::fill(_spans.begin(), _spans.end(), span{ 0, uint16_t(_width) });
+        _bounds = { 0, 0, int(_width), int(_spans.size()) };
+    }
+
+    void dirty_region::clear() noexcept
+    {
+        if (empty())
+            return;
+
+        std::fill(_spans.begin() + _bounds.top, _spans.begin() + _bounds.bottom, span{ 0, 0 });
+        _bounds = empty_rect;
+    }
+
+    size_t dirty_region::area() const noexcept
+    {
+        size_t total = 0;
+        for_each_span([&](unsigned, unsigned left, unsigned right)
+        {
+            total += right - left;
+        });
+        return total;
+    }
+}
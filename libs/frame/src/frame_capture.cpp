@@ -0,0 +1,106 @@
+#include <frame/frame_capture.h>
+#include <frame/frame_delta.h>
+
+#include <stdext/stream.h>
+
+#include <iterator>
+#include <stdexcept>
+
+#include <cstring>
+
+
+namespace wcdx::frame
+{
+    namespace
+    {
+        [[noreturn]] void invalid_record()
+        {
+            throw std::runtime_error("Invalid capture record");
+        }
+
+        template <class T>
+        T read_value(const std::byte*& p)
+        {
+            T value;
+            std::memcpy(&value, p, sizeof(value));
+            p += sizeof(value);
+            return value;
+        }
+
+        // Returns the number of bytes read, which is less than size only at
+        // the end of the input.
+        size_t read_bytes(stdext::input_stream& input, std::byte* data, size_t size)
+        {
+            size_t total = 0;
+            while (total != size)
+            {
+                auto count = input.read(data + total, size - total);
+                if (count == 0)
+                    break;
+                total += count;
+            }
+            return total;
+        }
+    }
+
+    capture_reader::capture_reader(stdext::input_stream& input)
+        : _input(input)
+    {
+        std::byte header[capture_header_size];
+        if (read_bytes(_input, header, std::size(header)) != std::size(header))
+            throw std::runtime_error("Not a frame capture");
+
+        const std::byte* p = header;
+        auto magic = read_value<uint32_t>(p);
+        auto version = read_value<uint16_t>(p);
+        _width = read_value<uint16_t>(p);
+        _height = read_value<uint16_t>(p);
+        if (magic != capture_magic)
+            throw std::runtime_error("Not a frame capture");
+        if (version != capture_version)
+            throw std::runtime_error("Unsupported frame capture version");
+
+        _pixels = std::make_unique<std::byte[]>(size_t(_width) * _height);
+    }
+
+    bool capture_reader::next()
+    {
+        // A capture cut short, e.g. by a crash, ends in an incomplete record;
+        // that's reported rather than taken for the end of the capture.
+        std::byte size_bytes[sizeof(uint32_t)];
+        auto count = read_bytes(_input, size_bytes, std::size(size_bytes));
+        if (count == 0)
+            return false;
+        if (count != std::size(size_bytes))
+            invalid_record();
+
+        const std::byte* size_p = size_bytes;
+        auto size = read_value<uint32_t>(size_p);
+        if (size < capture_record_header_size - sizeof(size))
+            invalid_record();
+
+        _record.resize(size);
+        if (read_bytes(_input, _record.data(), _record.size()) != _record.size())
+            invalid_record();
+
+        const std::byte* p = _record.data();
+        auto last = p + _record.size();
+        _frame_number = read_value<uint32_t>(p);
+        _timestamp = read_value<uint64_t>(p);
+        auto span_count = read_value<uint16_t>(p);
+        for (unsigned n = 0; n != span_count; ++n)
+        {
+            if (last - p < 2)
+                invalid_record();
+            auto first = unsigned(read_value<uint8_t>(p));
+            auto count = unsigned(read_value<uint8_t>(p)) + 1;
+            if (first + count > 256 || size_t(last - p) < count * sizeof(color))
+                invalid_record();
+            for (unsigned i = 0; i != count; ++i)
+                _palette[first + i] = read_value<color>(p);
+        }
+
+        apply_frame_delta(_pixels.get(), size_t(_width) * _height, p, size_t(last - p));
+        return true;
+    }
+}
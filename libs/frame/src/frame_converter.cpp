@@ -0,0 +1,177 @@
+#include <frame/frame_converter.h>
+#include <frame/pixel_ops.h>
+
+#include <stdext/utility.h>
+
+#include <algorithm>
+
+#include <cassert>
+
+
+namespace wcdx::frame
+{
+    frame_converter::frame_converter(unsigned width, unsigned height)
+        : _pixels(std::make_unique<std::byte[]>(size_t(width) * height)), _usage(width, height)
+        , _dirty(width, height), _palette_dirty(width, height)
+    {
+        std::fill_n(_palette, std::size(_palette), color(0xFF000000));
+        std::fill_n(_palette_mask, std::size(_palette_mask), color(0));
+        _dirty.add_all();
+    }
+
+    void frame_converter::set_palette(const color entries[256]) noexcept
+    {
+        for (unsigned n = 0; n != std::size(_palette); ++n)
+            update_palette(n, entries[n]);
+    }
+
+    void frame_converter::update_palette(unsigned index, color entry) noexcept
+    {
+        assert(index < std::size(_palette));
+
+        // The games rewrite entries that haven't changed; those cost nothing.
+        if (_palette[index] == entry)
+            return;
+
+        _palette[index] = entry;
+        _changed_indices.set(index);
+    }
+
+    void frame_converter::update_frame(int x, int y, unsigned width, unsigned height, size_t pitch, const std::byte* bits) noexcept
+    {
+        auto clipped = clip_block(x, y, width, height, this->width(), this->height());
+        if (empty(clipped))
+            return;
+
+        // Source pixels that fall outside the frame are skipped.
+        auto src = bits + (size_t(clipped.top - y) * pitch) + (clipped.left - x);
+        auto dest = _pixels.get() + clipped.left + (size_t(this->width()) * clipped.top);
+        auto row_width = size_t(clipped.right - clipped.left);
+        auto row_count = size_t(clipped.bottom - clipped.top);
+
+        // Usage tracking has to see what each row held before, so the copy
+        // comes after; full-frame updates then copy in one piece.
+        for (size_t row = 0; row != row_count; ++row)
+            _usage.replace(unsigned(clipped.top) + unsigned(row), dest + (size_t(this->width()) * row), src + (pitch * row), row_width);
+        copy_rows(src, pitch, dest, this->width(), row_width, row_count);
+
+        _dirty.add(clipped);
+    }
+
+    void frame_converter::assign(const std::byte* pixels, const color palette[256]) noexcept
+    {
+        set_palette(palette);
+
+        auto dest = _pixels.get();
+        for (unsigned row = 0; row != height(); ++row)
+        {
+            auto [src_first, dest_first] = std::mismatch(pixels, pixels + width(), dest);
+            if (src_first != pixels + width())
+            {
+                auto left = unsigned(src_first - pixels);
+                auto right = width();
+                while (pixels[right - 1] == dest[right - 1])
+                    --right;
+
+                _usage.replace(row, dest + left, pixels + left, right - left);
+                std::copy(pixels + left, pixels + right, dest + left);
+                _dirty.add_span(row, left, right);
+            }
+
+            pixels += width();
+            dest += width();
+        }
+    }
+
+    void frame_converter::invalidate() noexcept
+    {
+        _dirty.add_all();
+    }
+
+    rect frame_converter::dirty_bounds()
+    {
+        resolve_palette_changes();
+        if (_palette_dirty.empty())
+            return _dirty.bounds();
+        if (_dirty.empty())
+            return _palette_dirty.bounds();
+
+        auto& a = _dirty.bounds();
+        auto& b = _palette_dirty.bounds();
+        return { std::min(a.left, b.left), std::min(a.top, b.top), std::max(a.right, b.right), std::max(a.bottom, b.bottom) };
+    }
+
+    void frame_converter::convert(void* bits, size_t pitch, const rect& target_rect)
+    {
+        auto bounds = dirty_bounds();
+        assert(empty(bounds) || (target_rect.left <= bounds.left && target_rect.top <= bounds.top
+            && target_rect.right >= bounds.right && target_rect.bottom >= bounds.bottom));
+        stdext::discard(bounds);
+
+        auto target = static_cast<std::byte*>(bits);
+        auto target_row = [&](unsigned row)
+        {
+            return reinterpret_cast<color*>(target + (pitch * (row - target_rect.top))) - target_rect.left;
+        };
+
+        _dirty.for_each_span([&](unsigned row, unsigned left, unsigned right)
+        {
+            auto src = _pixels.get() + (size_t(width()) * row);
+            expand_pixels(src + left, target_row(row) + left, right - left, _palette);
+        });
+
+        _palette_dirty.for_each_span([&](unsigned row, unsigned left, unsigned right)
+        {
+            // Skip whatever part of the row was already converted in full.
+            auto src = _pixels.get() + (size_t(width()) * row);
+            auto dest = target_row(row);
+            auto [full_left, full_right] = _dirty.row_span(row);
+            if (full_left < full_right)
+            {
+                if (left < full_left)
+                    expand_pixels_masked(src + left, dest + left, full_left - left, _palette, _palette_mask);
+                left = std::max(left, full_right);
+            }
+            if (left < right)
+                expand_pixels_masked(src + left, dest + left, right - left, _palette, _palette_mask);
+        });
+
+        _dirty.clear();
+        _palette_dirty.clear();
+        std::fill_n(_palette_mask, std::size(_palette_mask), color(0));
+    }
+
+    void frame_converter::resolve_palette_changes()
+    {
+        if (_changed_indices.none())
+            return;
+
+        // Palette cycling mostly touches entries that aren't on screen.
+        auto affected_pixels = _usage.pixel_count(_changed_indices);
+        if (affected_pixels != 0)
+        {
+            // The masked conversion visits every pixel of each affected row and
+            // is slower per pixel than a plain conversion, so once enough of the
+            // frame is involved it's cheaper to convert all of it.
+            auto affected_rows = _usage.row_count(_changed_indices);
+            auto frame_pixels = size_t(width()) * height();
+            if (2 * affected_pixels >= frame_pixels || 3 * affected_rows >= 2 * height())
+                _dirty.add_all();
+            else
+            {
+                _usage.for_each_row(_changed_indices, [&](unsigned row)
+                {
+                    _palette_dirty.add_span(row, 0, width());
+                });
+
+                for (unsigned index = 0; index != std::size(_palette_mask); ++index)
+                {
+                    if (_changed_indices.test(index))
+                        _palette_mask[index] = ~color(0);
+                }
+            }
+        }
+
+        _changed_indices.reset();
+    }
+}
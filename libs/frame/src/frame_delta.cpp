@@ -0,0 +1,216 @@
+#include <frame/frame_delta.h>
+
+#include <bit>
+#include <stdexcept>
+
+#include <cstdint>
+#include <cstring>
+
+
+namespace wcdx::frame
+{
+    namespace
+    {
+        enum token_kind : unsigned
+        {
+            token_skip = 0,
+            token_fill = 1,
+            token_literal = 2
+        };
+
+        constexpr unsigned short_length_limit = 63;
+
+        // Skip and fill tokens shorter than this cost more than carrying the
+        // pixels along in the surrounding literal.
+        constexpr size_t min_run_length = 4;
+
+        class delta_writer
+        {
+        public:
+            explicit delta_writer(std::byte* out) noexcept : _first(out), _next(out) { }
+
+        public:
+            size_t size() const noexcept { return size_t(_next - _first); }
+
+            void write_token(token_kind kind, size_t length) noexcept
+            {
+                if (length <= short_length_limit)
+                {
+                    *_next++ = std::byte((kind << 6) | (length - 1));
+                    return;
+                }
+
+                *_next++ = std::byte((kind << 6) | short_length_limit);
+                for (length -= short_length_limit + 1; length >= 0x80; length >>= 7)
+                    *_next++ = std::byte(0x80 | (length & 0x7F));
+                *_next++ = std::byte(length);
+            }
+
+            void write(std::byte value) noexcept { *_next++ = value; }
+
+            void write_xor(const std::byte* previous, const std::byte* current, size_t length) noexcept
+            {
+                for (size_t n = 0; n != length; ++n)
+                    *_next++ = previous[n] ^ current[n];
+            }
+
+        private:
+            std::byte* _first;
+            std::byte* _next;
+        };
+
+        uint64_t load_difference(const std::byte* previous, const std::byte* current) noexcept
+        {
+            uint64_t a, b;
+            std::memcpy(&a, previous, sizeof(a));
+            std::memcpy(&b, current, sizeof(b));
+            return a ^ b;
+        }
+
+        // Finds the end of the run of unchanged pixels starting at first.
+        // Most of a frame is usually unchanged, so this compares a block of
+        // words at a time and then finds the first changed byte within the
+        // word that differs (words are little-endian).
+        size_t unchanged_end(const std::byte* previous, const std::byte* current, size_t first, size_t size) noexcept
+        {
+            constexpr size_t word_size = sizeof(uint64_t);
+            constexpr size_t block_size = 4 * word_size;
+
+            auto n = first;
+            for (; size - n >= block_size; n += block_size)
+            {
+                auto difference = load_difference(previous + n, current + n)
+                    | load_difference(previous + n + word_size, current + n + word_size)
+                    | load_difference(previous + n + 2 * word_size, current + n + 2 * word_size)
+                    | load_difference(previous + n + 3 * word_size, current + n + 3 * word_size);
+                if (difference != 0)
+                    break;
+            }
+
+            for (; size - n >= word_size; n += word_size)
+            {
+                auto difference = load_difference(previous + n, current + n);
+                if (difference != 0)
+                    return n + size_t(std::countr_zero(difference)) / 8;
+            }
+
+            while (n != size && previous[n] == current[n])
+                ++n;
+            return n;
+        }
+
+        [[noreturn]] void invalid_delta()
+        {
+            throw std::runtime_error("Invalid frame delta");
+        }
+    }
+
+    size_t encode_frame_delta(const std::byte* previous, const std::byte* current, size_t size, std::byte* out) noexcept
+    {
+        delta_writer writer(out);
+
+        // Pixels that aren't worth a token of their own accumulate in a
+        // pending literal, which is written out ahead of the next skip or
+        // fill token.
+        size_t literal_first = 0;
+        auto flush_literal = [&](size_t last)
+        {
+            if (last != literal_first)
+            {
+                writer.write_token(token_literal, last - literal_first);
+                writer.write_xor(previous + literal_first, current + literal_first, last - literal_first);
+            }
+        };
+
+        for (size_t n = 0; n != size; )
+        {
+            auto value = previous[n] ^ current[n];
+            size_t run_last;
+            if (value == std::byte(0))
+                run_last = unchanged_end(previous, current, n, size);
+            else
+            {
+                run_last = n + 1;
+                while (run_last != size && (previous[run_last] ^ current[run_last]) == value)
+                    ++run_last;
+            }
+
+            if (run_last - n >= min_run_length || (value == std::byte(0) && run_last == size))
+            {
+                flush_literal(n);
+                if (value != std::byte(0))
+                {
+                    writer.write_token(token_fill, run_last - n);
+                    writer.write(value);
+                }
+                else if (run_last != size)
+                    writer.write_token(token_skip, run_last - n);
+                literal_first = run_last;
+            }
+
+            n = run_last;
+        }
+
+        flush_literal(size);
+        return writer.size();
+    }
+
+    void apply_frame_delta(std::byte* frame, size_t size, const std::byte* delta, size_t delta_size)
+    {
+        auto delta_last = delta + delta_size;
+        auto frame_last = frame + size;
+        while (delta != delta_last)
+        {
+            auto token = unsigned(*delta++);
+            auto kind = token >> 6;
+            size_t length = (token & short_length_limit) + 1;
+            if (length > short_length_limit)
+            {
+                size_t extra = 0;
+                for (unsigned shift = 0; ; shift += 7)
+                {
+                    if (delta == delta_last || shift >= 8 * sizeof(size_t))
+                        invalid_delta();
+
+                    auto byte = unsigned(*delta++);
+                    extra |= size_t(byte & 0x7F) << shift;
+                    if ((byte & 0x80) == 0)
+                        break;
+                }
+                length += extra;
+            }
+
+            if (length > size_t(frame_last - frame))
+                invalid_delta();
+
+            switch (kind)
+            {
+            case token_skip:
+                break;
+
+            case token_fill:
+            {
+                if (delta == delta_last)
+                    invalid_delta();
+                auto value = *delta++;
+                for (size_t n = 0; n != length; ++n)
+                    frame[n] ^= value;
+                break;
+            }
+
+            case token_literal:
+                if (length > size_t(delta_last - delta))
+                    invalid_delta();
+                for (size_t n = 0; n != length; ++n)
+                    frame[n] ^= delta[n];
+                delta += length;
+                break;
+
+            default:
+                invalid_delta();
+            }
+
+            frame += length;
+        }
+    }
+}
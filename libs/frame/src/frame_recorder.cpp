@@ -0,0 +1,179 @@
+#include <frame/frame_recorder.h>
+#include <frame/frame_capture.h>
+#include <frame/frame_delta.h>
+
+#include <stdext/stream.h>
+
+#include <algorithm>
+#include <utility>
+
+#include <cstring>
+
+
+namespace wcdx::frame
+{
+    namespace
+    {
+        // The writer wakes up this often on its own, and sooner when the ring
+        // is more than half full.
+        constexpr auto write_interval = std::chrono::milliseconds(50);
+
+        // Every palette entry changing one at a time, each in its own span.
+        constexpr size_t max_palette_spans_size = 256 * (2 + sizeof(color));
+
+        template <class T>
+        std::byte* write_value(std::byte* p, T value) noexcept
+        {
+            std::memcpy(p, &value, sizeof(value));
+            return p + sizeof(value);
+        }
+    }
+
+    frame_recorder::frame_recorder(unsigned width, unsigned height, stdext::output_stream& output, size_t buffer_size)
+        : _width(width), _height(height), _output(output), _start(std::chrono::steady_clock::now())
+        , _previous(std::make_unique<std::byte[]>(size_t(width) * height))
+        , _scratch(std::make_unique<std::byte[]>(capture_record_header_size + max_palette_spans_size + max_frame_delta_size(size_t(width) * height)))
+        , _ring(std::make_unique<std::byte[]>(buffer_size)), _ring_size(buffer_size)
+    {
+        std::byte header[capture_header_size];
+        auto p = write_value(header, capture_magic);
+        p = write_value(p, capture_version);
+        p = write_value(p, uint16_t(width));
+        p = write_value(p, uint16_t(height));
+        write_value(p, uint16_t(0));
+        _output.write_all(header, std::size(header));
+
+        _thread = std::thread(&frame_recorder::write_thread, this);
+    }
+
+    frame_recorder::~frame_recorder()
+    {
+        try
+        {
+            finish();
+        }
+        catch (...)
+        {
+        }
+    }
+
+    void frame_recorder::record(const std::byte* pixels, const color palette[256]) noexcept
+    {
+        auto frame_number = _frame_number++;
+        if (_failed.load(std::memory_order_relaxed))
+        {
+            ++_dropped_count;
+            return;
+        }
+
+        auto timestamp = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - _start).count();
+        auto p = _scratch.get() + sizeof(uint32_t);
+        p = write_value(p, frame_number);
+        p = write_value(p, uint64_t(timestamp));
+
+        auto span_count_pos = p;
+        p += sizeof(uint16_t);
+        uint16_t span_count = 0;
+        for (unsigned first = 0; first != 256; )
+        {
+            if (palette[first] == _previous_palette[first])
+            {
+                ++first;
+                continue;
+            }
+
+            auto last = first + 1;
+            while (last != 256 && palette[last] != _previous_palette[last])
+                ++last;
+
+            *p++ = std::byte(first);
+            *p++ = std::byte(last - first - 1);
+            for (; first != last; ++first)
+                p = write_value(p, palette[first]);
+            ++span_count;
+        }
+        write_value(span_count_pos, span_count);
+
+        auto frame_size = size_t(_width) * _height;
+        auto delta = p;
+        auto delta_size = encode_frame_delta(_previous.get(), pixels, frame_size, delta);
+        p += delta_size;
+
+        auto record_size = size_t(p - _scratch.get());
+        write_value(_scratch.get(), uint32_t(record_size - sizeof(uint32_t)));
+
+        auto head = _head.load(std::memory_order_relaxed);
+        auto used = size_t(head - _tail.load(std::memory_order_acquire));
+        if (record_size > _ring_size - used)
+        {
+            ++_dropped_count;
+            return;
+        }
+
+        auto offset = size_t(head % _ring_size);
+        auto first_part = std::min(record_size, _ring_size - offset);
+        std::memcpy(_ring.get() + offset, _scratch.get(), first_part);
+        std::memcpy(_ring.get(), _scratch.get() + first_part, record_size - first_part);
+        _head.store(head + record_size, std::memory_order_release);
+
+        // Bring the previous frame up to date with what was just recorded;
+        // replaying the delta only touches the pixels that changed.
+        apply_frame_delta(_previous.get(), frame_size, delta, delta_size);
+        std::copy_n(palette, 256, _previous_palette);
+        ++_recorded_count;
+
+        if (2 * (used + record_size) > _ring_size)
+            _wake.notify_one();
+    }
+
+    void frame_recorder::finish()
+    {
+        if (_thread.joinable())
+        {
+            {
+                std::lock_guard<std::mutex> lock(_mutex);
+                _stop.store(true, std::memory_order_release);
+            }
+            _wake.notify_one();
+            _thread.join();
+        }
+
+        if (_error != nullptr)
+            std::rethrow_exception(std::exchange(_error, nullptr));
+    }
+
+    void frame_recorder::write_thread()
+    {
+        try
+        {
+            for (;;)
+            {
+                auto stopping = _stop.load(std::memory_order_acquire);
+                auto tail = _tail.load(std::memory_order_relaxed);
+                auto head = _head.load(std::memory_order_acquire);
+                if (head == tail)
+                {
+                    if (stopping)
+                        return;
+
+                    std::unique_lock<std::mutex> lock(_mutex);
+                    if (!_stop.load(std::memory_order_relaxed))
+                        _wake.wait_for(lock, write_interval);
+                    continue;
+                }
+
+                // Write up to the end of the ring at most; the rest wraps
+                // around to the next pass.
+                auto offset = size_t(tail % _ring_size);
+                auto size = std::min(size_t(head - tail), _ring_size - offset);
+                _output.write_all(_ring.get() + offset, size);
+                _tail.store(tail + size, std::memory_order_release);
+            }
+        }
+        catch (...)
+        {
+            _error = std::current_exception();
+            _failed.store(true, std::memory_order_relaxed);
+        }
+    }
+}
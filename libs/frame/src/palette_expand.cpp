@@ -0,0 +1,133 @@
+#include <frame/palette_expand.h>
+
+#include "palette_expand_kernels.h"
+
+#include <stdext/utility.h>
+
+#include <atomic>
+
+
+namespace wcdx::frame
+{
+    namespace
+    {
+        using expand_fn = void (*)(const std::byte* src, color* dest, size_t count, const color palette[256]) noexcept;
+        using expand_masked_fn = void (*)(const std::byte* src, color* dest, size_t count, const color palette[256], const color mask[256]) noexcept;
+
+        expand_path best_expand_path() noexcept;
+        expand_fn expand_function(expand_path path) noexcept;
+        expand_masked_fn expand_masked_function(expand_path path) noexcept;
+
+        std::atomic<expand_path> current_path = best_expand_path();
+        std::atomic<expand_fn> current_function = expand_function(current_path.load(std::memory_order_relaxed));
+        std::atomic<expand_masked_fn> current_masked_function = expand_masked_function(current_path.load(std::memory_order_relaxed));
+    }
+
+    void expand_pixels(const std::byte* src, color* dest, size_t count, const color palette[256]) noexcept
+    {
+        current_function.load(std::memory_order_relaxed)(src, dest, count, palette);
+    }
+
+    void expand_pixels_masked(const std::byte* src, color* dest, size_t count, const color palette[256], const color mask[256]) noexcept
+    {
+        current_masked_function.load(std::memory_order_relaxed)(src, dest, count, palette, mask);
+    }
+
+    expand_path active_expand_path() noexcept
+    {
+        return current_path.load(std::memory_order_relaxed);
+    }
+
+    expand_path select_expand_path(expand_path path) noexcept
+    {
+        if (!expand_path_supported(path))
+            path = best_expand_path();
+
+        current_path.store(path, std::memory_order_relaxed);
+        current_function.store(expand_function(path), std::memory_order_relaxed);
+        current_masked_function.store(expand_masked_function(path), std::memory_order_relaxed);
+        return path;
+    }
+
+    bool expand_path_supported(expand_path path) noexcept
+    {
+        switch (path)
+        {
+        case expand_path::scalar:
+            return true;
+        case expand_path::sse2:
+            return WCDX_FRAME_X86 && cpu_has_sse2();
+        case expand_path::avx2:
+            return WCDX_FRAME_X86 && cpu_has_avx2();
+        }
+
+        return false;
+    }
+
+    namespace kernels
+    {
+        void expand_pixels_scalar(const std::byte* src, color* dest, size_t count, const color palette[256]) noexcept
+        {
+            for (; count >= 4; count -= 4)
+            {
+                dest[0] = palette[uint8_t(src[0])];
+                dest[1] = palette[uint8_t(src[1])];
+                dest[2] = palette[uint8_t(src[2])];
+                dest[3] = palette[uint8_t(src[3])];
+                src += 4;
+                dest += 4;
+            }
+
+            while (count-- != 0)
+                *dest++ = palette[uint8_t(*src++)];
+        }
+
+        void expand_pixels_masked_scalar(const std::byte* src, color* dest, size_t count, const color palette[256], const color mask[256]) noexcept
+        {
+            for (size_t n = 0; n != count; ++n)
+            {
+                auto index = uint8_t(src[n]);
+                if (mask[index] != 0)
+                    dest[n] = palette[index];
+            }
+        }
+    }
+
+    namespace
+    {
+        expand_path best_expand_path() noexcept
+        {
+            if (expand_path_supported(expand_path::avx2))
+                return expand_path::avx2;
+            if (expand_path_supported(expand_path::sse2))
+                return expand_path::sse2;
+            return expand_path::scalar;
+        }
+
+        expand_fn expand_function(expand_path path) noexcept
+        {
+            switch (path)
+            {
+#if WCDX_FRAME_X86
+            case expand_path::avx2:
+                return kernels::expand_pixels_avx2;
+            case expand_path::sse2:
+                return kernels::expand_pixels_sse2;
+#endif
+            default:
+                return kernels::expand_pixels_scalar;
+            }
+        }
+
+        expand_masked_fn expand_masked_function(expand_path path) noexcept
+        {
+            // Without a gather there's nothing for SSE2 to win here.
+#if WCDX_FRAME_X86
+            if (path == expand_path::avx2)
+                return kernels::expand_pixels_masked_avx2;
+#endif
+            stdext::discard(path);
+            return kernels::expand_pixels_masked_scalar;
+        }
+    }
+}
@@ -0,0 +1,61 @@
+#include "palette_expand_kernels.h"
+
+#if WCDX_FRAME_X86
+
+#include <immintrin.h>
+
+
+namespace wcdx::frame::kernels
+{
+    void expand_pixels_avx2(const std::byte* src, color* dest, size_t count, const color palette[256]) noexcept
+    {
+        auto table = reinterpret_cast<const int*>(palette);
+        for (; count >= 16; count -= 16)
+        {
+            auto indices = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src));
+            auto lo = _mm256_i32gather_epi32(table, _mm256_cvtepu8_epi32(indices), 4);
+            auto hi = _mm256_i32gather_epi32(table, _mm256_cvtepu8_epi32(_mm_srli_si128(indices, 8)), 4);
+            _mm256_storeu_si256(reinterpret_cast<__m256i*>(dest), lo);
+            _mm256_storeu_si256(reinterpret_cast<__m256i*>(dest + 8), hi);
+            src += 16;
+            dest += 16;
+        }
+
+        if (count >= 8)
+        {
+            auto indices = _mm_loadl_epi64(reinterpret_cast<const __m128i*>(src));
+            auto pixels = _mm256_i32gather_epi32(table, _mm256_cvtepu8_epi32(indices), 4);
+            _mm256_storeu_si256(reinterpret_cast<__m256i*>(dest), pixels);
+            src += 8;
+            dest += 8;
+            count -= 8;
+        }
+
+        // Avoid AVX-SSE transition penalties in the caller.
+        _mm256_zeroupper();
+        expand_pixels_scalar(src, dest, count, palette);
+    }
+
+    void expand_pixels_masked_avx2(const std::byte* src, color* dest, size_t count, const color palette[256], const color mask[256]) noexcept
+    {
+        auto table = reinterpret_cast<const int*>(palette);
+        auto mask_table = reinterpret_cast<const int*>(mask);
+        for (; count >= 8; count -= 8)
+        {
+            auto indices = _mm256_cvtepu8_epi32(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(src)));
+            auto store_mask = _mm256_i32gather_epi32(mask_table, indices, 4);
+            if (!_mm256_testz_si256(store_mask, store_mask))
+            {
+                auto pixels = _mm256_i32gather_epi32(table, indices, 4);
+                _mm256_maskstore_epi32(reinterpret_cast<int*>(dest), store_mask, pixels);
+            }
+            src += 8;
+            dest += 8;
+        }
+
+        _mm256_zeroupper();
+        expand_pixels_masked_scalar(src, dest, count, palette, mask);
+    }
+}
+
+#endif
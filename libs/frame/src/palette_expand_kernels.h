@@ -0,0 +1,21 @@
+#ifndef FRAME_PALETTE_EXPAND_KERNELS_INCLUDED
+#define FRAME_PALETTE_EXPAND_KERNELS_INCLUDED
+#pragma once
+
+#include <frame/palette_expand.h>
+
+#include "cpu_features.h"
+
+
+namespace wcdx::frame::kernels
+{
+    void expand_pixels_scalar(const std::byte* src, color* dest, size_t count, const color palette[256]) noexcept;
+    void expand_pixels_masked_scalar(const std::byte* src, color* dest, size_t count, const color palette[256], const color mask[256]) noexcept;
+#if WCDX_FRAME_X86
+    void expand_pixels_sse2(const std::byte* src, color* dest, size_t count, const color palette[256]) noexcept;
+    void expand_pixels_avx2(const std::byte* src, color* dest, size_t count, const color palette[256]) noexcept;
+    void expand_pixels_masked_avx2(const std::byte* src, color* dest, size_t count, const color palette[256], const color mask[256]) noexcept;
+#endif
+}
+
+#endif
@@ -0,0 +1,32 @@
+#include "palette_expand_kernels.h"
+
+#if WCDX_FRAME_X86
+
+#include <emmintrin.h>
+
+
+namespace wcdx::frame::kernels
+{
+    // SSE2 has no gather, so the lookups stay scalar; the win comes from
+    // assembling four pixels in a register and issuing one 16-byte store.
+    void expand_pixels_sse2(const std::byte* src, color* dest, size_t count, const color palette[256]) noexcept
+    {
+        for (; count >= 8; count -= 8)
+        {
+            auto lo = _mm_unpacklo_epi64(
+                _mm_unpacklo_epi32(_mm_cvtsi32_si128(int(palette[uint8_t(src[0])])), _mm_cvtsi32_si128(int(palette[uint8_t(src[1])]))),
+                _mm_unpacklo_epi32(_mm_cvtsi32_si128(int(palette[uint8_t(src[2])])), _mm_cvtsi32_si128(int(palette[uint8_t(src[3])]))));
+            auto hi = _mm_unpacklo_epi64(
+                _mm_unpacklo_epi32(_mm_cvtsi32_si128(int(palette[uint8_t(src[4])])), _mm_cvtsi32_si128(int(palette[uint8_t(src[5])]))),
+                _mm_unpacklo_epi32(_mm_cvtsi32_si128(int(palette[uint8_t(src[6])])), _mm_cvtsi32_si128(int(palette[uint8_t(src[7])]))));
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(dest), lo);
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(dest + 4), hi);
+            src += 8;
+            dest += 8;
+        }
+
+        expand_pixels_scalar(src, dest, count, palette);
+    }
+}
+
+#endif
@@ -0,0 +1,111 @@
+#include <frame/palette_usage.h>
+
+#include <algorithm>
+#include <limits>
+
+#include <cassert>
+
+
+namespace wcdx::frame
+{
+    palette_usage::palette_usage(unsigned width, unsigned height)
+        : _width(width), _height(height), _row_words((height + word_bits - 1) / word_bits)
+        , _row_counts(size_t(height) * 256), _row_masks(size_t(_row_words) * 256)
+    {
+        assert(width <= std::numeric_limits<uint16_t>::max());
+
+        // A new frame is all index 0.
+        std::fill_n(_totals, std::size(_totals), size_t(0));
+        if (width != 0)
+        {
+            for (unsigned row = 0; row != height; ++row)
+            {
+                _row_counts[size_t(row) * 256] = uint16_t(width);
+                _row_masks[row / word_bits] |= uint64_t(1) << (row % word_bits);
+            }
+            _totals[0] = size_t(width) * height;
+        }
+    }
+
+    void palette_usage::reset(const std::byte* pixels) noexcept
+    {
+        std::fill(_row_counts.begin(), _row_counts.end(), uint16_t(0));
+        std::fill(_row_masks.begin(), _row_masks.end(), uint64_t(0));
+        std::fill_n(_totals, std::size(_totals), size_t(0));
+
+        for (unsigned row = 0; row != _height; ++row)
+        {
+            for (unsigned n = 0; n != _width; ++n)
+                increment(row, uint8_t(*pixels++));
+        }
+    }
+
+    void palette_usage::replace(unsigned row, const std::byte* old_pixels, const std::byte* new_pixels, size_t count) noexcept
+    {
+        assert(row < _height);
+        for (size_t n = 0; n != count; ++n)
+        {
+            auto old_index = uint8_t(old_pixels[n]);
+            auto new_index = uint8_t(new_pixels[n]);
+            if (old_index != new_index)
+            {
+                decrement(row, old_index);
+                increment(row, new_index);
+            }
+        }
+    }
+
+    size_t palette_usage::pixel_count(const index_set& indices) const noexcept
+    {
+        size_t total = 0;
+        for (unsigned index = 0; index != std::size(_totals); ++index)
+        {
+            if (indices.test(index))
+                total += _totals[index];
+        }
+        return total;
+    }
+
+    unsigned palette_usage::row_count(const index_set& indices) const
+    {
+        std::vector<uint64_t> rows;
+        rows_using(indices, rows);
+
+        unsigned count = 0;
+        for (auto bits : rows)
+        {
+            for (; bits != 0; bits &= bits - 1)
+                ++count;
+        }
+        return count;
+    }
+
+    void palette_usage::rows_using(const index_set& indices, std::vector<uint64_t>& rows) const
+    {
+        rows.assign(_row_words, 0);
+        for (unsigned index = 0; index != std::size(_totals); ++index)
+        {
+            if (!indices.test(index) || _totals[index] == 0)
+                continue;
+
+            auto mask = _row_masks.data() + (size_t(index) * _row_words);
+            for (unsigned word = 0; word != _row_words; ++word)
+                rows[word] |= mask[word];
+        }
+    }
+
+    void palette_usage::increment(unsigned row, uint8_t index) noexcept
+    {
+        if (_row_counts[(size_t(row) * 256) + index]++ == 0)
+            _row_masks[(size_t(index) * _row_words) + (row / word_bits)] |= uint64_t(1) << (row % word_bits);
+        ++_totals[index];
+    }
+
+    void palette_usage::decrement(unsigned row, uint8_t index) noexcept
+    {
+        assert(_row_counts[(size_t(row) * 256) + index] != 0);
+        if (--_row_counts[(size_t(row) * 256) + index] == 0)
+            _row_masks[(size_t(index) * _row_words) + (row / word_bits)] &= ~(uint64_t(1) << (row % word_bits));
+        --_totals[index];
+    }
+}
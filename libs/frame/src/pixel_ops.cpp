@@ -0,0 +1,175 @@
+#include <frame/pixel_ops.h>
+
+#include "pixel_ops_kernels.h"
+
+#include <algorithm>
+#include <atomic>
+
+#include <cstring>
+
+
+namespace wcdx::frame
+{
+    namespace
+    {
+        using fill_snow_row_fn = uint32_t (*)(std::byte* dest, size_t count, std::byte color, uint32_t key, uint32_t counter) noexcept;
+        using copy_row_transparent_fn = void (*)(const std::byte* src, std::byte* dest, size_t count, std::byte transparent) noexcept;
+
+        expand_path best_pixel_path() noexcept;
+        fill_snow_row_fn fill_snow_row_function(expand_path path) noexcept;
+        copy_row_transparent_fn copy_row_transparent_function(expand_path path) noexcept;
+
+        std::atomic<expand_path> current_path = best_pixel_path();
+        std::atomic<fill_snow_row_fn> current_fill_snow_row = fill_snow_row_function(current_path.load(std::memory_order_relaxed));
+        std::atomic<copy_row_transparent_fn> current_copy_row_transparent = copy_row_transparent_function(current_path.load(std::memory_order_relaxed));
+    }
+
+    rect clip_block(int x, int y, unsigned width, unsigned height, unsigned target_width, unsigned target_height) noexcept
+    {
+        // Widen before adding so that blocks reaching past INT_MAX clip
+        // instead of wrapping.
+        auto right = std::min(int64_t(x) + width, int64_t(target_width));
+        auto bottom = std::min(int64_t(y) + height, int64_t(target_height));
+        return
+        {
+            std::max(x, 0),
+            std::max(y, 0),
+            int(std::max(right, int64_t(0))),
+            int(std::max(bottom, int64_t(0)))
+        };
+    }
+
+    void copy_rows(const std::byte* src, size_t src_pitch, std::byte* dest, size_t dest_pitch, size_t width, size_t height) noexcept
+    {
+        if (width == 0 || height == 0)
+            return;
+
+        if (src_pitch == width && dest_pitch == width)
+        {
+            std::memcpy(dest, src, width * height);
+            return;
+        }
+
+        for (size_t row = 0; row != height; ++row)
+        {
+            std::memcpy(dest, src, width);
+            src += src_pitch;
+            dest += dest_pitch;
+        }
+    }
+
+    void copy_rows_transparent(const std::byte* src, size_t src_pitch, std::byte* dest, size_t dest_pitch, size_t width, size_t height,
+        std::byte transparent) noexcept
+    {
+        auto copy_row = current_copy_row_transparent.load(std::memory_order_relaxed);
+        if (src_pitch == width && dest_pitch == width)
+        {
+            copy_row(src, dest, width * height, transparent);
+            return;
+        }
+
+        for (size_t row = 0; row != height; ++row)
+        {
+            copy_row(src, dest, width, transparent);
+            src += src_pitch;
+            dest += dest_pitch;
+        }
+    }
+
+    snow_generator::snow_generator(uint32_t seed) noexcept
+        : _key(kernels::snow_word(0x9e3779b9, seed))
+    {
+    }
+
+    void snow_generator::fill(std::byte* pixels, size_t pitch, unsigned width, unsigned height, std::byte color) noexcept
+    {
+        auto fill_row = current_fill_snow_row.load(std::memory_order_relaxed);
+        for (unsigned row = 0; row != height; ++row)
+            _counter = fill_row(pixels + (pitch * row), width, color, _key, _counter);
+    }
+
+    expand_path active_pixel_path() noexcept
+    {
+        return current_path.load(std::memory_order_relaxed);
+    }
+
+    expand_path select_pixel_path(expand_path path) noexcept
+    {
+        if (!expand_path_supported(path))
+            path = best_pixel_path();
+
+        current_path.store(path, std::memory_order_relaxed);
+        current_fill_snow_row.store(fill_snow_row_function(path), std::memory_order_relaxed);
+        current_copy_row_transparent.store(copy_row_transparent_function(path), std::memory_order_relaxed);
+        return path;
+    }
+
+    namespace kernels
+    {
+        uint32_t fill_snow_row_scalar(std::byte* dest, size_t count, std::byte color, uint32_t key, uint32_t counter) noexcept
+        {
+            while (count != 0)
+            {
+                auto bits = snow_word(key, counter++);
+                auto n = std::min(count, size_t(32));
+                for (size_t i = 0; i != n; ++i)
+                    dest[i] = std::byte(uint8_t(-int((bits >> i) & 1))) & color;
+                dest += n;
+                count -= n;
+            }
+
+            return counter;
+        }
+
+        void copy_row_transparent_scalar(const std::byte* src, std::byte* dest, size_t count, std::byte transparent) noexcept
+        {
+            for (size_t n = 0; n != count; ++n)
+            {
+                if (src[n] != transparent)
+                    dest[n] = src[n];
+            }
+        }
+    }
+
+    namespace
+    {
+        expand_path best_pixel_path() noexcept
+        {
+            if (expand_path_supported(expand_path::avx2))
+                return expand_path::avx2;
+            if (expand_path_supported(expand_path::sse2))
+                return expand_path::sse2;
+            return expand_path::scalar;
+        }
+
+        fill_snow_row_fn fill_snow_row_function(expand_path path) noexcept
+        {
+            switch (path)
+            {
+#if WCDX_FRAME_X86
+            case expand_path::avx2:
+                return kernels::fill_snow_row_avx2;
+            case expand_path::sse2:
+                return kernels::fill_snow_row_sse2;
+#endif
+            default:
+                return kernels::fill_snow_row_scalar;
+            }
+        }
+
+        copy_row_transparent_fn copy_row_transparent_function(expand_path path) noexcept
+        {
+            switch (path)
+            {
+#if WCDX_FRAME_X86
+            case expand_path::avx2:
+                return kernels::copy_row_transparent_avx2;
+            case expand_path::sse2:
+                return kernels::copy_row_transparent_sse2;
+#endif
+            default:
+                return kernels::copy_row_transparent_scalar;
+            }
+        }
+    }
+}
@@ -0,0 +1,83 @@
+#include "pixel_ops_kernels.h"
+
+#if WCDX_FRAME_X86
+
+#include <immintrin.h>
+
+#include <cstring>
+
+
+namespace wcdx::frame::kernels
+{
+    uint32_t fill_snow_row_avx2(std::byte* dest, size_t count, std::byte color, uint32_t key, uint32_t counter) noexcept
+    {
+        auto keys = _mm256_set1_epi32(int(key));
+        auto steps = _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7);
+        auto m1 = _mm256_set1_epi32(int(snow_multiplier_1));
+        auto m2 = _mm256_set1_epi32(int(snow_multiplier_2));
+
+        // With a word broadcast to every lane, the shuffle spreads each of its
+        // bytes over eight pixels and the mask picks out one bit per pixel.
+        auto spread = _mm256_setr_epi8(
+            0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 1, 1, 1, 1,
+            2, 2, 2, 2, 2, 2, 2, 2, 3, 3, 3, 3, 3, 3, 3, 3);
+        auto bit_select = _mm256_setr_epi8(
+            1, 2, 4, 8, 16, 32, 64, -128, 1, 2, 4, 8, 16, 32, 64, -128,
+            1, 2, 4, 8, 16, 32, 64, -128, 1, 2, 4, 8, 16, 32, 64, -128);
+        auto colors = _mm256_set1_epi8(char(color));
+
+        while (count != 0)
+        {
+            auto x = _mm256_add_epi32(_mm256_add_epi32(_mm256_set1_epi32(int(counter)), steps), keys);
+            x = _mm256_xor_si256(x, _mm256_srli_epi32(x, 16));
+            x = _mm256_mullo_epi32(x, m1);
+            x = _mm256_xor_si256(x, _mm256_srli_epi32(x, 15));
+            x = _mm256_mullo_epi32(x, m2);
+            auto words = _mm256_xor_si256(x, _mm256_srli_epi32(x, 16));
+
+            for (int n = 0; n != 8 && count != 0; ++n)
+            {
+                auto word = _mm256_permutevar8x32_epi32(words, _mm256_set1_epi32(n));
+                auto bytes = _mm256_and_si256(_mm256_shuffle_epi8(word, spread), bit_select);
+                auto pixels = _mm256_and_si256(_mm256_cmpeq_epi8(bytes, bit_select), colors);
+                if (count >= 32)
+                {
+                    _mm256_storeu_si256(reinterpret_cast<__m256i*>(dest), pixels);
+                    dest += 32;
+                    count -= 32;
+                }
+                else
+                {
+                    std::byte tail[32];
+                    _mm256_storeu_si256(reinterpret_cast<__m256i*>(tail), pixels);
+                    std::memcpy(dest, tail, count);
+                    count = 0;
+                }
+
+                ++counter;
+            }
+        }
+
+        // Avoid AVX-SSE transition penalties in the caller.
+        _mm256_zeroupper();
+        return counter;
+    }
+
+    void copy_row_transparent_avx2(const std::byte* src, std::byte* dest, size_t count, std::byte transparent) noexcept
+    {
+        auto key = _mm256_set1_epi8(char(transparent));
+        for (; count >= 32; count -= 32)
+        {
+            auto s = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(src));
+            auto d = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(dest));
+            _mm256_storeu_si256(reinterpret_cast<__m256i*>(dest), _mm256_blendv_epi8(s, d, _mm256_cmpeq_epi8(s, key)));
+            src += 32;
+            dest += 32;
+        }
+
+        _mm256_zeroupper();
+        copy_row_transparent_scalar(src, dest, count, transparent);
+    }
+}
+
+#endif
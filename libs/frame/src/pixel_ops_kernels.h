@@ -0,0 +1,41 @@
+#ifndef FRAME_PIXEL_OPS_KERNELS_INCLUDED
+#define FRAME_PIXEL_OPS_KERNELS_INCLUDED
+#pragma once
+
+#include <frame/pixel_ops.h>
+
+#include "cpu_features.h"
+
+
+namespace wcdx::frame::kernels
+{
+    // The hash behind snow_generator: a 32-bit integer finalizer with low
+    // bias, applied to the word's counter offset by the generator's key.
+    // Each bit of the result decides one pixel, lowest bit first.
+    constexpr uint32_t snow_multiplier_1 = 0x7feb352d;
+    constexpr uint32_t snow_multiplier_2 = 0x846ca68b;
+
+    inline uint32_t snow_word(uint32_t key, uint32_t counter) noexcept
+    {
+        auto x = counter + key;
+        x ^= x >> 16;
+        x *= snow_multiplier_1;
+        x ^= x >> 15;
+        x *= snow_multiplier_2;
+        x ^= x >> 16;
+        return x;
+    }
+
+    // Fill count pixels starting from the given word counter, and return
+    // the counter of the next unused word.
+    uint32_t fill_snow_row_scalar(std::byte* dest, size_t count, std::byte color, uint32_t key, uint32_t counter) noexcept;
+    void copy_row_transparent_scalar(const std::byte* src, std::byte* dest, size_t count, std::byte transparent) noexcept;
+#if WCDX_FRAME_X86
+    uint32_t fill_snow_row_sse2(std::byte* dest, size_t count, std::byte color, uint32_t key, uint32_t counter) noexcept;
+    uint32_t fill_snow_row_avx2(std::byte* dest, size_t count, std::byte color, uint32_t key, uint32_t counter) noexcept;
+    void copy_row_transparent_sse2(const std::byte* src, std::byte* dest, size_t count, std::byte transparent) noexcept;
+    void copy_row_transparent_avx2(const std::byte* src, std::byte* dest, size_t count, std::byte transparent) noexcept;
+#endif
+}
+
+#endif
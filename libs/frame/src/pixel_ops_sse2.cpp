@@ -0,0 +1,110 @@
+#include "pixel_ops_kernels.h"
+
+#if WCDX_FRAME_X86
+
+#include <emmintrin.h>
+
+#include <algorithm>
+
+#include <cstring>
+
+
+namespace wcdx::frame::kernels
+{
+    namespace
+    {
+        // SSE2 only multiplies even lanes into 64-bit products; the odd
+        // lanes take a second multiply.
+        __m128i mullo_epi32(__m128i a, __m128i b) noexcept
+        {
+            auto even = _mm_mul_epu32(a, b);
+            auto odd = _mm_mul_epu32(_mm_srli_si128(a, 4), _mm_srli_si128(b, 4));
+            return _mm_unpacklo_epi32(_mm_shuffle_epi32(even, _MM_SHUFFLE(0, 0, 2, 0)), _mm_shuffle_epi32(odd, _MM_SHUFFLE(0, 0, 2, 0)));
+        }
+
+        __m128i snow_words(__m128i counters, __m128i key) noexcept
+        {
+            auto x = _mm_add_epi32(counters, key);
+            x = _mm_xor_si128(x, _mm_srli_epi32(x, 16));
+            x = mullo_epi32(x, _mm_set1_epi32(int(snow_multiplier_1)));
+            x = _mm_xor_si128(x, _mm_srli_epi32(x, 15));
+            x = mullo_epi32(x, _mm_set1_epi32(int(snow_multiplier_2)));
+            return _mm_xor_si128(x, _mm_srli_epi32(x, 16));
+        }
+
+        // Turns a register holding each byte of a word four times over into
+        // the word's 32 pixels.
+        void expand_word(__m128i quad, std::byte* dest, __m128i bit_select, __m128i colors) noexcept
+        {
+            auto lo = _mm_unpacklo_epi32(quad, quad);
+            auto hi = _mm_unpackhi_epi32(quad, quad);
+            lo = _mm_and_si128(_mm_cmpeq_epi8(_mm_and_si128(lo, bit_select), bit_select), colors);
+            hi = _mm_and_si128(_mm_cmpeq_epi8(_mm_and_si128(hi, bit_select), bit_select), colors);
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(dest), lo);
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(dest + 16), hi);
+        }
+    }
+
+    uint32_t fill_snow_row_sse2(std::byte* dest, size_t count, std::byte color, uint32_t key, uint32_t counter) noexcept
+    {
+        auto keys = _mm_set1_epi32(int(key));
+        auto steps = _mm_set_epi32(3, 2, 1, 0);
+        auto bit_select = _mm_set_epi8(-128, 64, 32, 16, 8, 4, 2, 1, -128, 64, 32, 16, 8, 4, 2, 1);
+        auto colors = _mm_set1_epi8(char(color));
+
+        while (count != 0)
+        {
+            auto words = snow_words(_mm_add_epi32(_mm_set1_epi32(int(counter)), steps), keys);
+            auto lo = _mm_unpacklo_epi8(words, words);
+            auto hi = _mm_unpackhi_epi8(words, words);
+            __m128i quads[] =
+            {
+                _mm_unpacklo_epi16(lo, lo),
+                _mm_unpackhi_epi16(lo, lo),
+                _mm_unpacklo_epi16(hi, hi),
+                _mm_unpackhi_epi16(hi, hi)
+            };
+
+            for (auto quad : quads)
+            {
+                if (count >= 32)
+                {
+                    expand_word(quad, dest, bit_select, colors);
+                    dest += 32;
+                    count -= 32;
+                }
+                else
+                {
+                    std::byte tail[32];
+                    expand_word(quad, tail, bit_select, colors);
+                    std::memcpy(dest, tail, count);
+                    count = 0;
+                }
+
+                ++counter;
+                if (count == 0)
+                    break;
+            }
+        }
+
+        return counter;
+    }
+
+    void copy_row_transparent_sse2(const std::byte* src, std::byte* dest, size_t count, std::byte transparent) noexcept
+    {
+        auto key = _mm_set1_epi8(char(transparent));
+        for (; count >= 16; count -= 16)
+        {
+            auto s = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src));
+            auto d = _mm_loadu_si128(reinterpret_cast<const __m128i*>(dest));
+            auto keep = _mm_cmpeq_epi8(s, key);
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(dest), _mm_or_si128(_mm_and_si128(keep, d), _mm_andnot_si128(keep, s)));
+            src += 16;
+            dest += 16;
+        }
+
+        copy_row_transparent_scalar(src, dest, count, transparent);
+    }
+}
+
+#endif
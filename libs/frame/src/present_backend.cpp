@@ -0,0 +1,28 @@
+#include <frame/present_backend.h>
+#include <frame/frame_converter.h>
+
+#include <cassert>
+
+
+namespace wcdx::frame
+{
+    software_backend::software_backend(unsigned width, unsigned height)
+        : _width(width), _height(height), _pixels(std::make_unique<color[]>(size_t(width) * height))
+    {
+    }
+
+    bool software_backend::present(frame_converter& frame)
+    {
+        assert(frame.width() == _width && frame.height() == _height);
+
+        auto bounds = frame.dirty_bounds();
+        if (!empty(bounds))
+        {
+            auto target = _pixels.get() + (size_t(_width) * size_t(bounds.top)) + size_t(bounds.left);
+            frame.convert(target, _width * sizeof(color), bounds);
+        }
+
+        ++_presented_count;
+        return true;
+    }
+}
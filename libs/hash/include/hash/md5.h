@@ -0,0 +1,87 @@
+#ifndef HASH_MD5_INCLUDED
+#define HASH_MD5_INCLUDED
+#pragma once
+
+#include <initializer_list>
+
+#include <cstddef>
+#include <cstdint>
+
+
+namespace wcdx::hash
+{
+    struct md5_hash;
+
+    bool operator == (const md5_hash& a, const md5_hash& b);
+    bool operator != (const md5_hash& a, const md5_hash& b);
+    bool operator <  (const md5_hash& a, const md5_hash& b);
+    bool operator >  (const md5_hash& a, const md5_hash& b);
+    bool operator <= (const md5_hash& a, const md5_hash& b);
+    bool operator >= (const md5_hash& a, const md5_hash& b);
+
+    struct md5_hash
+    {
+        uint32_t a, b, c, d;
+
+        md5_hash() = default;
+        md5_hash(const void* data, size_t size);
+        md5_hash(std::initializer_list<uint32_t> elems);
+    };
+
+    // Computes a hash incrementally, so that data can be hashed as it arrives.
+    class md5_hasher
+    {
+    public:
+        md5_hasher() noexcept;
+
+    public:
+        void update(const void* data, size_t size) noexcept;
+        md5_hash finish() noexcept;
+
+    private:
+        void transform(const unsigned char* block) noexcept;
+
+    private:
+        uint32_t _state[4];
+        uint64_t _size = 0;
+        unsigned char _buffer[64];
+    };
+
+    inline bool operator == (const md5_hash& a, const md5_hash& b)
+    {
+        return a.a == b.a && a.b == b.b && a.c == b.c && a.d == b.d;
+    }
+
+    inline bool operator != (const md5_hash& a, const md5_hash& b)
+    {
+        return !(a == b);
+    }
+
+    inline bool operator < (const md5_hash& a, const md5_hash& b)
+    {
+        return a.d < b.d ? true
+            : a.d > b.d ? false
+            : a.c < b.c ? true
+            : a.c > b.c ? false
+            : a.b < b.b ? true
+            : a.b > b.b ? false
+            : a.a < b.a;
+    }
+
+    inline bool operator > (const md5_hash& a, const md5_hash& b)
+    {
+        return b < a;
+    }
+
+    inline bool operator <= (const md5_hash& a, const md5_hash& b)
+    {
+        return !(b < a);
+    }
+
+    inline bool operator >= (const md5_hash& a, const md5_hash& b)
+    {
+        return !(a < b);
+    }
+}
+
+#endif
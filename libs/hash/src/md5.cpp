@@ -0,0 +1,157 @@
+#include <hash/md5.h>
+
+#include <algorithm>
+#include <stdexcept>
+
+
+namespace wcdx::hash
+{
+    namespace
+    {
+        constexpr uint32_t initial_state[4] = { 0x67452301, 0xEFCDAB89, 0x98BADCFE, 0x10325476 };
+
+        // Per-round shift amounts and the additive constants floor(abs(sin(i + 1)) * 2^32), from RFC 1321.
+        constexpr unsigned shifts[64] =
+        {
+            7, 12, 17, 22, 7, 12, 17, 22, 7, 12, 17, 22, 7, 12, 17, 22,
+            5,  9, 14, 20, 5,  9, 14, 20, 5,  9, 14, 20, 5,  9, 14, 20,
+            4, 11, 16, 23, 4, 11, 16, 23, 4, 11, 16, 23, 4, 11, 16, 23,
+            6, 10, 15, 21, 6, 10, 15, 21, 6, 10, 15, 21, 6, 10, 15, 21
+        };
+
+        constexpr uint32_t constants[64] =
+        {
+            0xD76AA478, 0xE8C7B756, 0x242070DB, 0xC1BDCEEE, 0xF57C0FAF, 0x4787C62A, 0xA8304613, 0xFD469501,
+            0x698098D8, 0x8B44F7AF, 0xFFFF5BB1, 0x895CD7BE, 0x6B901122, 0xFD987193, 0xA679438E, 0x49B40821,
+            0xF61E2562, 0xC040B340, 0x265E5A51, 0xE9B6C7AA, 0xD62F105D, 0x02441453, 0xD8A1E681, 0xE7D3FBC8,
+            0x21E1CDE6, 0xC33707D6, 0xF4D50D87, 0x455A14ED, 0xA9E3E905, 0xFCEFA3F8, 0x676F02D9, 0x8D2A4C8A,
+            0xFFFA3942, 0x8771F681, 0x6D9D6122, 0xFDE5380C, 0xA4BEEA44, 0x4BDECFA9, 0xF6BB4B60, 0xBEBFBC70,
+            0x289B7EC6, 0xEAA127FA, 0xD4EF3085, 0x04881D05, 0xD9D4D039, 0xE6DB99E5, 0x1FA27CF8, 0xC4AC5665,
+            0xF4292244, 0x432AFF97, 0xAB9423A7, 0xFC93A039, 0x655B59C3, 0x8F0CCC92, 0xFFEFF47D, 0x85845DD1,
+            0x6FA87E4F, 0xFE2CE6E0, 0xA3014314, 0x4E0811A1, 0xF7537E82, 0xBD3AF235, 0x2AD7D2BB, 0xEB86D391
+        };
+
+        uint32_t rotate_left(uint32_t value, unsigned count) noexcept
+        {
+            return (value << count) | (value >> (32 - count));
+        }
+    }
+
+    md5_hash::md5_hash(const void* data, size_t size)
+    {
+        md5_hasher hasher;
+        hasher.update(data, size);
+        *this = hasher.finish();
+    }
+
+    md5_hash::md5_hash(std::initializer_list<uint32_t> elems)
+    {
+        if (elems.size() != 4)
+            throw std::invalid_argument("md5_hash must be initialized with four values");
+
+        auto i = begin(elems);
+        a = *i++;
+        b = *i++;
+        c = *i++;
+        d = *i;
+    }
+
+    md5_hasher::md5_hasher() noexcept
+    {
+        std::copy(std::begin(initial_state), std::end(initial_state), _state);
+    }
+
+    void md5_hasher::update(const void* data, size_t size) noexcept
+    {
+        auto p = static_cast<const unsigned char*>(data);
+        auto buffered = size_t(_size % 64);
+        _size += size;
+
+        // Top up a partial block left over from the last update first.
+        if (buffered != 0)
+        {
+            auto count = std::min(size, 64 - buffered);
+            std::copy_n(p, count, _buffer + buffered);
+            p += count;
+            size -= count;
+            if (buffered + count != 64)
+                return;
+            transform(_buffer);
+        }
+
+        // Whole blocks are hashed straight from the caller's data.
+        for (; size >= 64; p += 64, size -= 64)
+            transform(p);
+
+        std::copy_n(p, size, _buffer);
+    }
+
+    md5_hash md5_hasher::finish() noexcept
+    {
+        // Pad with a single 1 bit and then zeros up to 56 bytes into a block,
+        // followed by the message length in bits.
+        auto bit_count = _size * 8;
+        unsigned char padding[72] = { 0x80 };
+        auto padding_size = 64 - ((_size + 8) % 64) + 8;
+        for (unsigned n = 0; n != 8; ++n)
+            padding[padding_size - 8 + n] = static_cast<unsigned char>(bit_count >> (8 * n));
+        update(padding, padding_size);
+
+        md5_hash hash;
+        hash.a = _state[0];
+        hash.b = _state[1];
+        hash.c = _state[2];
+        hash.d = _state[3];
+        return hash;
+    }
+
+    void md5_hasher::transform(const unsigned char* block) noexcept
+    {
+        uint32_t words[16];
+        for (unsigned n = 0; n != 16; ++n)
+        {
+            words[n] = uint32_t(block[4 * n]) | (uint32_t(block[4 * n + 1]) << 8)
+                | (uint32_t(block[4 * n + 2]) << 16) | (uint32_t(block[4 * n + 3]) << 24);
+        }
+
+        auto a = _state[0];
+        auto b = _state[1];
+        auto c = _state[2];
+        auto d = _state[3];
+        for (unsigned n = 0; n != 64; ++n)
+        {
+            uint32_t f;
+            unsigned g;
+            switch (n / 16)
+            {
+            case 0:
+                f = (b & c) | (~b & d);
+                g = n;
+                break;
+            case 1:
+                f = (d & b) | (~d & c);
+                g = (5 * n + 1) % 16;
+                break;
+            case 2:
+                f = b ^ c ^ d;
+                g = (3 * n + 5) % 16;
+                break;
+            default:
+                f = c ^ (b | ~d);
+                g = (7 * n) % 16;
+                break;
+            }
+
+            auto next = b + rotate_left(a + f + constants[n] + words[g], shifts[n]);
+            a = d;
+            d = c;
+            c = b;
+            b = next;
+        }
+
+        _state[0] += a;
+        _state[1] += b;
+        _state[2] += c;
+        _state[3] += d;
+    }
+}
@@ -1,13 +1,15 @@
+#ifndef IMAGE_IMAGE_INCLUDED
+#define IMAGE_IMAGE_INCLUDED
+#pragma once
+
 #include <cstddef>
 
 
 namespace stdext
 {
     template <class T> class array_view;
-    template <class... Interfaces> class multi_ref;
     class input_stream;
     class output_stream;
-    class seekable;
 }
 
 namespace wcdx::image
@@ -18,5 +20,19 @@ namespace wcdx::image
         unsigned height;
     };
 
-    void write_image(const image_descriptor& descriptor, stdext::array_view<const std::byte> palette, stdext::input_stream& pixels, stdext::multi_ref<stdext::output_stream, stdext::seekable> out);
+    // Trades encoding speed for output size.
+    enum class compression
+    {
+        none,   // stored deflate blocks; no compression at all
+        fast,   // runs of repeated pixels only; suited to batch extraction
+        best    // full LZ77 match search
+    };
+
+    // Writes an 8-bit indexed PNG.  The palette holds 256 RGB triples; the last
+    // entry is transparent.  Rows are read from pixels as they're encoded.
+    // Throws std::runtime_error, before anything is written, if either
+    // dimension is zero.
+    void write_image(const image_descriptor& descriptor, stdext::array_view<const std::byte> palette, stdext::input_stream& pixels, stdext::output_stream& out, compression level = compression::best);
 }
+
+#endif
@@ -0,0 +1,110 @@
+#ifndef IMAGE_IMAGE_CACHE_INCLUDED
+#define IMAGE_IMAGE_CACHE_INCLUDED
+#pragma once
+
+#include <image/sprite.h>
+
+#include <stdext/array_view.h>
+
+#include <vector>
+
+#include <cstddef>
+#include <cstdint>
+
+
+namespace stdext
+{
+    class output_stream;
+}
+
+namespace wcdx::image
+{
+    // An image cache holds sprites pre-decoded into rows of runs that can be
+    // drawn without any further parsing (see doc/cachedimage.txt):
+    //
+    //      char version[4];        // "1.00"
+    //      uint32_t count;
+    //      struct
+    //      {
+    //          uint32_t offset;    // from the start of the file
+    //          uint32_t reserved;
+    //      } image_info[count];
+    //
+    // followed by the images, each a header:
+    //
+    //      uint16_t height;
+    //      uint16_t width;
+    //      int16_t reference_y;
+    //      int16_t reference_x;
+    //      int32_t left;           // -reference_x
+    //      int32_t top;            // -reference_y
+    //      int32_t right;          // width - reference_x
+    //      int32_t bottom;         // height - reference_y
+    //
+    // and one line of runs per row, each line ending with a zero byte:
+    //
+    //      1, n        n transparent pixels
+    //      2n, x       n pixels of color x
+    //      2n + 1, ... n literal pixels
+    //
+    // Transparency at the end of a row is implied.  All values are
+    // little-endian.
+    constexpr char image_cache_version[4] = { '1', '.', '0', '0' };
+    constexpr size_t image_cache_header_size = 8;
+    constexpr size_t image_cache_info_size = 8;
+    constexpr size_t cached_image_header_size = 24;
+
+    // A cached image, pointing into the cache it came from.  size counts the
+    // bytes from data to the end of the cache; the rows use some or all of
+    // them.
+    struct cached_image
+    {
+        unsigned width;
+        unsigned height;
+        int reference_x;
+        int reference_y;
+        const std::byte* data;
+        size_t size;
+    };
+
+    bool is_image_cache(stdext::array_view<const std::byte> data) noexcept;
+
+    // Reads a cache in place, typically from a mapped file, which must
+    // outlive it.  Images are not copied or decoded until they are drawn.
+    class image_cache
+    {
+    public:
+        // Throws std::runtime_error if the header or image table is invalid.
+        explicit image_cache(stdext::array_view<const std::byte> data);
+
+    public:
+        size_t size() const noexcept { return _count; }
+
+        // Throws std::range_error if index is out of range, and
+        // std::runtime_error if the image header is invalid.
+        cached_image image(size_t index) const;
+
+    private:
+        stdext::array_view<const std::byte> _data;
+        size_t _count;
+    };
+
+    // Throws std::range_error if the sprite is too large for the format.
+    std::vector<std::byte> encode_cached_image(const sprite& image);
+
+    // Writes a cache holding images produced by encode_cached_image.  Throws
+    // std::range_error if the cache would be larger than 4GB.
+    void write_image_cache(stdext::array_view<const std::vector<std::byte>> images, stdext::output_stream& output);
+
+    // Draws an image with its reference point at (x, y) into an 8-bit target
+    // of width x height pixels, clipped to the target's edges.  Pixels under
+    // transparent runs are left as they were.  Throws std::runtime_error if
+    // the image data is damaged.
+    void draw_cached_image(const cached_image& image, int x, int y, std::byte* target, size_t pitch, unsigned width, unsigned height);
+
+    // Draws an image onto a transparent background of its own size, giving
+    // the same result as decode_sprite gives for the original.
+    sprite decode_cached_image(const cached_image& image);
+}
+
+#endif
@@ -0,0 +1,51 @@
+#ifndef IMAGE_PALETTE_QUANTIZER_INCLUDED
+#define IMAGE_PALETTE_QUANTIZER_INCLUDED
+#pragma once
+
+#include <memory>
+
+#include <cstddef>
+#include <cstdint>
+
+
+namespace stdext
+{
+    template <class T> class array_view;
+}
+
+namespace wcdx::image
+{
+    // Maps colors to the nearest entry of a game palette.  The color cube is
+    // divided into cells, and each cell keeps the few palette entries that
+    // can be nearest to some color inside it, so a lookup compares against a
+    // handful of entries instead of all 255.  The tables are built once and
+    // never change, so one quantizer can be shared by any number of threads.
+    class palette_quantizer
+    {
+    public:
+        // The palette holds 256 RGB triples; the last entry is transparent
+        // and is never chosen for an opaque color.
+        explicit palette_quantizer(stdext::array_view<const std::byte> palette);
+        palette_quantizer(const palette_quantizer&) = delete;
+        palette_quantizer& operator = (const palette_quantizer&) = delete;
+
+    public:
+        // Ties go to the lowest index.
+        std::byte nearest(uint8_t red, uint8_t green, uint8_t blue) const noexcept;
+
+        // Converts pixels stored as blue, green, red, alpha bytes.  Pixels
+        // less than half opaque become transparent.
+        void quantize(const std::byte* bgra, size_t count, std::byte* out) const noexcept;
+
+    private:
+        static constexpr unsigned cell_bits = 5;
+        static constexpr unsigned cell_count = 1 << (3 * cell_bits);
+        static constexpr unsigned color_count = 255;
+
+        uint8_t _colors[color_count][3];
+        std::unique_ptr<uint32_t[]> _cell_first;    // cell_count + 1 offsets into _candidates
+        std::unique_ptr<uint8_t[]> _candidates;
+    };
+}
+
+#endif
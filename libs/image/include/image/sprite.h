@@ -0,0 +1,39 @@
+#ifndef IMAGE_SPRITE_INCLUDED
+#define IMAGE_SPRITE_INCLUDED
+#pragma once
+
+#include <image/image.h>
+
+#include <memory>
+#include <vector>
+
+#include <cstddef>
+
+
+namespace wcdx::image
+{
+    // Pixels not covered by any segment of a sprite are transparent.
+    constexpr std::byte transparent_index = std::byte(0xFF);
+
+    // An image from a Wing Commander image archive.  On disk, a sprite is a
+    // header giving its extents around the reference point, followed by
+    // horizontal segments of pixels that may be run-length coded.
+    struct sprite
+    {
+        image_descriptor descriptor;
+        int reference_x;
+        int reference_y;
+        std::unique_ptr<std::byte[]> pixels;
+    };
+
+    // Throws std::runtime_error if the data doesn't describe a valid sprite.
+    sprite decode_sprite(stdext::input_stream& input);
+
+    // Produces the smallest encoding that decode_sprite reads back exactly.
+    // Each horizontal span of opaque pixels becomes one segment, coded as a
+    // mix of literal and fill runs wherever that beats storing it verbatim.
+    // Throws std::range_error if the sprite is too large for the format.
+    std::vector<std::byte> encode_sprite(const sprite& image);
+}
+
+#endif
@@ -0,0 +1,76 @@
+#include "checksum.h"
+
+#include <array>
+
+
+namespace wcdx::image
+{
+    namespace
+    {
+        // Four tables let the CRC loop consume a 32-bit word per step.
+        using crc_tables = std::array<std::array<uint32_t, 256>, 4>;
+
+        constexpr crc_tables make_crc_tables() noexcept
+        {
+            crc_tables tables = { };
+            for (uint32_t n = 0; n != 256; ++n)
+            {
+                auto c = n;
+                for (unsigned k = 0; k != 8; ++k)
+                    c = (c & 1) != 0 ? 0xEDB88320 ^ (c >> 1) : c >> 1;
+                tables[0][n] = c;
+            }
+
+            for (unsigned t = 1; t != tables.size(); ++t)
+            {
+                for (unsigned n = 0; n != 256; ++n)
+                    tables[t][n] = tables[0][tables[t - 1][n] & 0xFF] ^ (tables[t - 1][n] >> 8);
+            }
+
+            return tables;
+        }
+
+        constexpr auto crc_table = make_crc_tables();
+
+        // The largest number of bytes that can be summed before the Adler-32
+        // sums must be reduced to avoid overflowing 32 bits.
+        constexpr size_t adler_block_size = 5552;
+        constexpr uint32_t adler_modulus = 65521;
+    }
+
+    uint32_t update_crc32(uint32_t crc, const std::byte* data, size_t size) noexcept
+    {
+        auto c = ~crc;
+        for (; size >= 4; size -= 4, data += 4)
+        {
+            c ^= uint32_t(data[0]) | (uint32_t(data[1]) << 8) | (uint32_t(data[2]) << 16) | (uint32_t(data[3]) << 24);
+            c = crc_table[3][c & 0xFF] ^ crc_table[2][(c >> 8) & 0xFF] ^ crc_table[1][(c >> 16) & 0xFF] ^ crc_table[0][c >> 24];
+        }
+
+        for (; size != 0; --size, ++data)
+            c = crc_table[0][(c ^ uint32_t(*data)) & 0xFF] ^ (c >> 8);
+
+        return ~c;
+    }
+
+    uint32_t update_adler32(uint32_t adler, const std::byte* data, size_t size) noexcept
+    {
+        uint32_t a = adler & 0xFFFF;
+        uint32_t b = adler >> 16;
+        while (size != 0)
+        {
+            auto block = size < adler_block_size ? size : adler_block_size;
+            size -= block;
+            for (; block != 0; --block)
+            {
+                a += uint32_t(*data++);
+                b += a;
+            }
+
+            a %= adler_modulus;
+            b %= adler_modulus;
+        }
+
+        return a | (b << 16);
+    }
+}
@@ -0,0 +1,21 @@
+#ifndef IMAGE_CHECKSUM_INCLUDED
+#define IMAGE_CHECKSUM_INCLUDED
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+
+namespace wcdx::image
+{
+    // CRC-32 as used by PNG chunks and Adler-32 as used by zlib streams.  Both
+    // take the running value from a previous call; start with the initial
+    // value for a new checksum.
+    constexpr uint32_t crc32_initial = 0;
+    constexpr uint32_t adler32_initial = 1;
+
+    uint32_t update_crc32(uint32_t crc, const std::byte* data, size_t size) noexcept;
+    uint32_t update_adler32(uint32_t adler, const std::byte* data, size_t size) noexcept;
+}
+
+#endif
@@ -0,0 +1,657 @@
+#include "deflate.h"
+
+#include "checksum.h"
+
+#include <algorithm>
+#include <array>
+#include <iterator>
+
+#include <cassert>
+
+
+namespace wcdx::image
+{
+    namespace
+    {
+        constexpr size_t window_size = 32768;
+        constexpr size_t block_input_size = 65536;
+        constexpr unsigned min_match = 3;
+        constexpr unsigned max_match = 258;
+
+        constexpr unsigned hash_bits = 15;
+        constexpr uint32_t hash_mask = (1u << hash_bits) - 1;
+
+        // Search effort for compression::best.  Matches at least as long as
+        // good_length aren't checked for a better match at the next byte, and
+        // the chain search stops early at nice_length.
+        constexpr unsigned max_chain = 128;
+        constexpr unsigned good_length = 32;
+        constexpr unsigned nice_length = 128;
+
+        // Symbols 286 and 287 are never used, but they're part of the fixed
+        // literal/length code, whose codes depend on them.
+        constexpr unsigned literal_codes = 286;
+        constexpr unsigned fixed_literal_codes = 288;
+        constexpr unsigned distance_codes = 30;
+        constexpr unsigned length_codes = 19;
+        constexpr unsigned end_of_block = 256;
+        constexpr unsigned max_code_length = 15;
+        constexpr unsigned max_length_code_length = 7;
+
+        constexpr uint16_t length_base[29] =
+        {
+            3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31,
+            35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258
+        };
+        constexpr uint8_t length_extra[29] =
+        {
+            0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2,
+            3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0
+        };
+        constexpr uint16_t distance_base[30] =
+        {
+            1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193,
+            257, 385, 513, 769, 1025, 1537, 2049, 3073, 4097, 6145, 8193, 12289, 16385, 24577
+        };
+        constexpr uint8_t distance_extra[30] =
+        {
+            0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6,
+            7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13
+        };
+        constexpr uint8_t length_code_order[length_codes] =
+        {
+            16, 17, 18, 0, 8, 7, 9, 6, 10, 5, 11, 4, 12, 3, 13, 2, 14, 1, 15
+        };
+
+        // Maps a match length to its length code (less 257).
+        constexpr auto length_code_table = []
+        {
+            std::array<uint8_t, max_match + 1> table = { };
+            for (unsigned code = 0; code != std::size(length_base); ++code)
+            {
+                for (unsigned n = 0; n != (1u << length_extra[code]) && length_base[code] + n <= max_match; ++n)
+                    table[length_base[code] + n] = uint8_t(code);
+            }
+            table[max_match] = uint8_t(std::size(length_base) - 1);
+            return table;
+        }();
+
+        // Maps distance - 1 to its distance code; distances above 256 are
+        // looked up by (distance - 1) / 128, offset by 256.
+        constexpr auto distance_code_table = []
+        {
+            std::array<uint8_t, 512> table = { };
+            for (unsigned code = 0; code != std::size(distance_base); ++code)
+            {
+                for (unsigned n = 0; n != (1u << distance_extra[code]); ++n)
+                {
+                    unsigned d = distance_base[code] + n - 1;
+                    table[d < 256 ? d : 256 + (d >> 7)] = uint8_t(code);
+                }
+            }
+            return table;
+        }();
+
+        unsigned length_code(unsigned length) noexcept
+        {
+            return length_code_table[length];
+        }
+
+        unsigned distance_code(unsigned distance) noexcept
+        {
+            --distance;
+            return distance_code_table[distance < 256 ? distance : 256 + (distance >> 7)];
+        }
+
+        unsigned fixed_literal_length(unsigned symbol) noexcept
+        {
+            return symbol < 144 ? 8 : symbol < 256 ? 9 : symbol < 280 ? 7 : 8;
+        }
+
+        constexpr unsigned fixed_distance_length = 5;
+
+        // Computes Huffman code lengths no longer than limit for the given
+        // symbol frequencies.  Codes that would be too long are avoided by
+        // flattening the frequencies and trying again.
+        void build_code_lengths(const uint32_t* frequencies, unsigned count, unsigned limit, uint8_t* lengths)
+        {
+            std::vector<uint32_t> weights(frequencies, frequencies + count);
+            std::vector<unsigned> symbols;
+            std::vector<uint32_t> node_weights;
+            std::vector<unsigned> parents;
+            while (true)
+            {
+                std::fill_n(lengths, count, uint8_t(0));
+
+                symbols.clear();
+                for (unsigned n = 0; n != count; ++n)
+                {
+                    if (weights[n] != 0)
+                        symbols.push_back(n);
+                }
+                if (symbols.empty())
+                    return;
+                if (symbols.size() == 1)
+                {
+                    lengths[symbols[0]] = 1;
+                    return;
+                }
+
+                std::stable_sort(symbols.begin(), symbols.end(), [&](unsigned a, unsigned b) { return weights[a] < weights[b]; });
+
+                // Two-queue construction: leaves in weight order, followed by
+                // internal nodes, which are created in weight order too.
+                auto leaf_count = symbols.size();
+                node_weights.resize(2 * leaf_count - 1);
+                parents.assign(2 * leaf_count - 1, 0);
+                for (size_t n = 0; n != leaf_count; ++n)
+                    node_weights[n] = weights[symbols[n]];
+
+                size_t next_leaf = 0;
+                size_t next_internal = leaf_count;
+                auto take = [&](size_t end)
+                {
+                    if (next_leaf < leaf_count && (next_internal == end || node_weights[next_leaf] <= node_weights[next_internal]))
+                        return next_leaf++;
+                    return next_internal++;
+                };
+
+                for (auto node = leaf_count; node != node_weights.size(); ++node)
+                {
+                    auto a = take(node);
+                    auto b = take(node);
+                    node_weights[node] = node_weights[a] + node_weights[b];
+                    parents[a] = unsigned(node);
+                    parents[b] = unsigned(node);
+                }
+
+                // Depths, from the root down; the root is the last node.
+                std::vector<unsigned> depths(node_weights.size(), 0);
+                unsigned max_depth = 0;
+                for (auto node = node_weights.size() - 1; node-- != 0; )
+                {
+                    depths[node] = depths[parents[node]] + 1;
+                    max_depth = std::max(max_depth, depths[node]);
+                }
+
+                if (max_depth <= limit)
+                {
+                    for (size_t n = 0; n != leaf_count; ++n)
+                        lengths[symbols[n]] = uint8_t(depths[n]);
+                    return;
+                }
+
+                for (auto& weight : weights)
+                {
+                    if (weight != 0)
+                        weight = (weight >> 1) | 1;
+                }
+            }
+        }
+
+        // Computes canonical codes for the given lengths, bit-reversed so that
+        // they can be written least significant bit first.
+        void build_codes(const uint8_t* lengths, unsigned count, uint16_t* codes) noexcept
+        {
+            unsigned length_counts[max_code_length + 1] = { };
+            for (unsigned n = 0; n != count; ++n)
+                ++length_counts[lengths[n]];
+            length_counts[0] = 0;
+
+            unsigned next_code[max_code_length + 1] = { };
+            unsigned code = 0;
+            for (unsigned bits = 1; bits <= max_code_length; ++bits)
+            {
+                code = (code + length_counts[bits - 1]) << 1;
+                next_code[bits] = code;
+            }
+
+            for (unsigned n = 0; n != count; ++n)
+            {
+                auto length = lengths[n];
+                if (length == 0)
+                {
+                    codes[n] = 0;
+                    continue;
+                }
+
+                auto value = next_code[length]++;
+                unsigned reversed = 0;
+                for (unsigned bit = 0; bit != length; ++bit)
+                    reversed |= ((value >> bit) & 1) << (length - 1 - bit);
+                codes[n] = uint16_t(reversed);
+            }
+        }
+
+        // Deflate decoders differ in how they treat codes with fewer than two
+        // symbols, so there are always at least two.
+        void ensure_two_symbols(uint32_t* frequencies, unsigned count) noexcept
+        {
+            auto used = std::count_if(frequencies, frequencies + count, [](uint32_t f) { return f != 0; });
+            for (unsigned n = 0; used < 2 && n != count; ++n)
+            {
+                if (frequencies[n] == 0)
+                {
+                    frequencies[n] = 1;
+                    ++used;
+                }
+            }
+        }
+
+        // The code length sequence of a dynamic block header, run-length coded
+        // with symbols 16 (repeat previous), 17 and 18 (repeat zero).
+        struct length_symbol
+        {
+            uint8_t symbol;
+            uint8_t extra;
+        };
+
+        void encode_code_lengths(const uint8_t* lengths, unsigned count, std::vector<length_symbol>& symbols)
+        {
+            symbols.clear();
+            for (unsigned n = 0; n != count; )
+            {
+                auto length = lengths[n];
+                unsigned run = 1;
+                while (n + run != count && lengths[n + run] == length)
+                    ++run;
+                n += run;
+
+                if (length == 0)
+                {
+                    while (run >= 11)
+                    {
+                        auto repeat = std::min(run, 138u);
+                        symbols.push_back({ 18, uint8_t(repeat - 11) });
+                        run -= repeat;
+                    }
+                    if (run >= 3)
+                    {
+                        symbols.push_back({ 17, uint8_t(run - 3) });
+                        run = 0;
+                    }
+                }
+                else if (run >= 4)
+                {
+                    symbols.push_back({ length, 0 });
+                    --run;
+                    while (run >= 3)
+                    {
+                        auto repeat = std::min(run, 6u);
+                        symbols.push_back({ 16, uint8_t(repeat - 3) });
+                        run -= repeat;
+                    }
+                }
+
+                for (; run != 0; --run)
+                    symbols.push_back({ length, 0 });
+            }
+        }
+
+        unsigned length_symbol_extra_bits(unsigned symbol) noexcept
+        {
+            return symbol == 16 ? 2 : symbol == 17 ? 3 : symbol == 18 ? 7 : 0;
+        }
+    }
+
+    zlib_encoder::zlib_encoder(compression level)
+        : _level(level), _adler(adler32_initial)
+    {
+        _buffer.reserve(window_size + block_input_size + max_match);
+        if (_level == compression::best)
+        {
+            _head.assign(size_t(1) << hash_bits, 0);
+            _prev.assign(window_size, 0);
+        }
+
+        // CMF: deflate with a 32 KiB window; FLG: the compression level, with
+        // check bits making the header a multiple of 31.
+        static constexpr uint8_t level_flags[] = { 0x01, 0x5E, 0xDA };
+        _output.push_back(std::byte(0x78));
+        _output.push_back(std::byte(level_flags[unsigned(_level)]));
+    }
+
+    void zlib_encoder::write(const std::byte* data, size_t size)
+    {
+        assert(!_finished);
+
+        _adler = update_adler32(_adler, data, size);
+        while (size != 0)
+        {
+            // Keep enough input past the end of a block for the longest match.
+            auto capacity = window_size + block_input_size + max_match;
+            auto count = std::min(size, capacity - _buffer.size());
+            _buffer.insert(_buffer.end(), data, data + count);
+            data += count;
+            size -= count;
+
+            if (_buffer.size() == capacity)
+                compress(_pending + block_input_size, false);
+        }
+    }
+
+    void zlib_encoder::finish()
+    {
+        if (_finished)
+            return;
+
+        compress(_buffer.size(), true);
+        align();
+        for (unsigned shift = 32; shift != 0; shift -= 8)
+            _output.push_back(std::byte(_adler >> (shift - 8)));
+        _finished = true;
+    }
+
+    void zlib_encoder::compress(size_t end, bool final)
+    {
+        auto begin = _pending;
+        switch (_level)
+        {
+        case compression::none:
+            write_stored(begin, end, final);
+            break;
+
+        case compression::fast:
+            end = tokenize_runs(begin, end);
+            write_block(begin, end, final);
+            break;
+
+        case compression::best:
+            end = tokenize_matches(begin, end);
+            write_block(begin, end, final);
+            break;
+        }
+        _pending = end;
+
+        // Slide the window.
+        if (_pending > window_size)
+        {
+            auto discard = _pending - window_size;
+            _buffer.erase(_buffer.begin(), _buffer.begin() + discard);
+            _base += discard;
+            _pending -= discard;
+        }
+    }
+
+    size_t zlib_encoder::tokenize_runs(size_t begin, size_t end)
+    {
+        // Only matches against the immediately preceding byte are considered,
+        // which is all it takes to catch the long runs in sprite data.
+        _tokens.clear();
+        auto data = _buffer.data();
+        auto pos = begin;
+        while (pos < end)
+        {
+            if (pos != 0 && data[pos] == data[pos - 1])
+            {
+                auto limit = std::min<size_t>(max_match, _buffer.size() - pos);
+                unsigned length = 1;
+                while (length != limit && data[pos + length] == data[pos - 1])
+                    ++length;
+
+                if (length >= min_match)
+                {
+                    _tokens.push_back({ uint16_t(length), 1 });
+                    pos += length;
+                    continue;
+                }
+            }
+
+            _tokens.push_back({ uint16_t(data[pos]), 0 });
+            ++pos;
+        }
+
+        return pos;
+    }
+
+    size_t zlib_encoder::tokenize_matches(size_t begin, size_t end)
+    {
+        _tokens.clear();
+        auto pos = begin;
+        while (pos < end)
+        {
+            auto found = find_match(pos, max_chain);
+            if (found.length >= min_match && found.length < good_length && pos + 1 < end)
+            {
+                // Lazy evaluation: prefer a literal followed by a longer match.
+                auto next = find_match(pos + 1, max_chain / 4);
+                if (next.length > found.length)
+                {
+                    _tokens.push_back({ uint16_t(_buffer[pos]), 0 });
+                    ++pos;
+                    found = next;
+                }
+            }
+
+            if (found.length >= min_match)
+            {
+                _tokens.push_back({ uint16_t(found.length), uint16_t(found.distance) });
+                pos += found.length;
+            }
+            else
+            {
+                _tokens.push_back({ uint16_t(_buffer[pos]), 0 });
+                ++pos;
+            }
+        }
+
+        return pos;
+    }
+
+    auto zlib_encoder::find_match(size_t pos, unsigned chain) -> match
+    {
+        insert_hashes(pos);
+
+        auto data = _buffer.data();
+        auto limit = unsigned(std::min<size_t>(max_match, _buffer.size() - pos));
+        if (limit < min_match)
+            return { 0, 0 };
+
+        auto hash = ((uint32_t(data[pos]) << 10) ^ (uint32_t(data[pos + 1]) << 5) ^ uint32_t(data[pos + 2])) & hash_mask;
+        auto position = _base + pos;
+        match best = { 0, 0 };
+        for (auto entry = _head[hash]; entry != 0 && chain != 0; entry = _prev[(entry - 1) & (window_size - 1)], --chain)
+        {
+            auto candidate = entry - 1;
+            auto distance = position - candidate;
+            if (distance > window_size)
+                break;
+
+            auto p = data + (candidate - _base);
+            auto q = data + pos;
+            if (p[best.length] != q[best.length] || p[0] != q[0])
+                continue;
+
+            unsigned length = 0;
+            while (length != limit && p[length] == q[length])
+                ++length;
+
+            if (length > best.length)
+            {
+                best = { length, unsigned(distance) };
+                if (length >= nice_length || length == limit)
+                    break;
+            }
+        }
+
+        return best;
+    }
+
+    void zlib_encoder::insert_hashes(size_t end) noexcept
+    {
+        // Positions are hashed lazily, up to (but not including) end.
+        auto data = _buffer.data();
+        for (; _hashed < _base + end; ++_hashed)
+        {
+            auto pos = size_t(_hashed - _base);
+            if (pos + min_match > _buffer.size())
+                continue;
+
+            auto hash = ((uint32_t(data[pos]) << 10) ^ (uint32_t(data[pos + 1]) << 5) ^ uint32_t(data[pos + 2])) & hash_mask;
+            _prev[_hashed & (window_size - 1)] = _head[hash];
+            _head[hash] = uint32_t(_hashed + 1);
+        }
+    }
+
+    void zlib_encoder::write_block(size_t begin, size_t end, bool final)
+    {
+        uint32_t literal_frequencies[literal_codes] = { };
+        uint32_t distance_frequencies[distance_codes] = { };
+        uint64_t extra_bits = 0;
+        for (auto& t : _tokens)
+        {
+            if (t.distance == 0)
+                ++literal_frequencies[t.length];
+            else
+            {
+                auto lcode = length_code(t.length);
+                auto dcode = distance_code(t.distance);
+                ++literal_frequencies[257 + lcode];
+                ++distance_frequencies[dcode];
+                extra_bits += length_extra[lcode] + distance_extra[dcode];
+            }
+        }
+        literal_frequencies[end_of_block] = 1;
+        ensure_two_symbols(literal_frequencies, literal_codes);
+        ensure_two_symbols(distance_frequencies, distance_codes);
+
+        uint8_t literal_lengths[fixed_literal_codes];
+        uint8_t distance_lengths[distance_codes];
+        build_code_lengths(literal_frequencies, literal_codes, max_code_length, literal_lengths);
+        build_code_lengths(distance_frequencies, distance_codes, max_code_length, distance_lengths);
+
+        unsigned literal_count = literal_codes;
+        while (literal_count > 257 && literal_lengths[literal_count - 1] == 0)
+            --literal_count;
+        unsigned distance_count = distance_codes;
+        while (distance_count > 1 && distance_lengths[distance_count - 1] == 0)
+            --distance_count;
+
+        uint8_t all_lengths[literal_codes + distance_codes];
+        std::copy_n(literal_lengths, literal_count, all_lengths);
+        std::copy_n(distance_lengths, distance_count, all_lengths + literal_count);
+        std::vector<length_symbol> length_symbols;
+        encode_code_lengths(all_lengths, literal_count + distance_count, length_symbols);
+
+        uint32_t length_frequencies[length_codes] = { };
+        for (auto& s : length_symbols)
+            ++length_frequencies[s.symbol];
+        uint8_t length_lengths[length_codes];
+        build_code_lengths(length_frequencies, length_codes, max_length_code_length, length_lengths);
+
+        unsigned length_count = length_codes;
+        while (length_count > 4 && length_lengths[length_code_order[length_count - 1]] == 0)
+            --length_count;
+
+        // Compare the sizes of the three block types.  The stored size counts
+        // the stored block headers and the byte alignment they force.
+        uint64_t fixed_bits = 3 + extra_bits;
+        uint64_t dynamic_bits = 3 + 5 + 5 + 4 + (3 * length_count) + extra_bits;
+        for (unsigned n = 0; n != literal_codes; ++n)
+        {
+            fixed_bits += uint64_t(literal_frequencies[n]) * fixed_literal_length(n);
+            dynamic_bits += uint64_t(literal_frequencies[n]) * literal_lengths[n];
+        }
+        for (unsigned n = 0; n != distance_codes; ++n)
+        {
+            fixed_bits += uint64_t(distance_frequencies[n]) * fixed_distance_length;
+            dynamic_bits += uint64_t(distance_frequencies[n]) * distance_lengths[n];
+        }
+        for (auto& s : length_symbols)
+            dynamic_bits += length_lengths[s.symbol] + length_symbol_extra_bits(s.symbol);
+
+        auto stored_blocks = std::max<uint64_t>(1, (end - begin + 65534) / 65535);
+        uint64_t stored_bits = (stored_blocks * (3 + 7 + 32)) + (8 * uint64_t(end - begin));
+
+        if (stored_bits < std::min(fixed_bits, dynamic_bits))
+        {
+            write_stored(begin, end, final);
+            return;
+        }
+
+        uint16_t literal_codes_table[fixed_literal_codes];
+        uint16_t distance_codes_table[distance_codes];
+        unsigned literal_table_size = literal_codes;
+        if (fixed_bits <= dynamic_bits)
+        {
+            literal_table_size = fixed_literal_codes;
+            for (unsigned n = 0; n != fixed_literal_codes; ++n)
+                literal_lengths[n] = uint8_t(fixed_literal_length(n));
+            std::fill_n(distance_lengths, distance_codes, uint8_t(fixed_distance_length));
+
+            put_bits(final ? 1 : 0, 1);
+            put_bits(1, 2);
+        }
+        else
+        {
+            put_bits(final ? 1 : 0, 1);
+            put_bits(2, 2);
+            put_bits(literal_count - 257, 5);
+            put_bits(distance_count - 1, 5);
+            put_bits(length_count - 4, 4);
+            for (unsigned n = 0; n != length_count; ++n)
+                put_bits(length_lengths[length_code_order[n]], 3);
+
+            uint16_t length_codes_table[length_codes];
+            build_codes(length_lengths, length_codes, length_codes_table);
+            for (auto& s : length_symbols)
+            {
+                put_bits(length_codes_table[s.symbol], length_lengths[s.symbol]);
+                put_bits(s.extra, length_symbol_extra_bits(s.symbol));
+            }
+        }
+        build_codes(literal_lengths, literal_table_size, literal_codes_table);
+        build_codes(distance_lengths, distance_codes, distance_codes_table);
+
+        for (auto& t : _tokens)
+        {
+            if (t.distance == 0)
+            {
+                put_bits(literal_codes_table[t.length], literal_lengths[t.length]);
+                continue;
+            }
+
+            auto lcode = length_code(t.length);
+            auto dcode = distance_code(t.distance);
+            put_bits(literal_codes_table[257 + lcode], literal_lengths[257 + lcode]);
+            put_bits(t.length - length_base[lcode], length_extra[lcode]);
+            put_bits(distance_codes_table[dcode], distance_lengths[dcode]);
+            put_bits(t.distance - distance_base[dcode], distance_extra[dcode]);
+        }
+        put_bits(literal_codes_table[end_of_block], literal_lengths[end_of_block]);
+    }
+
+    void zlib_encoder::write_stored(size_t begin, size_t end, bool final)
+    {
+        do
+        {
+            auto size = std::min<size_t>(end - begin, 65535);
+            put_bits(final && begin + size == end ? 1 : 0, 1);
+            put_bits(0, 2);
+            align();
+
+            put_bits(uint32_t(size), 16);
+            put_bits(uint32_t(~size & 0xFFFF), 16);
+            _output.insert(_output.end(), _buffer.begin() + begin, _buffer.begin() + begin + size);
+            begin += size;
+        } while (begin != end);
+    }
+
+    void zlib_encoder::put_bits(uint32_t value, unsigned count)
+    {
+        _bits |= uint64_t(value) << _bit_count;
+        _bit_count += count;
+        while (_bit_count >= 8)
+        {
+            _output.push_back(std::byte(_bits));
+            _bits >>= 8;
+            _bit_count -= 8;
+        }
+    }
+
+    void zlib_encoder::align()
+    {
+        if (_bit_count != 0)
+            put_bits(0, 8 - _bit_count);
+    }
+}
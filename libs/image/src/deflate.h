@@ -0,0 +1,83 @@
+#ifndef IMAGE_DEFLATE_INCLUDED
+#define IMAGE_DEFLATE_INCLUDED
+#pragma once
+
+#include <image/image.h>
+
+#include <vector>
+
+#include <cstddef>
+#include <cstdint>
+
+
+namespace wcdx::image
+{
+    // Produces a zlib stream (RFC 1950) of deflate data (RFC 1951) from input
+    // supplied in pieces of any size.  Input is compressed in blocks of up to
+    // 64 KiB; each block is written with whichever of stored, fixed Huffman, or
+    // dynamic Huffman coding is smallest.
+    class zlib_encoder
+    {
+    public:
+        explicit zlib_encoder(compression level);
+        zlib_encoder(const zlib_encoder&) = delete;
+        zlib_encoder& operator = (const zlib_encoder&) = delete;
+
+    public:
+        void write(const std::byte* data, size_t size);
+        void finish();
+
+        // Compressed bytes produced so far.  The caller removes whatever it
+        // consumes.
+        std::vector<std::byte>& output() noexcept { return _output; }
+
+    private:
+        struct token
+        {
+            uint16_t length;    // literal byte if distance is zero
+            uint16_t distance;
+        };
+
+        struct match
+        {
+            unsigned length;
+            unsigned distance;
+        };
+
+        void compress(size_t end, bool final);
+        size_t tokenize_runs(size_t begin, size_t end);
+        size_t tokenize_matches(size_t begin, size_t end);
+        match find_match(size_t pos, unsigned max_chain);
+        void insert_hashes(size_t end) noexcept;
+
+        void write_block(size_t begin, size_t end, bool final);
+        void write_stored(size_t begin, size_t end, bool final);
+        void put_bits(uint32_t value, unsigned count);
+        void align();
+
+    private:
+        compression _level;
+
+        // The last 32 KiB of processed input (for matching), followed by input
+        // that hasn't been compressed yet.
+        std::vector<std::byte> _buffer;
+        size_t _pending = 0;
+        uint64_t _base = 0;
+        uint32_t _adler;
+
+        // Hash chains over three-byte prefixes, holding stream positions plus
+        // one so that zero means "none".
+        std::vector<uint32_t> _head;
+        std::vector<uint32_t> _prev;
+        uint64_t _hashed = 0;
+
+        std::vector<token> _tokens;
+
+        uint64_t _bits = 0;
+        unsigned _bit_count = 0;
+        std::vector<std::byte> _output;
+        bool _finished = false;
+    };
+}
+
+#endif
@@ -1,269 +1,136 @@
 #include <image/image.h>
 
+#include "checksum.h"
+#include "deflate.h"
+
 #include <stdext/array_view.h>
-#include <stdext/multi.h>
-#include <stdext/scope_guard.h>
 #include <stdext/stream.h>
-#include <stdext/utility.h>
-
-#include <cassert>
 
-#define NOMINMAX
-#define WIN32_LEAN_AND_MEAN
-#include <comdef.h>
-#include <wincodec.h>
+#include <algorithm>
+#include <memory>
+#include <stdexcept>
+#include <vector>
 
+#include <cassert>
 
-#define COM_REQUIRE_SUCCESS(expr) if (FAILED(hr = (expr))) _com_raise_error(hr)
 
 namespace wcdx::image
 {
     namespace
     {
-        _COM_SMARTPTR_TYPEDEF(IWICImagingFactory, __uuidof(IWICImagingFactory));
-        _COM_SMARTPTR_TYPEDEF(IWICBitmap, __uuidof(IWICBitmap));
-        _COM_SMARTPTR_TYPEDEF(IWICPalette, __uuidof(IWICPalette));
-        _COM_SMARTPTR_TYPEDEF(IWICBitmapLock, __uuidof(IWICBitmapLock));
-        _COM_SMARTPTR_TYPEDEF(IWICStream, __uuidof(IWICStream));
-        _COM_SMARTPTR_TYPEDEF(IWICBitmapEncoder, __uuidof(IWICBitmapEncoder));
-        _COM_SMARTPTR_TYPEDEF(IWICBitmapFrameEncode, __uuidof(IWICBitmapFrameEncode));
-        _COM_SMARTPTR_TYPEDEF(IWICBitmapDecoder, __uuidof(IWICBitmapDecoder));
-        _COM_SMARTPTR_TYPEDEF(IWICBitmapFrameDecode, __uuidof(IWICBitmapFrameDecode));
-        _COM_SMARTPTR_TYPEDEF(IWICFormatConverter, __uuidof(IWICFormatConverter));
+        constexpr std::byte png_signature[] =
+        {
+            std::byte(0x89), std::byte('P'), std::byte('N'), std::byte('G'),
+            std::byte('\r'), std::byte('\n'), std::byte(0x1A), std::byte('\n')
+        };
 
-        class OutputStreamAdapter : public IStream
+        // Compressed data is written out in IDAT chunks of about this size.
+        constexpr size_t idat_size = 32768;
+
+        class png_writer
         {
         public:
-            OutputStreamAdapter(stdext::multi_ref<stdext::output_stream, stdext::seekable>& stream) noexcept
-                : _stream(stream.as<stdext::output_stream>()), _seeker(stream.as<stdext::seekable>()) { }
-            OutputStreamAdapter(const OutputStreamAdapter&) = delete;
-            OutputStreamAdapter& operator = (const OutputStreamAdapter&) = delete;
+            explicit png_writer(stdext::output_stream& out) noexcept : _out(out) { }
+            png_writer(const png_writer&) = delete;
+            png_writer& operator = (const png_writer&) = delete;
 
         public:
-            // IUnknown
-            HRESULT STDMETHODCALLTYPE QueryInterface(REFIID riid, void** ppvObject) override;
-            ULONG STDMETHODCALLTYPE AddRef() override;
-            ULONG STDMETHODCALLTYPE Release() override;
-
-            // ISequentialStream
-            HRESULT STDMETHODCALLTYPE Read(void* pv, ULONG cb, ULONG* pcbRead) override;
-            HRESULT STDMETHODCALLTYPE Write(const void* pv, ULONG cb, ULONG* pcbWritten) override;
+            void write_signature() { _out.write_all(png_signature, std::size(png_signature)); }
+            void write_chunk(const char (&type)[5], const std::byte* data, size_t size);
 
-            // IStream
-            HRESULT STDMETHODCALLTYPE Seek(LARGE_INTEGER dlibMove, DWORD dwOrigin, ULARGE_INTEGER* plibNewPosition) override;
-            HRESULT STDMETHODCALLTYPE SetSize(ULARGE_INTEGER libNewSize) override;
-            HRESULT STDMETHODCALLTYPE CopyTo(IStream* pstm, ULARGE_INTEGER cb, ULARGE_INTEGER* pcbRead, ULARGE_INTEGER* pcbWritten) override;
-            HRESULT STDMETHODCALLTYPE Commit(DWORD grfCommitFlags) override;
-            HRESULT STDMETHODCALLTYPE Revert() override;
-            HRESULT STDMETHODCALLTYPE LockRegion(ULARGE_INTEGER libOffset, ULARGE_INTEGER cb, DWORD dwLockType) override;
-            HRESULT STDMETHODCALLTYPE UnlockRegion(ULARGE_INTEGER libOffset, ULARGE_INTEGER cb, DWORD dwLockType) override;
-            HRESULT STDMETHODCALLTYPE Stat(STATSTG* pstatstg, DWORD grfStatFlag) override;
-            HRESULT STDMETHODCALLTYPE Clone(IStream** ppstm) override;
+        private:
+            void write_u32(uint32_t value);
 
         private:
-            stdext::output_stream& _stream;
-            stdext::seekable& _seeker;
-            ULONG _refcount = 1;
+            stdext::output_stream& _out;
         };
-    }
 
-    void write_image(const image_descriptor& descriptor, stdext::array_view<const std::byte> palette_data, stdext::input_stream& pixels, stdext::multi_ref<stdext::output_stream, stdext::seekable> out)
-    {
-        assert(palette_data.size() == 3 * 256);  // one byte each red, green, and blue for 256 colors
-
-        WICColor colors[256];
-
-        auto palette_p = palette_data.data();
-        auto color_p = colors;
-        for (size_t n = 0; n < std::size(colors); ++n)
+        void put_u32(std::byte* p, uint32_t value) noexcept
         {
-            auto red = *palette_p++;
-            auto green = *palette_p++;
-            auto blue = *palette_p++;
-            *color_p++ = uint8_t(blue) | (uint8_t(green) << 8) | (uint8_t(red) << 16) | (0xFF << 24);
+            p[0] = std::byte(value >> 24);
+            p[1] = std::byte(value >> 16);
+            p[2] = std::byte(value >> 8);
+            p[3] = std::byte(value);
         }
-        colors[std::size(colors) - 1] &= 0x00FFFFFF; // last entry transparent
-
-        HRESULT hr;
-        COM_REQUIRE_SUCCESS(::CoInitializeEx(nullptr, COINIT_APARTMENTTHREADED));
-        at_scope_exit(::CoUninitialize);
-
-        IWICImagingFactoryPtr imaging_factory;
-        COM_REQUIRE_SUCCESS(imaging_factory.CreateInstance(CLSID_WICImagingFactory));
-
-        IWICPalettePtr palette;
-        COM_REQUIRE_SUCCESS(imaging_factory->CreatePalette(&palette));
-        COM_REQUIRE_SUCCESS(palette->InitializeCustom(colors, std::size(colors)));
-
-        IWICBitmapPtr bitmap;
-        COM_REQUIRE_SUCCESS(imaging_factory->CreateBitmap(descriptor.width,
-            descriptor.height,
-            GUID_WICPixelFormat8bppIndexed,
-            WICBitmapCacheOnDemand,
-            &bitmap));
-        COM_REQUIRE_SUCCESS(bitmap->SetPalette(palette));
-
-        {
-            WICRect lock_rect =
-            {
-                0, 0,
-                INT(descriptor.width), INT(descriptor.height)
-            };
-
-            IWICBitmapLockPtr lock;
-            COM_REQUIRE_SUCCESS(bitmap->Lock(&lock_rect, WICBitmapLockWrite, &lock));
-
-            UINT buffer_size;
-            WICInProcPointer bitmap_data;
-            COM_REQUIRE_SUCCESS(lock->GetDataPointer(&buffer_size, &bitmap_data));
+    }
 
-            UINT bitmap_stride;
-            COM_REQUIRE_SUCCESS(lock->GetStride(&bitmap_stride));
+    void write_image(const image_descriptor& descriptor, stdext::array_view<const std::byte> palette_data, stdext::input_stream& pixels, stdext::output_stream& out, compression level)
+    {
+        assert(palette_data.size() == 3 * 256);  // one byte each red, green, and blue for 256 colors
 
-            for (unsigned n = 0; n < descriptor.height; ++n)
+        // PNG has no way to describe an empty image, and its dimensions are
+        // limited to 31 bits.
+        if (descriptor.width == 0 || descriptor.height == 0)
+            throw std::runtime_error("Can't write an empty image");
+        if (descriptor.width > 0x7FFFFFFF || descriptor.height > 0x7FFFFFFF)
+            throw std::range_error("Image is too large");
+
+        png_writer png(out);
+        png.write_signature();
+
+        std::byte header[13];
+        put_u32(header, descriptor.width);
+        put_u32(header + 4, descriptor.height);
+        header[8] = std::byte(8);      // bit depth
+        header[9] = std::byte(3);      // color type: indexed
+        header[10] = std::byte(0);     // compression method: deflate
+        header[11] = std::byte(0);     // filter method: adaptive
+        header[12] = std::byte(0);     // interlace method: none
+        png.write_chunk("IHDR", header, std::size(header));
+
+        png.write_chunk("PLTE", palette_data.data(), palette_data.size());
+
+        std::byte alpha[256];
+        std::fill_n(alpha, std::size(alpha), std::byte(0xFF));
+        alpha[std::size(alpha) - 1] = std::byte(0);     // last entry transparent
+        png.write_chunk("tRNS", alpha, std::size(alpha));
+
+        // Each row is prefixed with its filter type.  Filters don't help
+        // indexed images, so every row uses filter type 0 (none).
+        zlib_encoder encoder(level);
+        auto row = std::make_unique<std::byte[]>(size_t(descriptor.width) + 1);
+        row[0] = std::byte(0);
+        for (unsigned y = 0; y != descriptor.height; ++y)
+        {
+            pixels.read_all(row.get() + 1, descriptor.width);
+            encoder.write(row.get(), size_t(descriptor.width) + 1);
+
+            auto& compressed = encoder.output();
+            if (compressed.size() >= idat_size)
             {
-                pixels.read_all(bitmap_data, descriptor.width);
-                bitmap_data += bitmap_stride;
+                png.write_chunk("IDAT", compressed.data(), compressed.size());
+                compressed.clear();
             }
         }
 
-        OutputStreamAdapter stream_adapter(out);
-
-        IWICBitmapEncoderPtr encoder;
-        COM_REQUIRE_SUCCESS(imaging_factory->CreateEncoder(GUID_ContainerFormatPng, nullptr, &encoder));
-        COM_REQUIRE_SUCCESS(encoder->Initialize(&stream_adapter, WICBitmapEncoderNoCache));
-
-        IWICBitmapFrameEncodePtr frame_encode;
-        COM_REQUIRE_SUCCESS(encoder->CreateNewFrame(&frame_encode, nullptr));
-        COM_REQUIRE_SUCCESS(frame_encode->Initialize(nullptr));
-        COM_REQUIRE_SUCCESS(frame_encode->WriteSource(bitmap, nullptr));
-        COM_REQUIRE_SUCCESS(frame_encode->Commit());
-        COM_REQUIRE_SUCCESS(encoder->Commit());
+        encoder.finish();
+        auto& compressed = encoder.output();
+        png.write_chunk("IDAT", compressed.data(), compressed.size());
+        png.write_chunk("IEND", nullptr, 0);
     }
 
     namespace
     {
-        HRESULT STDMETHODCALLTYPE OutputStreamAdapter::QueryInterface(REFIID riid, void** ppvObject)
+        void png_writer::write_chunk(const char (&type)[5], const std::byte* data, size_t size)
         {
-            if (ppvObject == nullptr)
-                return E_POINTER;
-
-            if (IsEqualIID(riid, IID_IUnknown))
-            {
-                *ppvObject = static_cast<IUnknown*>(this);
-                return S_OK;
-            }
+            std::byte type_bytes[4];
+            std::transform(type, type + 4, type_bytes, [](char c) { return std::byte(c); });
 
-            if (IsEqualIID(riid, IID_ISequentialStream))
-            {
-                *ppvObject = static_cast<ISequentialStream*>(this);
-                return S_OK;
-            }
-
-            if (IsEqualIID(riid, IID_IStream))
-            {
-                *ppvObject = static_cast<IStream*>(this);
-                return S_OK;
-            }
-
-            *ppvObject = nullptr;
-            return E_NOINTERFACE;
-        }
-
-        ULONG STDMETHODCALLTYPE OutputStreamAdapter::AddRef()
-        {
-            return ++_refcount;
-        }
+            write_u32(uint32_t(size));
+            _out.write_all(type_bytes, std::size(type_bytes));
+            if (size != 0)
+                _out.write_all(data, size);
 
-        ULONG STDMETHODCALLTYPE OutputStreamAdapter::Release()
-        {
-            return --_refcount;
-        }
-
-        HRESULT STDMETHODCALLTYPE OutputStreamAdapter::Read(void* pv, ULONG cb, ULONG* pcbRead)
-        {
-            return STG_E_ACCESSDENIED;
-        }
-
-        HRESULT STDMETHODCALLTYPE OutputStreamAdapter::Write(const void* pv, ULONG cb, ULONG* pcbWritten)
-        {
-            if (cb != 0 && pv == nullptr)
-                return STG_E_INVALIDPOINTER;
-
-            auto bytes = _stream.write(static_cast<const std::byte*>(pv), cb);
-            if (pcbWritten != nullptr)
-                *pcbWritten = ULONG(bytes);
-
-            return S_OK;
-        }
-
-        HRESULT STDMETHODCALLTYPE OutputStreamAdapter::Seek(LARGE_INTEGER dlibMove, DWORD dwOrigin, ULARGE_INTEGER* plibNewPosition)
-        {
-            stdext::seek_from from;
-            switch (dwOrigin)
-            {
-            case STREAM_SEEK_SET:
-                from = stdext::seek_from::begin;
-                break;
-
-            case STREAM_SEEK_CUR:
-                from = stdext::seek_from::current;
-                break;
-
-            case STREAM_SEEK_END:
-                from = stdext::seek_from::end;
-                break;
-
-            default:
-                return STG_E_INVALIDFUNCTION;
-            }
-
-            auto position = _seeker.seek(from, dlibMove.QuadPart);
-            if (plibNewPosition != nullptr)
-                plibNewPosition->QuadPart = position;
-
-            return S_OK;
-        }
-
-        HRESULT STDMETHODCALLTYPE OutputStreamAdapter::SetSize(ULARGE_INTEGER libNewSize)
-        {
-            assert(false);
-            return E_NOTIMPL;
-        }
-
-        HRESULT STDMETHODCALLTYPE OutputStreamAdapter::CopyTo(IStream* pstm, ULARGE_INTEGER cb, ULARGE_INTEGER* pcbRead, ULARGE_INTEGER* pcbWritten)
-        {
-            return STG_E_ACCESSDENIED;
-        }
-
-        HRESULT STDMETHODCALLTYPE OutputStreamAdapter::Commit(DWORD grfCommitFlags)
-        {
-            return S_OK;
-        }
-
-        HRESULT STDMETHODCALLTYPE OutputStreamAdapter::Revert()
-        {
-            return STG_E_INVALIDFUNCTION;
-        }
-
-        HRESULT STDMETHODCALLTYPE OutputStreamAdapter::LockRegion(ULARGE_INTEGER libOffset, ULARGE_INTEGER cb, DWORD dwLockType)
-        {
-            return STG_E_INVALIDFUNCTION;
-        }
-
-        HRESULT STDMETHODCALLTYPE OutputStreamAdapter::UnlockRegion(ULARGE_INTEGER libOffset, ULARGE_INTEGER cb, DWORD dwLockType)
-        {
-            return STG_E_INVALIDFUNCTION;
-        }
-
-        HRESULT STDMETHODCALLTYPE OutputStreamAdapter::Stat(STATSTG* pstatstg, DWORD grfStatFlag)
-        {
-            return E_NOTIMPL;
+            auto crc = update_crc32(crc32_initial, type_bytes, std::size(type_bytes));
+            crc = update_crc32(crc, data, size);
+            write_u32(crc);
         }
 
-        HRESULT STDMETHODCALLTYPE OutputStreamAdapter::Clone(IStream** ppstm)
+        void png_writer::write_u32(uint32_t value)
         {
-            return E_NOTIMPL;
+            std::byte bytes[4];
+            put_u32(bytes, value);
+            _out.write_all(bytes, std::size(bytes));
         }
     }
 }
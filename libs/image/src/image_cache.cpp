@@ -0,0 +1,253 @@
+#include <image/image_cache.h>
+
+#include "run_planner.h"
+
+#include <stdext/stream.h>
+
+#include <algorithm>
+#include <limits>
+#include <stdexcept>
+#include <string>
+
+#include <cstring>
+
+
+namespace wcdx::image
+{
+    namespace
+    {
+        constexpr unsigned max_transparent_run = 0xFF;
+
+        [[noreturn]] void invalid_image()
+        {
+            throw std::runtime_error("Invalid image data");
+        }
+
+        template <class T>
+        T read_value(const std::byte* p) noexcept
+        {
+            T value;
+            std::memcpy(&value, p, sizeof(value));
+            return value;
+        }
+
+        template <class T>
+        void write_value(std::vector<std::byte>& output, T value)
+        {
+            auto p = reinterpret_cast<const std::byte*>(&value);
+            output.insert(output.end(), p, p + sizeof(value));
+        }
+
+        int16_t checked_i16(int value)
+        {
+            if (value < std::numeric_limits<int16_t>::min() || value > std::numeric_limits<int16_t>::max())
+                throw std::range_error("Image is too large");
+            return int16_t(value);
+        }
+    }
+
+    bool is_image_cache(stdext::array_view<const std::byte> data) noexcept
+    {
+        return data.size() >= image_cache_header_size
+            && std::memcmp(data.data(), image_cache_version, sizeof(image_cache_version)) == 0;
+    }
+
+    image_cache::image_cache(stdext::array_view<const std::byte> data)
+        : _data(data)
+    {
+        if (!is_image_cache(data))
+            throw std::runtime_error("Invalid image cache");
+
+        _count = read_value<uint32_t>(data.data() + sizeof(image_cache_version));
+        if (_count > (data.size() - image_cache_header_size) / image_cache_info_size)
+            throw std::runtime_error("Invalid image cache");
+    }
+
+    cached_image image_cache::image(size_t index) const
+    {
+        if (index >= _count)
+            throw std::range_error("Image index " + std::to_string(index) + " out of range");
+
+        auto offset = read_value<uint32_t>(_data.data() + image_cache_header_size + (index * image_cache_info_size));
+        if (offset > _data.size() || _data.size() - offset < cached_image_header_size)
+            invalid_image();
+
+        auto p = _data.data() + offset;
+        return
+        {
+            read_value<uint16_t>(p + 2),
+            read_value<uint16_t>(p),
+            read_value<int16_t>(p + 6),
+            read_value<int16_t>(p + 4),
+            p + cached_image_header_size,
+            _data.size() - offset - cached_image_header_size
+        };
+    }
+
+    std::vector<std::byte> encode_cached_image(const sprite& image)
+    {
+        auto width = image.descriptor.width;
+        auto height = image.descriptor.height;
+        if (width > std::numeric_limits<uint16_t>::max() || height > std::numeric_limits<uint16_t>::max())
+            throw std::range_error("Image is too large");
+
+        std::vector<std::byte> output;
+        write_value(output, uint16_t(height));
+        write_value(output, uint16_t(width));
+        write_value(output, checked_i16(image.reference_y));
+        write_value(output, checked_i16(image.reference_x));
+        write_value(output, int32_t(-image.reference_x));
+        write_value(output, int32_t(-image.reference_y));
+        write_value(output, int32_t(int(width) - image.reference_x));
+        write_value(output, int32_t(int(height) - image.reference_y));
+
+        run_planner planner;
+        for (unsigned y = 0; y != height; ++y)
+        {
+            auto row = image.pixels.get() + (size_t(y) * width);
+            auto row_last = row + width;
+            auto p = row;
+            auto gap_first = row;
+            while ((p = std::find_if(p, row_last, [](std::byte pixel) { return pixel != transparent_index; })) != row_last)
+            {
+                for (auto gap = unsigned(p - gap_first); gap != 0; )
+                {
+                    auto length = std::min(gap, max_transparent_run);
+                    output.push_back(std::byte(1));
+                    output.push_back(std::byte(length));
+                    gap -= length;
+                }
+
+                auto span_last = std::find(p, row_last, transparent_index);
+                auto span_width = unsigned(span_last - p);
+                planner.plan(p, span_width);
+                planner.for_each_run(p, span_width, [&](const std::byte* first, unsigned length, bool fill)
+                {
+                    if (fill)
+                    {
+                        output.push_back(std::byte(length << 1));
+                        output.push_back(*first);
+                    }
+                    else
+                    {
+                        output.push_back(std::byte((length << 1) | 1));
+                        output.insert(output.end(), first, first + length);
+                    }
+                });
+
+                gap_first = p = span_last;
+            }
+
+            output.push_back(std::byte(0));
+        }
+
+        return output;
+    }
+
+    void write_image_cache(stdext::array_view<const std::vector<std::byte>> images, stdext::output_stream& output)
+    {
+        uint64_t offset = image_cache_header_size + (uint64_t(images.size()) * image_cache_info_size);
+        if (images.size() > std::numeric_limits<uint32_t>::max())
+            throw std::range_error("Image cache is too large");
+
+        output.write_all(image_cache_version, sizeof(image_cache_version));
+        output.write(uint32_t(images.size()));
+        for (size_t n = 0; n != images.size(); ++n)
+        {
+            if (offset > std::numeric_limits<uint32_t>::max())
+                throw std::range_error("Image cache is too large");
+
+            output.write(uint32_t(offset));
+            output.write(uint32_t(0));
+            offset += images.data()[n].size();
+        }
+
+        for (size_t n = 0; n != images.size(); ++n)
+            output.write_all(images.data()[n].data(), images.data()[n].size());
+    }
+
+    void draw_cached_image(const cached_image& image, int x, int y, std::byte* target, size_t pitch, unsigned width, unsigned height)
+    {
+        auto p = image.data;
+        auto last = image.data + image.size;
+        auto left = int64_t(x) - image.reference_x;
+        auto top = int64_t(y) - image.reference_y;
+
+        for (unsigned row = 0; row != image.height; ++row)
+        {
+            // Rows above the target still have to be parsed to find the ones
+            // below them, but once past the bottom edge there's nothing left
+            // to draw.
+            auto target_y = top + row;
+            if (target_y >= int64_t(height))
+                break;
+
+            auto dest = target_y >= 0 ? target + (size_t(target_y) * pitch) : nullptr;
+            auto column = left;
+            unsigned remaining = image.width;
+            for (;;)
+            {
+                if (p == last)
+                    invalid_image();
+
+                auto code = unsigned(*p++);
+                if (code == 0)
+                    break;
+                if (p == last)
+                    invalid_image();
+
+                unsigned length;
+                const std::byte* src;
+                if (code == 1)
+                {
+                    length = unsigned(*p++);
+                    src = nullptr;
+                }
+                else
+                {
+                    length = code >> 1;
+                    src = p;
+                    auto stored = (code & 1) != 0 ? length : 1;
+                    if (size_t(last - p) < stored)
+                        invalid_image();
+                    p += stored;
+                }
+
+                if (length > remaining)
+                    invalid_image();
+
+                if (dest != nullptr && src != nullptr)
+                {
+                    auto first = std::max(column, int64_t(0));
+                    auto end = std::min(column + length, int64_t(width));
+                    if (first < end)
+                    {
+                        if ((code & 1) != 0)
+                            std::memcpy(dest + first, src + (first - column), size_t(end - first));
+                        else
+                            std::memset(dest + first, int(*src), size_t(end - first));
+                    }
+                }
+
+                column += length;
+                remaining -= length;
+            }
+        }
+    }
+
+    sprite decode_cached_image(const cached_image& image)
+    {
+        sprite result =
+        {
+            { image.width, image.height },
+            image.reference_x, image.reference_y,
+            nullptr
+        };
+
+        size_t buffer_size = size_t(image.width) * image.height;
+        result.pixels = std::make_unique<std::byte[]>(buffer_size);
+        std::fill_n(result.pixels.get(), buffer_size, transparent_index);
+        draw_cached_image(image, image.reference_x, image.reference_y, result.pixels.get(), image.width, image.width, image.height);
+        return result;
+    }
+}
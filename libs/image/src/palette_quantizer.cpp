@@ -0,0 +1,132 @@
+#include <image/palette_quantizer.h>
+#include <image/sprite.h>
+
+#include <stdext/array_view.h>
+
+#include <algorithm>
+#include <limits>
+#include <vector>
+
+#include <cassert>
+
+
+namespace wcdx::image
+{
+    namespace
+    {
+        unsigned distance(const uint8_t (&color)[3], uint8_t red, uint8_t green, uint8_t blue) noexcept
+        {
+            int dr = int(color[0]) - red;
+            int dg = int(color[1]) - green;
+            int db = int(color[2]) - blue;
+            return unsigned(dr * dr + dg * dg + db * db);
+        }
+    }
+
+    palette_quantizer::palette_quantizer(stdext::array_view<const std::byte> palette)
+        : _cell_first(std::make_unique<uint32_t[]>(cell_count + 1))
+    {
+        assert(palette.size() == 3 * 256);
+
+        for (unsigned n = 0; n != color_count; ++n)
+        {
+            for (unsigned c = 0; c != 3; ++c)
+                _colors[n][c] = uint8_t(palette[3 * n + c]);
+        }
+
+        // An entry can only be nearest to a color in a cell if its closest
+        // approach to the cell is no farther than the smallest worst-case
+        // distance of any entry.
+        constexpr unsigned cell_size = 1 << (8 - cell_bits);
+        constexpr unsigned cells_per_side = 1 << cell_bits;
+        std::vector<uint8_t> candidates;
+        candidates.reserve(cell_count * 4);
+        unsigned min_distance[color_count];
+        uint32_t cell = 0;
+        for (unsigned r = 0; r != cells_per_side; ++r)
+        {
+            for (unsigned g = 0; g != cells_per_side; ++g)
+            {
+                for (unsigned b = 0; b != cells_per_side; ++b, ++cell)
+                {
+                    unsigned cell_first[3] = { r * cell_size, g * cell_size, b * cell_size };
+                    auto threshold = std::numeric_limits<unsigned>::max();
+                    for (unsigned n = 0; n != color_count; ++n)
+                    {
+                        unsigned near_distance = 0;
+                        unsigned far_distance = 0;
+                        for (unsigned c = 0; c != 3; ++c)
+                        {
+                            int value = _colors[n][c];
+                            int first = int(cell_first[c]);
+                            int last = first + int(cell_size) - 1;
+                            int near_delta = value < first ? first - value : value > last ? value - last : 0;
+                            int far_delta = std::max(value - first, last - value);
+                            near_distance += unsigned(near_delta * near_delta);
+                            far_distance += unsigned(far_delta * far_delta);
+                        }
+                        min_distance[n] = near_distance;
+                        threshold = std::min(threshold, far_distance);
+                    }
+
+                    _cell_first[cell] = uint32_t(candidates.size());
+                    for (unsigned n = 0; n != color_count; ++n)
+                    {
+                        if (min_distance[n] <= threshold)
+                            candidates.push_back(uint8_t(n));
+                    }
+                }
+            }
+        }
+        _cell_first[cell_count] = uint32_t(candidates.size());
+
+        _candidates = std::make_unique<uint8_t[]>(candidates.size());
+        std::copy(candidates.begin(), candidates.end(), _candidates.get());
+    }
+
+    std::byte palette_quantizer::nearest(uint8_t red, uint8_t green, uint8_t blue) const noexcept
+    {
+        constexpr unsigned shift = 8 - cell_bits;
+        auto cell = ((red >> shift) << (2 * cell_bits)) | ((green >> shift) << cell_bits) | (blue >> shift);
+
+        auto first = _candidates.get() + _cell_first[cell];
+        auto last = _candidates.get() + _cell_first[cell + 1];
+        auto best = *first;
+        auto best_distance = distance(_colors[best], red, green, blue);
+        while (++first != last)
+        {
+            auto d = distance(_colors[*first], red, green, blue);
+            if (d < best_distance)
+            {
+                best = *first;
+                best_distance = d;
+            }
+        }
+
+        return std::byte(best);
+    }
+
+    void palette_quantizer::quantize(const std::byte* bgra, size_t count, std::byte* out) const noexcept
+    {
+        // Neighboring pixels are usually the same color.
+        uint32_t last_color = 0;
+        auto last_index = transparent_index;
+        for (auto last = bgra + (4 * count); bgra != last; bgra += 4)
+        {
+            auto alpha = uint8_t(bgra[3]);
+            if (alpha < 0x80)
+            {
+                *out++ = transparent_index;
+                continue;
+            }
+
+            auto color = uint32_t(bgra[0]) | (uint32_t(bgra[1]) << 8) | (uint32_t(bgra[2]) << 16) | 0xFF000000;
+            if (color != last_color)
+            {
+                last_color = color;
+                last_index = nearest(uint8_t(bgra[2]), uint8_t(bgra[1]), uint8_t(bgra[0]));
+            }
+            *out++ = last_index;
+        }
+    }
+}
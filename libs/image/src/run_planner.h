@@ -0,0 +1,92 @@
+#ifndef IMAGE_RUN_PLANNER_INCLUDED
+#define IMAGE_RUN_PLANNER_INCLUDED
+#pragma once
+
+#include <algorithm>
+#include <limits>
+#include <vector>
+
+#include <cstddef>
+
+
+namespace wcdx::image
+{
+    // Finds the cheapest way to split a span of pixels into runs, for the
+    // sprite and image cache formats alike.  A literal run costs one byte
+    // plus its pixels, and a fill run two bytes.  The cost of coding a prefix
+    // never decreases with its length (dropping the last pixel of a coding
+    // never makes it longer), so among fill runs ending at a pixel, the
+    // longest one is always the best choice.
+    class run_planner
+    {
+    public:
+        static constexpr unsigned max_run_width = 0x7F;
+
+    public:
+        // Returns the coded size of the span.
+        size_t plan(const std::byte* pixels, unsigned width)
+        {
+            _cost.assign(size_t(width) + 1, 0);
+            _run.resize(size_t(width) + 1);
+
+            unsigned repeat = 0;
+            for (unsigned n = 1; n <= width; ++n)
+            {
+                repeat = n > 1 && pixels[n - 1] == pixels[n - 2] ? repeat + 1 : 1;
+
+                auto best_cost = std::numeric_limits<size_t>::max();
+                run best_run = { };
+                for (unsigned length = 1; length <= std::min(n, max_run_width); ++length)
+                {
+                    auto cost = _cost[n - length] + 1 + length;
+                    if (cost < best_cost)
+                    {
+                        best_cost = cost;
+                        best_run = { length, false };
+                    }
+                }
+
+                auto fill_length = std::min(repeat, max_run_width);
+                if (fill_length > 1 && _cost[n - fill_length] + 2 < best_cost)
+                {
+                    best_cost = _cost[n - fill_length] + 2;
+                    best_run = { fill_length, true };
+                }
+
+                _cost[n] = best_cost;
+                _run[n] = best_run;
+            }
+
+            return _cost[width];
+        }
+
+        // Calls f(first, length, fill) for each run chosen by the last call
+        // to plan, in order.  A fill run repeats *first.
+        template <class F>
+        void for_each_run(const std::byte* pixels, unsigned width, F f)
+        {
+            _order.clear();
+            for (auto n = width; n != 0; n -= _run[n].length)
+                _order.push_back(n);
+
+            for (auto i = _order.rbegin(); i != _order.rend(); ++i)
+            {
+                auto& r = _run[*i];
+                f(pixels + (*i - r.length), r.length, r.fill);
+            }
+        }
+
+    private:
+        struct run
+        {
+            unsigned length;
+            bool fill;
+        };
+
+        std::vector<size_t> _cost;
+        std::vector<run> _run;
+        std::vector<unsigned> _order;
+    };
+}
+
+#endif
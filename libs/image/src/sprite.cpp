@@ -0,0 +1,159 @@
+#include <image/sprite.h>
+
+#include "run_planner.h"
+
+#include <stdext/stream.h>
+
+#include <algorithm>
+#include <limits>
+#include <stdexcept>
+
+
+namespace wcdx::image
+{
+    namespace
+    {
+        constexpr unsigned max_segment_width = 0x7FFF;
+
+        class sprite_writer
+        {
+        public:
+            explicit sprite_writer(std::vector<std::byte>& output) noexcept : _output(output) { }
+
+        public:
+            void write_u8(unsigned value) { _output.push_back(std::byte(value)); }
+
+            void write_u16(unsigned value)
+            {
+                _output.push_back(std::byte(value));
+                _output.push_back(std::byte(value >> 8));
+            }
+
+            void write_i16(int value)
+            {
+                if (value < std::numeric_limits<int16_t>::min() || value > std::numeric_limits<int16_t>::max())
+                    throw std::range_error("Image is too large");
+                write_u16(unsigned(uint16_t(value)));
+            }
+
+            void write(const std::byte* data, size_t size) { _output.insert(_output.end(), data, data + size); }
+
+        private:
+            std::vector<std::byte>& _output;
+        };
+    }
+
+    sprite decode_sprite(stdext::input_stream& input)
+    {
+        auto right_extent = input.read<int16_t>();
+        auto left_extent = input.read<int16_t>();
+        auto top_extent = input.read<int16_t>();
+        auto bottom_extent = input.read<int16_t>();
+
+        auto left = -left_extent;
+        auto top = -top_extent;
+        auto right = right_extent + 1;
+        auto bottom = bottom_extent + 1;
+        if (left > right || top > bottom)
+            throw std::runtime_error("Invalid image data");
+
+        sprite result =
+        {
+            { unsigned(right - left), unsigned(bottom - top) },
+            left_extent, top_extent,
+            nullptr
+        };
+
+        auto width = result.descriptor.width;
+        auto height = result.descriptor.height;
+        size_t buffer_size = size_t(width) * height;
+        result.pixels = std::make_unique<std::byte[]>(buffer_size);
+        std::fill_n(result.pixels.get(), buffer_size, transparent_index);
+
+        uint16_t seg_flags;
+        while ((seg_flags = input.read<uint16_t>()) != 0)
+        {
+            unsigned seg_width = seg_flags >> 1;
+
+            auto x = input.read<int16_t>() - left;
+            auto y = input.read<int16_t>() - top;
+            if (x < 0 || y < 0 || unsigned(y) >= height || unsigned(x) + seg_width > width)
+                throw std::runtime_error("Invalid image data");
+
+            auto segment_data = result.pixels.get() + (size_t(y) * width) + x;
+            if ((seg_flags & 1) != 0)
+            {
+                while (seg_width > 0)
+                {
+                    auto run_flags = input.read<uint8_t>();
+                    unsigned run_width = run_flags >> 1;
+                    if (run_width > seg_width)
+                        throw std::runtime_error("Invalid image data");
+
+                    if ((run_flags & 1) != 0)
+                    {
+                        auto color = input.read<std::byte>();
+                        std::fill_n(segment_data, run_width, color);
+                    }
+                    else
+                        input.read_all(segment_data, run_width);
+
+                    seg_width -= run_width;
+                    segment_data += run_width;
+                }
+            }
+            else
+                input.read_all(segment_data, seg_width);
+        }
+
+        return result;
+    }
+
+    std::vector<std::byte> encode_sprite(const sprite& image)
+    {
+        auto width = image.descriptor.width;
+        auto height = image.descriptor.height;
+        if (width > max_segment_width)
+            throw std::range_error("Image is too large");
+
+        std::vector<std::byte> output;
+        sprite_writer writer(output);
+        writer.write_i16(int(width) - 1 - image.reference_x);   // right
+        writer.write_i16(image.reference_x);                    // left
+        writer.write_i16(image.reference_y);                    // top
+        writer.write_i16(int(height) - 1 - image.reference_y);  // bottom
+
+        run_planner planner;
+        for (unsigned y = 0; y != height; ++y)
+        {
+            auto row = image.pixels.get() + (size_t(y) * width);
+            auto row_last = row + width;
+            for (auto p = row; (p = std::find_if(p, row_last, [](std::byte pixel) { return pixel != transparent_index; })) != row_last; )
+            {
+                auto segment_last = std::find(p, row_last, transparent_index);
+                auto segment_width = unsigned(segment_last - p);
+                auto coded_size = planner.plan(p, segment_width);
+                auto coded = coded_size < segment_width;
+
+                writer.write_u16((segment_width << 1) | (coded ? 1 : 0));
+                writer.write_i16(int(p - row) - image.reference_x);
+                writer.write_i16(int(y) - image.reference_y);
+                if (coded)
+                {
+                    planner.for_each_run(p, segment_width, [&](const std::byte* first, unsigned length, bool fill)
+                    {
+                        writer.write_u8((length << 1) | (fill ? 1 : 0));
+                        writer.write(first, fill ? 1 : length);
+                    });
+                }
+                else
+                    writer.write(p, segment_width);
+
+                p = segment_last;
+            }
+        }
+
+        writer.write_u16(0);
+        return output;
+    }
+}
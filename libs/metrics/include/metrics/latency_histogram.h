@@ -0,0 +1,89 @@
+#ifndef METRICS_LATENCY_HISTOGRAM_INCLUDED
+#define METRICS_LATENCY_HISTOGRAM_INCLUDED
+#pragma once
+
+#include <atomic>
+#include <chrono>
+
+#include <cstddef>
+#include <cstdint>
+
+
+namespace wcdx::metrics
+{
+    // Durations are counted in nanoseconds in buckets that grow
+    // logarithmically: each power of two is split into four, so a bucket's
+    // width is never more than a quarter of its lower bound.
+    constexpr unsigned sub_bucket_bits = 2;
+    constexpr unsigned sub_bucket_count = 1 << sub_bucket_bits;
+    constexpr size_t histogram_bucket_count = sub_bucket_count * (64 - sub_bucket_bits + 1);
+
+    size_t bucket_index(uint64_t nanoseconds) noexcept;
+    uint64_t bucket_lower_bound(size_t index) noexcept;
+
+    // A copy of a histogram's counts at one point in time.
+    struct histogram_snapshot
+    {
+        uint64_t count = 0;
+        uint64_t total = 0;     // nanoseconds
+        uint64_t min = 0;
+        uint64_t max = 0;
+        uint32_t buckets[histogram_bucket_count] = { };
+
+        double mean() const noexcept { return count != 0 ? double(total) / double(count) : 0.0; }
+
+        // The value below which the given fraction of samples fall, to within
+        // the width of a bucket.
+        uint64_t percentile(double fraction) const noexcept;
+    };
+
+    // Lock-free; any number of threads can record into a histogram while
+    // another takes snapshots of it.  A snapshot taken while samples are
+    // being recorded may be off by those samples.
+    class latency_histogram
+    {
+    public:
+        latency_histogram() noexcept = default;
+        latency_histogram(const latency_histogram&) = delete;
+        latency_histogram& operator = (const latency_histogram&) = delete;
+
+    public:
+        void record(uint64_t nanoseconds) noexcept;
+        void record(std::chrono::steady_clock::duration duration) noexcept
+        {
+            record(uint64_t(std::chrono::duration_cast<std::chrono::nanoseconds>(duration).count()));
+        }
+
+        histogram_snapshot snapshot() const noexcept;
+
+    private:
+        std::atomic<uint32_t> _buckets[histogram_bucket_count] = { };
+        std::atomic<uint64_t> _total = 0;
+        std::atomic<uint64_t> _min = UINT64_MAX;
+        std::atomic<uint64_t> _max = 0;
+    };
+
+    // Records the lifetime of the timer.
+    class scoped_timer
+    {
+    public:
+        explicit scoped_timer(latency_histogram& histogram) noexcept
+            : _histogram(histogram), _start(std::chrono::steady_clock::now())
+        {
+        }
+
+        scoped_timer(const scoped_timer&) = delete;
+        scoped_timer& operator = (const scoped_timer&) = delete;
+
+        ~scoped_timer()
+        {
+            _histogram.record(std::chrono::steady_clock::now() - _start);
+        }
+
+    private:
+        latency_histogram& _histogram;
+        std::chrono::steady_clock::time_point _start;
+    };
+}
+
+#endif
@@ -0,0 +1,29 @@
+#ifndef METRICS_REPORT_INCLUDED
+#define METRICS_REPORT_INCLUDED
+#pragma once
+
+#include <string>
+
+
+namespace stdext
+{
+    template <class T> class array_view;
+}
+
+namespace wcdx::metrics
+{
+    class latency_histogram;
+
+    struct named_histogram
+    {
+        const char* name;
+        const latency_histogram* histogram;
+    };
+
+    // Formats a table with one row per histogram giving its sample count and
+    // its mean, median, 90th, 99th percentile, and maximum in microseconds.
+    // Histograms with no samples are left out.
+    std::string format_report(stdext::array_view<const named_histogram> histograms);
+}
+
+#endif
@@ -0,0 +1,83 @@
+#include <metrics/latency_histogram.h>
+
+#include <bit>
+
+
+namespace wcdx::metrics
+{
+    size_t bucket_index(uint64_t nanoseconds) noexcept
+    {
+        if (nanoseconds < sub_bucket_count)
+            return size_t(nanoseconds);
+
+        // Values in [2^e, 2^(e+1)) land in group e - sub_bucket_bits + 1,
+        // indexed by the bits just below the leading one.
+        auto exponent = unsigned(std::bit_width(nanoseconds)) - 1;
+        auto sub_bucket = unsigned(nanoseconds >> (exponent - sub_bucket_bits)) & (sub_bucket_count - 1);
+        return size_t(sub_bucket_count * (exponent - sub_bucket_bits + 1) + sub_bucket);
+    }
+
+    uint64_t bucket_lower_bound(size_t index) noexcept
+    {
+        if (index < sub_bucket_count)
+            return index;
+
+        auto exponent = unsigned(index / sub_bucket_count) + sub_bucket_bits - 1;
+        auto sub_bucket = uint64_t(index % sub_bucket_count);
+        return (sub_bucket_count + sub_bucket) << (exponent - sub_bucket_bits);
+    }
+
+    uint64_t histogram_snapshot::percentile(double fraction) const noexcept
+    {
+        if (count == 0)
+            return 0;
+
+        auto rank = uint64_t(fraction * double(count));
+        uint64_t seen = 0;
+        for (size_t n = 0; n != histogram_bucket_count; ++n)
+        {
+            seen += buckets[n];
+            if (seen > rank)
+            {
+                // Report the top of the bucket, but never beyond what was
+                // actually recorded.
+                auto upper = n + 1 != histogram_bucket_count ? bucket_lower_bound(n + 1) - 1 : UINT64_MAX;
+                return upper < min ? min : upper > max ? max : upper;
+            }
+        }
+
+        return max;
+    }
+
+    void latency_histogram::record(uint64_t nanoseconds) noexcept
+    {
+        _buckets[bucket_index(nanoseconds)].fetch_add(1, std::memory_order_relaxed);
+        _total.fetch_add(nanoseconds, std::memory_order_relaxed);
+
+        auto min = _min.load(std::memory_order_relaxed);
+        while (nanoseconds < min && !_min.compare_exchange_weak(min, nanoseconds, std::memory_order_relaxed))
+            ;
+        auto max = _max.load(std::memory_order_relaxed);
+        while (nanoseconds > max && !_max.compare_exchange_weak(max, nanoseconds, std::memory_order_relaxed))
+            ;
+    }
+
+    histogram_snapshot latency_histogram::snapshot() const noexcept
+    {
+        histogram_snapshot snapshot;
+        for (size_t n = 0; n != histogram_bucket_count; ++n)
+        {
+            snapshot.buckets[n] = _buckets[n].load(std::memory_order_relaxed);
+            snapshot.count += snapshot.buckets[n];
+        }
+
+        snapshot.total = _total.load(std::memory_order_relaxed);
+        if (snapshot.count != 0)
+        {
+            snapshot.min = _min.load(std::memory_order_relaxed);
+            snapshot.max = _max.load(std::memory_order_relaxed);
+        }
+
+        return snapshot;
+    }
+}
@@ -0,0 +1,47 @@
+#include <metrics/report.h>
+#include <metrics/latency_histogram.h>
+
+#include <stdext/array_view.h>
+
+#include <iterator>
+
+#include <cinttypes>
+#include <cstdio>
+
+
+namespace wcdx::metrics
+{
+    namespace
+    {
+        double microseconds(uint64_t nanoseconds) noexcept
+        {
+            return double(nanoseconds) / 1000.0;
+        }
+    }
+
+    std::string format_report(stdext::array_view<const named_histogram> histograms)
+    {
+        std::string report;
+        char line[160];
+        std::snprintf(line, std::size(line), "%-24s %10s %10s %10s %10s %10s %10s\n", "(microseconds)", "count", "mean", "p50", "p90", "p99", "max");
+        report += line;
+
+        for (size_t n = 0; n != histograms.size(); ++n)
+        {
+            auto snapshot = histograms[n].histogram->snapshot();
+            if (snapshot.count == 0)
+                continue;
+
+            std::snprintf(line, std::size(line), "%-24s %10" PRIu64 " %10.1f %10.1f %10.1f %10.1f %10.1f\n",
+                histograms[n].name, snapshot.count,
+                snapshot.mean() / 1000.0,
+                microseconds(snapshot.percentile(0.5)),
+                microseconds(snapshot.percentile(0.9)),
+                microseconds(snapshot.percentile(0.99)),
+                microseconds(snapshot.max));
+            report += line;
+        }
+
+        return report;
+    }
+}
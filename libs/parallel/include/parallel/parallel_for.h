@@ -0,0 +1,28 @@
+#ifndef PARALLEL_PARALLEL_FOR_INCLUDED
+#define PARALLEL_PARALLEL_FOR_INCLUDED
+#pragma once
+
+#include <functional>
+
+#include <cstddef>
+
+
+namespace wcdx::parallel
+{
+    // Calls body(n) for every n in [0, count), on up to thread_count threads
+    // including the calling one; zero means one per processor.  Indices are
+    // claimed in order by whichever thread is free.
+    //
+    // Failures are reported as a serial loop would report them: once a call
+    // throws, no index past it is started, and when every thread is done, the
+    // exception thrown for the lowest index is rethrown.
+    void parallel_for_each_index(size_t count, const std::function<void(size_t)>& body, unsigned thread_count = 0);
+
+    // As above, for bodies that need state of their own on each thread, such
+    // as COM initialization.  Each thread calls make_body once, on that
+    // thread, and the body it returns is destroyed there when the thread has
+    // no more indices to claim.
+    void parallel_for_each_worker(size_t count, const std::function<std::function<void(size_t)>()>& make_body, unsigned thread_count = 0);
+}
+
+#endif
@@ -0,0 +1,59 @@
+#include <parallel/parallel_for.h>
+
+#include <algorithm>
+#include <atomic>
+#include <exception>
+#include <thread>
+#include <vector>
+
+
+namespace wcdx::parallel
+{
+    void parallel_for_each_index(size_t count, const std::function<void(size_t)>& body, unsigned thread_count)
+    {
+        parallel_for_each_worker(count, [&] { return body; }, thread_count);
+    }
+
+    void parallel_for_each_worker(size_t count, const std::function<std::function<void(size_t)>()>& make_body, unsigned thread_count)
+    {
+        if (count == 0)
+            return;
+
+        std::atomic<size_t> next_index = 0;
+        std::atomic<size_t> failed_index = count;
+        std::vector<std::exception_ptr> errors(count);
+        auto run = [&]
+        {
+            std::function<void(size_t)> body;
+            for (size_t n; (n = next_index++) < failed_index; )
+            {
+                try
+                {
+                    if (!body)
+                        body = make_body();
+                    body(n);
+                }
+                catch (...)
+                {
+                    errors[n] = std::current_exception();
+                    for (auto failed = failed_index.load(); n < failed && !failed_index.compare_exchange_weak(failed, n); )
+                        ;
+                }
+            }
+        };
+
+        if (thread_count == 0)
+            thread_count = std::max(std::thread::hardware_concurrency(), 1u);
+        thread_count = unsigned(std::min<size_t>(thread_count, count));
+
+        std::vector<std::thread> threads;
+        for (unsigned n = 1; n < thread_count; ++n)
+            threads.emplace_back(run);
+        run();
+        for (auto& thread : threads)
+            thread.join();
+
+        if (failed_index != count)
+            std::rethrow_exception(errors[failed_index]);
+    }
+}
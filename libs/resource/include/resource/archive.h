@@ -0,0 +1,145 @@
+#ifndef RESOURCE_ARCHIVE_INCLUDED
+#define RESOURCE_ARCHIVE_INCLUDED
+#pragma once
+
+#include <resource/mapped_file.h>
+
+#include <stdext/array_view.h>
+
+#include <filesystem>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+#include <cstddef>
+#include <cstdint>
+
+
+namespace wcdx::resource
+{
+    enum : uint8_t
+    {
+        resource_type_uncompressed  = 0,
+        resource_type_compressed    = 1
+    };
+
+    // Resource offsets share their word in the offset table with the resource
+    // type, which is kept in the high 8 bits.
+    constexpr uint32_t max_resource_offset = 0x00FFFFFF;
+
+    struct archive_entry
+    {
+        uint32_t offset;
+        uint32_t size;
+        uint8_t type;
+    };
+
+    // A resource archive, as found in the GAMEDAT folder and used for image
+    // sets.  An archive begins with its total size, followed by the offset of
+    // each resource and then the resources themselves.  Each resource extends
+    // to the start of the next one, or to the end of the archive.  Compressed
+    // resources begin with their uncompressed size, followed by LZW data.
+    //
+    // The offset table is read once, when the archive is opened; resources
+    // are handed out in place.  Throws std::runtime_error if the data isn't a
+    // valid archive.
+    class archive
+    {
+    public:
+        // Maps the file at path.
+        explicit archive(const std::filesystem::path& path);
+
+        // Reads an archive that is already in memory.  The data must outlive
+        // the archive.
+        explicit archive(stdext::array_view<const std::byte> data);
+
+        archive(const archive&) = delete;
+        archive& operator = (const archive&) = delete;
+        archive(archive&&) = default;
+        archive& operator = (archive&&) = default;
+
+    public:
+        size_t size() const noexcept { return _entries.size(); }
+        stdext::array_view<const std::byte> data() const noexcept { return _data; }
+
+        // Throws std::range_error if index is out of range.
+        const archive_entry& entry(size_t index) const;
+
+        // Returns the resource as stored, without decompressing it.
+        stdext::array_view<const std::byte> stored_data(size_t index) const;
+
+        size_t uncompressed_size(size_t index) const;
+
+        // Decompresses the resource, if needed, into output, which must hold
+        // uncompressed_size(index) bytes.
+        void extract(size_t index, stdext::array_view<std::byte> output) const;
+        std::vector<std::byte> extract(size_t index) const;
+
+    private:
+        void read_index();
+
+    private:
+        mapped_file _file;
+        stdext::array_view<const std::byte> _data;
+        std::vector<archive_entry> _entries;
+    };
+
+    // A view of a resource's uncompressed contents, which keeps the buffer it
+    // refers to alive.
+    class resource_view
+    {
+    public:
+        resource_view() noexcept = default;
+
+    public:
+        stdext::array_view<const std::byte> data() const noexcept { return _data; }
+
+    private:
+        friend class resource_cache;
+        resource_view(stdext::array_view<const std::byte> data, std::shared_ptr<const std::vector<std::byte>> buffer) noexcept
+            : _data(data), _buffer(std::move(buffer)) { }
+
+    private:
+        stdext::array_view<const std::byte> _data;
+        std::shared_ptr<const std::vector<std::byte>> _buffer;
+    };
+
+    // Decompresses resources of an archive on first use and keeps the most
+    // recently used ones, up to a total size in bytes.  Uncompressed resources
+    // are handed out in place and take no room in the cache.  A resource that
+    // is evicted stays alive for as long as a view of it does.  Safe to use
+    // from multiple threads.
+    class resource_cache
+    {
+    public:
+        resource_cache(const archive& archive, size_t capacity);
+        resource_cache(const resource_cache&) = delete;
+        resource_cache& operator = (const resource_cache&) = delete;
+
+    public:
+        resource_view get(size_t index);
+
+    private:
+        using buffer_ptr = std::shared_ptr<const std::vector<std::byte>>;
+        struct cache_entry
+        {
+            buffer_ptr buffer;
+            std::list<size_t>::iterator position;
+        };
+
+        void evict() noexcept;
+
+    private:
+        const archive& _archive;
+        size_t _capacity;
+        size_t _size = 0;
+
+        std::mutex _mutex;
+        std::unordered_map<size_t, cache_entry> _entries;
+        std::list<size_t> _recent;  // most recently used first
+    };
+}
+
+#endif
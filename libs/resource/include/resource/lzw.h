@@ -0,0 +1,39 @@
+#ifndef RESOURCE_LZW_INCLUDED
+#define RESOURCE_LZW_INCLUDED
+#pragma once
+
+#include <vector>
+
+#include <cstddef>
+
+
+namespace stdext
+{
+    template <class T> class array_view;
+    class input_stream;
+    class output_stream;
+}
+
+namespace wcdx::resource
+{
+    // Compressed resources use LZW with codes packed least significant bit
+    // first.  Codes start at 9 bits and grow to at most 12 bits; code 0x100
+    // resets the string table and code 0x101 ends the data.
+    //
+    // Decompresses input into output, which must be large enough to hold all
+    // of the decompressed data.  Returns the number of bytes written.  Throws
+    // std::length_error if output is too small, and std::runtime_error or
+    // std::range_error if the input is malformed.
+    size_t lzw_decompress(stdext::array_view<const std::byte> input, stdext::array_view<std::byte> output);
+
+    // Decompresses from one stream to another.  The input is read in blocks, so
+    // it may be consumed past the end of the compressed data.
+    void lzw_decompress(stdext::input_stream& input, stdext::output_stream& output);
+
+    // Compresses input into the format read by lzw_decompress.  The string
+    // table is reset whenever it fills up, so the output never depends on a
+    // decoder handling a full table.
+    std::vector<std::byte> lzw_compress(stdext::array_view<const std::byte> input);
+}
+
+#endif
@@ -0,0 +1,39 @@
+#ifndef RESOURCE_MAPPED_FILE_INCLUDED
+#define RESOURCE_MAPPED_FILE_INCLUDED
+#pragma once
+
+#include <stdext/array_view.h>
+
+#include <filesystem>
+
+#include <cstddef>
+
+
+namespace wcdx::resource
+{
+    // A whole file mapped read-only into memory.  The file is only paged in as
+    // it is accessed, so opening even a large file costs next to nothing.
+    class mapped_file
+    {
+    public:
+        mapped_file() noexcept = default;
+        explicit mapped_file(const std::filesystem::path& path);
+        mapped_file(mapped_file&& other) noexcept;
+        mapped_file& operator = (mapped_file&& other) noexcept;
+        ~mapped_file();
+
+    public:
+        const std::byte* data() const noexcept { return _data; }
+        size_t size() const noexcept { return _size; }
+        stdext::array_view<const std::byte> view() const noexcept { return stdext::array_view<const std::byte>(_data, _size); }
+
+    private:
+        void unmap() noexcept;
+
+    private:
+        const std::byte* _data = nullptr;
+        size_t _size = 0;
+    };
+}
+
+#endif
@@ -0,0 +1,180 @@
+#include <resource/archive.h>
+#include <resource/lzw.h>
+
+#include <algorithm>
+#include <numeric>
+#include <stdexcept>
+#include <string>
+
+#include <cstring>
+
+
+namespace wcdx::resource
+{
+    namespace
+    {
+        uint32_t read_u32(stdext::array_view<const std::byte> data, size_t offset)
+        {
+            if (data.size() < 4 || offset > data.size() - 4)
+                throw std::runtime_error("Invalid archive");
+
+            uint32_t value;
+            std::memcpy(&value, data.data() + offset, sizeof(value));
+            return value;
+        }
+    }
+
+    archive::archive(const std::filesystem::path& path)
+        : _file(path), _data(_file.view())
+    {
+        read_index();
+    }
+
+    archive::archive(stdext::array_view<const std::byte> data)
+        : _data(data)
+    {
+        read_index();
+    }
+
+    const archive_entry& archive::entry(size_t index) const
+    {
+        if (index >= _entries.size())
+            throw std::range_error("Resource index " + std::to_string(index) + " out of range");
+
+        return _entries[index];
+    }
+
+    stdext::array_view<const std::byte> archive::stored_data(size_t index) const
+    {
+        auto& e = entry(index);
+        return stdext::array_view<const std::byte>(_data.data() + e.offset, e.size);
+    }
+
+    size_t archive::uncompressed_size(size_t index) const
+    {
+        auto& e = entry(index);
+        if (e.type != resource_type_compressed)
+            return e.size;
+
+        if (e.size < sizeof(uint32_t))
+            throw std::runtime_error("Invalid compressed resource");
+        return read_u32(_data, e.offset);
+    }
+
+    void archive::extract(size_t index, stdext::array_view<std::byte> output) const
+    {
+        auto size = uncompressed_size(index);
+        if (output.size() != size)
+            throw std::length_error("Output buffer doesn't match the resource size");
+
+        auto stored = stored_data(index);
+        if (entry(index).type != resource_type_compressed)
+        {
+            std::copy_n(stored.data(), stored.size(), output.data());
+            return;
+        }
+
+        stdext::array_view<const std::byte> compressed(stored.data() + sizeof(uint32_t), stored.size() - sizeof(uint32_t));
+        if (lzw_decompress(compressed, output) != size)
+            throw std::runtime_error("Resource size mismatch");
+    }
+
+    std::vector<std::byte> archive::extract(size_t index) const
+    {
+        std::vector<std::byte> data(uncompressed_size(index));
+        extract(index, stdext::array_view<std::byte>(data.data(), data.size()));
+        return data;
+    }
+
+    void archive::read_index()
+    {
+        auto file_size = std::min<size_t>(read_u32(_data, 0), _data.size());
+        auto first_resource_offset = read_u32(_data, 4) & max_resource_offset;
+        if (first_resource_offset % 4 != 0 || first_resource_offset < 8 || first_resource_offset > file_size)
+            throw std::runtime_error("Invalid archive");
+
+        _entries.resize((first_resource_offset - 4) / 4);
+        for (size_t n = 0; n != _entries.size(); ++n)
+        {
+            auto descriptor = read_u32(_data, 4 + (4 * n));
+            auto& e = _entries[n];
+            e.offset = descriptor & max_resource_offset;
+            e.type = uint8_t(descriptor >> 24);
+            if (e.offset < first_resource_offset || e.offset > file_size)
+                throw std::runtime_error("Invalid resource offset");
+        }
+
+        // Each resource ends where the next one in the file begins.  Resources
+        // are normally stored in order, but nothing requires it.
+        auto by_offset = [&](uint32_t a, uint32_t b) { return _entries[a].offset < _entries[b].offset; };
+        std::vector<uint32_t> order(_entries.size());
+        std::iota(order.begin(), order.end(), 0);
+        if (!std::is_sorted(order.begin(), order.end(), by_offset))
+            std::stable_sort(order.begin(), order.end(), by_offset);
+
+        auto end = uint32_t(file_size);
+        for (auto n = order.size(); n-- != 0; )
+        {
+            auto& e = _entries[order[n]];
+            e.size = end - e.offset;
+            end = e.offset;
+        }
+    }
+
+    resource_cache::resource_cache(const archive& archive, size_t capacity)
+        : _archive(archive), _capacity(capacity)
+    {
+    }
+
+    resource_view resource_cache::get(size_t index)
+    {
+        if (_archive.entry(index).type != resource_type_compressed)
+            return resource_view(_archive.stored_data(index), nullptr);
+
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+            auto i = _entries.find(index);
+            if (i != _entries.end())
+            {
+                _recent.splice(_recent.begin(), _recent, i->second.position);
+                auto& buffer = i->second.buffer;
+                return resource_view(stdext::array_view<const std::byte>(buffer->data(), buffer->size()), buffer);
+            }
+        }
+
+        // Decompress without holding the lock, so other resources can be
+        // looked up meanwhile.  If another thread got here first, its copy
+        // is used and this one is dropped.
+        auto buffer = std::make_shared<const std::vector<std::byte>>(_archive.extract(index));
+
+        std::lock_guard<std::mutex> lock(_mutex);
+        auto [i, inserted] = _entries.try_emplace(index, cache_entry{ buffer, _recent.end() });
+        if (inserted)
+        {
+            _recent.push_front(index);
+            i->second.position = _recent.begin();
+            _size += buffer->size();
+            evict();
+        }
+        else
+        {
+            _recent.splice(_recent.begin(), _recent, i->second.position);
+            buffer = i->second.buffer;
+        }
+
+        return resource_view(stdext::array_view<const std::byte>(buffer->data(), buffer->size()), buffer);
+    }
+
+    void resource_cache::evict() noexcept
+    {
+        // The most recent resource is kept even if it alone exceeds the
+        // capacity; the caller holds it anyway.
+        while (_size > _capacity && _recent.size() > 1)
+        {
+            auto i = _entries.find(_recent.back());
+            _size -= i->second.buffer->size();
+            _entries.erase(i);
+            _recent.pop_back();
+        }
+    }
+}
@@ -0,0 +1,454 @@
+#include <resource/lzw.h>
+
+#include <stdext/array_view.h>
+#include <stdext/stream.h>
+
+#include <algorithm>
+#include <memory>
+#include <vector>
+#include <stdexcept>
+
+#include <cstdint>
+
+
+namespace wcdx::resource
+{
+    namespace
+    {
+        constexpr unsigned min_code_width = 9;
+        constexpr unsigned max_code_width = 12;
+        constexpr unsigned max_table_size = 1 << max_code_width;
+        constexpr unsigned initial_table_size = 0x102;
+        constexpr unsigned reset_code = 0x100;
+        constexpr unsigned stop_code = 0x101;
+
+        constexpr size_t stream_block_size = 0x10000;
+
+        // Input that is entirely in memory.
+        class memory_source
+        {
+        public:
+            explicit memory_source(stdext::array_view<const std::byte> input) noexcept : _input(input) { }
+
+            bool next(const std::byte*& first, const std::byte*& last) noexcept
+            {
+                if (_consumed)
+                    return false;
+
+                first = _input.data();
+                last = first + _input.size();
+                _consumed = true;
+                return first != last;
+            }
+
+        private:
+            stdext::array_view<const std::byte> _input;
+            bool _consumed = false;
+        };
+
+        // Input read from a stream one block at a time.
+        class stream_source
+        {
+        public:
+            explicit stream_source(stdext::input_stream& input) : _input(input), _buffer(std::make_unique<std::byte[]>(stream_block_size)) { }
+
+            bool next(const std::byte*& first, const std::byte*& last)
+            {
+                auto bytes = _input.read(_buffer.get(), stream_block_size);
+                first = _buffer.get();
+                last = first + bytes;
+                return bytes != 0;
+            }
+
+        private:
+            stdext::input_stream& _input;
+            std::unique_ptr<std::byte[]> _buffer;
+        };
+
+        // Output into a buffer supplied by the caller.
+        class memory_sink
+        {
+        public:
+            explicit memory_sink(stdext::array_view<std::byte> output) noexcept : _output(output) { }
+
+            std::byte* reserve(size_t size)
+            {
+                if (size > _output.size() - _size)
+                    throw std::length_error("Decompressed data is larger than the output buffer");
+                return _output.data() + _size;
+            }
+
+            void commit(size_t size) noexcept { _size += size; }
+            size_t size() const noexcept { return _size; }
+
+        private:
+            stdext::array_view<std::byte> _output;
+            size_t _size = 0;
+        };
+
+        // Output to a stream, one block at a time.
+        class stream_sink
+        {
+        public:
+            explicit stream_sink(stdext::output_stream& output) : _output(output), _buffer(std::make_unique<std::byte[]>(stream_block_size)) { }
+
+            std::byte* reserve(size_t size)
+            {
+                if (size > stream_block_size - _size)
+                    flush();
+                return _buffer.get() + _size;
+            }
+
+            void commit(size_t size) noexcept { _size += size; }
+
+            void flush()
+            {
+                _output.write_all(_buffer.get(), _size);
+                _size = 0;
+            }
+
+        private:
+            stdext::output_stream& _output;
+            std::unique_ptr<std::byte[]> _buffer;
+            size_t _size = 0;
+        };
+
+        // Reads codes least significant bit first through a 64-bit buffer that
+        // is refilled a word at a time whenever enough input is at hand.
+        template <class Source>
+        class code_reader
+        {
+        public:
+            explicit code_reader(Source& source) noexcept : _source(source) { }
+
+            unsigned read(unsigned width)
+            {
+                if (_count < width)
+                {
+                    refill();
+                    if (_count < width)
+                        throw std::runtime_error("Compressed data stream ends unexpectedly");
+                }
+
+                auto code = unsigned(_bits & ((uint64_t(1) << width) - 1));
+                _bits >>= width;
+                _count -= width;
+                return code;
+            }
+
+        private:
+            void refill()
+            {
+                if (_last - _next >= 8)
+                {
+                    uint64_t word = 0;
+                    for (unsigned n = 0; n != 8; ++n)
+                        word |= uint64_t(_next[n]) << (8 * n);
+
+                    _bits |= word << _count;
+                    _next += (63 - _count) >> 3;
+                    _count |= 56;
+                    return;
+                }
+
+                while (_count <= 56)
+                {
+                    if (_next == _last && !_source.next(_next, _last))
+                        return;
+
+                    _bits |= uint64_t(*_next++) << _count;
+                    _count += 8;
+                }
+            }
+
+        private:
+            Source& _source;
+            const std::byte* _next = nullptr;
+            const std::byte* _last = nullptr;
+            uint64_t _bits = 0;
+            unsigned _count = 0;
+        };
+
+        // The string table records each string's length and first byte, so a
+        // code can be expanded by writing its string backwards directly into
+        // the output.
+        class string_table
+        {
+        public:
+            string_table() noexcept
+            {
+                for (unsigned n = 0; n != 0x100; ++n)
+                {
+                    _prefix[n] = 0;
+                    _suffix[n] = std::byte(n);
+                    _first[n] = std::byte(n);
+                    _length[n] = 1;
+                }
+            }
+
+        public:
+            unsigned length(unsigned code) const noexcept { return _length[code]; }
+            std::byte first(unsigned code) const noexcept { return _first[code]; }
+
+            void expand(unsigned code, std::byte* out) const noexcept
+            {
+                auto p = out + _length[code];
+                while (code > 0xFF)
+                {
+                    *--p = _suffix[code];
+                    code = _prefix[code];
+                }
+                *--p = std::byte(code);
+            }
+
+            void add(unsigned code, unsigned prefix, std::byte suffix) noexcept
+            {
+                _prefix[code] = uint16_t(prefix);
+                _suffix[code] = suffix;
+                _first[code] = _first[prefix];
+                _length[code] = uint16_t(_length[prefix] + 1);
+            }
+
+        private:
+            uint16_t _prefix[max_table_size];
+            std::byte _suffix[max_table_size];
+            std::byte _first[max_table_size];
+            uint16_t _length[max_table_size];
+        };
+
+        template <class Source, class Sink>
+        void decompress(Source& source, Sink& sink)
+        {
+            code_reader<Source> reader(source);
+            auto table = std::make_unique<string_table>();
+
+            auto code = reader.read(min_code_width);
+            if (code == stop_code)
+                return;
+            if (code != reset_code)
+                throw std::runtime_error("Compressed data stream missing reset code");
+
+            do
+            {
+                auto code_width = min_code_width;
+                unsigned code_width_threshold = 1 << code_width;
+                unsigned table_size = initial_table_size;
+                auto prev_code = code;
+                while ((code = reader.read(code_width)) != reset_code && code != stop_code)
+                {
+                    std::byte first_value;
+                    if (code < table_size)
+                    {
+                        auto length = table->length(code);
+                        auto out = sink.reserve(length);
+                        table->expand(code, out);
+                        sink.commit(length);
+                        first_value = table->first(code);
+                    }
+                    else if (code == table_size && prev_code != reset_code)
+                    {
+                        // The string being defined by this very code: the
+                        // previous string followed by its own first byte.
+                        auto length = table->length(prev_code);
+                        auto out = sink.reserve(length + 1);
+                        table->expand(prev_code, out);
+                        first_value = table->first(prev_code);
+                        out[length] = first_value;
+                        sink.commit(length + 1);
+                    }
+                    else
+                        throw std::range_error("Decompressor table index out of range");
+
+                    // Once the table is full, codes are used as they are until
+                    // the next reset.
+                    if (prev_code != reset_code && table_size != max_table_size)
+                    {
+                        table->add(table_size, prev_code, first_value);
+                        if (++table_size == code_width_threshold && code_width != max_code_width)
+                        {
+                            ++code_width;
+                            code_width_threshold <<= 1;
+                        }
+                    }
+
+                    prev_code = code;
+                }
+            } while (code != stop_code);
+        }
+
+        // Packs codes least significant bit first.
+        class code_writer
+        {
+        public:
+            explicit code_writer(std::vector<std::byte>& output) noexcept : _output(output) { }
+
+            void write(unsigned code, unsigned width)
+            {
+                _bits |= uint64_t(code) << _count;
+                _count += width;
+                while (_count >= 8)
+                {
+                    _output.push_back(std::byte(_bits));
+                    _bits >>= 8;
+                    _count -= 8;
+                }
+            }
+
+            void flush()
+            {
+                if (_count != 0)
+                    _output.push_back(std::byte(_bits));
+                _bits = 0;
+                _count = 0;
+            }
+
+        private:
+            std::vector<std::byte>& _output;
+            uint64_t _bits = 0;
+            unsigned _count = 0;
+        };
+
+        // Maps (prefix code, byte) pairs to the codes of the strings they form,
+        // using open addressing.  The table never holds more than
+        // max_table_size strings, so twice as many slots keep probes short.
+        class string_map
+        {
+        public:
+            string_map() noexcept { clear(); }
+
+        public:
+            void clear() noexcept { std::fill_n(_keys, std::size(_keys), empty_key); }
+
+            // Returns the slot holding the given string, or the empty slot
+            // where it would be added.
+            unsigned find(unsigned prefix, std::byte suffix) const noexcept
+            {
+                auto key = (uint32_t(prefix) << 8) | uint32_t(suffix);
+                auto slot = unsigned((key * 0x9E3779B1u) >> (32 - slot_bits));
+                while (_keys[slot] != key && _keys[slot] != empty_key)
+                    slot = (slot + 1) & (slot_count - 1);
+                return slot;
+            }
+
+            bool empty(unsigned slot) const noexcept { return _keys[slot] == empty_key; }
+            unsigned code(unsigned slot) const noexcept { return _codes[slot]; }
+
+            void add(unsigned slot, unsigned prefix, std::byte suffix, unsigned code) noexcept
+            {
+                _keys[slot] = (uint32_t(prefix) << 8) | uint32_t(suffix);
+                _codes[slot] = uint16_t(code);
+            }
+
+        private:
+            static constexpr unsigned slot_bits = 13;
+            static constexpr unsigned slot_count = 1 << slot_bits;
+            static constexpr uint32_t empty_key = ~uint32_t(0);
+
+            uint32_t _keys[slot_count];
+            uint16_t _codes[slot_count];
+        };
+
+        // Follows the code width the decoder will read with.  The decoder's
+        // table lags one entry behind the encoder's, since it adds no entry
+        // for the first code after a reset.
+        class code_width_tracker
+        {
+        public:
+            unsigned width() const noexcept { return _width; }
+
+            void reset() noexcept
+            {
+                _width = min_code_width;
+                _table_size = initial_table_size;
+                _first = true;
+            }
+
+            void advance() noexcept
+            {
+                if (_first)
+                    _first = false;
+                else if (_table_size != max_table_size && ++_table_size == (1u << _width) && _width != max_code_width)
+                    ++_width;
+            }
+
+        private:
+            unsigned _width = min_code_width;
+            unsigned _table_size = initial_table_size;
+            bool _first = true;
+        };
+    }
+
+    size_t lzw_decompress(stdext::array_view<const std::byte> input, stdext::array_view<std::byte> output)
+    {
+        memory_source source(input);
+        memory_sink sink(output);
+        decompress(source, sink);
+        return sink.size();
+    }
+
+    void lzw_decompress(stdext::input_stream& input, stdext::output_stream& output)
+    {
+        stream_source source(input);
+        stream_sink sink(output);
+        decompress(source, sink);
+        sink.flush();
+    }
+
+    std::vector<std::byte> lzw_compress(stdext::array_view<const std::byte> input)
+    {
+        std::vector<std::byte> output;
+        output.reserve(input.size() / 2 + 16);
+
+        code_writer writer(output);
+        code_width_tracker decoder;
+        auto strings = std::make_unique<string_map>();
+
+        auto emit = [&](unsigned code)
+        {
+            writer.write(code, decoder.width());
+            decoder.advance();
+        };
+
+        writer.write(reset_code, decoder.width());
+
+        auto next = input.data();
+        auto last = next + input.size();
+        while (next != last)
+        {
+            // Each pass starts with an empty table and runs until the input
+            // ends or the table fills up.
+            auto prefix = unsigned(*next++);
+            auto table_size = initial_table_size;
+            for (; next != last; ++next)
+            {
+                auto slot = strings->find(prefix, *next);
+                if (!strings->empty(slot))
+                {
+                    prefix = strings->code(slot);
+                    continue;
+                }
+
+                emit(prefix);
+                strings->add(slot, prefix, *next, table_size);
+                prefix = unsigned(*next);
+                if (++table_size == max_table_size)
+                    break;
+            }
+
+            if (next == last)
+                emit(prefix);
+            else
+            {
+                // The string in progress is a single byte that hasn't been
+                // written yet; the next pass starts with it.
+                writer.write(reset_code, decoder.width());
+                decoder.reset();
+                strings->clear();
+            }
+        }
+
+        writer.write(stop_code, decoder.width());
+        writer.flush();
+        return output;
+    }
+}
@@ -0,0 +1,118 @@
+#include <resource/mapped_file.h>
+
+#include <stdext/scope_guard.h>
+
+#include <limits>
+#include <stdexcept>
+#include <system_error>
+#include <utility>
+
+#include <cerrno>
+#include <cstdint>
+
+#ifdef _WIN32
+#define NOMINMAX
+#define WIN32_LEAN_AND_MEAN
+#include <Windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+
+namespace wcdx::resource
+{
+#ifdef _WIN32
+    mapped_file::mapped_file(const std::filesystem::path& path)
+    {
+        auto file = ::CreateFileW(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+        if (file == INVALID_HANDLE_VALUE)
+            throw std::system_error(int(::GetLastError()), std::system_category(), path.string());
+        at_scope_exit([&]{ ::CloseHandle(file); });
+
+        LARGE_INTEGER size;
+        if (!::GetFileSizeEx(file, &size))
+            throw std::system_error(int(::GetLastError()), std::system_category(), path.string());
+        if (uint64_t(size.QuadPart) > std::numeric_limits<size_t>::max())
+            throw std::length_error(path.string() + ": File is too large to map");
+
+        // Empty files can't be mapped.
+        if (size.QuadPart == 0)
+            return;
+
+        // The view keeps the mapping open, so neither handle is needed once
+        // the view exists.
+        auto mapping = ::CreateFileMappingW(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+        if (mapping == nullptr)
+            throw std::system_error(int(::GetLastError()), std::system_category(), path.string());
+        at_scope_exit([&]{ ::CloseHandle(mapping); });
+
+        auto view = ::MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+        if (view == nullptr)
+            throw std::system_error(int(::GetLastError()), std::system_category(), path.string());
+
+        _data = static_cast<const std::byte*>(view);
+        _size = size_t(size.QuadPart);
+    }
+
+    void mapped_file::unmap() noexcept
+    {
+        if (_data != nullptr)
+            ::UnmapViewOfFile(_data);
+    }
+#else
+    mapped_file::mapped_file(const std::filesystem::path& path)
+    {
+        auto file = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+        if (file == -1)
+            throw std::system_error(errno, std::generic_category(), path.string());
+        at_scope_exit([&]{ ::close(file); });
+
+        struct stat status;
+        if (::fstat(file, &status) == -1)
+            throw std::system_error(errno, std::generic_category(), path.string());
+        if (uint64_t(status.st_size) > std::numeric_limits<size_t>::max())
+            throw std::length_error(path.string() + ": File is too large to map");
+
+        // Empty files can't be mapped.
+        if (status.st_size == 0)
+            return;
+
+        auto view = ::mmap(nullptr, size_t(status.st_size), PROT_READ, MAP_PRIVATE, file, 0);
+        if (view == MAP_FAILED)
+            throw std::system_error(errno, std::generic_category(), path.string());
+
+        _data = static_cast<const std::byte*>(view);
+        _size = size_t(status.st_size);
+    }
+
+    void mapped_file::unmap() noexcept
+    {
+        if (_data != nullptr)
+            ::munmap(const_cast<std::byte*>(_data), _size);
+    }
+#endif
+
+    mapped_file::mapped_file(mapped_file&& other) noexcept
+        : _data(std::exchange(other._data, nullptr)), _size(std::exchange(other._size, 0))
+    {
+    }
+
+    mapped_file& mapped_file::operator = (mapped_file&& other) noexcept
+    {
+        if (this != &other)
+        {
+            unmap();
+            _data = std::exchange(other._data, nullptr);
+            _size = std::exchange(other._size, 0);
+        }
+        return *this;
+    }
+
+    mapped_file::~mapped_file()
+    {
+        unmap();
+    }
+}
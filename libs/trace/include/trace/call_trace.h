@@ -0,0 +1,163 @@
+#ifndef TRACE_CALL_TRACE_INCLUDED
+#define TRACE_CALL_TRACE_INCLUDED
+#pragma once
+
+#include <chrono>
+#include <vector>
+
+#include <cstddef>
+#include <cstdint>
+
+
+namespace stdext
+{
+    class input_stream;
+    class output_stream;
+}
+
+namespace wcdx::trace
+{
+    // One per IWcdx method, in interface order.
+    enum class call_id : uint8_t
+    {
+        set_visible,
+        set_palette,
+        update_palette,
+        update_frame,
+        present,
+        is_full_screen,
+        convert_point_to_client,
+        convert_point_from_client,
+        convert_rect_to_client,
+        convert_rect_from_client,
+        saved_game_open,
+        open_file,
+        close_file,
+        write_file,
+        read_file,
+        seek_file,
+        file_length,
+        convert_point_to_screen,
+        convert_point_from_screen,
+        convert_rect_to_screen,
+        convert_rect_from_screen,
+        query_value,
+        set_value,
+        fill_snow,
+        count
+    };
+
+    const char* call_name(call_id call) noexcept;
+
+    // A trace file starts with a header:
+    //
+    //      uint32_t magic;         // "WCTR"
+    //      uint16_t version;       // trace_version
+    //      uint16_t width;
+    //      uint16_t height;
+    //      uint16_t reserved;
+    //
+    // followed by one record per call:
+    //
+    //      uint32_t size;          // of the rest of the record
+    //      uint64_t timestamp;     // microseconds since tracing started
+    //      uint8_t call;           // call_id
+    //      payload...
+    //
+    // Only the calls that change what is presented carry a payload:
+    //
+    //      set_palette:    uint32_t colors[256]
+    //      update_palette: uint32_t index, uint32_t color
+    //      update_frame:   int32_t x, int32_t y, uint32_t width, uint32_t height,
+    //                      followed by width * height packed pixels
+    //
+    // Colors are 32-bit X8R8G8B8, as converted for presentation.  Other calls
+    // are recorded so that a trace shows when the game made them.  All values
+    // are little-endian.
+    constexpr uint32_t trace_magic = 0x52544357;    // "WCTR"
+    constexpr uint16_t trace_version = 1;
+    constexpr size_t trace_header_size = 12;
+    constexpr size_t trace_record_header_size = 13;
+
+    // Buffers records in memory and writes them out in large pieces.  Tracing
+    // is a diagnostic aid, so recording never throws: if the output fails,
+    // the trace ends there and the rest of the calls are ignored.
+    class trace_writer
+    {
+    public:
+        static constexpr size_t buffer_size = 0x40000;
+
+    public:
+        // Writes the header; throws if the output fails.
+        trace_writer(unsigned width, unsigned height, stdext::output_stream& output);
+        trace_writer(const trace_writer&) = delete;
+        trace_writer& operator = (const trace_writer&) = delete;
+        ~trace_writer();
+
+    public:
+        void record(call_id call) noexcept;
+        void set_palette(const uint32_t colors[256]) noexcept;
+        void update_palette(unsigned index, uint32_t color) noexcept;
+        void update_frame(int x, int y, unsigned width, unsigned height, size_t pitch, const std::byte* bits) noexcept;
+        void flush() noexcept;
+
+        bool failed() const noexcept { return _failed; }
+
+    private:
+        std::byte* begin_record(call_id call, size_t payload_size) noexcept;
+
+    private:
+        stdext::output_stream& _output;
+        std::chrono::steady_clock::time_point _start;
+        std::vector<std::byte> _buffer;
+        bool _failed = false;
+    };
+
+    // A decoded record.  Pointers refer to storage owned by the reader and
+    // remain valid until the next record is read.
+    struct trace_record
+    {
+        call_id call;
+        uint64_t timestamp;
+
+        // set_palette
+        const uint32_t* palette;
+
+        // update_palette
+        unsigned index;
+        uint32_t color;
+
+        // update_frame; pixels are packed, so the pitch is width
+        int x;
+        int y;
+        unsigned width;
+        unsigned height;
+        const std::byte* pixels;
+    };
+
+    class trace_reader
+    {
+    public:
+        // Reads the header; throws std::runtime_error if it isn't a trace.
+        explicit trace_reader(stdext::input_stream& input);
+        trace_reader(const trace_reader&) = delete;
+        trace_reader& operator = (const trace_reader&) = delete;
+
+    public:
+        unsigned width() const noexcept { return _width; }
+        unsigned height() const noexcept { return _height; }
+
+        // Reads the next record, returning false at the end of the trace.
+        // Throws std::runtime_error if the record is damaged or cut short.
+        bool next(trace_record& record);
+
+    private:
+        stdext::input_stream& _input;
+        unsigned _width;
+        unsigned _height;
+        std::vector<std::byte> _record;
+        uint32_t _palette[256];
+    };
+}
+
+#endif
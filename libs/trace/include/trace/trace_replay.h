@@ -0,0 +1,23 @@
+#ifndef TRACE_TRACE_REPLAY_INCLUDED
+#define TRACE_TRACE_REPLAY_INCLUDED
+#pragma once
+
+#include <trace/call_trace.h>
+
+
+namespace wcdx::frame
+{
+    class frame_converter;
+    class present_backend;
+}
+
+namespace wcdx::trace
+{
+    // Applies a recorded call the way Wcdx would have: palette and frame
+    // updates go to the converter, and presents go to the backend.  Calls
+    // that don't affect presentation are ignored.  Returns false if the
+    // backend failed to present.
+    bool replay(const trace_record& record, frame::frame_converter& frame, frame::present_backend& backend);
+}
+
+#endif
@@ -0,0 +1,271 @@
+#include <trace/call_trace.h>
+
+#include <stdext/stream.h>
+
+#include <iterator>
+#include <new>
+#include <stdexcept>
+
+#include <cstring>
+
+
+namespace wcdx::trace
+{
+    namespace
+    {
+        constexpr const char* call_names[] =
+        {
+            "SetVisible",
+            "SetPalette",
+            "UpdatePalette",
+            "UpdateFrame",
+            "Present",
+            "IsFullScreen",
+            "ConvertPointToClient",
+            "ConvertPointFromClient",
+            "ConvertRectToClient",
+            "ConvertRectFromClient",
+            "SavedGameOpen",
+            "OpenFile",
+            "CloseFile",
+            "WriteFile",
+            "ReadFile",
+            "SeekFile",
+            "FileLength",
+            "ConvertPointToScreen",
+            "ConvertPointFromScreen",
+            "ConvertRectToScreen",
+            "ConvertRectFromScreen",
+            "QueryValue",
+            "SetValue",
+            "FillSnow"
+        };
+        static_assert(std::size(call_names) == size_t(call_id::count));
+
+        constexpr size_t update_frame_header_size = 16;
+
+        [[noreturn]] void invalid_record()
+        {
+            throw std::runtime_error("Invalid trace record");
+        }
+
+        template <class T>
+        std::byte* write_value(std::byte* p, T value) noexcept
+        {
+            std::memcpy(p, &value, sizeof(value));
+            return p + sizeof(value);
+        }
+
+        template <class T>
+        T read_value(const std::byte*& p) noexcept
+        {
+            T value;
+            std::memcpy(&value, p, sizeof(value));
+            p += sizeof(value);
+            return value;
+        }
+
+        // Returns the number of bytes read, which is less than size only at
+        // the end of the input.
+        size_t read_bytes(stdext::input_stream& input, std::byte* data, size_t size)
+        {
+            size_t total = 0;
+            while (total != size)
+            {
+                auto count = input.read(data + total, size - total);
+                if (count == 0)
+                    break;
+                total += count;
+            }
+            return total;
+        }
+    }
+
+    const char* call_name(call_id call) noexcept
+    {
+        return size_t(call) < std::size(call_names) ? call_names[size_t(call)] : "unknown";
+    }
+
+    trace_writer::trace_writer(unsigned width, unsigned height, stdext::output_stream& output)
+        : _output(output), _start(std::chrono::steady_clock::now())
+    {
+        _output.write(trace_magic);
+        _output.write(trace_version);
+        _output.write(uint16_t(width));
+        _output.write(uint16_t(height));
+        _output.write(uint16_t(0));
+
+        _buffer.reserve(buffer_size);
+    }
+
+    trace_writer::~trace_writer()
+    {
+        flush();
+    }
+
+    void trace_writer::record(call_id call) noexcept
+    {
+        begin_record(call, 0);
+    }
+
+    void trace_writer::set_palette(const uint32_t colors[256]) noexcept
+    {
+        auto p = begin_record(call_id::set_palette, 256 * sizeof(uint32_t));
+        if (p != nullptr)
+            std::memcpy(p, colors, 256 * sizeof(uint32_t));
+    }
+
+    void trace_writer::update_palette(unsigned index, uint32_t color) noexcept
+    {
+        auto p = begin_record(call_id::update_palette, 2 * sizeof(uint32_t));
+        if (p != nullptr)
+        {
+            p = write_value(p, uint32_t(index));
+            write_value(p, color);
+        }
+    }
+
+    void trace_writer::update_frame(int x, int y, unsigned width, unsigned height, size_t pitch, const std::byte* bits) noexcept
+    {
+        auto p = begin_record(call_id::update_frame, update_frame_header_size + (size_t(width) * height));
+        if (p == nullptr)
+            return;
+
+        p = write_value(p, int32_t(x));
+        p = write_value(p, int32_t(y));
+        p = write_value(p, uint32_t(width));
+        p = write_value(p, uint32_t(height));
+        for (unsigned row = 0; row != height; ++row)
+        {
+            std::memcpy(p, bits + (pitch * row), width);
+            p += width;
+        }
+    }
+
+    void trace_writer::flush() noexcept
+    {
+        if (_failed || _buffer.empty())
+            return;
+
+        try
+        {
+            _output.write_all(_buffer.data(), _buffer.size());
+        }
+        catch (const std::exception&)
+        {
+            _failed = true;
+        }
+
+        _buffer.clear();
+    }
+
+    std::byte* trace_writer::begin_record(call_id call, size_t payload_size) noexcept
+    {
+        auto record_size = trace_record_header_size + payload_size;
+        if (_buffer.size() + record_size > buffer_size)
+            flush();
+        if (_failed)
+            return nullptr;
+
+        // Records larger than the buffer grow it for as long as they're in it.
+        auto offset = _buffer.size();
+        try
+        {
+            _buffer.resize(offset + record_size);
+        }
+        catch (const std::bad_alloc&)
+        {
+            _failed = true;
+            return nullptr;
+        }
+
+        auto timestamp = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - _start);
+        auto p = _buffer.data() + offset;
+        p = write_value(p, uint32_t(record_size - sizeof(uint32_t)));
+        p = write_value(p, uint64_t(timestamp.count()));
+        p = write_value(p, uint8_t(call));
+        return p;
+    }
+
+    trace_reader::trace_reader(stdext::input_stream& input)
+        : _input(input)
+    {
+        std::byte header[trace_header_size];
+        if (read_bytes(_input, header, std::size(header)) != std::size(header))
+            throw std::runtime_error("Not a call trace");
+
+        const std::byte* p = header;
+        auto magic = read_value<uint32_t>(p);
+        auto version = read_value<uint16_t>(p);
+        _width = read_value<uint16_t>(p);
+        _height = read_value<uint16_t>(p);
+        if (magic != trace_magic)
+            throw std::runtime_error("Not a call trace");
+        if (version != trace_version)
+            throw std::runtime_error("Unsupported call trace version");
+    }
+
+    bool trace_reader::next(trace_record& record)
+    {
+        // A trace cut short, e.g. by a crash, ends in an incomplete record;
+        // that's reported rather than taken for the end of the trace.
+        std::byte size_bytes[sizeof(uint32_t)];
+        auto count = read_bytes(_input, size_bytes, std::size(size_bytes));
+        if (count == 0)
+            return false;
+        if (count != std::size(size_bytes))
+            invalid_record();
+
+        const std::byte* size_p = size_bytes;
+        auto size = read_value<uint32_t>(size_p);
+        if (size < trace_record_header_size - sizeof(size))
+            invalid_record();
+
+        _record.resize(size);
+        if (read_bytes(_input, _record.data(), _record.size()) != _record.size())
+            invalid_record();
+
+        const std::byte* p = _record.data();
+        auto payload_size = size_t(size) - (trace_record_header_size - sizeof(size));
+        record = { };
+        record.timestamp = read_value<uint64_t>(p);
+        record.call = call_id(read_value<uint8_t>(p));
+        switch (record.call)
+        {
+        case call_id::set_palette:
+            if (payload_size != sizeof(_palette))
+                invalid_record();
+            std::memcpy(_palette, p, sizeof(_palette));
+            record.palette = _palette;
+            break;
+
+        case call_id::update_palette:
+            if (payload_size != 2 * sizeof(uint32_t))
+                invalid_record();
+            record.index = read_value<uint32_t>(p);
+            record.color = read_value<uint32_t>(p);
+            if (record.index >= 256)
+                invalid_record();
+            break;
+
+        case call_id::update_frame:
+            if (payload_size < update_frame_header_size)
+                invalid_record();
+            record.x = read_value<int32_t>(p);
+            record.y = read_value<int32_t>(p);
+            record.width = read_value<uint32_t>(p);
+            record.height = read_value<uint32_t>(p);
+            if (payload_size - update_frame_header_size != uint64_t(record.width) * record.height)
+                invalid_record();
+            record.pixels = p;
+            break;
+
+        default:
+            if (size_t(record.call) >= size_t(call_id::count) || payload_size != 0)
+                invalid_record();
+            break;
+        }
+
+        return true;
+    }
+}
@@ -0,0 +1,32 @@
+#include <trace/trace_replay.h>
+
+#include <frame/frame_converter.h>
+#include <frame/present_backend.h>
+
+
+namespace wcdx::trace
+{
+    bool replay(const trace_record& record, frame::frame_converter& frame, frame::present_backend& backend)
+    {
+        switch (record.call)
+        {
+        case call_id::set_palette:
+            frame.set_palette(record.palette);
+            return true;
+
+        case call_id::update_palette:
+            frame.update_palette(record.index, record.color);
+            return true;
+
+        case call_id::update_frame:
+            frame.update_frame(record.x, record.y, record.width, record.height, record.width, record.pixels);
+            return true;
+
+        case call_id::present:
+            return backend.present(frame);
+
+        default:
+            return true;
+        }
+    }
+}
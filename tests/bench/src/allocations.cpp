@@ -0,0 +1,93 @@
+#include "bench.h"
+
+#include <atomic>
+#include <new>
+
+#include <cstdlib>
+
+
+// Replacing the global allocation functions counts every allocation made
+// through new, including those inside the standard library.  The nothrow
+// forms are replaced too, since not every library builds them on the plain
+// ones; the aligned forms are left to the implementation, along with their
+// matching deletes.
+namespace
+{
+    std::atomic<uint64_t> allocation_count = 0;
+    std::atomic<uint64_t> allocation_bytes = 0;
+
+    void* allocate(std::size_t size)
+    {
+        allocation_count.fetch_add(1, std::memory_order_relaxed);
+        allocation_bytes.fetch_add(size, std::memory_order_relaxed);
+
+        if (auto p = std::malloc(size != 0 ? size : 1))
+            return p;
+        throw std::bad_alloc();
+    }
+}
+
+void* operator new(std::size_t size)
+{
+    return allocate(size);
+}
+
+void* operator new[](std::size_t size)
+{
+    return allocate(size);
+}
+
+void* operator new(std::size_t size, const std::nothrow_t&) noexcept
+{
+    try
+    {
+        return allocate(size);
+    }
+    catch (const std::bad_alloc&)
+    {
+        return nullptr;
+    }
+}
+
+void* operator new[](std::size_t size, const std::nothrow_t& tag) noexcept
+{
+    return operator new(size, tag);
+}
+
+void operator delete(void* p) noexcept
+{
+    std::free(p);
+}
+
+void operator delete[](void* p) noexcept
+{
+    std::free(p);
+}
+
+void operator delete(void* p, std::size_t) noexcept
+{
+    std::free(p);
+}
+
+void operator delete[](void* p, std::size_t) noexcept
+{
+    std::free(p);
+}
+
+void operator delete(void* p, const std::nothrow_t&) noexcept
+{
+    std::free(p);
+}
+
+void operator delete[](void* p, const std::nothrow_t&) noexcept
+{
+    std::free(p);
+}
+
+namespace wcdx::bench
+{
+    allocation_counts current_allocations() noexcept
+    {
+        return { allocation_count.load(std::memory_order_relaxed), allocation_bytes.load(std::memory_order_relaxed) };
+    }
+}
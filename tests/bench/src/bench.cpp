@@ -0,0 +1,134 @@
+#include "bench.h"
+#include "generators.h"
+
+#include <frame/palette_expand.h>
+#include <frame/pixel_ops.h>
+
+#include <algorithm>
+#include <iterator>
+#include <utility>
+
+#include <cinttypes>
+#include <cstdio>
+
+
+namespace wcdx::bench
+{
+    namespace
+    {
+        const void* volatile sink;
+
+        const char* path_name(frame::expand_path path) noexcept
+        {
+            switch (path)
+            {
+            case frame::expand_path::sse2:
+                return "sse2";
+            case frame::expand_path::avx2:
+                return "avx2";
+            default:
+                return "scalar";
+            }
+        }
+
+        uint64_t percentile(const std::vector<uint64_t>& sorted, double fraction) noexcept
+        {
+            auto index = size_t(fraction * double(sorted.size() - 1) + 0.5);
+            return sorted[std::min(index, sorted.size() - 1)];
+        }
+
+        double per_second(uint64_t amount, double nanoseconds) noexcept
+        {
+            return nanoseconds > 0.0 ? double(amount) * 1e9 / nanoseconds : 0.0;
+        }
+    }
+
+    void consume(const void* p) noexcept
+    {
+        sink = p;
+    }
+
+    bench_runner::bench_runner(bench_config config)
+        : _config(std::move(config))
+    {
+    }
+
+    bool bench_runner::selected(std::string_view name) const noexcept
+    {
+        if (_config.filters.empty())
+            return true;
+
+        return std::any_of(_config.filters.begin(), _config.filters.end(),
+            [&](const std::string& filter) { return name.find(filter) != std::string_view::npos; });
+    }
+
+    void bench_runner::measure(std::string_view name, bench_work work, void (*invoke)(void*), void* context)
+    {
+        invoke(context);
+
+        _samples.clear();
+        std::chrono::nanoseconds elapsed { };
+        allocation_counts allocated = { };
+        while ((elapsed < _config.min_time || _samples.size() < _config.min_iterations) && _samples.size() < _config.max_iterations)
+        {
+            auto before = current_allocations();
+            auto start = std::chrono::steady_clock::now();
+            invoke(context);
+            auto duration = std::chrono::steady_clock::now() - start;
+            auto after = current_allocations();
+
+            elapsed += duration;
+            allocated.count += after.count - before.count;
+            allocated.bytes += after.bytes - before.bytes;
+            _samples.push_back(uint64_t(std::chrono::duration_cast<std::chrono::nanoseconds>(duration).count()));
+        }
+
+        auto iterations = double(_samples.size());
+        std::sort(_samples.begin(), _samples.end());
+        _results.push_back(
+        {
+            std::string(name),
+            work,
+            _samples.size(),
+            double(elapsed.count()) / iterations,
+            percentile(_samples, 0.5),
+            percentile(_samples, 0.99),
+            _samples.front(),
+            _samples.back(),
+            double(allocated.count) / iterations,
+            double(allocated.bytes) / iterations
+        });
+
+        auto& r = _results.back();
+        std::fprintf(stderr, "%-40s %10.1f us  p99 %10.1f us  %10.1f MB/s\n",
+            r.name.c_str(), r.mean / 1000.0, double(r.p99) / 1000.0, per_second(r.work.bytes, r.mean) / (1024 * 1024));
+    }
+
+    std::string format_results_json(const workload& work, const bench_runner& runner)
+    {
+        std::string json;
+        char buffer[512];
+        std::snprintf(buffer, std::size(buffer),
+            "{\n  \"version\": \"%s\",\n  \"workload\": \"%s\",\n  \"seed\": %" PRIu64 ",\n"
+            "  \"expand_path\": \"%s\",\n  \"pixel_path\": \"%s\",\n  \"benchmarks\": [",
+            WCDX_VERSION, work.name, work.seed, path_name(frame::active_expand_path()), path_name(frame::active_pixel_path()));
+        json += buffer;
+
+        const char* separator = "\n";
+        for (auto& r : runner.results())
+        {
+            std::snprintf(buffer, std::size(buffer),
+                "%s    { \"name\": \"%s\", \"iterations\": %" PRIu64 ", \"bytes_per_iteration\": %" PRIu64 ", \"items_per_iteration\": %" PRIu64 ", "
+                "\"mean_ns\": %.1f, \"p50_ns\": %" PRIu64 ", \"p99_ns\": %" PRIu64 ", \"min_ns\": %" PRIu64 ", \"max_ns\": %" PRIu64 ", "
+                "\"bytes_per_second\": %.0f, \"items_per_second\": %.1f, \"allocations_per_iteration\": %.2f, \"allocated_bytes_per_iteration\": %.0f }",
+                separator, r.name.c_str(), r.iterations, r.work.bytes, r.work.items,
+                r.mean, r.p50, r.p99, r.min, r.max,
+                per_second(r.work.bytes, r.mean), per_second(r.work.items, r.mean), r.allocations, r.allocated_bytes);
+            json += buffer;
+            separator = ",\n";
+        }
+
+        json += "\n  ]\n}\n";
+        return json;
+    }
+}
@@ -0,0 +1,108 @@
+#ifndef BENCH_BENCH_INCLUDED
+#define BENCH_BENCH_INCLUDED
+#pragma once
+
+#include <chrono>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include <cstddef>
+#include <cstdint>
+
+
+namespace wcdx::bench
+{
+    struct workload;
+
+    // Heap allocations made through operator new since the program started,
+    // on any thread.
+    struct allocation_counts
+    {
+        uint64_t count;
+        uint64_t bytes;
+    };
+
+    allocation_counts current_allocations() noexcept;
+
+    // Keeps the optimizer from discarding work whose result is otherwise
+    // unused.
+    void consume(const void* p) noexcept;
+
+    struct bench_config
+    {
+        std::chrono::nanoseconds min_time = std::chrono::milliseconds(200);
+        uint64_t min_iterations = 10;
+        uint64_t max_iterations = 1000000;
+        std::vector<std::string> filters;   // substrings of names; empty runs everything
+    };
+
+    // What one iteration of a benchmark processes, for throughput.
+    struct bench_work
+    {
+        uint64_t bytes;
+        uint64_t items;
+    };
+
+    struct bench_result
+    {
+        std::string name;
+        bench_work work;
+        uint64_t iterations;
+        double mean;                // nanoseconds per iteration
+        uint64_t p50;
+        uint64_t p99;
+        uint64_t min;
+        uint64_t max;
+        double allocations;         // per iteration
+        double allocated_bytes;     // per iteration
+    };
+
+    // Times every iteration separately, after one untimed warm-up, until both
+    // the minimum time and the minimum number of iterations are reached.
+    // Percentiles are exact, taken from the sorted samples.  Allocations are
+    // counted over the iterations only.
+    class bench_runner
+    {
+    public:
+        explicit bench_runner(bench_config config);
+        bench_runner(const bench_runner&) = delete;
+        bench_runner& operator = (const bench_runner&) = delete;
+
+    public:
+        bool selected(std::string_view name) const noexcept;
+
+        template <class F>
+        void run(std::string_view name, bench_work work, F body)
+        {
+            if (selected(name))
+                measure(name, work, [](void* context) { (*static_cast<F*>(context))(); }, &body);
+        }
+
+        const std::vector<bench_result>& results() const noexcept { return _results; }
+
+    private:
+        void measure(std::string_view name, bench_work work, void (*invoke)(void*), void* context);
+
+    private:
+        bench_config _config;
+        std::vector<uint64_t> _samples;
+        std::vector<bench_result> _results;
+    };
+
+    // Writes the results as a JSON object, with the workload and the pixel
+    // paths in use, so that runs can be compared across releases.
+    std::string format_results_json(const workload& work, const bench_runner& runner);
+
+    // Each group generates its own inputs from the workload.
+    void run_audio_benchmarks(bench_runner& runner, const workload& work);
+    void run_fileio_benchmarks(bench_runner& runner, const workload& work);
+    void run_font_benchmarks(bench_runner& runner, const workload& work);
+    void run_frame_benchmarks(bench_runner& runner, const workload& work);
+    void run_image_benchmarks(bench_runner& runner, const workload& work);
+    void run_metrics_benchmarks(bench_runner& runner, const workload& work);
+    void run_resource_benchmarks(bench_runner& runner, const workload& work);
+    void run_trace_benchmarks(bench_runner& runner, const workload& work);
+}
+
+#endif
@@ -0,0 +1,57 @@
+#include "bench.h"
+#include "generators.h"
+
+#include <audio/wcaudio_stream.h>
+
+#include <algorithm>
+#include <memory>
+#include <vector>
+
+
+namespace wcdx::bench
+{
+    void run_audio_benchmarks(bench_runner& runner, const workload& work)
+    {
+        random rng(work.seed + 2);
+        auto data = make_stream_file(rng, work.chunk_count, work.chunk_size);
+        auto path = write_asset(work, "stream.str", data);
+
+        runner.run("audio/stream_open", { data.size(), 1 }, [&]
+        {
+            audio::wcaudio_file file(path);
+            consume(&file);
+        });
+
+        // Every track is played through twice over, in pieces the size of
+        // the stream's buffer, as wcjukebox feeds its output.  At intensity
+        // 0 each track loops; at 100 it jumps around within itself, so that
+        // most chunk boundaries are links.
+        auto file = std::make_shared<const audio::wcaudio_file>(path);
+        auto bytes_per_track = 2 * (data.size() / stream_track_count);
+        std::vector<std::byte> buffer(file->header().buffer_size);
+        const struct { const char* name; uint8_t intensity; } variants[] =
+        {
+            { "audio/stream_read", 0 },
+            { "audio/stream_read_branching", 100 },
+        };
+        for (auto& variant : variants)
+        {
+            auto reads = stream_track_count * ((bytes_per_track + buffer.size() - 1) / buffer.size());
+            runner.run(variant.name, { stream_track_count * bytes_per_track, reads }, [&]
+            {
+                audio::wcaudio_stream stream(file);
+                for (unsigned track = 0; track != stream_track_count; ++track)
+                {
+                    stream.select(uint8_t(track), variant.intensity);
+                    for (auto remaining = bytes_per_track; remaining != 0; )
+                    {
+                        auto size = std::min(remaining, buffer.size());
+                        stream.read_all(buffer.data(), size);
+                        remaining -= size;
+                    }
+                }
+                consume(buffer.data());
+            });
+        }
+    }
+}
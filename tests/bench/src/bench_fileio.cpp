@@ -0,0 +1,98 @@
+#include "bench.h"
+#include "generators.h"
+
+#include <fileio/buffered_file.h>
+
+#include <algorithm>
+#include <memory>
+#include <vector>
+
+#include <cstring>
+
+
+namespace wcdx::bench
+{
+    namespace
+    {
+        // A file held in memory, so that only the cost of the cache itself is
+        // measured; the system calls it saves are extra on top.
+        class memory_device : public fileio::file_device
+        {
+        public:
+            explicit memory_device(std::vector<std::byte>& data) noexcept : _data(data) { }
+
+        public:
+            int64_t seek(int64_t offset, fileio::seek_origin origin) override
+            {
+                auto base = origin == fileio::seek_origin::begin ? 0 : origin == fileio::seek_origin::current ? _position : int64_t(_data.size());
+                if (base + offset < 0)
+                    return -1;
+                return _position = base + offset;
+            }
+
+            int64_t read(void* data, size_t size) override
+            {
+                auto count = size_t(std::clamp<int64_t>(int64_t(_data.size()) - _position, 0, int64_t(size)));
+                if (count == 0)
+                    return 0;
+
+                std::memcpy(data, _data.data() + _position, count);
+                _position += int64_t(count);
+                return int64_t(count);
+            }
+
+            int64_t write(const void* data, size_t size) override
+            {
+                if (size_t(_position) + size > _data.size())
+                    _data.resize(size_t(_position) + size);
+                std::memcpy(_data.data() + _position, data, size);
+                _position += int64_t(size);
+                return int64_t(size);
+            }
+
+            int64_t length() override { return int64_t(_data.size()); }
+
+        private:
+            std::vector<std::byte>& _data;
+            int64_t _position = 0;
+        };
+    }
+
+    void run_fileio_benchmarks(bench_runner& runner, const workload& work)
+    {
+        // Saved games and data files are read a record at a time.
+        random rng(work.seed + 4);
+        auto data = make_resource_data(rng, work.resource_size * 16);
+        constexpr size_t record_size = 64;
+        auto record_count = data.size() / record_size;
+        std::byte record[record_size];
+
+        runner.run("fileio/sequential_reads/buffered", { record_count * record_size, record_count }, [&]
+        {
+            fileio::buffered_file file(std::make_unique<memory_device>(data));
+            for (size_t n = 0; n != record_count; ++n)
+                file.read(fileio::buffered_file::current_position, record, record_size);
+            consume(record);
+        });
+
+        runner.run("fileio/sequential_reads/unbuffered", { record_count * record_size, record_count }, [&]
+        {
+            memory_device device(data);
+            for (size_t n = 0; n != record_count; ++n)
+                device.read(record, record_size);
+            consume(record);
+        });
+
+        // Writes coalesced until the file is flushed.
+        std::vector<std::byte> output;
+        runner.run("fileio/sequential_writes/buffered", { record_count * record_size, record_count }, [&]
+        {
+            output.clear();
+            fileio::buffered_file file(std::make_unique<memory_device>(output));
+            for (size_t n = 0; n != record_count; ++n)
+                file.write(fileio::buffered_file::current_position, data.data() + (n * record_size), record_size);
+            file.flush();
+            consume(output.data());
+        });
+    }
+}
@@ -0,0 +1,53 @@
+#include "bench.h"
+#include "generators.h"
+
+#include <font/font.h>
+#include <font/glyph_atlas.h>
+#include <font/text.h>
+
+#include <stdext/array_view.h>
+
+#include <string_view>
+#include <vector>
+
+
+namespace wcdx::bench
+{
+    void run_font_benchmarks(bench_runner& runner, const workload& work)
+    {
+        random rng(work.seed + 6);
+        auto data = make_font(rng, 10);
+        font::font f(data.data(), data.size());
+
+        runner.run("font/glyph_atlas", { data.size(), font::glyph_count }, [&]
+        {
+            font::glyph_atlas atlas(f);
+            consume(atlas.pixels());
+        });
+
+        font::glyph_atlas atlas(f);
+        auto text = make_text(rng, 40, 60);
+        std::vector<std::string_view> lines(text.begin(), text.end());
+        uint64_t character_count = 0;
+        for (auto& line : text)
+            character_count += line.size();
+
+        runner.run("font/render_text_sheet", { character_count, lines.size() }, [&]
+        {
+            auto sheet = font::render_text_sheet(atlas, stdext::array_view<const std::string_view>(lines.data(), lines.size()), 2, std::byte(0));
+            consume(sheet.pixels.get());
+        });
+
+        std::vector<std::byte> screen(size_t(screen_width) * screen_height);
+        runner.run("font/draw_text", { character_count, lines.size() }, [&]
+        {
+            int y = 0;
+            for (auto line : lines)
+            {
+                font::draw_text(atlas, line, 0, y, screen.data(), screen_width, screen_width, screen_height);
+                y = (y + int(atlas.line_height())) % int(screen_height);
+            }
+            consume(screen.data());
+        });
+    }
+}
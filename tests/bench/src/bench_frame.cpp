@@ -0,0 +1,170 @@
+#include "bench.h"
+#include "generators.h"
+#include "streams.h"
+
+#include <frame/frame_delta.h>
+#include <frame/frame_recorder.h>
+#include <frame/palette_expand.h>
+#include <frame/pixel_ops.h>
+#include <image/sprite.h>
+
+#include <algorithm>
+#include <memory>
+#include <random>
+#include <string>
+#include <vector>
+
+
+namespace wcdx::bench
+{
+    namespace
+    {
+        const struct { frame::expand_path path; const char* name; } paths[] =
+        {
+            { frame::expand_path::scalar, "scalar" },
+            { frame::expand_path::sse2, "sse2" },
+            { frame::expand_path::avx2, "avx2" },
+        };
+
+        // How static was drawn before snow_generator: one Mersenne Twister
+        // draw per pixel.
+        void fill_snow_mt19937(std::independent_bits_engine<std::mt19937, 1, unsigned int>& random_bit, std::byte* pixels, size_t pitch,
+            unsigned width, unsigned height, std::byte color)
+        {
+            for (unsigned y = 0; y != height; ++y)
+            {
+                auto p = pixels + (y * pitch);
+                for (unsigned x = 0; x != width; ++x)
+                    *p++ = std::byte(random_bit() * unsigned(color));
+            }
+        }
+
+        // How blocks were copied before copy_rows: one copy_n per row, even
+        // when the rows are packed.
+        void copy_rows_per_row(const std::byte* src, size_t src_pitch, std::byte* dest, size_t dest_pitch, size_t width, size_t height)
+        {
+            for (size_t row = 0; row != height; ++row)
+                std::copy_n(src + (row * src_pitch), width, dest + (row * dest_pitch));
+        }
+    }
+
+    void run_frame_benchmarks(bench_runner& runner, const workload& work)
+    {
+        random rng(work.seed + 3);
+        auto screen = make_screen(rng);
+        auto palette = make_palette(rng);
+        constexpr auto screen_size = size_t(screen_width) * screen_height;
+
+        // Palette expansion, as done for every dirty pixel at presentation,
+        // on every path this processor supports.
+        auto expand = frame::active_expand_path();
+        std::vector<frame::color> colors(screen_size);
+        for (auto& p : paths)
+        {
+            if (!frame::expand_path_supported(p.path))
+                continue;
+
+            frame::select_expand_path(p.path);
+            runner.run(std::string("frame/expand_pixels/") + p.name, { screen_size, screen_size }, [&]
+            {
+                frame::expand_pixels(screen.data(), colors.data(), screen_size, palette.data());
+                consume(colors.data());
+            });
+        }
+        frame::select_expand_path(expand);
+
+        // Static and sprite composition on every path, against the code they
+        // replaced.
+        std::vector<std::byte> target(screen_size);
+        std::independent_bits_engine<std::mt19937, 1, unsigned int> random_bit(uint32_t(work.seed));
+        runner.run("frame/snow/mt19937", { screen_size, screen_size }, [&]
+        {
+            fill_snow_mt19937(random_bit, target.data(), screen_width, screen_width, screen_height, std::byte(0x0F));
+            consume(target.data());
+        });
+
+        auto sprite = make_sprite(rng, 192);
+        auto sprite_size = size_t(sprite.descriptor.width) * sprite.descriptor.height;
+        auto pixel_path = frame::active_pixel_path();
+        for (auto& p : paths)
+        {
+            if (!frame::expand_path_supported(p.path))
+                continue;
+
+            frame::select_pixel_path(p.path);
+            frame::snow_generator snow(uint32_t(work.seed));
+            runner.run(std::string("frame/snow/") + p.name, { screen_size, screen_size }, [&]
+            {
+                snow.fill(target.data(), screen_width, screen_width, screen_height, std::byte(0x0F));
+                consume(target.data());
+            });
+
+            runner.run(std::string("frame/copy_rows_transparent/") + p.name, { sprite_size, sprite_size }, [&]
+            {
+                frame::copy_rows_transparent(sprite.pixels.get(), sprite.descriptor.width, target.data(), screen_width,
+                    sprite.descriptor.width, sprite.descriptor.height, image::transparent_index);
+                consume(target.data());
+            });
+        }
+        frame::select_pixel_path(pixel_path);
+
+        // A full-screen update, whose rows are packed in both buffers, and a
+        // block whose rows aren't.
+        const struct { const char* name; unsigned width; unsigned height; } blocks[] =
+        {
+            { "full", screen_width, screen_height },
+            { "block", 256, 160 },
+        };
+        for (auto& block : blocks)
+        {
+            auto size = size_t(block.width) * block.height;
+            runner.run(std::string("frame/copy_rows/") + block.name, { size, size }, [&]
+            {
+                frame::copy_rows(screen.data(), screen_width, target.data(), block.width, block.width, block.height);
+                consume(target.data());
+            });
+
+            runner.run(std::string("frame/copy_rows/") + block.name + "/per_row_copy_n", { size, size }, [&]
+            {
+                copy_rows_per_row(screen.data(), screen_width, target.data(), block.width, block.width, block.height);
+                consume(target.data());
+            });
+        }
+
+        // Frame captures: the delta codec alone, then the whole recorder with
+        // its writer thread.
+        auto frames = make_frames(rng, std::max(work.frame_count, 2u));
+        auto sequence_size = uint64_t(frames.size()) * screen_size;
+        std::vector<std::vector<std::byte>> deltas;
+        std::vector<std::byte> scratch(frame::max_frame_delta_size(screen_size));
+        for (size_t n = 1; n != frames.size(); ++n)
+        {
+            auto size = frame::encode_frame_delta(frames[n - 1].data(), frames[n].data(), screen_size, scratch.data());
+            deltas.emplace_back(scratch.data(), scratch.data() + size);
+        }
+
+        runner.run("frame/delta_encode", { sequence_size - screen_size, deltas.size() }, [&]
+        {
+            for (size_t n = 1; n != frames.size(); ++n)
+                frame::encode_frame_delta(frames[n - 1].data(), frames[n].data(), screen_size, scratch.data());
+            consume(scratch.data());
+        });
+
+        runner.run("frame/delta_apply", { sequence_size - screen_size, deltas.size() }, [&]
+        {
+            std::copy_n(frames[0].data(), screen_size, target.data());
+            for (auto& delta : deltas)
+                frame::apply_frame_delta(target.data(), screen_size, delta.data(), delta.size());
+            consume(target.data());
+        });
+
+        runner.run("frame/recorder", { sequence_size, frames.size() }, [&]
+        {
+            null_output_stream output;
+            frame::frame_recorder recorder(screen_width, screen_height, output, 0x800000);
+            for (auto& f : frames)
+                recorder.record(f.data(), palette.data());
+            recorder.finish();
+        });
+    }
+}
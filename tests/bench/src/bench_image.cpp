@@ -0,0 +1,121 @@
+#include "bench.h"
+#include "generators.h"
+#include "streams.h"
+
+#include <frame/pixel_ops.h>
+#include <image/image.h>
+#include <image/image_cache.h>
+#include <image/sprite.h>
+#include <resource/archive.h>
+
+#include <stdext/array_view.h>
+#include <stdext/stream.h>
+
+#include <vector>
+
+
+namespace wcdx::bench
+{
+    void run_image_benchmarks(bench_runner& runner, const workload& work)
+    {
+        random rng(work.seed + 1);
+        std::vector<std::vector<std::byte>> sprites;
+        std::vector<std::vector<std::byte>> cached;
+        uint64_t pixel_count = 0;
+        for (unsigned n = 0; n != work.sprite_count; ++n)
+        {
+            auto s = make_sprite(rng, work.max_sprite_size);
+            pixel_count += uint64_t(s.descriptor.width) * s.descriptor.height;
+            sprites.push_back(image::encode_sprite(s));
+            cached.push_back(image::encode_cached_image(s));
+        }
+
+        // An image set is an archive of uncompressed sprites, as read by wcimg.
+        auto set_data = make_archive(sprites, false);
+        write_asset(work, "sprites.dat", set_data);
+        resource::archive set(stdext::array_view<const std::byte>(set_data.data(), set_data.size()));
+
+        vector_output_stream cache_stream;
+        image::write_image_cache(stdext::array_view<const std::vector<std::byte>>(cached.data(), cached.size()), cache_stream);
+        auto& cache_data = cache_stream.data();
+        write_asset(work, "sprites.cache", cache_data);
+        image::image_cache cache(stdext::array_view<const std::byte>(cache_data.data(), cache_data.size()));
+
+        runner.run("image/decode_sprite", { set_data.size(), pixel_count }, [&]
+        {
+            for (size_t n = 0; n != set.size(); ++n)
+            {
+                auto stored = set.stored_data(n);
+                stdext::memory_input_stream input(stored.data(), stored.size());
+                auto s = image::decode_sprite(input);
+                consume(s.pixels.get());
+            }
+        });
+
+        runner.run("image/decode_cached_image", { cache_data.size(), pixel_count }, [&]
+        {
+            for (size_t n = 0; n != cache.size(); ++n)
+            {
+                auto s = image::decode_cached_image(cache.image(n));
+                consume(s.pixels.get());
+            }
+        });
+
+        // Drawing every sprite onto the screen, some partly off its edges:
+        // first by decoding each one and composing it, then straight from
+        // the cache.
+        std::vector<std::byte> screen(size_t(screen_width) * screen_height);
+        struct point { int x, y; };
+        std::vector<point> positions(work.sprite_count);
+        for (auto& p : positions)
+            p = { int(rng.below(screen_width + 64)) - 32, int(rng.below(screen_height + 64)) - 32 };
+
+        runner.run("image/decode_sprite_and_draw", { set_data.size(), pixel_count }, [&]
+        {
+            for (size_t n = 0; n != set.size(); ++n)
+            {
+                auto stored = set.stored_data(n);
+                stdext::memory_input_stream input(stored.data(), stored.size());
+                auto s = image::decode_sprite(input);
+
+                auto left = positions[n].x - s.reference_x;
+                auto top = positions[n].y - s.reference_y;
+                auto r = frame::clip_block(left, top, s.descriptor.width, s.descriptor.height, screen_width, screen_height);
+                if (r.left < r.right && r.top < r.bottom)
+                {
+                    auto src = s.pixels.get() + (size_t(r.top - top) * s.descriptor.width) + size_t(r.left - left);
+                    frame::copy_rows_transparent(src, s.descriptor.width, screen.data() + (size_t(r.top) * screen_width) + size_t(r.left), screen_width,
+                        size_t(r.right - r.left), size_t(r.bottom - r.top), image::transparent_index);
+                }
+            }
+            consume(screen.data());
+        });
+
+        runner.run("image/draw_cached_image", { cache_data.size(), pixel_count }, [&]
+        {
+            for (size_t n = 0; n != cache.size(); ++n)
+                image::draw_cached_image(cache.image(n), positions[n].x, positions[n].y, screen.data(), screen_width, screen_width, screen_height);
+            consume(screen.data());
+        });
+
+        // PNG encoding of a full screen at each compression level, as wcimg
+        // and wccapture write them.
+        auto palette = make_rgb_palette(rng);
+        auto pixels = make_screen(rng);
+        const struct { const char* name; image::compression level; } levels[] =
+        {
+            { "image/write_png/none", image::compression::none },
+            { "image/write_png/fast", image::compression::fast },
+            { "image/write_png/best", image::compression::best },
+        };
+        for (auto& level : levels)
+        {
+            runner.run(level.name, { pixels.size(), 1 }, [&]
+            {
+                stdext::memory_input_stream input(pixels.data(), pixels.size());
+                null_output_stream output;
+                image::write_image({ screen_width, screen_height }, stdext::array_view<const std::byte>(palette.data(), palette.size()), input, output, level.level);
+            });
+        }
+    }
+}
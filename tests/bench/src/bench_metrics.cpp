@@ -0,0 +1,33 @@
+#include "bench.h"
+#include "generators.h"
+
+#include <metrics/latency_histogram.h>
+
+#include <vector>
+
+
+namespace wcdx::bench
+{
+    void run_metrics_benchmarks(bench_runner& runner, const workload& work)
+    {
+        // Durations spread over several orders of magnitude, as the IWcdx
+        // timings are.
+        random rng(work.seed + 5);
+        std::vector<uint64_t> samples(0x1000);
+        for (auto& sample : samples)
+            sample = rng.next() >> rng.between(34, 60);
+
+        metrics::latency_histogram histogram;
+        runner.run("metrics/histogram_record", { samples.size() * sizeof(uint64_t), samples.size() }, [&]
+        {
+            for (auto sample : samples)
+                histogram.record(sample);
+        });
+
+        runner.run("metrics/histogram_snapshot", { sizeof(metrics::histogram_snapshot), 1 }, [&]
+        {
+            auto snapshot = histogram.snapshot();
+            consume(&snapshot);
+        });
+    }
+}
@@ -0,0 +1,69 @@
+#include "bench.h"
+#include "generators.h"
+#include "streams.h"
+
+#include <resource/archive.h>
+#include <resource/lzw.h>
+
+#include <stdext/array_view.h>
+#include <stdext/stream.h>
+
+#include <vector>
+
+
+namespace wcdx::bench
+{
+    void run_resource_benchmarks(bench_runner& runner, const workload& work)
+    {
+        random rng(work.seed);
+        std::vector<std::vector<std::byte>> resources;
+        uint64_t total_size = 0;
+        for (unsigned n = 0; n != work.resource_count; ++n)
+        {
+            resources.push_back(make_resource_data(rng, rng.between(unsigned(work.resource_size / 2), unsigned(work.resource_size + (work.resource_size / 2)))));
+            total_size += resources.back().size();
+        }
+
+        auto data = make_archive(resources, true);
+        write_asset(work, "resources.dat", data);
+        resource::archive archive(stdext::array_view<const std::byte>(data.data(), data.size()));
+
+        // What wcres does for every resource it extracts.
+        std::vector<std::byte> output(size_t(work.resource_size * 2));
+        runner.run("resource/lzw_decompress", { total_size, archive.size() }, [&]
+        {
+            for (size_t n = 0; n != archive.size(); ++n)
+                archive.extract(n, stdext::array_view<std::byte>(output.data(), archive.uncompressed_size(n)));
+            consume(output.data());
+        });
+
+        runner.run("resource/lzw_decompress_stream", { total_size, archive.size() }, [&]
+        {
+            null_output_stream sink;
+            for (size_t n = 0; n != archive.size(); ++n)
+            {
+                auto stored = archive.stored_data(n);
+                stdext::memory_input_stream input(stored.data() + sizeof(uint32_t), stored.size() - sizeof(uint32_t));
+                resource::lzw_decompress(input, sink);
+            }
+        });
+
+        runner.run("resource/archive_open", { data.size(), archive.size() }, [&]
+        {
+            resource::archive opened(stdext::array_view<const std::byte>(data.data(), data.size()));
+            consume(&opened);
+        });
+
+        // Repeated lookups of a working set that fits in the cache, as the
+        // tools make when the same resources are needed again.
+        resource::resource_cache cache(archive, size_t(total_size));
+        runner.run("resource/cache_hit", { total_size, archive.size() }, [&]
+        {
+            for (size_t n = 0; n != archive.size(); ++n)
+            {
+                auto view = cache.get(n);
+                consume(view.data().data());
+            }
+        });
+    }
+}
@@ -0,0 +1,98 @@
+#include "bench.h"
+#include "generators.h"
+#include "streams.h"
+
+#include <frame/frame_converter.h>
+#include <frame/present_backend.h>
+#include <trace/call_trace.h>
+#include <trace/trace_replay.h>
+
+#include <stdext/stream.h>
+
+#include <algorithm>
+#include <stdexcept>
+#include <vector>
+
+
+namespace wcdx::bench
+{
+    namespace
+    {
+        // Records a session as wcdx would: a palette, then for each frame an
+        // update of the rows that changed and a present, with the odd palette
+        // entry changed along the way.
+        void record_session(trace::trace_writer& writer, const std::vector<std::vector<std::byte>>& frames, const std::vector<uint32_t>& palette,
+            random& rng)
+        {
+            writer.set_palette(palette.data());
+            const std::byte* previous = nullptr;
+            for (auto& f : frames)
+            {
+                unsigned top = 0;
+                unsigned bottom = screen_height;
+                if (previous != nullptr)
+                {
+                    auto row_changed = [&](unsigned y)
+                    {
+                        return !std::equal(f.data() + (size_t(y) * screen_width), f.data() + (size_t(y + 1) * screen_width), previous + (size_t(y) * screen_width));
+                    };
+                    while (top != bottom && !row_changed(top))
+                        ++top;
+                    while (bottom != top && !row_changed(bottom - 1))
+                        --bottom;
+                }
+
+                if (rng.below(8) == 0)
+                    writer.update_palette(rng.below(256), uint32_t(rng.next()) & 0x00FFFFFF);
+                if (top != bottom)
+                    writer.update_frame(0, int(top), screen_width, bottom - top, screen_width, f.data() + (size_t(top) * screen_width));
+                writer.record(trace::call_id::present);
+                previous = f.data();
+            }
+        }
+    }
+
+    void run_trace_benchmarks(bench_runner& runner, const workload& work)
+    {
+        random rng(work.seed + 7);
+        auto frames = make_frames(rng, std::max(work.frame_count, 1u));
+        auto palette = make_palette(rng);
+
+        vector_output_stream output;
+        {
+            random session_rng(work.seed + 8);
+            trace::trace_writer writer(screen_width, screen_height, output);
+            record_session(writer, frames, palette, session_rng);
+            writer.flush();
+            if (writer.failed())
+                throw std::runtime_error("Can't record trace");
+        }
+        auto& data = output.data();
+        write_asset(work, "session.wctrace", data);
+
+        runner.run("trace/record", { data.size(), frames.size() }, [&]
+        {
+            null_output_stream sink;
+            random session_rng(work.seed + 8);
+            trace::trace_writer writer(screen_width, screen_height, sink);
+            record_session(writer, frames, palette, session_rng);
+        });
+
+        // Replays into the software backend, as tests/replay does.
+        runner.run("trace/replay", { data.size(), frames.size() }, [&]
+        {
+            stdext::memory_input_stream input(data.data(), data.size());
+            trace::trace_reader reader(input);
+            frame::frame_converter frame(reader.width(), reader.height());
+            frame::software_backend backend(reader.width(), reader.height());
+
+            trace::trace_record record;
+            while (reader.next(record))
+            {
+                if (!trace::replay(record, frame, backend))
+                    throw std::runtime_error("Presentation failed");
+            }
+            consume(backend.pixels());
+        });
+    }
+}
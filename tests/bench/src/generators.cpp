@@ -0,0 +1,409 @@
+#include "generators.h"
+
+#include <audio/wcaudio_stream.h>
+#include <resource/archive.h>
+#include <resource/lzw.h>
+
+#include <stdext/array_view.h>
+#include <stdext/endian.h>
+
+#include <algorithm>
+#include <fstream>
+#include <iterator>
+#include <memory>
+#include <stdexcept>
+
+#include <cstring>
+
+
+using namespace stdext::literals;
+
+namespace wcdx::bench
+{
+    namespace
+    {
+        const workload presets[] =
+        {
+            //  name        seed    resources       sprites     chunks          frames
+            { "small",      1,      32, 0x4000,     64, 64,     64, 0x2000,     60, { } },
+            { "medium",     1,      128, 0x8000,    256, 128,   256, 0x4000,    240, { } },
+            { "large",      1,      256, 0xC000,    1024, 192,  1024, 0x8000,   600, { } },
+        };
+
+        // Chunk headers and links, as laid out in a stream file.
+        constexpr size_t chunk_header_size = 24;
+        constexpr size_t link_size = 5;
+
+        template <class T>
+        void append(std::vector<std::byte>& data, T value)
+        {
+            auto p = reinterpret_cast<const std::byte*>(&value);
+            data.insert(data.end(), p, p + sizeof(value));
+        }
+
+        template <class T>
+        void store(std::vector<std::byte>& data, size_t offset, T value) noexcept
+        {
+            std::memcpy(data.data() + offset, &value, sizeof(value));
+        }
+
+        std::byte opaque_color(random& rng) noexcept
+        {
+            return std::byte(rng.below(0xFF));
+        }
+
+        // Draws a sprite with its top left corner at (x, y), clipped to the
+        // screen.
+        void draw_sprite(const image::sprite& s, int x, int y, std::byte* screen)
+        {
+            for (unsigned row = 0; row != s.descriptor.height; ++row)
+            {
+                auto screen_y = y + int(row);
+                if (screen_y < 0 || screen_y >= int(screen_height))
+                    continue;
+
+                for (unsigned column = 0; column != s.descriptor.width; ++column)
+                {
+                    auto screen_x = x + int(column);
+                    auto pixel = s.pixels[(size_t(row) * s.descriptor.width) + column];
+                    if (screen_x >= 0 && screen_x < int(screen_width) && pixel != image::transparent_index)
+                        screen[(size_t(screen_y) * screen_width) + size_t(screen_x)] = pixel;
+                }
+            }
+        }
+    }
+
+    const workload* find_workload(std::string_view name) noexcept
+    {
+        for (auto& preset : presets)
+        {
+            if (name == preset.name)
+                return &preset;
+        }
+
+        return nullptr;
+    }
+
+    std::vector<std::byte> make_resource_data(random& rng, size_t size)
+    {
+        std::vector<std::byte> data;
+        data.reserve(size);
+        while (data.size() < size)
+        {
+            auto remaining = size - data.size();
+            switch (rng.below(10))
+            {
+            case 0: case 1: case 2:
+                // A run of one value, as in image data and padding.
+                data.insert(data.end(), std::min<size_t>(rng.between(4, 64), remaining), std::byte(rng.below(16)));
+                break;
+
+            case 3: case 4: case 5: case 6:
+                // A string seen before, as in tables and text.
+                if (data.size() >= 8)
+                {
+                    auto length = std::min<size_t>(rng.between(4, 48), remaining);
+                    auto first = rng.below(uint32_t(data.size() - 4));
+                    for (size_t n = 0; n != length; ++n)
+                        data.push_back(data[first + (n % (data.size() - first))]);
+                    break;
+                }
+                [[fallthrough]];
+
+            default:
+                // Noise, drawn mostly from a small alphabet.
+                for (auto n = std::min<size_t>(rng.between(1, 16), remaining); n != 0; --n)
+                    data.push_back(std::byte(rng.below(4) == 0 ? rng.below(256) : rng.below(24)));
+                break;
+            }
+        }
+
+        return data;
+    }
+
+    std::vector<std::byte> make_archive(const std::vector<std::vector<std::byte>>& resources, bool compress)
+    {
+        std::vector<std::vector<std::byte>> stored;
+        stored.reserve(resources.size());
+        for (auto& resource : resources)
+        {
+            if (!compress)
+            {
+                stored.push_back(resource);
+                continue;
+            }
+
+            std::vector<std::byte> data;
+            append(data, uint32_t(resource.size()));
+            auto compressed = resource::lzw_compress(stdext::array_view<const std::byte>(resource.data(), resource.size()));
+            data.insert(data.end(), compressed.begin(), compressed.end());
+            stored.push_back(std::move(data));
+        }
+
+        uint64_t size = 4 * (uint64_t(stored.size()) + 1);
+        for (auto& data : stored)
+            size += data.size();
+        if (size > resource::max_resource_offset)
+            throw std::range_error("Archive is too large");
+
+        std::vector<std::byte> archive;
+        archive.reserve(size_t(size));
+        append(archive, uint32_t(size));
+        auto offset = 4 * (uint32_t(stored.size()) + 1);
+        auto type = uint32_t(compress ? resource::resource_type_compressed : resource::resource_type_uncompressed);
+        for (auto& data : stored)
+        {
+            append(archive, offset | (type << 24));
+            offset += uint32_t(data.size());
+        }
+
+        for (auto& data : stored)
+            archive.insert(archive.end(), data.begin(), data.end());
+
+        return archive;
+    }
+
+    image::sprite make_sprite(random& rng, unsigned max_size)
+    {
+        auto width = rng.between(std::max(max_size / 4, 4u), max_size);
+        auto height = rng.between(std::max(max_size / 4, 4u), max_size);
+        image::sprite result =
+        {
+            { width, height },
+            int(rng.below(width)), int(rng.below(height)),
+            std::make_unique<std::byte[]>(size_t(width) * height)
+        };
+
+        // Coordinates are doubled so that the centers fall on whole numbers.
+        auto rx = int64_t(width);
+        auto ry = int64_t(height);
+        struct hole { int64_t x, y, r; } holes[2];
+        for (auto& h : holes)
+            h = { 2 * int64_t(rng.below(width)), 2 * int64_t(rng.below(height)), 2 * int64_t(rng.between(1, std::max(std::min(width, height) / 6, 1u))) };
+
+        auto p = result.pixels.get();
+        for (unsigned y = 0; y != height; ++y)
+        {
+            unsigned remaining = 0;
+            bool noise = false;
+            auto color = std::byte();
+            for (unsigned x = 0; x != width; ++x, ++p)
+            {
+                if (remaining == 0)
+                {
+                    remaining = rng.between(1, 24);
+                    noise = rng.below(3) == 0;
+                    color = opaque_color(rng);
+                }
+                --remaining;
+
+                auto dx = (2 * int64_t(x) + 1) - rx;
+                auto dy = (2 * int64_t(y) + 1) - ry;
+                bool inside = (dx * dx * ry * ry) + (dy * dy * rx * rx) <= rx * rx * ry * ry;
+                for (auto& h : holes)
+                {
+                    auto hx = (2 * int64_t(x)) - h.x;
+                    auto hy = (2 * int64_t(y)) - h.y;
+                    inside = inside && (hx * hx) + (hy * hy) > h.r * h.r;
+                }
+
+                *p = !inside ? image::transparent_index : noise ? opaque_color(rng) : color;
+            }
+        }
+
+        return result;
+    }
+
+    std::vector<std::byte> make_rgb_palette(random& rng)
+    {
+        std::vector<std::byte> palette(3 * 256);
+        for (auto& component : palette)
+            component = std::byte(rng.below(256));
+        return palette;
+    }
+
+    std::vector<uint32_t> make_palette(random& rng)
+    {
+        std::vector<uint32_t> palette(256);
+        for (auto& color : palette)
+            color = uint32_t(rng.next()) & 0x00FFFFFF;
+        return palette;
+    }
+
+    std::vector<std::byte> make_screen(random& rng)
+    {
+        std::vector<std::byte> screen(size_t(screen_width) * screen_height);
+        for (unsigned y = 0; y != screen_height; ++y)
+            std::fill_n(screen.data() + (size_t(y) * screen_width), screen_width, std::byte(y / 8));
+        for (unsigned n = 0; n != 64; ++n)
+            screen[rng.below(uint32_t(screen.size()))] = std::byte(rng.between(0xF0, 0xFE));
+
+        for (unsigned n = 0; n != 12; ++n)
+        {
+            auto s = make_sprite(rng, 64);
+            draw_sprite(s, int(rng.below(screen_width)) - 32, int(rng.below(screen_height)) - 32, screen.data());
+        }
+
+        return screen;
+    }
+
+    std::vector<std::vector<std::byte>> make_frames(random& rng, unsigned count)
+    {
+        std::vector<std::vector<std::byte>> frames;
+        frames.reserve(count);
+        for (unsigned n = 0; n != count; ++n)
+        {
+            if (n % 30 == 0)
+            {
+                frames.push_back(make_screen(rng));
+                continue;
+            }
+
+            frames.push_back(frames.back());
+            for (auto changes = rng.between(1, 4); changes != 0; --changes)
+            {
+                auto s = make_sprite(rng, 48);
+                draw_sprite(s, int(rng.below(screen_width)) - 24, int(rng.below(screen_height)) - 24, frames.back().data());
+            }
+        }
+
+        return frames;
+    }
+
+    std::vector<std::byte> make_stream_file(random& rng, unsigned chunk_count, size_t chunk_size)
+    {
+        chunk_count = std::max(chunk_count, 1 + stream_track_count);
+        auto chunks_per_track = (chunk_count - 1) / stream_track_count;
+        chunk_count = 1 + (chunks_per_track * stream_track_count);
+
+        // Playback at intensity 0 runs through a track and loops back to its
+        // start; higher intensities jump around within the track.
+        struct link { uint8_t value; uint32_t chunk_index; };
+        std::vector<link> trigger_links;
+        std::vector<link> chunk_links;
+        std::vector<std::pair<uint32_t, uint32_t>> chunk_link_ranges(chunk_count);
+        for (unsigned track = 0; track != stream_track_count; ++track)
+        {
+            auto first = 1 + (track * chunks_per_track);
+            trigger_links.push_back({ uint8_t(track), first });
+            for (unsigned n = 0; n != chunks_per_track; ++n)
+            {
+                auto chunk = first + n;
+                bool last = n + 1 == chunks_per_track;
+                if (!last && rng.below(2) == 0)
+                    continue;
+
+                chunk_link_ranges[chunk] = { uint32_t(chunk_links.size()), 2 };
+                chunk_links.push_back({ 0, last ? first : chunk + 1 });
+                chunk_links.push_back({ 100, first + rng.below(chunks_per_track) });
+            }
+        }
+
+        wcdx::audio::stream_file_header header = { };
+        header.magic = "STRM"_4cc;
+        header.version = 1;
+        header.channels = 2;
+        header.bits_per_sample = 16;
+        header.sample_rate = 22050;
+        header.buffer_size = 0x4000;
+        header.chunk_headers_offset = uint32_t(sizeof(header));
+        header.chunk_count = chunk_count;
+        header.chunk_link_offset = header.chunk_headers_offset + uint32_t(chunk_count * chunk_header_size);
+        header.chunk_link_count = uint32_t(chunk_links.size());
+        header.trigger_link_offset = header.chunk_link_offset + uint32_t(chunk_links.size() * link_size);
+        header.trigger_link_count = uint32_t(trigger_links.size());
+
+        std::vector<std::byte> data(header.trigger_link_offset + (trigger_links.size() * link_size));
+        std::memcpy(data.data(), &header, sizeof(header));
+
+        auto write_links = [&](size_t offset, const std::vector<link>& links)
+        {
+            for (auto& l : links)
+            {
+                store(data, offset, l.value);
+                store(data, offset + 1, l.chunk_index);
+                offset += link_size;
+            }
+        };
+        write_links(header.chunk_link_offset, chunk_links);
+        write_links(header.trigger_link_offset, trigger_links);
+
+        // Chunk 0 is the index and holds no audio.
+        for (uint32_t chunk = 0; chunk != chunk_count; ++chunk)
+        {
+            auto start = uint32_t(data.size());
+            if (chunk != 0)
+            {
+                auto size = std::max<size_t>(rng.between(unsigned(chunk_size / 2), unsigned(chunk_size + (chunk_size / 2))) & ~size_t(3), 4);
+                for (size_t n = 0; n < size; n += 8)
+                    append(data, rng.next());
+                data.resize(start + size);
+            }
+
+            auto offset = header.chunk_headers_offset + (chunk * chunk_header_size);
+            store(data, offset, start);
+            store(data, offset + 4, uint32_t(data.size()));
+            store(data, offset + 8, uint32_t(chunk == 0 ? trigger_links.size() : 0));
+            store(data, offset + 12, uint32_t(0));
+            store(data, offset + 16, chunk_link_ranges[chunk].second);
+            store(data, offset + 20, chunk_link_ranges[chunk].first);
+        }
+
+        return data;
+    }
+
+    std::vector<std::byte> make_font(random& rng, unsigned height)
+    {
+        constexpr size_t glyph_count = 0x100;
+        constexpr size_t header_size = 4 + (3 * glyph_count);
+
+        std::vector<std::byte> data(header_size);
+        data[0] = std::byte(height);
+        data[1] = std::byte(height >> 8);
+        data[2] = std::byte(1);
+        for (unsigned index = ' '; index != 0x7F; ++index)
+        {
+            auto width = index == ' ' ? 4 : rng.between(3, 8);
+            auto position = data.size();
+            data[4 + index] = std::byte(width);
+            data[4 + glyph_count + index] = std::byte(position);
+            data[4 + (2 * glyph_count) + index] = std::byte(position >> 8);
+            for (auto n = size_t(width) * height; n != 0; --n)
+                data.push_back(index != ' ' && rng.below(3) == 0 ? std::byte(rng.between(1, 15)) : std::byte(0));
+        }
+
+        return data;
+    }
+
+    std::vector<std::string> make_text(random& rng, unsigned line_count, unsigned max_line_length)
+    {
+        constexpr char characters[] = "abcdefghijklmnopqrstuvwxyzABCDEFGHIJKLMNOPQRSTUVWXYZ0123456789.,!?'-";
+
+        std::vector<std::string> lines(line_count);
+        for (auto& line : lines)
+        {
+            auto length = rng.between(max_line_length / 2, max_line_length);
+            while (line.size() < length)
+            {
+                if (!line.empty())
+                    line += ' ';
+                for (auto n = rng.between(1, 10); n != 0 && line.size() < length; --n)
+                    line += characters[rng.below(uint32_t(std::size(characters) - 1))];
+            }
+        }
+
+        return lines;
+    }
+
+    std::filesystem::path write_asset(const workload& work, const char* file_name, const std::vector<std::byte>& data)
+    {
+        std::filesystem::create_directories(work.asset_directory);
+        auto path = work.asset_directory / file_name;
+
+        std::ofstream file(path, std::ios::binary | std::ios::trunc);
+        if (!file || !file.write(reinterpret_cast<const char*>(data.data()), std::streamsize(data.size())))
+            throw std::runtime_error("Can't write " + path.string());
+
+        return path;
+    }
+}
@@ -0,0 +1,112 @@
+#ifndef BENCH_GENERATORS_INCLUDED
+#define BENCH_GENERATORS_INCLUDED
+#pragma once
+
+#include <image/sprite.h>
+
+#include <filesystem>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include <cstddef>
+#include <cstdint>
+
+
+namespace wcdx::bench
+{
+    // How much data the generators produce.  Every input is derived from the
+    // seed alone, so a given workload is the same on every run and platform.
+    struct workload
+    {
+        const char* name;
+        uint64_t seed;
+
+        unsigned resource_count;        // compressed resources in the archive
+        size_t resource_size;           // average uncompressed size
+        unsigned sprite_count;          // sprites in the image set
+        unsigned max_sprite_size;       // largest width or height
+        unsigned chunk_count;           // audio chunks in the stream file
+        size_t chunk_size;              // average bytes per chunk
+        unsigned frame_count;           // frames in recorded sequences
+
+        std::filesystem::path asset_directory;
+    };
+
+    // Returns the preset of the given name (small, medium, or large), or null
+    // if there is none.
+    const workload* find_workload(std::string_view name) noexcept;
+
+    constexpr unsigned screen_width = 320;
+    constexpr unsigned screen_height = 200;
+
+    // splitmix64.  Unlike the std distributions, its output is the same with
+    // every standard library.
+    class random
+    {
+    public:
+        explicit random(uint64_t seed) noexcept : _state(seed) { }
+
+    public:
+        uint64_t next() noexcept
+        {
+            auto z = (_state += 0x9e3779b97f4a7c15);
+            z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9;
+            z = (z ^ (z >> 27)) * 0x94d049bb133111eb;
+            return z ^ (z >> 31);
+        }
+
+        // Uniform in [0, bound).
+        uint32_t below(uint32_t bound) noexcept { return uint32_t(((next() >> 32) * bound) >> 32); }
+
+        // Uniform in [low, high].
+        unsigned between(unsigned low, unsigned high) noexcept { return low + below(high - low + 1); }
+
+    private:
+        uint64_t _state;
+    };
+
+    // Data with the mix of runs, repeated strings, and noise that LZW sees in
+    // game resources.
+    std::vector<std::byte> make_resource_data(random& rng, size_t size);
+
+    // Lays out a resource archive as read by wcdx::resource::archive.  If
+    // compress is set, every resource is stored LZW compressed.
+    std::vector<std::byte> make_archive(const std::vector<std::vector<std::byte>>& resources, bool compress);
+
+    // A roughly elliptical sprite with transparent edges and holes, filled
+    // with bands of solid color broken up by noise, so that its encoding
+    // mixes fill and literal runs.
+    image::sprite make_sprite(random& rng, unsigned max_size);
+
+    // 256 RGB triples, as taken by wcdx::image::write_image.
+    std::vector<std::byte> make_rgb_palette(random& rng);
+
+    // 256 X8R8G8B8 colors, as taken by the frame library.
+    std::vector<uint32_t> make_palette(random& rng);
+
+    // A screen's worth of pixels with sprites scattered over a background.
+    std::vector<std::byte> make_screen(random& rng);
+
+    // A sequence of screens, each one the previous one with a few rectangles
+    // redrawn, and now and then a complete change of scene.
+    std::vector<std::vector<std::byte>> make_frames(random& rng, unsigned count);
+
+    // A stream file as read by wcdx::audio::wcaudio_file: chunk 0 is the
+    // index, with one trigger per track, and each track is a run of chunks
+    // that loops at intensity 0 and branches within the track at other
+    // intensities.
+    std::vector<std::byte> make_stream_file(random& rng, unsigned chunk_count, size_t chunk_size);
+    constexpr unsigned stream_track_count = 8;
+
+    // A Wing Commander II font resource covering printable ASCII.
+    std::vector<std::byte> make_font(random& rng, unsigned height);
+
+    // Lines of printable ASCII words.
+    std::vector<std::string> make_text(random& rng, unsigned line_count, unsigned max_line_length);
+
+    // Writes data under the workload's asset directory and returns its path.
+    std::filesystem::path write_asset(const workload& work, const char* file_name, const std::vector<std::byte>& data);
+}
+
+#endif
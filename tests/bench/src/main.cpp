@@ -0,0 +1,211 @@
+#include "bench.h"
+#include "generators.h"
+
+#include <stdext/scope_guard.h>
+
+#include <chrono>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <system_error>
+
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+
+
+namespace
+{
+    struct program_options
+    {
+        const char* size = "medium";
+        uint64_t seed = 0;
+        bool seed_set = false;
+        wcdx::bench::bench_config config;
+        const char* asset_path = nullptr;
+        const char* output_path = nullptr;
+    };
+
+    class usage_error : public std::runtime_error
+    {
+        using runtime_error::runtime_error;
+    };
+
+    program_options parse_args(int argc, char* argv[]);
+    void show_usage(const char* invocation);
+    void run_benchmarks(const program_options& options);
+}
+
+int main(int argc, char* argv[])
+{
+    std::string invocation = argc > 0 ? std::filesystem::path(argv[0]).filename().string() : "bench";
+
+    try
+    {
+        auto options = parse_args(argc, argv);
+        run_benchmarks(options);
+        return EXIT_SUCCESS;
+    }
+    catch (const usage_error& e)
+    {
+        std::cerr << "Error: " << e.what() << '\n';
+        show_usage(invocation.c_str());
+    }
+    catch (const std::exception& e)
+    {
+        std::cerr << "Error: " << e.what() << '\n';
+    }
+    catch (...)
+    {
+        std::cerr << "Unknown error\n";
+    }
+
+    return EXIT_FAILURE;
+}
+
+namespace
+{
+    const char* next_arg(int argc, char* argv[], int& n, const char* expected)
+    {
+        if (++n == argc)
+            throw usage_error(std::string("Expected ") + expected);
+        return argv[n];
+    }
+
+    void check_once(bool& set, const char* option)
+    {
+        if (set)
+            throw usage_error(std::string("The ") + option + " option can only be used once");
+        set = true;
+    }
+
+    program_options parse_args(int argc, char* argv[])
+    {
+        program_options options;
+        bool size_set = false;
+        bool min_time_set = false;
+
+        for (int n = 1; n < argc; ++n)
+        {
+            if (std::strcmp(argv[n], "-size") == 0)
+            {
+                auto size = next_arg(argc, argv, n, "workload size");
+                check_once(size_set, "-size");
+                if (wcdx::bench::find_workload(size) == nullptr)
+                    throw usage_error(std::string("Invalid workload size: ") + size);
+                options.size = size;
+            }
+            else if (std::strcmp(argv[n], "-seed") == 0)
+            {
+                auto seed = next_arg(argc, argv, n, "seed");
+                check_once(options.seed_set, "-seed");
+
+                char* end;
+                options.seed = std::strtoull(seed, &end, 0);
+                if (*seed == '\0' || *end != '\0')
+                    throw usage_error(std::string("Invalid seed: ") + seed);
+            }
+            else if (std::strcmp(argv[n], "-filter") == 0)
+                options.config.filters.emplace_back(next_arg(argc, argv, n, "benchmark filter"));
+            else if (std::strcmp(argv[n], "-min-time") == 0)
+            {
+                auto time = next_arg(argc, argv, n, "minimum time");
+                check_once(min_time_set, "-min-time");
+
+                char* end;
+                auto ms = std::strtoul(time, &end, 10);
+                if (*time == '\0' || *end != '\0' || ms > 3600000)
+                    throw usage_error(std::string("Invalid minimum time: ") + time);
+                options.config.min_time = std::chrono::milliseconds(ms);
+            }
+            else if (std::strcmp(argv[n], "-assets") == 0)
+            {
+                if (options.asset_path != nullptr)
+                    throw usage_error("The -assets option can only be used once");
+                options.asset_path = next_arg(argc, argv, n, "asset directory");
+            }
+            else if (std::strcmp(argv[n], "-o") == 0)
+            {
+                if (options.output_path != nullptr)
+                    throw usage_error("The -o option can only be used once");
+                options.output_path = next_arg(argc, argv, n, "output path");
+            }
+            else if (std::strcmp(argv[n], "-?") == 0 || std::strcmp(argv[n], "-help") == 0)
+            {
+                show_usage(std::filesystem::path(argv[0]).filename().string().c_str());
+                std::exit(EXIT_SUCCESS);
+            }
+            else
+                throw usage_error(std::string("Unrecognized argument: ") + argv[n]);
+        }
+
+        return options;
+    }
+
+    void show_usage(const char* invocation)
+    {
+        std::cout << "Usage:\n"
+            "    " << invocation << " [-size small|medium|large] [-seed <n>] [-filter <text>]...\n"
+            "        [-min-time <ms>] [-assets <directory>] [-o <output_path>]\n"
+            "\n"
+            "Runs the benchmark suite over synthetic inputs generated from the seed, so\n"
+            "that every run with the same size and seed measures the same data.  The\n"
+            "workload size is medium by default.\n"
+            "\n"
+            "Options:\n"
+            "    -filter    Runs only the benchmarks whose names contain the text; may be\n"
+            "               given more than once\n"
+            "    -min-time  Minimum time spent timing each benchmark (200 ms by default)\n"
+            "    -assets    Keeps the generated input files in the directory, instead of\n"
+            "               a temporary one that is removed afterwards\n"
+            "    -o         Writes the results as JSON to output_path instead of standard\n"
+            "               output; progress is always written to standard error\n";
+    }
+
+    void run_benchmarks(const program_options& options)
+    {
+        auto work = *wcdx::bench::find_workload(options.size);
+        if (options.seed_set)
+            work.seed = options.seed;
+
+        bool temporary = options.asset_path == nullptr;
+        if (temporary)
+            work.asset_directory = std::filesystem::temp_directory_path() / ("wcdx-bench-" + std::to_string(work.seed));
+        else
+            work.asset_directory = options.asset_path;
+
+        wcdx::bench::bench_runner runner(options.config);
+        {
+            at_scope_exit([&]
+            {
+                if (temporary)
+                {
+                    std::error_code ec;
+                    std::filesystem::remove_all(work.asset_directory, ec);
+                }
+            });
+
+            wcdx::bench::run_resource_benchmarks(runner, work);
+            wcdx::bench::run_image_benchmarks(runner, work);
+            wcdx::bench::run_audio_benchmarks(runner, work);
+            wcdx::bench::run_frame_benchmarks(runner, work);
+            wcdx::bench::run_font_benchmarks(runner, work);
+            wcdx::bench::run_trace_benchmarks(runner, work);
+            wcdx::bench::run_fileio_benchmarks(runner, work);
+            wcdx::bench::run_metrics_benchmarks(runner, work);
+        }
+
+        auto json = wcdx::bench::format_results_json(work, runner);
+        if (options.output_path == nullptr)
+        {
+            std::cout << json;
+            return;
+        }
+
+        std::ofstream output(options.output_path, std::ios::trunc);
+        if (!output || !(output << json) || !output.flush())
+            throw std::runtime_error(std::string("Can't write ") + options.output_path);
+    }
+}
@@ -0,0 +1,39 @@
+#ifndef BENCH_STREAMS_INCLUDED
+#define BENCH_STREAMS_INCLUDED
+#pragma once
+
+#include <stdext/stream.h>
+
+#include <vector>
+
+#include <cstddef>
+
+
+namespace wcdx::bench
+{
+    // Discards everything written to it.
+    class null_output_stream : public stdext::output_stream
+    {
+    private:
+        size_t do_write(const std::byte*, size_t size) override { return size; }
+    };
+
+    // Collects everything written to it.
+    class vector_output_stream : public stdext::output_stream
+    {
+    public:
+        std::vector<std::byte>& data() noexcept { return _data; }
+
+    private:
+        size_t do_write(const std::byte* buffer, size_t size) override
+        {
+            _data.insert(_data.end(), buffer, buffer + size);
+            return size;
+        }
+
+    private:
+        std::vector<std::byte> _data;
+    };
+}
+
+#endif
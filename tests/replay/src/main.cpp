@@ -0,0 +1,199 @@
+#include <frame/frame_converter.h>
+#include <frame/present_backend.h>
+#include <metrics/latency_histogram.h>
+#include <metrics/report.h>
+#include <trace/call_trace.h>
+#include <trace/trace_replay.h>
+
+#include <stdext/array_view.h>
+#include <stdext/stream.h>
+
+#include <chrono>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+
+
+namespace
+{
+    struct program_options
+    {
+        const char* input_path = nullptr;
+        unsigned loops = 1;
+    };
+
+    class usage_error : public std::runtime_error
+    {
+        using runtime_error::runtime_error;
+    };
+
+    program_options parse_args(int argc, char* argv[]);
+    void show_usage(const char* invocation);
+    std::vector<std::byte> read_file(const char* path);
+    void replay_trace(const program_options& options);
+}
+
+int main(int argc, char* argv[])
+{
+    std::string invocation = argc > 0 ? std::filesystem::path(argv[0]).filename().string() : "replay";
+
+    try
+    {
+        if (argc == 1)
+        {
+            show_usage(invocation.c_str());
+            return EXIT_SUCCESS;
+        }
+
+        auto options = parse_args(argc, argv);
+        replay_trace(options);
+        return EXIT_SUCCESS;
+    }
+    catch (const usage_error& e)
+    {
+        std::cerr << "Error: " << e.what() << '\n';
+        show_usage(invocation.c_str());
+    }
+    catch (const std::exception& e)
+    {
+        std::cerr << "Error: " << e.what() << '\n';
+    }
+    catch (...)
+    {
+        std::cerr << "Unknown error\n";
+    }
+
+    return EXIT_FAILURE;
+}
+
+namespace
+{
+    program_options parse_args(int argc, char* argv[])
+    {
+        program_options options;
+        bool loops_set = false;
+
+        for (int n = 1; n < argc; ++n)
+        {
+            if (argv[n][0] == '-')
+            {
+                if (std::strcmp(argv[n], "-loops") == 0)
+                {
+                    if (++n == argc)
+                        throw usage_error("Expected loop count");
+                    if (loops_set)
+                        throw usage_error("The -loops option can only be used once");
+
+                    char* end;
+                    auto loops = std::strtoul(argv[n], &end, 10);
+                    if (*end != '\0' || loops == 0 || loops > UINT32_MAX)
+                        throw usage_error(std::string("Invalid loop count: ") + argv[n]);
+                    options.loops = unsigned(loops);
+                    loops_set = true;
+                }
+                else
+                    throw usage_error(std::string("Unrecognized option: ") + argv[n]);
+            }
+            else
+            {
+                if (options.input_path != nullptr)
+                    throw usage_error(std::string("Unexpected argument: ") + argv[n]);
+                options.input_path = argv[n];
+            }
+        }
+
+        if (options.input_path == nullptr)
+            throw usage_error("Missing input path");
+
+        return options;
+    }
+
+    void show_usage(const char* invocation)
+    {
+        std::cout << "Usage:\n"
+            "    " << invocation << " [-loops <count>] <input_path>\n"
+            "\n"
+            "input_path is a call trace written by wcdx.  To record one, set the DWORD\n"
+            "value TraceCalls under HKEY_CURRENT_USER\\Software\\wcdx to 1; traces are\n"
+            "saved in the game's working directory.\n"
+            "\n"
+            "The trace is replayed as fast as possible into an in-memory surface, count\n"
+            "times over (once by default), and the time spent in each kind of call is\n"
+            "reported along with the number of frames presented per second.\n";
+    }
+
+    std::vector<std::byte> read_file(const char* path)
+    {
+        std::ifstream file(path, std::ios::binary);
+        if (!file)
+            throw std::runtime_error(std::string("Can't open ") + path);
+
+        std::vector<std::byte> data(size_t(std::filesystem::file_size(path)));
+        if (!file.read(reinterpret_cast<char*>(data.data()), std::streamsize(data.size())))
+            throw std::runtime_error(std::string("Can't read ") + path);
+
+        return data;
+    }
+
+    void replay_trace(const program_options& options)
+    {
+        using wcdx::trace::call_id;
+
+        // The whole trace is loaded up front so that file I/O stays out of
+        // the measurements; each loop starts over with a fresh frame.
+        auto data = read_file(options.input_path);
+
+        wcdx::metrics::latency_histogram histograms[size_t(call_id::count)];
+        std::chrono::steady_clock::duration elapsed { };
+        uint64_t call_count = 0;
+        uint64_t frame_count = 0;
+        uint64_t recorded_duration = 0;
+
+        for (unsigned loop = 0; loop != options.loops; ++loop)
+        {
+            stdext::memory_input_stream input(data.data(), data.size());
+            wcdx::trace::trace_reader reader(input);
+            wcdx::frame::frame_converter frame(reader.width(), reader.height());
+            wcdx::frame::software_backend backend(reader.width(), reader.height());
+
+            wcdx::trace::trace_record record;
+            while (reader.next(record))
+            {
+                auto start = std::chrono::steady_clock::now();
+                if (!wcdx::trace::replay(record, frame, backend))
+                    throw std::runtime_error("Presentation failed");
+                auto duration = std::chrono::steady_clock::now() - start;
+
+                histograms[size_t(record.call)].record(duration);
+                elapsed += duration;
+                recorded_duration = record.timestamp;
+                ++call_count;
+            }
+
+            frame_count += backend.presented_count();
+        }
+
+        // Only the calls that replay does anything with are worth reporting.
+        const call_id timed_calls[] = { call_id::set_palette, call_id::update_palette, call_id::update_frame, call_id::present };
+        std::vector<wcdx::metrics::named_histogram> report;
+        for (auto call : timed_calls)
+            report.push_back({ wcdx::trace::call_name(call), &histograms[size_t(call)] });
+
+        auto seconds = std::chrono::duration<double>(elapsed).count();
+        std::cout << call_count << " calls, " << frame_count << " frames replayed in "
+            << seconds * 1000.0 << " ms: " << (seconds > 0.0 ? double(frame_count) / seconds : 0.0) << " frames/s";
+        if (recorded_duration != 0)
+            std::cout << " (recorded at " << double(frame_count / options.loops) * 1e6 / double(recorded_duration) << " frames/s)";
+        std::cout << "\n\n"
+            << wcdx::metrics::format_report(stdext::array_view<const wcdx::metrics::named_histogram>(report.data(), report.size()));
+    }
+}
@@ -0,0 +1,128 @@
+#include "unit.h"
+
+#include <exception>
+#include <filesystem>
+#include <iostream>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include <cstdlib>
+#include <cstring>
+
+
+namespace
+{
+    struct test_case
+    {
+        const char* name;
+        void (*run)();
+    };
+
+    // Function-local so that registrars in other translation units can use it
+    // during static initialization.
+    std::vector<test_case>& test_cases()
+    {
+        static std::vector<test_case> cases;
+        return cases;
+    }
+
+    bool selected(std::string_view name, const std::vector<std::string_view>& filters)
+    {
+        if (filters.empty())
+            return true;
+
+        for (auto filter : filters)
+        {
+            if (name.find(filter) != std::string_view::npos)
+                return true;
+        }
+        return false;
+    }
+
+    void show_usage(const char* invocation);
+}
+
+namespace wcdx::unit
+{
+    registrar::registrar(const char* name, void (*run)())
+    {
+        test_cases().push_back({ name, run });
+    }
+
+    void fail(const char* file, int line, const std::string& message)
+    {
+        throw test_failure(std::filesystem::path(file).filename().string() + "(" + std::to_string(line) + "): " + message);
+    }
+}
+
+int main(int argc, char* argv[])
+{
+    std::string invocation = argc > 0 ? std::filesystem::path(argv[0]).filename().string() : "unit";
+
+    std::vector<std::string_view> filters;
+    bool list = false;
+    for (int n = 1; n < argc; ++n)
+    {
+        if (std::strcmp(argv[n], "-list") == 0)
+            list = true;
+        else if (argv[n][0] == '-')
+        {
+            std::cerr << "Error: Unrecognized option: " << argv[n] << '\n';
+            show_usage(invocation.c_str());
+            return EXIT_FAILURE;
+        }
+        else
+            filters.push_back(argv[n]);
+    }
+
+    unsigned run_count = 0;
+    unsigned failed_count = 0;
+    for (auto& t : test_cases())
+    {
+        if (!selected(t.name, filters))
+            continue;
+
+        if (list)
+        {
+            std::cout << t.name << '\n';
+            continue;
+        }
+
+        ++run_count;
+        try
+        {
+            t.run();
+        }
+        catch (const std::exception& e)
+        {
+            ++failed_count;
+            std::cout << "FAILED " << t.name << ": " << e.what() << '\n';
+            continue;
+        }
+        catch (...)
+        {
+            ++failed_count;
+            std::cout << "FAILED " << t.name << ": Unknown exception\n";
+            continue;
+        }
+
+        std::cout << "passed " << t.name << '\n';
+    }
+
+    if (!list)
+        std::cout << '\n' << run_count - failed_count << " of " << run_count << " tests passed\n";
+    return failed_count == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+namespace
+{
+    void show_usage(const char* invocation)
+    {
+        std::cout << "Usage:\n"
+            "    " << invocation << " [-list] [<filter>...]\n"
+            "\n"
+            "Runs the tests whose names contain any of the filters, or every test if\n"
+            "none are given.  With -list, the selected tests are listed rather than run.\n";
+    }
+}
@@ -0,0 +1,314 @@
+#include "unit.h"
+
+#include <resource/archive.h>
+#include <resource/lzw.h>
+
+#include <stdext/array_view.h>
+
+#include <algorithm>
+#include <list>
+#include <map>
+#include <numeric>
+#include <stdexcept>
+#include <vector>
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+
+namespace
+{
+    struct test_resource
+    {
+        std::vector<std::byte> contents;
+        uint8_t type;
+    };
+
+    stdext::array_view<const std::byte> view(const std::vector<std::byte>& data)
+    {
+        return stdext::array_view<const std::byte>(data.data(), data.size());
+    }
+
+    std::vector<std::byte> random_bytes(wcdx::unit::random& rng, size_t size)
+    {
+        // Few distinct values, so that compression has something to find.
+        std::vector<std::byte> data(size);
+        for (auto& b : data)
+            b = std::byte(rng.below(4));
+        return data;
+    }
+
+    std::vector<std::byte> stored_form(const test_resource& resource)
+    {
+        if (resource.type != wcdx::resource::resource_type_compressed)
+            return resource.contents;
+
+        auto size = uint32_t(resource.contents.size());
+        std::vector<std::byte> stored(reinterpret_cast<const std::byte*>(&size), reinterpret_cast<const std::byte*>(&size) + sizeof(size));
+        auto compressed = wcdx::resource::lzw_compress(view(resource.contents));
+        stored.insert(stored.end(), compressed.begin(), compressed.end());
+        return stored;
+    }
+
+    // Lays out an archive with the resources stored in the given order, which
+    // needn't be the order of the offset table.  Returns the archive and the
+    // stored form of each resource.
+    std::vector<std::byte> make_archive(const std::vector<test_resource>& resources, const std::vector<size_t>& file_order, std::vector<std::vector<std::byte>>& stored)
+    {
+        std::vector<std::byte> data(4 + (4 * resources.size()));
+        stored.assign(resources.size(), { });
+        for (auto n : file_order)
+        {
+            stored[n] = stored_form(resources[n]);
+            auto descriptor = uint32_t(data.size()) | (uint32_t(resources[n].type) << 24);
+            std::memcpy(data.data() + 4 + (4 * n), &descriptor, sizeof(descriptor));
+            data.insert(data.end(), stored[n].begin(), stored[n].end());
+        }
+
+        auto total = uint32_t(data.size());
+        std::memcpy(data.data(), &total, sizeof(total));
+        return data;
+    }
+
+    std::vector<size_t> in_order(size_t count)
+    {
+        std::vector<size_t> order(count);
+        std::iota(order.begin(), order.end(), size_t(0));
+        return order;
+    }
+}
+
+UNIT_TEST(archive_entries_and_extraction)
+{
+    wcdx::unit::random rng(1);
+    std::vector<test_resource> resources;
+    for (size_t size : { 0, 1, 3, 4, 5, 100, 4096, 30000 })
+    {
+        resources.push_back({ random_bytes(rng, size), wcdx::resource::resource_type_uncompressed });
+        resources.push_back({ random_bytes(rng, size), wcdx::resource::resource_type_compressed });
+    }
+
+    // Stored in the table's order, in reverse, and shuffled.  The first
+    // resource stays first, since its offset gives the size of the table.
+    auto order = in_order(resources.size());
+    for (unsigned layout = 0; layout != 3; ++layout)
+    {
+        if (layout == 1)
+            std::reverse(order.begin() + 1, order.end());
+        else if (layout == 2)
+        {
+            for (auto n = order.size(); n > 2; --n)
+                std::swap(order[n - 1], order[1 + rng.below(uint32_t(n - 1))]);
+        }
+
+        std::vector<std::vector<std::byte>> stored;
+        auto data = make_archive(resources, order, stored);
+        wcdx::resource::archive archive(view(data));
+        UNIT_CHECK_EQUAL(archive.size(), resources.size());
+        UNIT_CHECK(archive.data().data() == data.data());
+
+        for (size_t n = 0; n != resources.size(); ++n)
+        {
+            auto& entry = archive.entry(n);
+            UNIT_CHECK_EQUAL(entry.type, resources[n].type);
+            UNIT_CHECK_EQUAL(entry.size, stored[n].size());
+            UNIT_CHECK(entry.offset + entry.size <= data.size());
+
+            // Each span holds exactly the resource as stored.
+            auto span = archive.stored_data(n);
+            UNIT_CHECK(span.data() == data.data() + entry.offset);
+            UNIT_CHECK_EQUAL(span.size(), stored[n].size());
+            UNIT_CHECK(std::equal(span.begin(), span.end(), stored[n].begin(), stored[n].end()));
+
+            UNIT_CHECK_EQUAL(archive.uncompressed_size(n), resources[n].contents.size());
+            UNIT_CHECK(archive.extract(n) == resources[n].contents);
+
+            std::vector<std::byte> output(resources[n].contents.size());
+            archive.extract(n, stdext::array_view<std::byte>(output.data(), output.size()));
+            UNIT_CHECK(output == resources[n].contents);
+
+            output.resize(output.size() + 1);
+            UNIT_CHECK_THROWS(std::length_error, archive.extract(n, stdext::array_view<std::byte>(output.data(), output.size())));
+        }
+
+        UNIT_CHECK_THROWS(std::range_error, archive.entry(resources.size()));
+        UNIT_CHECK_THROWS(std::range_error, archive.extract(resources.size()));
+    }
+}
+
+UNIT_TEST(archive_rejects_invalid_tables)
+{
+    wcdx::unit::random rng(2);
+    std::vector<test_resource> resources;
+    for (unsigned n = 0; n != 4; ++n)
+        resources.push_back({ random_bytes(rng, 50), uint8_t(n % 2) });
+    std::vector<std::vector<std::byte>> stored;
+    auto data = make_archive(resources, in_order(resources.size()), stored);
+
+    // Too short to hold a table.
+    for (size_t size = 0; size != 8; ++size)
+    {
+        std::vector<std::byte> truncated(data.begin(), data.begin() + size);
+        UNIT_CHECK_THROWS(std::runtime_error, wcdx::resource::archive(view(truncated)));
+    }
+
+    auto with_descriptor = [&](size_t n, uint32_t descriptor)
+    {
+        auto damaged = data;
+        std::memcpy(damaged.data() + 4 + (4 * n), &descriptor, sizeof(descriptor));
+        return damaged;
+    };
+
+    // A first offset that isn't word aligned, leaves no room for the table,
+    // or lies past the end.
+    for (uint32_t offset : { 6u, 4u, 0u, uint32_t(data.size()) + 4 })
+    {
+        auto damaged = with_descriptor(0, offset);
+        UNIT_CHECK_THROWS(std::runtime_error, wcdx::resource::archive(view(damaged)));
+    }
+
+    // Later offsets inside the table or past the end.
+    for (uint32_t offset : { 4u, 8u, uint32_t(data.size()) + 1 })
+    {
+        auto damaged = with_descriptor(2, offset);
+        UNIT_CHECK_THROWS(std::runtime_error, wcdx::resource::archive(view(damaged)));
+    }
+
+    // A total size shorter than the data cuts the last resource short, and a
+    // compressed resource too short for its size can't be extracted.
+    auto damaged = data;
+    auto total = uint32_t(data.size() - 10);
+    std::memcpy(damaged.data(), &total, sizeof(total));
+    wcdx::resource::archive archive(view(damaged));
+    UNIT_CHECK_EQUAL(archive.stored_data(3).size(), stored[3].size() - 10);
+    UNIT_CHECK_THROWS(std::runtime_error, archive.extract(3));
+
+    auto last_offset = archive.entry(3).offset;
+    total = last_offset + 2;
+    std::memcpy(damaged.data(), &total, sizeof(total));
+    UNIT_CHECK_THROWS(std::runtime_error, wcdx::resource::archive(view(damaged)).uncompressed_size(3));
+}
+
+UNIT_TEST(resource_cache_evicts_least_recently_used)
+{
+    // Six compressed resources of 100 bytes, one of 500 and one left
+    // uncompressed, with room in the cache for three of the small ones.
+    wcdx::unit::random rng(3);
+    std::vector<test_resource> resources;
+    for (unsigned n = 0; n != 6; ++n)
+        resources.push_back({ random_bytes(rng, 100), wcdx::resource::resource_type_compressed });
+    resources.push_back({ random_bytes(rng, 500), wcdx::resource::resource_type_compressed });
+    resources.push_back({ random_bytes(rng, 100), wcdx::resource::resource_type_uncompressed });
+
+    std::vector<std::vector<std::byte>> stored;
+    auto data = make_archive(resources, in_order(resources.size()), stored);
+    wcdx::resource::archive archive(view(data));
+    wcdx::resource::resource_cache cache(archive, 300);
+
+    // Views are kept for as long as the test runs, so an evicted buffer
+    // can't be freed and its address reused by the next extraction; a hit
+    // hands out the same buffer again, a miss a new one.
+    std::list<wcdx::resource::resource_view> kept;
+    std::map<size_t, const std::byte*> buffers;
+    auto hit = [&](size_t index)
+    {
+        auto view = cache.get(index);
+        UNIT_CHECK(std::equal(view.data().begin(), view.data().end(), resources[index].contents.begin(), resources[index].contents.end()));
+
+        auto i = buffers.find(index);
+        auto result = i != buffers.end() && i->second == view.data().data();
+        buffers[index] = view.data().data();
+        kept.push_back(view);
+        return result;
+    };
+
+    UNIT_CHECK(!hit(0));
+    UNIT_CHECK(!hit(1));
+    UNIT_CHECK(!hit(2));
+    UNIT_CHECK(hit(0));         // recent: 0 2 1
+    UNIT_CHECK(!hit(3));        // evicts 1; recent: 3 0 2
+    UNIT_CHECK(hit(2));         // recent: 2 3 0
+    UNIT_CHECK(hit(0));         // recent: 0 2 3
+    UNIT_CHECK(!hit(1));        // evicts 3; recent: 1 0 2
+    UNIT_CHECK(hit(2));
+    UNIT_CHECK(hit(1));
+    UNIT_CHECK(hit(0));         // recent: 0 1 2
+
+    // Uncompressed resources are handed out in place and don't count.
+    auto in_place = cache.get(7);
+    UNIT_CHECK(in_place.data().data() == data.data() + archive.entry(7).offset);
+    UNIT_CHECK_EQUAL(in_place.data().size(), 100u);
+    UNIT_CHECK(hit(2) && hit(1) && hit(0));
+
+    // A resource larger than the whole budget pushes out everything else but
+    // is kept itself, until the next one arrives.
+    UNIT_CHECK(!hit(6));
+    UNIT_CHECK(hit(6));
+    UNIT_CHECK(!hit(0));        // evicts 6
+    UNIT_CHECK(!hit(6));        // evicts 0
+    UNIT_CHECK(!hit(1));        // evicts 6
+    UNIT_CHECK(!hit(2));
+    UNIT_CHECK(!hit(3));        // exactly at capacity; recent: 3 2 1
+    UNIT_CHECK(hit(1) && hit(2) && hit(3));
+
+    // Evicted buffers live on in the views handed out earlier.
+    for (auto& view : kept)
+        UNIT_CHECK(std::any_of(resources.begin(), resources.end(), [&](const test_resource& r) { return std::equal(view.data().begin(), view.data().end(), r.contents.begin(), r.contents.end()); }));
+}
+
+UNIT_TEST(resource_cache_matches_lru_model)
+{
+    wcdx::unit::random rng(4);
+    std::vector<test_resource> resources;
+    for (unsigned n = 0; n != 24; ++n)
+        resources.push_back({ random_bytes(rng, 1 + rng.below(2000)), uint8_t(rng.below(5) == 0 ? wcdx::resource::resource_type_uncompressed : wcdx::resource::resource_type_compressed) });
+
+    std::vector<std::vector<std::byte>> stored;
+    auto data = make_archive(resources, in_order(resources.size()), stored);
+    wcdx::resource::archive archive(view(data));
+
+    for (size_t capacity : { size_t(0), size_t(1500), size_t(6000), size_t(20000), size_t(100000) })
+    {
+        // The last view of each resource is kept until the next lookup of
+        // it, so the old buffer is still alive when a new one is allocated.
+        wcdx::resource::resource_cache cache(archive, capacity);
+        std::map<size_t, wcdx::resource::resource_view> latest;
+
+        // The cache as it should be: most recently used first, dropping from
+        // the back while over capacity but always keeping the newest.
+        std::list<size_t> model;
+        size_t model_size = 0;
+
+        for (unsigned lookup = 0; lookup != 2000; ++lookup)
+        {
+            auto index = size_t(rng.below(rng.below(3) == 0 ? 24 : 6));
+            auto view = cache.get(index);
+            UNIT_CHECK(std::equal(view.data().begin(), view.data().end(), resources[index].contents.begin(), resources[index].contents.end()));
+            if (resources[index].type != wcdx::resource::resource_type_compressed)
+            {
+                UNIT_CHECK(view.data().data() == archive.stored_data(index).data());
+                continue;
+            }
+
+            auto i = latest.find(index);
+            auto hit = i != latest.end() && i->second.data().data() == view.data().data();
+            latest[index] = view;
+
+            auto position = std::find(model.begin(), model.end(), index);
+            UNIT_CHECK_EQUAL(hit, position != model.end());
+            if (position != model.end())
+                model.splice(model.begin(), model, position);
+            else
+            {
+                model.push_front(index);
+                model_size += resources[index].contents.size();
+                while (model_size > capacity && model.size() > 1)
+                {
+                    model_size -= resources[model.back()].contents.size();
+                    model.pop_back();
+                }
+            }
+        }
+    }
+}
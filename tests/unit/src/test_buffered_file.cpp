@@ -0,0 +1,353 @@
+#include "unit.h"
+
+#include <fileio/buffered_file.h>
+
+#include <algorithm>
+#include <memory>
+#include <vector>
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+
+namespace
+{
+    using wcdx::fileio::buffered_file;
+    using wcdx::fileio::seek_origin;
+
+    constexpr int64_t block_size = int64_t(buffered_file::block_size);
+
+    // A file held in memory that can be made to fail its writes.
+    class memory_device : public wcdx::fileio::file_device
+    {
+    public:
+        memory_device(std::vector<std::byte>& data, const bool& fail_writes) noexcept : _data(data), _fail_writes(fail_writes) { }
+
+    public:
+        int64_t seek(int64_t offset, seek_origin origin) override
+        {
+            auto base = origin == seek_origin::begin ? 0 : origin == seek_origin::current ? _position : int64_t(_data.size());
+            if (base + offset < 0)
+                return -1;
+            return _position = base + offset;
+        }
+
+        int64_t read(void* data, size_t size) override
+        {
+            auto count = size_t(std::clamp<int64_t>(int64_t(_data.size()) - _position, 0, int64_t(size)));
+            if (count != 0)
+                std::memcpy(data, _data.data() + _position, count);
+            _position += int64_t(count);
+            return int64_t(count);
+        }
+
+        int64_t write(const void* data, size_t size) override
+        {
+            if (_fail_writes)
+                return -1;
+
+            if (size_t(_position) + size > _data.size())
+                _data.resize(size_t(_position) + size);
+            std::memcpy(_data.data() + _position, data, size);
+            _position += int64_t(size);
+            return int64_t(size);
+        }
+
+        int64_t length() override { return int64_t(_data.size()); }
+
+    private:
+        std::vector<std::byte>& _data;
+        const bool& _fail_writes;
+        int64_t _position = 0;
+    };
+
+    // What the same requests do to an unbuffered file.
+    class reference_file
+    {
+    public:
+        explicit reference_file(std::vector<std::byte> data) : _data(std::move(data)) { }
+
+    public:
+        int64_t read(int64_t offset, void* data, size_t size)
+        {
+            if (offset != buffered_file::current_position)
+                _position = offset;
+
+            auto count = size_t(std::clamp<int64_t>(int64_t(_data.size()) - _position, 0, int64_t(size)));
+            if (count != 0)
+                std::memcpy(data, _data.data() + _position, count);
+            _position += int64_t(count);
+            return int64_t(count);
+        }
+
+        int64_t write(int64_t offset, const void* data, size_t size)
+        {
+            if (offset != buffered_file::current_position)
+                _position = offset;
+
+            if (size == 0)
+                return 0;
+            if (size_t(_position) + size > _data.size())
+                _data.resize(size_t(_position) + size);
+            std::memcpy(_data.data() + _position, data, size);
+            _position += int64_t(size);
+            return int64_t(size);
+        }
+
+        int64_t seek(int64_t offset, seek_origin origin)
+        {
+            auto base = origin == seek_origin::begin ? 0 : origin == seek_origin::current ? _position : int64_t(_data.size());
+            if (base + offset < 0)
+                return -1;
+            return _position = base + offset;
+        }
+
+        int64_t length() const noexcept { return int64_t(_data.size()); }
+        int64_t position() const noexcept { return _position; }
+        const std::vector<std::byte>& data() const noexcept { return _data; }
+
+    private:
+        std::vector<std::byte> _data;
+        int64_t _position = 0;
+    };
+
+    enum class op_kind
+    {
+        read,
+        write,
+        seek,
+        length,
+        flush
+    };
+
+    struct op
+    {
+        op_kind kind;
+        int64_t offset;     // or buffered_file::current_position
+        size_t size = 0;
+        seek_origin origin = seek_origin::begin;
+    };
+
+    std::vector<std::byte> make_bytes(wcdx::unit::random& rng, size_t size)
+    {
+        std::vector<std::byte> bytes(size);
+        for (auto& b : bytes)
+            b = std::byte(rng.next());
+        return bytes;
+    }
+
+    // Replays a trace through a buffered_file and the reference, checking each
+    // result, the position after each request, and the bytes on the device
+    // after each flush.
+    class trace_replay
+    {
+    public:
+        explicit trace_replay(size_t file_size, uint64_t seed = 1)
+            : _rng(seed), _device_data(make_bytes(_rng, file_size)), _reference(_device_data)
+            , _file(std::make_unique<memory_device>(_device_data, _fail_writes))
+        {
+        }
+
+    public:
+        void run(const op& o)
+        {
+            switch (o.kind)
+            {
+            case op_kind::read:
+            {
+                std::vector<std::byte> actual(o.size, std::byte(0xCD));
+                std::vector<std::byte> expected(o.size, std::byte(0xCD));
+                UNIT_CHECK_EQUAL(_file.read(o.offset, actual.data(), o.size), _reference.read(o.offset, expected.data(), o.size));
+                UNIT_CHECK(actual == expected);
+                break;
+            }
+
+            case op_kind::write:
+            {
+                auto bytes = make_bytes(_rng, o.size);
+                UNIT_CHECK_EQUAL(_file.write(o.offset, bytes.data(), o.size), _reference.write(o.offset, bytes.data(), o.size));
+                break;
+            }
+
+            case op_kind::seek:
+                UNIT_CHECK_EQUAL(_file.seek(o.offset, o.origin), _reference.seek(o.offset, o.origin));
+                break;
+
+            case op_kind::length:
+                UNIT_CHECK_EQUAL(_file.length(), _reference.length());
+                break;
+
+            case op_kind::flush:
+                UNIT_CHECK(_file.flush());
+                UNIT_CHECK(_device_data == _reference.data());
+                break;
+            }
+            UNIT_CHECK_EQUAL(_file.position(), _reference.position());
+        }
+
+        void run(const std::vector<op>& trace)
+        {
+            for (auto& o : trace)
+                run(o);
+            run({ op_kind::flush, 0 });
+        }
+
+        buffered_file& file() noexcept { return _file; }
+        std::vector<std::byte>& device_data() noexcept { return _device_data; }
+        void fail_writes(bool fail) noexcept { _fail_writes = fail; }
+
+    private:
+        wcdx::unit::random _rng;
+        std::vector<std::byte> _device_data;
+        bool _fail_writes = false;
+        reference_file _reference;
+        buffered_file _file;
+    };
+}
+
+UNIT_TEST(buffered_file_fixed_trace)
+{
+    constexpr auto cur = buffered_file::current_position;
+
+    // Three full blocks and a short one.
+    trace_replay replay(size_t(3 * block_size + 1000));
+    replay.run({
+        // Small sequential reads served from one block.
+        { op_kind::read, 0, 100 },
+        { op_kind::read, cur, 100 },
+        { op_kind::read, cur, 300 },
+
+        // Read-after-write inside the cached block, both overlapping the
+        // write and straddling its ends.
+        { op_kind::write, 150, 50 },
+        { op_kind::read, 100, 200 },
+        { op_kind::write, cur, 10 },
+        { op_kind::read, 190, 40 },
+        { op_kind::read, cur, 100 },
+
+        // Across a block boundary, and a large read that bypasses the cache.
+        { op_kind::read, block_size - 10, 20 },
+        { op_kind::read, 5, size_t(block_size + 7) },
+        { op_kind::read, cur, 10 },
+
+        // The short final block: a read ending inside it, one running off
+        // its end, and reads at and past the end of the file.
+        { op_kind::read, 3 * block_size + 900, 50 },
+        { op_kind::read, cur, 100 },
+        { op_kind::read, cur, 100 },
+        { op_kind::read, 3 * block_size + 1000, 10 },
+        { op_kind::read, 4 * block_size + 1, 10 },
+
+        // Writes that extend the short block, then reads of it.
+        { op_kind::read, 3 * block_size, 10 },
+        { op_kind::write, 3 * block_size + 990, 30 },
+        { op_kind::read, 3 * block_size + 980, 100 },
+        { op_kind::length, 0 },
+
+        // A write past the span of the short block means it no longer ends
+        // the file.
+        { op_kind::read, 3 * block_size + 900, 10 },
+        { op_kind::write, 4 * block_size + 10, 10 },
+        { op_kind::read, 3 * block_size + 1000, 100 },
+
+        // A seek past the end followed by a write leaves a gap of zeros.
+        { op_kind::seek, 5000, 0, seek_origin::end },
+        { op_kind::write, cur, 20 },
+        { op_kind::length, 0 },
+        { op_kind::read, 3 * block_size + 1000, 6000 },
+        { op_kind::read, 3 * block_size + 1000, size_t(2 * block_size) },
+        { op_kind::seek, -10, 0, seek_origin::current },
+        { op_kind::read, cur, 30 },
+
+        // Coalesced writes that outgrow the pending buffer, and a large write.
+        { op_kind::write, 1000, 4000 },
+        { op_kind::write, cur, 4000 },
+        { op_kind::write, cur, 4000 },
+        { op_kind::write, cur, 5000 },
+        { op_kind::read, 900, 20000 },
+        { op_kind::write, 2 * block_size + 1, size_t(block_size + 3) },
+        { op_kind::read, 2 * block_size - 5, 100 },
+        { op_kind::flush, 0 },
+        { op_kind::seek, 0, 0, seek_origin::end },
+        { op_kind::read, cur, 10 },
+    });
+}
+
+UNIT_TEST(buffered_file_generated_traces)
+{
+    constexpr auto cur = buffered_file::current_position;
+
+    for (uint64_t seed = 1; seed <= 50; ++seed)
+    {
+        wcdx::unit::random rng(seed);
+        auto file_size = size_t(rng.below(uint32_t(4 * block_size)));
+        trace_replay replay(file_size, seed);
+
+        for (unsigned n = 0; n != 400; ++n)
+        {
+            auto offset = rng.below(4) == 0 ? cur : int64_t(rng.below(uint32_t(5 * block_size)));
+            auto size = size_t(rng.below(16) == 0 ? rng.below(uint32_t(2 * block_size)) : rng.below(600));
+            switch (rng.below(10))
+            {
+            case 0:
+                replay.run({ op_kind::seek, int64_t(rng.below(2000)) - 1000, 0, rng.below(2) == 0 ? seek_origin::current : seek_origin::end });
+                break;
+
+            case 1:
+                replay.run({ op_kind::length, 0 });
+                break;
+
+            case 2:
+                replay.run({ op_kind::flush, 0 });
+                break;
+
+            case 3:
+            case 4:
+            case 5:
+                replay.run({ op_kind::write, offset, size });
+                break;
+
+            default:
+                replay.run({ op_kind::read, offset, size });
+                break;
+            }
+        }
+        replay.run({ op_kind::flush, 0 });
+    }
+}
+
+UNIT_TEST(buffered_file_deferred_write_failure)
+{
+    trace_replay replay(size_t(block_size + 100));
+    auto original = replay.device_data();
+
+    // The write is buffered, so it succeeds; the failure shows up on flush().
+    std::byte bytes[40] = { };
+    replay.fail_writes(true);
+    UNIT_CHECK_EQUAL(replay.file().write(10, bytes, sizeof(bytes)), int64_t(sizeof(bytes)));
+    UNIT_CHECK_EQUAL(replay.file().position(), 50);
+    UNIT_CHECK(!replay.file().flush());
+    UNIT_CHECK(replay.device_data() == original);
+
+    // The failed data is dropped rather than retried, and the file can still
+    // be used once the device recovers.
+    replay.fail_writes(false);
+    UNIT_CHECK(replay.file().flush());
+    UNIT_CHECK(replay.device_data() == original);
+
+    std::byte read_back[60];
+    UNIT_CHECK_EQUAL(replay.file().read(0, read_back, sizeof(read_back)), int64_t(sizeof(read_back)));
+    UNIT_CHECK(std::equal(read_back, read_back + sizeof(read_back), original.begin()));
+
+    UNIT_CHECK_EQUAL(replay.file().write(block_size, bytes, sizeof(bytes)), int64_t(sizeof(bytes)));
+    UNIT_CHECK(replay.file().flush());
+    UNIT_CHECK(std::equal(bytes, bytes + sizeof(bytes), replay.device_data().begin() + block_size));
+
+    // A failure is also reported by the request that triggers the flush.
+    replay.fail_writes(true);
+    UNIT_CHECK_EQUAL(replay.file().write(0, bytes, sizeof(bytes)), int64_t(sizeof(bytes)));
+    UNIT_CHECK_EQUAL(replay.file().read(500, read_back, sizeof(read_back)), -1);
+    replay.fail_writes(false);
+    UNIT_CHECK_EQUAL(replay.file().length(), int64_t(original.size()));
+}
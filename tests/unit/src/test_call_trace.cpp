@@ -0,0 +1,391 @@
+#include "unit.h"
+
+#include <trace/call_trace.h>
+#include <trace/trace_replay.h>
+
+#include <frame/frame_converter.h>
+#include <frame/present_backend.h>
+
+#include <stdext/stream.h>
+
+#include <algorithm>
+#include <stdexcept>
+#include <vector>
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+
+namespace
+{
+    using wcdx::trace::call_id;
+
+    constexpr unsigned frame_width = 320;
+    constexpr unsigned frame_height = 200;
+
+    // What a trace should decode to, and the frame it should leave behind.
+    struct expected_call
+    {
+        call_id call = call_id::count;
+        std::vector<uint32_t> palette;
+        unsigned index = 0;
+        uint32_t color = 0;
+        int x = 0;
+        int y = 0;
+        unsigned width = 0;
+        unsigned height = 0;
+        std::vector<std::byte> pixels;     // packed
+    };
+
+    class trace_script
+    {
+    public:
+        explicit trace_script(wcdx::trace::trace_writer& writer) noexcept : _writer(writer)
+        {
+            std::fill_n(_palette, std::size(_palette), uint32_t(0xFF000000));
+        }
+
+    public:
+        void set_palette(const uint32_t colors[256])
+        {
+            _writer.set_palette(colors);
+            expected_call call;
+            call.call = call_id::set_palette;
+            call.palette.assign(colors, colors + 256);
+            _calls.push_back(std::move(call));
+            std::copy_n(colors, 256, _palette);
+        }
+
+        void update_palette(unsigned index, uint32_t color)
+        {
+            _writer.update_palette(index, color);
+            expected_call call;
+            call.call = call_id::update_palette;
+            call.index = index;
+            call.color = color;
+            _calls.push_back(std::move(call));
+            _palette[index] = color;
+        }
+
+        void update_frame(int x, int y, unsigned width, unsigned height, size_t pitch, const std::byte* bits)
+        {
+            _writer.update_frame(x, y, width, height, pitch, bits);
+            expected_call call;
+            call.call = call_id::update_frame;
+            call.x = x;
+            call.y = y;
+            call.width = width;
+            call.height = height;
+            for (unsigned row = 0; row != height; ++row)
+                call.pixels.insert(call.pixels.end(), bits + (pitch * row), bits + (pitch * row) + width);
+            _calls.push_back(std::move(call));
+
+            // Clipped to the frame, independently of the frame library.
+            for (unsigned row = 0; row != height; ++row)
+            {
+                for (unsigned column = 0; column != width; ++column)
+                {
+                    auto frame_x = int64_t(x) + column;
+                    auto frame_y = int64_t(y) + row;
+                    if (frame_x >= 0 && frame_x < frame_width && frame_y >= 0 && frame_y < frame_height)
+                        _frame[size_t(frame_y) * frame_width + size_t(frame_x)] = bits[pitch * row + column];
+                }
+            }
+        }
+
+        void record(call_id id)
+        {
+            _writer.record(id);
+            expected_call call;
+            call.call = id;
+            _calls.push_back(std::move(call));
+        }
+
+        const std::vector<expected_call>& calls() const noexcept { return _calls; }
+
+        std::vector<wcdx::frame::color> expanded_frame() const
+        {
+            std::vector<wcdx::frame::color> expanded(_frame.size());
+            for (size_t n = 0; n != _frame.size(); ++n)
+                expanded[n] = _palette[uint8_t(_frame[n])];
+            return expanded;
+        }
+
+    private:
+        wcdx::trace::trace_writer& _writer;
+        std::vector<expected_call> _calls;
+        std::vector<std::byte> _frame = std::vector<std::byte>(size_t(frame_width) * frame_height);
+        uint32_t _palette[256];
+    };
+
+    std::vector<std::byte> random_bits(wcdx::unit::random& rng, size_t size)
+    {
+        std::vector<std::byte> bits(size);
+        for (auto& b : bits)
+            b = std::byte(rng.next());
+        return bits;
+    }
+
+    // Records a short session: palette loads and cycling, updates that hang
+    // off each edge with a pitch wider than the update, one update too big
+    // for the writer's buffer, and presents between them.
+    std::vector<std::byte> record_session(std::vector<expected_call>& calls, std::vector<wcdx::frame::color>& final_frame)
+    {
+        wcdx::unit::random rng(7);
+        wcdx::unit::vector_output_stream output;
+        {
+            wcdx::trace::trace_writer writer(frame_width, frame_height, output);
+            trace_script script(writer);
+
+            uint32_t palette[256];
+            for (auto& entry : palette)
+                entry = uint32_t(rng.next()) | 0xFF000000;
+            script.set_palette(palette);
+            script.record(call_id::set_visible);
+
+            auto full = random_bits(rng, size_t(frame_width) * frame_height);
+            script.update_frame(0, 0, frame_width, frame_height, frame_width, full.data());
+            script.record(call_id::present);
+
+            struct { int x, y; unsigned width, height; size_t pitch; } updates[] =
+            {
+                { -3, -2, 10, 7, 13 },
+                { frame_width - 5, 40, 12, 9, 16 },
+                { 100, frame_height - 3, 20, 11, 20 },
+                { -50, -60, 40, 50, 41 },
+                { 17, 23, 33, 29, 64 },
+                { -10, 150, 700, 400, 703 },
+            };
+            for (auto& u : updates)
+            {
+                auto bits = random_bits(rng, u.pitch * u.height);
+                script.update_frame(u.x, u.y, u.width, u.height, u.pitch, bits.data());
+                script.update_palette(rng.below(256), uint32_t(rng.next()));
+                script.record(call_id::present);
+                script.record(call_id::is_full_screen);
+            }
+
+            for (unsigned n = 0; n != 20; ++n)
+                script.update_palette(rng.below(256), uint32_t(rng.next()));
+            script.record(call_id::fill_snow);
+            script.record(call_id::present);
+
+            writer.flush();
+            UNIT_CHECK(!writer.failed());
+            calls = script.calls();
+            final_frame = script.expanded_frame();
+        }
+        return output.data();
+    }
+}
+
+UNIT_TEST(trace_round_trip)
+{
+    std::vector<expected_call> calls;
+    std::vector<wcdx::frame::color> final_frame;
+    auto data = record_session(calls, final_frame);
+
+    stdext::memory_input_stream input(data.data(), data.size());
+    wcdx::trace::trace_reader reader(input);
+    UNIT_CHECK_EQUAL(reader.width(), frame_width);
+    UNIT_CHECK_EQUAL(reader.height(), frame_height);
+
+    uint64_t last_timestamp = 0;
+    wcdx::trace::trace_record record;
+    for (auto& expected : calls)
+    {
+        UNIT_CHECK(reader.next(record));
+        UNIT_CHECK(record.call == expected.call);
+        UNIT_CHECK(record.timestamp >= last_timestamp);
+        last_timestamp = record.timestamp;
+
+        switch (expected.call)
+        {
+        case call_id::set_palette:
+            UNIT_CHECK(std::equal(expected.palette.begin(), expected.palette.end(), record.palette));
+            break;
+
+        case call_id::update_palette:
+            UNIT_CHECK_EQUAL(record.index, expected.index);
+            UNIT_CHECK_EQUAL(record.color, expected.color);
+            break;
+
+        case call_id::update_frame:
+            UNIT_CHECK_EQUAL(record.x, expected.x);
+            UNIT_CHECK_EQUAL(record.y, expected.y);
+            UNIT_CHECK_EQUAL(record.width, expected.width);
+            UNIT_CHECK_EQUAL(record.height, expected.height);
+            UNIT_CHECK(std::equal(expected.pixels.begin(), expected.pixels.end(), record.pixels));
+            break;
+
+        default:
+            break;
+        }
+    }
+    UNIT_CHECK(!reader.next(record));
+}
+
+UNIT_TEST(trace_replay_matches_frame)
+{
+    std::vector<expected_call> calls;
+    std::vector<wcdx::frame::color> final_frame;
+    auto data = record_session(calls, final_frame);
+
+    stdext::memory_input_stream input(data.data(), data.size());
+    wcdx::trace::trace_reader reader(input);
+    wcdx::frame::frame_converter converter(reader.width(), reader.height());
+    wcdx::frame::software_backend backend(reader.width(), reader.height());
+
+    wcdx::trace::trace_record record;
+    while (reader.next(record))
+        UNIT_CHECK(wcdx::trace::replay(record, converter, backend));
+
+    auto presents = std::count_if(calls.begin(), calls.end(), [](auto& call) { return call.call == call_id::present; });
+    UNIT_CHECK_EQUAL(backend.presented_count(), uint64_t(presents));
+    UNIT_CHECK(std::equal(final_frame.begin(), final_frame.end(), backend.pixels()));
+}
+
+UNIT_TEST(trace_rejects_truncated_records)
+{
+    std::vector<expected_call> calls;
+    std::vector<wcdx::frame::color> final_frame;
+    auto data = record_session(calls, final_frame);
+
+    // Find where each record ends.
+    std::vector<size_t> boundaries = { wcdx::trace::trace_header_size };
+    while (boundaries.back() != data.size())
+    {
+        uint32_t size;
+        std::memcpy(&size, data.data() + boundaries.back(), sizeof(size));
+        boundaries.push_back(boundaries.back() + sizeof(size) + size);
+        UNIT_CHECK(boundaries.back() <= data.size());
+    }
+    UNIT_CHECK_EQUAL(boundaries.size(), calls.size() + 1);
+
+    // Cutting the trace at a record boundary ends it cleanly; anywhere else
+    // is an error once the reader reaches the cut.
+    wcdx::unit::random rng(3);
+    for (unsigned n = 0; n != 2000; ++n)
+    {
+        auto cut = wcdx::trace::trace_header_size + rng.below(uint32_t(data.size() - wcdx::trace::trace_header_size));
+        if (n < 40)
+            cut = boundaries[rng.below(uint32_t(boundaries.size()))] + (n % 5);
+        cut = std::min(cut, data.size());
+
+        auto complete = size_t(std::upper_bound(boundaries.begin(), boundaries.end(), cut) - boundaries.begin()) - 1;
+        auto at_boundary = boundaries[complete] == cut;
+
+        stdext::memory_input_stream input(data.data(), cut);
+        wcdx::trace::trace_reader reader(input);
+        wcdx::trace::trace_record record;
+        size_t read = 0;
+        bool rejected = false;
+        try
+        {
+            while (reader.next(record))
+                ++read;
+        }
+        catch (const std::runtime_error&)
+        {
+            rejected = true;
+        }
+
+        UNIT_CHECK_EQUAL(read, complete);
+        UNIT_CHECK(rejected != at_boundary);
+    }
+
+    // A header that's cut short isn't a trace.
+    for (size_t cut = 0; cut != wcdx::trace::trace_header_size; ++cut)
+    {
+        stdext::memory_input_stream input(data.data(), cut);
+        UNIT_CHECK_THROWS(std::runtime_error, wcdx::trace::trace_reader(input));
+    }
+}
+
+UNIT_TEST(trace_rejects_wrong_payload_sizes)
+{
+    auto make_trace = [](call_id call, const std::vector<std::byte>& payload)
+    {
+        wcdx::unit::vector_output_stream output;
+        output.write(wcdx::trace::trace_magic);
+        output.write(wcdx::trace::trace_version);
+        output.write(uint16_t(frame_width));
+        output.write(uint16_t(frame_height));
+        output.write(uint16_t(0));
+        output.write(uint32_t(wcdx::trace::trace_record_header_size - sizeof(uint32_t) + payload.size()));
+        output.write(uint64_t(0));
+        output.write(uint8_t(call));
+        output.write_all(payload.data(), payload.size());
+        return output.data();
+    };
+
+    auto accepted = [&](call_id call, const std::vector<std::byte>& payload)
+    {
+        auto data = make_trace(call, payload);
+        stdext::memory_input_stream input(data.data(), data.size());
+        wcdx::trace::trace_reader reader(input);
+        wcdx::trace::trace_record record;
+        try
+        {
+            return reader.next(record) && !reader.next(record);
+        }
+        catch (const std::runtime_error&)
+        {
+            return false;
+        }
+    };
+
+    auto update_frame_payload = [](int32_t x, int32_t y, uint32_t width, uint32_t height, size_t pixel_count)
+    {
+        std::vector<std::byte> payload(16 + pixel_count);
+        std::memcpy(payload.data(), &x, 4);
+        std::memcpy(payload.data() + 4, &y, 4);
+        std::memcpy(payload.data() + 8, &width, 4);
+        std::memcpy(payload.data() + 12, &height, 4);
+        return payload;
+    };
+
+    auto update_palette_payload = [](uint32_t index)
+    {
+        std::vector<std::byte> payload(8);
+        std::memcpy(payload.data(), &index, 4);
+        return payload;
+    };
+
+    // The sizes the writer produces are accepted...
+    UNIT_CHECK(accepted(call_id::present, { }));
+    UNIT_CHECK(accepted(call_id::set_palette, std::vector<std::byte>(1024)));
+    UNIT_CHECK(accepted(call_id::update_palette, update_palette_payload(255)));
+    UNIT_CHECK(accepted(call_id::update_frame, update_frame_payload(-4, 5, 3, 2, 6)));
+    UNIT_CHECK(accepted(call_id::update_frame, update_frame_payload(0, 0, 0, 9, 0)));
+
+    // ...and anything else isn't.
+    UNIT_CHECK(!accepted(call_id::present, std::vector<std::byte>(1)));
+    UNIT_CHECK(!accepted(call_id::fill_snow, std::vector<std::byte>(4)));
+    UNIT_CHECK(!accepted(call_id::count, { }));
+    UNIT_CHECK(!accepted(call_id(200), { }));
+    UNIT_CHECK(!accepted(call_id::set_palette, std::vector<std::byte>(1023)));
+    UNIT_CHECK(!accepted(call_id::set_palette, std::vector<std::byte>(1028)));
+    UNIT_CHECK(!accepted(call_id::update_palette, std::vector<std::byte>(4)));
+    UNIT_CHECK(!accepted(call_id::update_palette, std::vector<std::byte>(12)));
+    UNIT_CHECK(!accepted(call_id::update_palette, update_palette_payload(256)));
+    UNIT_CHECK(!accepted(call_id::update_frame, std::vector<std::byte>(15)));
+    UNIT_CHECK(!accepted(call_id::update_frame, update_frame_payload(0, 0, 3, 2, 5)));
+    UNIT_CHECK(!accepted(call_id::update_frame, update_frame_payload(0, 0, 3, 2, 7)));
+    UNIT_CHECK(!accepted(call_id::update_frame, update_frame_payload(0, 0, 0x10000, 0x10000, 0)));
+
+    // A record too short to hold its own header.
+    auto data = make_trace(call_id::present, { });
+    data[wcdx::trace::trace_header_size] = std::byte(wcdx::trace::trace_record_header_size - sizeof(uint32_t) - 1);
+    data.pop_back();
+    stdext::memory_input_stream input(data.data(), data.size());
+    wcdx::trace::trace_reader reader(input);
+    wcdx::trace::trace_record record;
+    UNIT_CHECK_THROWS(std::runtime_error, reader.next(record));
+
+    // Not a trace at all.
+    data[0] = std::byte('X');
+    stdext::memory_input_stream bad_magic(data.data(), data.size());
+    UNIT_CHECK_THROWS(std::runtime_error, wcdx::trace::trace_reader(bad_magic));
+}
@@ -0,0 +1,409 @@
+#include "unit.h"
+
+#include <frame/frame_capture.h>
+#include <frame/frame_delta.h>
+#include <frame/frame_recorder.h>
+
+#include <stdext/stream.h>
+
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <initializer_list>
+#include <mutex>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+
+namespace
+{
+    using wcdx::frame::color;
+
+    std::vector<std::byte> encode(const std::vector<std::byte>& previous, const std::vector<std::byte>& current)
+    {
+        std::vector<std::byte> delta(wcdx::frame::max_frame_delta_size(current.size()));
+        auto size = wcdx::frame::encode_frame_delta(previous.data(), current.data(), current.size(), delta.data());
+        UNIT_CHECK(size <= delta.size());
+        delta.resize(size);
+        return delta;
+    }
+
+    void check_round_trip(const std::vector<std::byte>& previous, const std::vector<std::byte>& current)
+    {
+        auto delta = encode(previous, current);
+        auto frame = previous;
+        wcdx::frame::apply_frame_delta(frame.data(), frame.size(), delta.data(), delta.size());
+        UNIT_CHECK(frame == current);
+    }
+
+    std::vector<std::byte> bytes(std::initializer_list<unsigned> values)
+    {
+        std::vector<std::byte> result;
+        for (auto value : values)
+            result.push_back(std::byte(value));
+        return result;
+    }
+
+    // Holds up the recorder's writer thread until it's opened, so that the
+    // ring fills and frames are dropped.
+    class gated_output_stream : public stdext::output_stream
+    {
+    public:
+        const std::vector<std::byte>& data() const noexcept { return _data; }
+
+        void close()
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+            _open = false;
+        }
+
+        void open()
+        {
+            {
+                std::lock_guard<std::mutex> lock(_mutex);
+                _open = true;
+            }
+            _opened.notify_all();
+        }
+
+    private:
+        size_t do_write(const std::byte* buffer, size_t size) override
+        {
+            std::unique_lock<std::mutex> lock(_mutex);
+            _opened.wait(lock, [&] { return _open; });
+            _data.insert(_data.end(), buffer, buffer + size);
+            return size;
+        }
+
+    private:
+        std::mutex _mutex;
+        std::condition_variable _opened;
+        bool _open = true;
+        std::vector<std::byte> _data;
+    };
+}
+
+UNIT_TEST(frame_delta_token_lengths)
+{
+    // Fill runs of 63 and 64 pixels either side of the short length limit,
+    // followed by pixels that didn't change, which need no token at all.
+    for (size_t run : { 1, 4, 62, 63, 64, 65, 127, 128, 191, 192, 16447, 16448, 20000 })
+    {
+        std::vector<std::byte> previous(run + 100);
+        auto current = previous;
+        std::fill_n(current.begin(), run, std::byte(5));
+        check_round_trip(previous, current);
+        check_round_trip(current, previous);
+    }
+
+    // The encoding itself, as documented in frame_delta.h.
+    std::vector<std::byte> previous(300);
+    auto current = previous;
+    std::fill_n(current.begin(), 63, std::byte(5));
+    UNIT_CHECK(encode(previous, current) == bytes({ 0x40 | 62, 5 }));
+
+    std::fill_n(current.begin(), 64, std::byte(5));
+    UNIT_CHECK(encode(previous, current) == bytes({ 0x40 | 63, 0, 5 }));
+
+    std::fill_n(current.begin(), 64 + 200, std::byte(5));
+    UNIT_CHECK(encode(previous, current) == bytes({ 0x40 | 63, 0xC8, 0x01, 5 }));
+
+    // A skip, then a fill running to the end.
+    current = previous;
+    std::fill(current.begin() + 64, current.end(), std::byte(9));
+    UNIT_CHECK(encode(previous, current) == bytes({ 0x00 | 63, 0, 0x40 | 63, 0xAC, 0x01, 9 }));
+    check_round_trip(previous, current);
+
+    // Unchanged frames encode to nothing.
+    UNIT_CHECK(encode(previous, previous).empty());
+    UNIT_CHECK(encode(std::vector<std::byte>(), std::vector<std::byte>()).empty());
+}
+
+UNIT_TEST(frame_delta_round_trip)
+{
+    // Literal runs either side of the length limits, and a long one.
+    for (size_t run : { 1, 2, 3, 62, 63, 64, 65, 200, 16448, 20000 })
+    {
+        std::vector<std::byte> previous(run + 50, std::byte(0x33));
+        auto current = previous;
+        for (size_t n = 0; n != run; ++n)
+            current[n + 10] = std::byte(n % 3 + 1);
+        check_round_trip(previous, current);
+    }
+
+    // Random frames built from runs of every kind and length, with and
+    // without a trailing unchanged run.
+    wcdx::unit::random rng(5);
+    for (unsigned iteration = 0; iteration != 2000; ++iteration)
+    {
+        auto size = size_t(rng.below(iteration < 1000 ? 200 : 70000));
+        std::vector<std::byte> previous(size);
+        for (auto& b : previous)
+            b = std::byte(rng.below(4));
+
+        auto current = previous;
+        for (size_t n = 0; n < size; )
+        {
+            auto length = std::min(size - n, size_t(rng.below(8) == 0 ? rng.below(300) : rng.below(8)) + 1);
+            switch (rng.below(3))
+            {
+            case 0:
+                break;
+
+            case 1:
+            {
+                auto value = std::byte(rng.below(256));
+                for (size_t k = 0; k != length; ++k)
+                    current[n + k] = previous[n + k] ^ value;
+                break;
+            }
+
+            default:
+                for (size_t k = 0; k != length; ++k)
+                    current[n + k] = std::byte(rng.next());
+                break;
+            }
+            n += length;
+        }
+
+        check_round_trip(previous, current);
+    }
+}
+
+UNIT_TEST(frame_delta_rejects_malformed)
+{
+    std::vector<std::byte> frame(100);
+    auto rejected = [&](std::initializer_list<unsigned> delta)
+    {
+        auto data = bytes(delta);
+        try
+        {
+            wcdx::frame::apply_frame_delta(frame.data(), frame.size(), data.data(), data.size());
+            return false;
+        }
+        catch (const std::runtime_error&)
+        {
+            return true;
+        }
+    };
+
+    UNIT_CHECK(!rejected({ }));
+    UNIT_CHECK(!rejected({ 0x40 | 63, 36, 7 }));          // exactly the whole frame
+    UNIT_CHECK(rejected({ 0x40 | 63, 37, 7 }));           // one past the end
+    UNIT_CHECK(rejected({ 0x00 | 63, 0, 0x00 | 63, 0 }));
+    UNIT_CHECK(rejected({ 0x40 | 3 }));                   // fill without its value
+    UNIT_CHECK(rejected({ 0x80 | 3, 1, 2, 3 }));          // literal cut short
+    UNIT_CHECK(rejected({ 0xC0 | 3 }));                   // no such token
+    UNIT_CHECK(rejected({ 0x00 | 63 }));                  // length cut short
+    UNIT_CHECK(rejected({ 0x00 | 63, 0x80 }));
+    UNIT_CHECK(rejected({ 0x00 | 63, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0x01 }));
+}
+
+namespace
+{
+    constexpr unsigned capture_width = 64;
+    constexpr unsigned capture_height = 32;
+
+    struct captured_frame
+    {
+        std::vector<std::byte> pixels;
+        std::vector<color> palette;
+    };
+
+    // Frames that change a little at a time, as the games' do, with
+    // occasional single palette entries, spans, and whole new palettes.
+    std::vector<captured_frame> make_frames(wcdx::unit::random& rng, unsigned count, bool noisy)
+    {
+        std::vector<captured_frame> frames;
+        captured_frame frame = { std::vector<std::byte>(size_t(capture_width) * capture_height), std::vector<color>(256) };
+        for (unsigned n = 0; n != count; ++n)
+        {
+            if (noisy)
+            {
+                for (auto& b : frame.pixels)
+                    b = std::byte(rng.next());
+            }
+            else
+            {
+                auto x = rng.below(capture_width);
+                auto y = rng.below(capture_height);
+                auto width = 1 + rng.below(capture_width - x);
+                auto height = 1 + rng.below(capture_height - y);
+                auto value = std::byte(rng.next());
+                for (unsigned row = y; row != y + height; ++row)
+                    std::fill_n(frame.pixels.begin() + (row * capture_width) + x, width, value);
+            }
+
+            switch (rng.below(4))
+            {
+            case 0:
+                break;
+
+            case 1:
+                frame.palette[rng.below(256)] = color(rng.next());
+                break;
+
+            case 2:
+            {
+                auto first = rng.below(256);
+                auto last = first + rng.below(256 - first);
+                for (auto index = first; index <= last; ++index)
+                    frame.palette[index] = color(rng.next());
+                break;
+            }
+
+            default:
+                for (auto& entry : frame.palette)
+                    entry = color(rng.next());
+                break;
+            }
+
+            frames.push_back(frame);
+        }
+        return frames;
+    }
+
+    // Reads a capture back, checking every frame against what was recorded
+    // under its number, and returns the frame numbers seen.
+    std::vector<uint32_t> replay_capture(const std::vector<std::byte>& data, const std::vector<captured_frame>& frames)
+    {
+        stdext::memory_input_stream input(data.data(), data.size());
+        wcdx::frame::capture_reader reader(input);
+        UNIT_CHECK_EQUAL(reader.width(), capture_width);
+        UNIT_CHECK_EQUAL(reader.height(), capture_height);
+
+        std::vector<uint32_t> numbers;
+        uint64_t last_timestamp = 0;
+        while (reader.next())
+        {
+            UNIT_CHECK(reader.frame_number() < frames.size());
+            UNIT_CHECK(numbers.empty() || reader.frame_number() > numbers.back());
+            UNIT_CHECK(reader.timestamp() >= last_timestamp);
+            numbers.push_back(reader.frame_number());
+            last_timestamp = reader.timestamp();
+
+            auto& expected = frames[reader.frame_number()];
+            UNIT_CHECK(std::equal(expected.pixels.begin(), expected.pixels.end(), reader.pixels()));
+            UNIT_CHECK(std::equal(expected.palette.begin(), expected.palette.end(), reader.palette()));
+        }
+        return numbers;
+    }
+}
+
+UNIT_TEST(frame_recorder_round_trip)
+{
+    wcdx::unit::random rng(11);
+    auto frames = make_frames(rng, 200, false);
+
+    gated_output_stream output;
+    {
+        wcdx::frame::frame_recorder recorder(capture_width, capture_height, output, 1 << 20);
+        for (auto& frame : frames)
+            recorder.record(frame.pixels.data(), frame.palette.data());
+        recorder.finish();
+        UNIT_CHECK_EQUAL(recorder.recorded_count(), frames.size());
+        UNIT_CHECK_EQUAL(recorder.dropped_count(), 0u);
+    }
+
+    auto numbers = replay_capture(output.data(), frames);
+    UNIT_CHECK_EQUAL(numbers.size(), frames.size());
+    for (size_t n = 0; n != numbers.size(); ++n)
+        UNIT_CHECK_EQUAL(numbers[n], n);
+}
+
+UNIT_TEST(frame_recorder_drops_frames)
+{
+    wcdx::unit::random rng(12);
+    auto frames = make_frames(rng, 30, true);
+
+    // Each noisy frame needs about a quarter of the ring, and nothing can be
+    // written until the output opens, so most of the first frames are
+    // dropped.  Later ones are encoded against the last one kept.
+    gated_output_stream output;
+    uint32_t recorded;
+    uint32_t dropped;
+    {
+        wcdx::frame::frame_recorder recorder(capture_width, capture_height, output, 10000);
+        output.close();
+        for (size_t n = 0; n != 20; ++n)
+            recorder.record(frames[n].pixels.data(), frames[n].palette.data());
+        UNIT_CHECK(recorder.dropped_count() >= 15);
+
+        // Once the output opens the ring drains, and the remaining frames
+        // have time to fit.
+        output.open();
+        for (size_t n = 20; n != frames.size(); ++n)
+        {
+            std::this_thread::sleep_for(std::chrono::milliseconds(20));
+            recorder.record(frames[n].pixels.data(), frames[n].palette.data());
+        }
+        recorder.finish();
+        recorded = recorder.recorded_count();
+        dropped = recorder.dropped_count();
+    }
+    UNIT_CHECK_EQUAL(recorded + dropped, frames.size());
+
+    auto numbers = replay_capture(output.data(), frames);
+    UNIT_CHECK_EQUAL(numbers.size(), recorded);
+    UNIT_CHECK(!numbers.empty() && numbers.front() == 0);
+
+    // Every dropped frame shows up as a gap, or as missing from the end.
+    size_t gaps = 0;
+    for (size_t n = 1; n != numbers.size(); ++n)
+        gaps += numbers[n] - numbers[n - 1] - 1;
+    gaps += frames.size() - 1 - numbers.back();
+    UNIT_CHECK_EQUAL(gaps, dropped);
+    UNIT_CHECK(numbers.back() >= 20);
+}
+
+UNIT_TEST(capture_rejects_truncated_records)
+{
+    wcdx::unit::random rng(13);
+    auto frames = make_frames(rng, 30, false);
+
+    gated_output_stream output;
+    {
+        wcdx::frame::frame_recorder recorder(capture_width, capture_height, output, 1 << 20);
+        for (auto& frame : frames)
+            recorder.record(frame.pixels.data(), frame.palette.data());
+    }
+    auto& data = output.data();
+
+    std::vector<size_t> boundaries = { wcdx::frame::capture_header_size };
+    while (boundaries.back() != data.size())
+    {
+        uint32_t size;
+        std::memcpy(&size, data.data() + boundaries.back(), sizeof(size));
+        boundaries.push_back(boundaries.back() + sizeof(size) + size);
+        UNIT_CHECK(boundaries.back() <= data.size());
+    }
+    UNIT_CHECK_EQUAL(boundaries.size(), frames.size() + 1);
+
+    for (auto cut = wcdx::frame::capture_header_size; cut <= data.size(); ++cut)
+    {
+        auto complete = size_t(std::upper_bound(boundaries.begin(), boundaries.end(), cut) - boundaries.begin()) - 1;
+        auto at_boundary = boundaries[complete] == cut;
+
+        stdext::memory_input_stream input(data.data(), cut);
+        wcdx::frame::capture_reader reader(input);
+        size_t read = 0;
+        bool rejected = false;
+        try
+        {
+            while (reader.next())
+                ++read;
+        }
+        catch (const std::runtime_error&)
+        {
+            rejected = true;
+        }
+
+        UNIT_CHECK_EQUAL(read, complete);
+        UNIT_CHECK(rejected != at_boundary);
+    }
+}
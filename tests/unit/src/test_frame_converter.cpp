@@ -0,0 +1,418 @@
+#include "unit.h"
+
+#include <frame/frame_converter.h>
+#include <frame/palette_expand.h>
+#include <frame/palette_usage.h>
+
+#include <algorithm>
+#include <vector>
+
+#include <cstddef>
+#include <cstdint>
+
+
+namespace
+{
+    using wcdx::frame::color;
+    using wcdx::frame::expand_path;
+
+    constexpr unsigned frame_width = 320;
+    constexpr unsigned frame_height = 200;
+    constexpr color untouched = 0xDEADBEEF;
+
+    // Selects each path the processor supports in turn, restoring the
+    // original selection afterwards.
+    template <class F>
+    void for_each_expand_path(F&& f)
+    {
+        auto original = wcdx::frame::active_expand_path();
+        for (auto path : { expand_path::scalar, expand_path::sse2, expand_path::avx2 })
+        {
+            if (!wcdx::frame::expand_path_supported(path))
+                continue;
+
+            wcdx::frame::select_expand_path(path);
+            f(path);
+        }
+        wcdx::frame::select_expand_path(original);
+    }
+
+    void random_palette(wcdx::unit::random& rng, color palette[256])
+    {
+        for (unsigned n = 0; n != 256; ++n)
+            palette[n] = color(rng.next());
+    }
+
+    std::vector<color> full_expansion(const wcdx::frame::frame_converter& converter)
+    {
+        auto pixels = converter.pixels();
+        std::vector<color> expected(size_t(converter.width()) * converter.height());
+        for (size_t n = 0; n != expected.size(); ++n)
+            expected[n] = converter.palette()[uint8_t(pixels[n])];
+        return expected;
+    }
+
+    // Converts the dirty region into a full-frame target and checks that the
+    // target now matches a full expansion, and that nothing outside the
+    // dirty bounds was written.
+    void convert_and_check(wcdx::frame::frame_converter& converter, std::vector<color>& target)
+    {
+        auto bounds = converter.dirty_bounds();
+        auto before = target;
+        converter.convert(target.data(), frame_width * sizeof(color), { 0, 0, int(frame_width), int(frame_height) });
+        UNIT_CHECK(!converter.dirty());
+
+        auto expected = full_expansion(converter);
+        UNIT_CHECK(target == expected);
+
+        bool outside_written = false;
+        for (unsigned row = 0; row != frame_height; ++row)
+        {
+            for (unsigned column = 0; column != frame_width; ++column)
+            {
+                auto inside = int(column) >= bounds.left && int(column) < bounds.right && int(row) >= bounds.top && int(row) < bounds.bottom;
+                auto n = size_t(row) * frame_width + column;
+                outside_written = outside_written || (!inside && target[n] != before[n]);
+            }
+        }
+        UNIT_CHECK(!outside_written);
+    }
+
+    // A rectangle that may hang off any edge of the frame, with a pitch wider
+    // than the rectangle.
+    void random_update(wcdx::unit::random& rng, wcdx::frame::frame_converter& converter)
+    {
+        auto width = 1 + rng.below(rng.below(8) == 0 ? frame_width + 40 : 80);
+        auto height = 1 + rng.below(rng.below(8) == 0 ? frame_height + 40 : 60);
+        auto x = int(rng.below(frame_width + 2 * width)) - int(width);
+        auto y = int(rng.below(frame_height + 2 * height)) - int(height);
+        auto pitch = size_t(width) + rng.below(9);
+
+        // A few indices per update, as the games draw.
+        uint8_t indices[4];
+        for (auto& index : indices)
+            index = uint8_t(rng.next());
+
+        std::vector<std::byte> bits(pitch * height);
+        for (auto& b : bits)
+            b = std::byte(indices[rng.below(4)]);
+        converter.update_frame(x, y, width, height, pitch, bits.data());
+    }
+
+    void fill_frame(wcdx::frame::frame_converter& converter, int x, int y, unsigned width, unsigned height, uint8_t index)
+    {
+        std::vector<std::byte> bits(size_t(width) * height, std::byte(index));
+        converter.update_frame(x, y, width, height, width, bits.data());
+    }
+
+    bool bounds_equal(const wcdx::frame::rect& bounds, int left, int top, int right, int bottom)
+    {
+        return bounds.left == left && bounds.top == top && bounds.right == right && bounds.bottom == bottom;
+    }
+}
+
+UNIT_TEST(expand_pixels_matches_scalar)
+{
+    wcdx::unit::random rng(1);
+    color palette[256];
+    random_palette(rng, palette);
+
+    color mask[256];
+    for (auto& m : mask)
+        m = rng.below(3) == 0 ? ~color(0) : 0;
+
+    constexpr size_t max_count = 300;
+    std::vector<std::byte> src(max_count + 8);
+    for (auto& b : src)
+        b = std::byte(rng.next());
+
+    // Offsets misalign the source and destination; lengths cover every tail
+    // a vector loop can leave.  Each case writes into a buffer of sentinels
+    // so that overruns show up too.
+    auto run_cases = [&]
+    {
+        std::vector<std::vector<color>> results;
+        for (size_t count = 0; count <= max_count; count += count < 70 ? 1 : 23)
+        {
+            for (size_t src_offset = 0; src_offset != 8; ++src_offset)
+            {
+                auto dest_offset = (src_offset * 3) % 8;
+                std::vector<color> plain(max_count + 16, untouched);
+                wcdx::frame::expand_pixels(src.data() + src_offset, plain.data() + dest_offset, count, palette);
+                results.push_back(std::move(plain));
+
+                std::vector<color> masked(max_count + 16, untouched);
+                wcdx::frame::expand_pixels_masked(src.data() + src_offset, masked.data() + dest_offset, count, palette, mask);
+                results.push_back(std::move(masked));
+            }
+        }
+        return results;
+    };
+
+    std::vector<std::vector<color>> scalar;
+    unsigned paths = 0;
+    for_each_expand_path([&](expand_path path)
+    {
+        ++paths;
+        if (path == expand_path::scalar)
+        {
+            scalar = run_cases();
+            return;
+        }
+
+        auto results = run_cases();
+        UNIT_CHECK_EQUAL(results.size(), scalar.size());
+        for (size_t n = 0; n != results.size(); ++n)
+            UNIT_CHECK(results[n] == scalar[n]);
+    });
+    UNIT_CHECK(paths != 0);
+
+    // The scalar path itself is a plain table lookup.
+    size_t n = 0;
+    for (size_t count = 0; count <= max_count; count += count < 70 ? 1 : 23)
+    {
+        for (size_t src_offset = 0; src_offset != 8; ++src_offset, n += 2)
+        {
+            auto dest_offset = (src_offset * 3) % 8;
+            for (size_t k = 0; k != max_count + 16; ++k)
+            {
+                auto inside = k >= dest_offset && k < dest_offset + count;
+                auto index = inside ? uint8_t(src[src_offset + k - dest_offset]) : 0;
+                UNIT_CHECK_EQUAL(scalar[n][k], inside ? palette[index] : untouched);
+                UNIT_CHECK_EQUAL(scalar[n + 1][k], inside && mask[index] != 0 ? palette[index] : untouched);
+            }
+        }
+    }
+}
+
+UNIT_TEST(frame_converter_converts_dirty_region)
+{
+    for_each_expand_path([&](expand_path path)
+    {
+        wcdx::unit::random rng(uint64_t(path) + 1);
+        wcdx::frame::frame_converter converter(frame_width, frame_height);
+        std::vector<color> target(size_t(frame_width) * frame_height, untouched);
+
+        color palette[256];
+        random_palette(rng, palette);
+        converter.set_palette(palette);
+        convert_and_check(converter, target);
+
+        for (unsigned present = 0; present != 200; ++present)
+        {
+            auto updates = rng.below(6);
+            for (unsigned n = 0; n != updates; ++n)
+                random_update(rng, converter);
+            convert_and_check(converter, target);
+        }
+    });
+}
+
+UNIT_TEST(frame_converter_maps_palette_changes)
+{
+    for_each_expand_path([&](expand_path)
+    {
+        wcdx::frame::frame_converter converter(frame_width, frame_height);
+        std::vector<color> target(size_t(frame_width) * frame_height, untouched);
+
+        // A background of index 0, a band of index 7, a single pixel of index 9
+        // and a thin column of index 5 that reaches every row.
+        fill_frame(converter, 0, 0, frame_width, frame_height, 0);
+        fill_frame(converter, 10, 50, 11, 2, 7);
+        fill_frame(converter, 300, 150, 1, 1, 9);
+        fill_frame(converter, 3, 0, 1, frame_height, 5);
+        convert_and_check(converter, target);
+
+        // Rewriting an entry with the same color costs nothing.
+        converter.update_palette(7, converter.palette()[7]);
+        UNIT_CHECK(!converter.dirty());
+
+        // Rarely used entries only touch the rows that reference them.
+        converter.update_palette(9, 0xFF102030);
+        UNIT_CHECK(bounds_equal(converter.dirty_bounds(), 0, 150, frame_width, 151));
+        convert_and_check(converter, target);
+
+        converter.update_palette(7, 0xFF405060);
+        converter.update_palette(9, 0xFF708090);
+        UNIT_CHECK(bounds_equal(converter.dirty_bounds(), 0, 50, frame_width, 151));
+        convert_and_check(converter, target);
+
+        // Unused entries leave nothing to convert.
+        converter.update_palette(200, 0xFFA0B0C0);
+        UNIT_CHECK(empty(converter.dirty_bounds()));
+        convert_and_check(converter, target);
+
+        // A frame update next to a palette change covers both.
+        fill_frame(converter, 100, 10, 5, 5, 9);
+        converter.update_palette(7, 0xFF0000FF);
+        UNIT_CHECK(bounds_equal(converter.dirty_bounds(), 0, 10, frame_width, 52));
+        convert_and_check(converter, target);
+
+        // Half the pixels, or two thirds of the rows, fall back to converting
+        // the whole frame.
+        converter.update_palette(0, 0xFF00FF00);
+        UNIT_CHECK(bounds_equal(converter.dirty_bounds(), 0, 0, frame_width, frame_height));
+        convert_and_check(converter, target);
+
+        converter.update_palette(5, 0xFFFF0000);
+        UNIT_CHECK(bounds_equal(converter.dirty_bounds(), 0, 0, frame_width, frame_height));
+        convert_and_check(converter, target);
+
+        // Once index 7 is overwritten, changing it has nothing left to touch.
+        fill_frame(converter, 10, 50, 11, 2, 0);
+        convert_and_check(converter, target);
+        converter.update_palette(7, 0xFF00FFFF);
+        UNIT_CHECK(empty(converter.dirty_bounds()));
+        convert_and_check(converter, target);
+    });
+}
+
+UNIT_TEST(frame_converter_interleaves_palette_and_frame_updates)
+{
+    for_each_expand_path([&](expand_path path)
+    {
+        wcdx::unit::random rng(uint64_t(path) + 10);
+        wcdx::frame::frame_converter converter(frame_width, frame_height);
+        std::vector<color> target(size_t(frame_width) * frame_height, untouched);
+
+        color palette[256];
+        random_palette(rng, palette);
+        converter.set_palette(palette);
+        fill_frame(converter, 0, 0, frame_width, frame_height, 0);
+        convert_and_check(converter, target);
+
+        for (unsigned present = 0; present != 300; ++present)
+        {
+            auto operations = rng.below(6);
+            for (unsigned n = 0; n != operations; ++n)
+            {
+                switch (rng.below(6))
+                {
+                case 0:
+                case 1:
+                    random_update(rng, converter);
+                    break;
+
+                case 2:
+                    // Occasionally cover most of the frame with one index so
+                    // that changing it takes the full conversion.
+                    fill_frame(converter, int(rng.below(40)) - 20, int(rng.below(40)) - 20, frame_width, frame_height, uint8_t(rng.next()));
+                    break;
+
+                case 3:
+                case 4:
+                {
+                    auto index = rng.below(256);
+                    converter.update_palette(index, rng.below(4) == 0 ? converter.palette()[index] : color(rng.next()));
+                    break;
+                }
+
+                default:
+                {
+                    // Whole palettes, mostly the same as the current one.
+                    std::copy_n(converter.palette(), 256, palette);
+                    auto changes = rng.below(4) == 0 ? 256 : rng.below(6);
+                    for (unsigned k = 0; k != changes; ++k)
+                        palette[rng.below(256)] = color(rng.next());
+                    converter.set_palette(palette);
+                    break;
+                }
+                }
+            }
+            convert_and_check(converter, target);
+        }
+    });
+}
+
+UNIT_TEST(palette_usage_tracks_replacements)
+{
+    // More rows than one word of row bits, and rows long enough that counts
+    // go well past a byte.
+    constexpr unsigned width = 300;
+    constexpr unsigned height = 150;
+    wcdx::unit::random rng(20);
+
+    std::vector<std::byte> frame(size_t(width) * height);
+    for (auto& b : frame)
+        b = std::byte(rng.below(4));
+    wcdx::frame::palette_usage usage(width, height);
+    usage.reset(frame.data());
+
+    auto check_counts = [&]
+    {
+        std::vector<size_t> totals(256);
+        std::vector<std::vector<bool>> rows_using(256, std::vector<bool>(height));
+        for (unsigned row = 0; row != height; ++row)
+        {
+            for (unsigned column = 0; column != width; ++column)
+            {
+                auto index = uint8_t(frame[size_t(row) * width + column]);
+                ++totals[index];
+                rows_using[index][row] = true;
+            }
+        }
+
+        for (unsigned index = 0; index != 256; ++index)
+            UNIT_CHECK_EQUAL(usage.pixel_count(index), totals[index]);
+
+        for (unsigned trial = 0; trial != 20; ++trial)
+        {
+            wcdx::frame::palette_usage::index_set indices;
+            auto count = trial == 0 ? 256 : 1 + rng.below(trial < 10 ? 2 : 20);
+            for (unsigned k = 0; k != count; ++k)
+                indices.set(trial == 0 ? k : rng.below(256));
+
+            size_t pixels = 0;
+            std::vector<unsigned> rows;
+            for (unsigned row = 0; row != height; ++row)
+            {
+                auto used = false;
+                for (unsigned index = 0; index != 256; ++index)
+                    used = used || (indices.test(index) && rows_using[index][row]);
+                if (used)
+                    rows.push_back(row);
+            }
+            for (unsigned index = 0; index != 256; ++index)
+                pixels += indices.test(index) ? totals[index] : 0;
+
+            std::vector<unsigned> visited;
+            usage.for_each_row(indices, [&](unsigned row) { visited.push_back(row); });
+            UNIT_CHECK_EQUAL(usage.pixel_count(indices), pixels);
+            UNIT_CHECK_EQUAL(usage.row_count(indices), rows.size());
+            UNIT_CHECK(visited == rows);
+        }
+    };
+
+    check_counts();
+    for (unsigned update = 0; update != 300; ++update)
+    {
+        // Overlapping rectangles, each replaced row by row before the frame is
+        // overwritten, as frame_converter does.
+        auto left = rng.below(width);
+        auto top = rng.below(height);
+        auto right = left + 1 + rng.below(width - left);
+        auto bottom = top + 1 + rng.below(std::min(height - top, 40u));
+        auto value = uint8_t(rng.below(8) == 0 ? rng.next() : rng.below(6));
+
+        std::vector<std::byte> row_pixels(right - left);
+        for (auto row = top; row != bottom; ++row)
+        {
+            for (auto& b : row_pixels)
+                b = rng.below(3) == 0 ? std::byte(rng.next()) : std::byte(value);
+
+            auto dest = frame.data() + size_t(row) * width + left;
+            usage.replace(row, dest, row_pixels.data(), row_pixels.size());
+            std::copy(row_pixels.begin(), row_pixels.end(), dest);
+        }
+
+        if (update % 10 == 0)
+            check_counts();
+    }
+    check_counts();
+
+    // A recount agrees with the tracked counts.
+    wcdx::frame::palette_usage recount(width, height);
+    recount.reset(frame.data());
+    for (unsigned index = 0; index != 256; ++index)
+        UNIT_CHECK_EQUAL(recount.pixel_count(index), usage.pixel_count(index));
+}
@@ -0,0 +1,107 @@
+#include "unit.h"
+
+#include <frame/frame_queue.h>
+
+#include <algorithm>
+#include <atomic>
+#include <thread>
+
+#include <cstddef>
+#include <cstdint>
+
+
+namespace
+{
+    // Small enough that the two threads collide often.  Every pixel and
+    // palette entry of a frame is derived from its sequence number, so a
+    // frame that the producer was still writing shows up as a mismatch.
+    constexpr unsigned frame_width = 64;
+    constexpr unsigned frame_height = 8;
+    constexpr uint64_t frame_count = 200000;
+
+    void stamp(wcdx::frame::frame_snapshot& frame, uint64_t sequence)
+    {
+        frame.sequence = sequence;
+        std::fill_n(frame.pixels.get(), size_t(frame.width) * frame.height, std::byte(sequence));
+        for (unsigned n = 0; n != 256; ++n)
+            frame.palette[n] = wcdx::frame::color(sequence + n);
+    }
+
+    bool intact(const wcdx::frame::frame_snapshot& frame)
+    {
+        auto size = size_t(frame.width) * frame.height;
+        auto expected = std::byte(frame.sequence);
+        if (!std::all_of(frame.pixels.get(), frame.pixels.get() + size, [&](std::byte b) { return b == expected; }))
+            return false;
+
+        for (unsigned n = 0; n != 256; ++n)
+        {
+            if (frame.palette[n] != wcdx::frame::color(frame.sequence + n))
+                return false;
+        }
+        return true;
+    }
+}
+
+// Run under -fsanitize=thread (WCDX_SANITIZE=thread) to check the memory
+// ordering as well as the outcome.
+UNIT_TEST(frame_queue_producer_consumer)
+{
+    wcdx::frame::frame_queue queue(frame_width, frame_height);
+    std::atomic<bool> done = false;
+
+    std::thread producer([&]
+    {
+        for (uint64_t sequence = 1; sequence <= frame_count; ++sequence)
+        {
+            stamp(queue.back(), sequence);
+            queue.publish();
+        }
+        done.store(true, std::memory_order_release);
+    });
+
+    uint64_t last = 0;
+    uint64_t acquired = 0;
+    bool torn = false;
+    bool reordered = false;
+    for (;;)
+    {
+        // Checked before acquiring so that the last frame isn't missed.
+        bool finished = done.load(std::memory_order_acquire);
+        if (queue.acquire())
+        {
+            auto& frame = queue.front();
+            torn = torn || !intact(frame);
+            reordered = reordered || frame.sequence <= last;
+            last = frame.sequence;
+            ++acquired;
+        }
+        else if (finished)
+            break;
+    }
+    producer.join();
+
+    UNIT_CHECK(!torn);
+    UNIT_CHECK(!reordered);
+    UNIT_CHECK_EQUAL(last, frame_count);
+    UNIT_CHECK(acquired != 0);
+    UNIT_CHECK(!queue.acquire());
+}
+
+UNIT_TEST(frame_queue_latest_wins)
+{
+    wcdx::frame::frame_queue queue(frame_width, frame_height);
+    UNIT_CHECK(!queue.acquire());
+
+    for (uint64_t sequence = 1; sequence <= 3; ++sequence)
+    {
+        stamp(queue.back(), sequence);
+        queue.publish();
+    }
+
+    UNIT_CHECK(queue.acquire());
+    UNIT_CHECK_EQUAL(queue.front().sequence, 3u);
+    UNIT_CHECK(intact(queue.front()));
+    UNIT_CHECK(!queue.acquire());
+    UNIT_CHECK_EQUAL(queue.front().sequence, 3u);
+}
@@ -0,0 +1,303 @@
+#include "unit.h"
+
+#include <image/image_cache.h>
+#include <image/sprite.h>
+
+#include <stdext/array_view.h>
+
+#include <algorithm>
+#include <initializer_list>
+#include <memory>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+
+namespace
+{
+    using wcdx::image::transparent_index;
+
+    stdext::array_view<const std::byte> view(const std::vector<std::byte>& data)
+    {
+        return stdext::array_view<const std::byte>(data.data(), data.size());
+    }
+
+    // Rows made of transparent gaps (some longer than one run can hold),
+    // fills and noise, with the reference point anywhere in or around the
+    // image.
+    wcdx::image::sprite random_sprite(wcdx::unit::random& rng, unsigned width, unsigned height)
+    {
+        wcdx::image::sprite result =
+        {
+            { width, height },
+            int(rng.below(width + 20)) - 10, int(rng.below(height + 20)) - 10,
+            std::make_unique<std::byte[]>(size_t(width) * height)
+        };
+
+        for (unsigned y = 0; y != height; ++y)
+        {
+            auto row = result.pixels.get() + (size_t(y) * width);
+            for (unsigned x = 0; x < width; )
+            {
+                auto length = std::min(width - x, 1 + rng.below(rng.below(6) == 0 ? 400 : 12));
+                switch (rng.below(3))
+                {
+                case 0:
+                    std::fill_n(row + x, length, transparent_index);
+                    break;
+
+                case 1:
+                    std::fill_n(row + x, length, std::byte(rng.below(255)));
+                    break;
+
+                default:
+                    for (unsigned n = 0; n != length; ++n)
+                        row[x + n] = std::byte(rng.below(8) == 0 ? 0xFF : rng.below(255));
+                    break;
+                }
+                x += length;
+            }
+        }
+        return result;
+    }
+
+    std::vector<std::byte> make_cache(const std::vector<std::vector<std::byte>>& images)
+    {
+        wcdx::unit::vector_output_stream output;
+        wcdx::image::write_image_cache(stdext::array_view<const std::vector<std::byte>>(images.data(), images.size()), output);
+        return output.data();
+    }
+
+    // Draws a sprite pixel by pixel, as draw_cached_image should.
+    void draw_reference(const wcdx::image::sprite& image, int x, int y, std::vector<std::byte>& target, size_t pitch, unsigned width, unsigned height)
+    {
+        for (unsigned row = 0; row != image.descriptor.height; ++row)
+        {
+            for (unsigned column = 0; column != image.descriptor.width; ++column)
+            {
+                auto pixel = image.pixels[size_t(row) * image.descriptor.width + column];
+                auto target_x = x - image.reference_x + int(column);
+                auto target_y = y - image.reference_y + int(row);
+                if (pixel != transparent_index && target_x >= 0 && target_x < int(width) && target_y >= 0 && target_y < int(height))
+                    target[size_t(target_y) * pitch + target_x] = pixel;
+            }
+        }
+    }
+
+    bool draw_rejected(const wcdx::image::cached_image& image)
+    {
+        std::vector<std::byte> target(size_t(image.width) * image.height);
+        try
+        {
+            wcdx::image::draw_cached_image(image, image.reference_x, image.reference_y, target.data(), image.width, image.width, image.height);
+            return false;
+        }
+        catch (const std::runtime_error&)
+        {
+            return true;
+        }
+    }
+}
+
+UNIT_TEST(image_cache_round_trip)
+{
+    wcdx::unit::random rng(1);
+    std::vector<wcdx::image::sprite> sprites;
+    for (auto [width, height] : { std::pair(0u, 0u), std::pair(0u, 3u), std::pair(5u, 0u), std::pair(1u, 1u), std::pair(64u, 48u), std::pair(700u, 5u), std::pair(3u, 300u) })
+        sprites.push_back(random_sprite(rng, width, height));
+    for (unsigned n = 0; n != 40; ++n)
+        sprites.push_back(random_sprite(rng, 1 + rng.below(100), 1 + rng.below(100)));
+
+    // Wholly transparent and wholly opaque images.
+    sprites.push_back(random_sprite(rng, 300, 4));
+    std::fill_n(sprites.back().pixels.get(), 300 * 4, transparent_index);
+    sprites.push_back(random_sprite(rng, 300, 4));
+    std::fill_n(sprites.back().pixels.get(), 300 * 4, std::byte(7));
+
+    std::vector<std::vector<std::byte>> encoded;
+    for (auto& image : sprites)
+        encoded.push_back(wcdx::image::encode_cached_image(image));
+
+    auto data = make_cache(encoded);
+    UNIT_CHECK(wcdx::image::is_image_cache(view(data)));
+    UNIT_CHECK(std::memcmp(data.data(), wcdx::image::image_cache_version, sizeof(wcdx::image::image_cache_version)) == 0);
+
+    wcdx::image::image_cache cache(view(data));
+    UNIT_CHECK_EQUAL(cache.size(), sprites.size());
+
+    // The images follow the table in order, stored exactly as encoded.
+    size_t offset = wcdx::image::image_cache_header_size + (sprites.size() * wcdx::image::image_cache_info_size);
+    for (size_t n = 0; n != sprites.size(); ++n)
+    {
+        auto& original = sprites[n];
+        auto image = cache.image(n);
+        UNIT_CHECK_EQUAL(image.width, original.descriptor.width);
+        UNIT_CHECK_EQUAL(image.height, original.descriptor.height);
+        UNIT_CHECK_EQUAL(image.reference_x, original.reference_x);
+        UNIT_CHECK_EQUAL(image.reference_y, original.reference_y);
+        UNIT_CHECK(image.data == data.data() + offset + wcdx::image::cached_image_header_size);
+        UNIT_CHECK_EQUAL(image.size, data.size() - offset - wcdx::image::cached_image_header_size);
+        UNIT_CHECK(std::equal(encoded[n].begin(), encoded[n].end(), data.begin() + offset));
+
+        int32_t extents[4];
+        std::memcpy(extents, encoded[n].data() + 8, sizeof(extents));
+        UNIT_CHECK_EQUAL(extents[0], -original.reference_x);
+        UNIT_CHECK_EQUAL(extents[1], -original.reference_y);
+        UNIT_CHECK_EQUAL(extents[2], int(original.descriptor.width) - original.reference_x);
+        UNIT_CHECK_EQUAL(extents[3], int(original.descriptor.height) - original.reference_y);
+
+        auto decoded = wcdx::image::decode_cached_image(image);
+        auto pixel_count = size_t(original.descriptor.width) * original.descriptor.height;
+        UNIT_CHECK(std::equal(decoded.pixels.get(), decoded.pixels.get() + pixel_count, original.pixels.get()));
+
+        offset += encoded[n].size();
+    }
+    UNIT_CHECK_EQUAL(offset, data.size());
+    UNIT_CHECK_THROWS(std::range_error, cache.image(sprites.size()));
+
+    auto empty = make_cache({ });
+    UNIT_CHECK_EQUAL(empty.size(), wcdx::image::image_cache_header_size);
+    UNIT_CHECK_EQUAL(wcdx::image::image_cache(view(empty)).size(), 0u);
+}
+
+UNIT_TEST(image_cache_draw_clipped)
+{
+    constexpr unsigned target_width = 40;
+    constexpr unsigned target_height = 30;
+    constexpr size_t pitch = 48;
+    constexpr std::byte background = std::byte(0xEE);
+
+    wcdx::unit::random rng(2);
+    for (unsigned trial = 0; trial != 6; ++trial)
+    {
+        auto original = random_sprite(rng, 1 + rng.below(60), 1 + rng.below(45));
+        std::vector<std::vector<std::byte>> encoded = { wcdx::image::encode_cached_image(original) };
+        auto data = make_cache(encoded);
+        auto image = wcdx::image::image_cache(view(data)).image(0);
+
+        // Every position from wholly off the left or top of the target to
+        // wholly off the right or bottom, so that each edge clips every part
+        // of the image.  The padding at the end of each row is never touched.
+        auto left = original.reference_x - int(original.descriptor.width) - 2;
+        auto top = original.reference_y - int(original.descriptor.height) - 2;
+        auto right = int(target_width) + original.reference_x + 2;
+        auto bottom = int(target_height) + original.reference_y + 2;
+        for (auto y = top; y <= bottom; ++y)
+        {
+            for (auto x = left; x <= right; ++x)
+            {
+                std::vector<std::byte> target(pitch * target_height, background);
+                auto expected = target;
+                wcdx::image::draw_cached_image(image, x, y, target.data(), pitch, target_width, target_height);
+                draw_reference(original, x, y, expected, pitch, target_width, target_height);
+                UNIT_CHECK(target == expected);
+
+                auto off_target = x - original.reference_x >= int(target_width) || x - original.reference_x + int(original.descriptor.width) <= 0
+                    || y - original.reference_y >= int(target_height) || y - original.reference_y + int(original.descriptor.height) <= 0;
+                if (off_target)
+                    UNIT_CHECK(std::all_of(target.begin(), target.end(), [&](std::byte b) { return b == background; }));
+            }
+        }
+    }
+}
+
+UNIT_TEST(image_cache_rejects_damaged_tables)
+{
+    wcdx::unit::random rng(3);
+    std::vector<std::vector<std::byte>> encoded;
+    for (unsigned n = 0; n != 3; ++n)
+        encoded.push_back(wcdx::image::encode_cached_image(random_sprite(rng, 10, 10)));
+    auto data = make_cache(encoded);
+
+    // Headers and tables cut short, with the wrong version, or claiming more
+    // images than fit.
+    for (size_t size = 0; size != wcdx::image::image_cache_header_size + (3 * wcdx::image::image_cache_info_size); ++size)
+    {
+        std::vector<std::byte> truncated(data.begin(), data.begin() + size);
+        UNIT_CHECK_THROWS(std::runtime_error, wcdx::image::image_cache(view(truncated)));
+    }
+
+    auto damaged = data;
+    damaged[3] = std::byte('1');
+    UNIT_CHECK(!wcdx::image::is_image_cache(view(damaged)));
+    UNIT_CHECK_THROWS(std::runtime_error, wcdx::image::image_cache(view(damaged)));
+
+    for (uint32_t count : { 0xFFFFFFFFu, 0x10000000u, uint32_t((data.size() - wcdx::image::image_cache_header_size) / wcdx::image::image_cache_info_size) + 1 })
+    {
+        damaged = data;
+        std::memcpy(damaged.data() + 4, &count, sizeof(count));
+        UNIT_CHECK_THROWS(std::runtime_error, wcdx::image::image_cache(view(damaged)));
+    }
+
+    // Offsets past the end, or too close to it to hold an image header.
+    auto last_offset = wcdx::image::image_cache_header_size + (2 * wcdx::image::image_cache_info_size);
+    for (auto offset : { uint64_t(0xFFFFFFFF), uint64_t(data.size()) + 1, uint64_t(data.size()), uint64_t(data.size()) - wcdx::image::cached_image_header_size + 1 })
+    {
+        damaged = data;
+        auto value = uint32_t(offset);
+        std::memcpy(damaged.data() + last_offset, &value, sizeof(value));
+        wcdx::image::image_cache cache(view(damaged));
+        UNIT_CHECK_THROWS(std::runtime_error, cache.image(2));
+        UNIT_CHECK(!draw_rejected(cache.image(1)));
+    }
+
+    // An offset that leaves exactly a header has no rows to draw.
+    damaged = data;
+    auto value = uint32_t(data.size() - wcdx::image::cached_image_header_size);
+    std::memcpy(damaged.data() + last_offset, &value, sizeof(value));
+    auto image = wcdx::image::image_cache(view(damaged)).image(2);
+    UNIT_CHECK_EQUAL(image.size, 0u);
+    UNIT_CHECK(image.height == 0 || draw_rejected(image));
+}
+
+UNIT_TEST(image_cache_rejects_damaged_images)
+{
+    wcdx::unit::random rng(4);
+    auto original = random_sprite(rng, 300, 12);
+    std::vector<std::vector<std::byte>> encoded = { wcdx::image::encode_cached_image(original) };
+    auto data = make_cache(encoded);
+    auto image_offset = wcdx::image::image_cache_header_size + wcdx::image::image_cache_info_size;
+
+    // Cut anywhere inside the rows, the image is rejected; each copy is
+    // exactly as long as the cut so that reading past it would be caught.
+    for (auto size = image_offset + wcdx::image::cached_image_header_size; size != data.size(); ++size)
+    {
+        std::vector<std::byte> truncated(data.begin(), data.begin() + size);
+        wcdx::image::image_cache cache(view(truncated));
+        UNIT_CHECK(draw_rejected(cache.image(0)));
+    }
+
+    // Runs longer than the rest of their row.
+    auto rows = image_offset + wcdx::image::cached_image_header_size;
+    auto row_with = [&](std::initializer_list<unsigned> codes)
+    {
+        auto damaged = data;
+        damaged.resize(rows);
+        for (auto code : codes)
+            damaged.push_back(std::byte(code));
+        for (unsigned row = 1; row != original.descriptor.height; ++row)
+            damaged.push_back(std::byte(0));
+        return damaged;
+    };
+
+    auto accepted = row_with({ 1, 255, 1, 45, 0 });
+    UNIT_CHECK(!draw_rejected(wcdx::image::image_cache(view(accepted)).image(0)));
+    for (auto damaged : { row_with({ 1, 255, 1, 46, 0 }), row_with({ 1, 255, 1, 40, 2 * 6, 9, 0 }), row_with({ 1, 255, 1, 40, (2 * 6) + 1, 1, 2, 3, 4, 5, 6, 0 }),
+        row_with({ 1, 255, 1, 40, (2 * 5) + 1, 1, 2, 3, 4 }), row_with({ 2 * 5 }), row_with({ 1 }), row_with({ 1, 255, 1, 45 }) })
+    {
+        UNIT_CHECK(draw_rejected(wcdx::image::image_cache(view(damaged)).image(0)));
+    }
+
+    // Random damage is either rejected or drawn within bounds.
+    for (unsigned trial = 0; trial != 2000; ++trial)
+    {
+        auto damaged = data;
+        for (auto changes = 1 + rng.below(4); changes != 0; --changes)
+            damaged[rows + rng.below(uint32_t(data.size() - rows))] = std::byte(rng.next());
+        draw_rejected(wcdx::image::image_cache(view(damaged)).image(0));
+    }
+}
@@ -0,0 +1,180 @@
+#include "unit.h"
+
+#include <metrics/latency_histogram.h>
+#include <metrics/report.h>
+
+#include <stdext/array_view.h>
+
+#include <atomic>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <cstddef>
+#include <cstdint>
+
+
+UNIT_TEST(histogram_bucket_boundaries)
+{
+    using wcdx::metrics::bucket_index;
+    using wcdx::metrics::bucket_lower_bound;
+    using wcdx::metrics::histogram_bucket_count;
+
+    // The smallest values each get a bucket of their own.
+    for (uint64_t n = 0; n != 4; ++n)
+    {
+        UNIT_CHECK_EQUAL(bucket_index(n), n);
+        UNIT_CHECK_EQUAL(bucket_lower_bound(n), n);
+    }
+
+    // Each power of two starts a group of four.
+    for (unsigned exponent = 2; exponent != 64; ++exponent)
+    {
+        auto power = uint64_t(1) << exponent;
+        UNIT_CHECK_EQUAL(bucket_index(power), 4 * (exponent - 1));
+        UNIT_CHECK_EQUAL(bucket_index(power - 1), 4 * (exponent - 1) - 1);
+        UNIT_CHECK_EQUAL(bucket_lower_bound(4 * (exponent - 1)), power);
+    }
+
+    UNIT_CHECK_EQUAL(histogram_bucket_count, 252u);
+    UNIT_CHECK_EQUAL(bucket_index(UINT64_MAX), 251u);
+    UNIT_CHECK_EQUAL(bucket_lower_bound(251), uint64_t(7) << 61);
+
+    // Every bucket holds exactly the values from its lower bound up to the
+    // next one, and is no wider than a quarter of its lower bound.
+    for (size_t index = 0; index != histogram_bucket_count; ++index)
+    {
+        auto lower = bucket_lower_bound(index);
+        auto upper = index + 1 != histogram_bucket_count ? bucket_lower_bound(index + 1) - 1 : UINT64_MAX;
+        UNIT_CHECK(lower <= upper);
+        UNIT_CHECK_EQUAL(bucket_index(lower), index);
+        UNIT_CHECK_EQUAL(bucket_index(upper), index);
+        if (index >= 4)
+            UNIT_CHECK(upper - lower < lower / 4);
+    }
+}
+
+UNIT_TEST(histogram_percentile_clamping)
+{
+    wcdx::metrics::latency_histogram histogram;
+    histogram.record(uint64_t(1000));
+    auto single = histogram.snapshot();
+
+    // 1000 lands in [896, 1024), but nothing above 1000 was recorded.
+    UNIT_CHECK_EQUAL(single.count, 1u);
+    UNIT_CHECK_EQUAL(single.min, 1000u);
+    UNIT_CHECK_EQUAL(single.max, 1000u);
+    UNIT_CHECK_EQUAL(single.percentile(0.0), 1000u);
+    UNIT_CHECK_EQUAL(single.percentile(0.5), 1000u);
+    UNIT_CHECK_EQUAL(single.percentile(1.0), 1000u);
+
+    histogram.record(uint64_t(5000));
+    histogram.record(uint64_t(1100));
+    auto several = histogram.snapshot();
+    UNIT_CHECK_EQUAL(several.count, 3u);
+    UNIT_CHECK_EQUAL(several.total, 7100u);
+    UNIT_CHECK_EQUAL(several.percentile(0.0), 1023u);
+    UNIT_CHECK_EQUAL(several.percentile(0.5), 1279u);
+    UNIT_CHECK_EQUAL(several.percentile(0.99), 5000u);
+    UNIT_CHECK_EQUAL(several.percentile(1.0), 5000u);
+
+    // A snapshot taken mid-record can see a count before the matching
+    // minimum; the result still stays within [min, max].
+    wcdx::metrics::histogram_snapshot inconsistent;
+    inconsistent.count = 1;
+    inconsistent.buckets[0] = 1;
+    inconsistent.min = 40;
+    inconsistent.max = 50;
+    UNIT_CHECK_EQUAL(inconsistent.percentile(0.5), 40u);
+}
+
+UNIT_TEST(histogram_empty_snapshot)
+{
+    wcdx::metrics::latency_histogram histogram;
+    auto snapshot = histogram.snapshot();
+
+    UNIT_CHECK_EQUAL(snapshot.count, 0u);
+    UNIT_CHECK_EQUAL(snapshot.total, 0u);
+    UNIT_CHECK_EQUAL(snapshot.min, 0u);
+    UNIT_CHECK_EQUAL(snapshot.max, 0u);
+    UNIT_CHECK(snapshot.mean() == 0.0);
+    UNIT_CHECK_EQUAL(snapshot.percentile(0.0), 0u);
+    UNIT_CHECK_EQUAL(snapshot.percentile(0.99), 0u);
+    for (auto count : snapshot.buckets)
+        UNIT_CHECK_EQUAL(count, 0u);
+
+    // Empty histograms are left out of the report.
+    wcdx::metrics::latency_histogram recorded;
+    recorded.record(uint64_t(2000));
+    const wcdx::metrics::named_histogram histograms[] = { { "empty", &histogram }, { "recorded", &recorded } };
+    auto report = wcdx::metrics::format_report(histograms);
+    UNIT_CHECK(report.find("empty") == std::string::npos);
+    UNIT_CHECK(report.find("recorded") != std::string::npos);
+}
+
+// Run under -fsanitize=thread (WCDX_SANITIZE=thread) to check the memory
+// ordering as well as the outcome.
+UNIT_TEST(histogram_concurrent_record_and_snapshot)
+{
+    constexpr unsigned thread_count = 4;
+    constexpr uint64_t samples_per_thread = 100000;
+
+    // Thread t records t + 1, t + 1 + thread_count, ..., so the totals are
+    // known exactly.
+    auto sample = [](unsigned thread, uint64_t n) { return thread + 1 + n * thread_count; };
+
+    wcdx::metrics::latency_histogram histogram;
+    std::atomic<unsigned> finished = 0;
+    std::vector<std::thread> threads;
+    for (unsigned t = 0; t != thread_count; ++t)
+    {
+        threads.emplace_back([&, t]
+        {
+            for (uint64_t n = 0; n != samples_per_thread; ++n)
+                histogram.record(sample(t, n));
+            finished.fetch_add(1, std::memory_order_release);
+        });
+    }
+
+    // Counts only ever grow, and never pass what will be recorded.
+    wcdx::metrics::histogram_snapshot previous;
+    bool shrank = false;
+    bool overshot = false;
+    unsigned snapshots = 0;
+    while (finished.load(std::memory_order_acquire) != thread_count)
+    {
+        auto snapshot = histogram.snapshot();
+        for (size_t n = 0; n != wcdx::metrics::histogram_bucket_count; ++n)
+            shrank = shrank || snapshot.buckets[n] < previous.buckets[n];
+        shrank = shrank || snapshot.count < previous.count || snapshot.total < previous.total;
+        overshot = overshot || snapshot.count > thread_count * samples_per_thread;
+        previous = snapshot;
+        ++snapshots;
+    }
+    for (auto& thread : threads)
+        thread.join();
+
+    UNIT_CHECK(!shrank);
+    UNIT_CHECK(!overshot);
+    UNIT_CHECK(snapshots != 0);
+
+    wcdx::metrics::histogram_snapshot expected;
+    for (unsigned t = 0; t != thread_count; ++t)
+    {
+        for (uint64_t n = 0; n != samples_per_thread; ++n)
+        {
+            auto value = sample(t, n);
+            ++expected.buckets[wcdx::metrics::bucket_index(value)];
+            ++expected.count;
+            expected.total += value;
+        }
+    }
+
+    auto result = histogram.snapshot();
+    UNIT_CHECK_EQUAL(result.count, expected.count);
+    UNIT_CHECK_EQUAL(result.total, expected.total);
+    UNIT_CHECK_EQUAL(result.min, 1u);
+    UNIT_CHECK_EQUAL(result.max, thread_count * samples_per_thread);
+    for (size_t n = 0; n != wcdx::metrics::histogram_bucket_count; ++n)
+        UNIT_CHECK_EQUAL(result.buckets[n], expected.buckets[n]);
+}
@@ -0,0 +1,402 @@
+#include "unit.h"
+
+#include <resource/archive.h>
+#include <resource/lzw.h>
+
+#include <stdext/array_view.h>
+#include <stdext/stream.h>
+
+#include <algorithm>
+#include <optional>
+#include <stack>
+#include <stdexcept>
+#include <vector>
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+
+namespace
+{
+    // Thrown where the baseline decoder's behavior was undefined: it wrote
+    // past the end of its table once the table was full.
+    class baseline_undefined : public std::exception
+    {
+    };
+
+    // extract_compressed as it was in wcres before the resource library, fed
+    // from memory instead of a file.
+    std::vector<std::byte> baseline_decompress(const std::vector<std::byte>& input)
+    {
+        static constexpr size_t min_code_width = 9;
+        static constexpr size_t max_code_width = 12;
+        static constexpr size_t initial_table_size = 0x102;
+        static constexpr uint16_t reset_code = 0x100;
+        static constexpr uint16_t stop_code = 0x101;
+
+        size_t position = 0;
+        size_t src_bit_position = 8;
+        std::byte src_byte { };
+        auto read = [&](size_t bit_width)
+        {
+            uint16_t result = 0;
+            size_t dst_bit_position = 0;
+            while (bit_width != 0)
+            {
+                if (src_bit_position == 8)
+                {
+                    if (position == input.size())
+                        throw std::runtime_error("End of stream");
+                    src_byte = input[position++];
+                    src_bit_position = 0;
+                }
+                size_t bits_used = std::min(bit_width, size_t(8 - src_bit_position));
+                auto byte = (src_byte >> src_bit_position) & std::byte((1 << bits_used) - 1);
+                src_bit_position += bits_used;
+                bit_width -= bits_used;
+                result = uint16_t(result | (uint16_t(byte) << dst_bit_position));
+                dst_bit_position += bits_used;
+            }
+            return result;
+        };
+
+        struct entry
+        {
+            uint16_t prev_index;
+            std::byte value;
+        };
+        std::vector<entry> table(1 << max_code_width);
+        std::stack<std::byte> stack;
+        std::vector<std::byte> output;
+
+        auto code = read(min_code_width);
+        if (code == stop_code)
+            return output;
+        if (code != reset_code)
+            throw std::runtime_error("Compressed data stream missing reset code");
+
+        do
+        {
+            size_t code_width = min_code_width;
+            size_t code_width_threshold = size_t(1) << code_width;
+            size_t table_size = initial_table_size;
+            uint16_t prev_code = code;
+            while ((code = read(code_width)) != reset_code && code != stop_code)
+            {
+                size_t index = code;
+                if (index > table_size)
+                    throw std::range_error("Decompressor table index out of range");
+
+                if (index == table_size)
+                {
+                    if (prev_code == reset_code)
+                        throw std::range_error("Decompressor table index out of range");
+                    index = prev_code;
+                }
+
+                while (index > 0xFF)
+                {
+                    stack.push(table[index].value);
+                    index = table[index].prev_index;
+                }
+
+                auto first_value = std::byte(index);
+                output.push_back(first_value);
+                for (; !stack.empty(); stack.pop())
+                    output.push_back(stack.top());
+
+                if (prev_code != reset_code)
+                {
+                    if (table_size == table.size())
+                        throw baseline_undefined();
+
+                    table[table_size].prev_index = prev_code;
+                    table[table_size].value = first_value;
+                    if (code == table_size)
+                        output.push_back(first_value);
+                    if (++table_size == code_width_threshold && code_width != max_code_width)
+                    {
+                        ++code_width;
+                        code_width_threshold <<= 1;
+                    }
+                }
+
+                prev_code = code;
+            }
+        } while (code != stop_code);
+
+        return output;
+    }
+
+    // Decodes through both entry points of the library, checking that they
+    // agree.  Returns nothing if the input is rejected.  Bad data is reported
+    // with std::runtime_error or std::range_error, which derives from it.
+    std::optional<std::vector<std::byte>> library_decompress(const std::vector<std::byte>& input)
+    {
+        std::optional<std::vector<std::byte>> streamed;
+        try
+        {
+            stdext::memory_input_stream in(input.data(), input.size());
+            wcdx::unit::vector_output_stream out;
+            wcdx::resource::lzw_decompress(in, out);
+            streamed = out.data();
+        }
+        catch (const std::runtime_error&)
+        {
+        }
+
+        // Given exactly the room the data needs, only the data can make the
+        // decode fail.  Rejected data may also overrun an arbitrary buffer
+        // before the error is found.
+        std::optional<std::vector<std::byte>> buffered;
+        try
+        {
+            std::vector<std::byte> output(streamed ? streamed->size() : input.size() * 8);
+            auto size = wcdx::resource::lzw_decompress(stdext::array_view<const std::byte>(input.data(), input.size()),
+                stdext::array_view<std::byte>(output.data(), output.size()));
+            output.resize(size);
+            buffered = std::move(output);
+        }
+        catch (const std::runtime_error&)
+        {
+        }
+        catch (const std::length_error&)
+        {
+            UNIT_CHECK(!streamed);
+        }
+
+        UNIT_CHECK(streamed.has_value() == buffered.has_value());
+        UNIT_CHECK(!streamed || *streamed == *buffered);
+        return buffered;
+    }
+
+    // Checks the library against the baseline on any input, valid or not.
+    // Returns false if the baseline's behavior was undefined.
+    bool compare_with_baseline(const std::vector<std::byte>& input)
+    {
+        std::optional<std::vector<std::byte>> expected;
+        try
+        {
+            expected = baseline_decompress(input);
+        }
+        catch (const baseline_undefined&)
+        {
+            return false;
+        }
+        catch (const std::runtime_error&)
+        {
+        }
+
+        auto actual = library_decompress(input);
+        UNIT_CHECK(expected.has_value() == actual.has_value());
+        UNIT_CHECK(!expected || *expected == *actual);
+
+        // One byte short must be reported as such, not as bad data.
+        if (expected && !expected->empty())
+        {
+            std::vector<std::byte> output(expected->size() - 1);
+            UNIT_CHECK_THROWS(std::length_error, wcdx::resource::lzw_decompress(stdext::array_view<const std::byte>(input.data(), input.size()),
+                stdext::array_view<std::byte>(output.data(), output.size())));
+        }
+        return true;
+    }
+
+    // Data with runs, repeats, and noise, like game resources.
+    std::vector<std::byte> make_data(wcdx::unit::random& rng, size_t size)
+    {
+        std::vector<std::byte> data(size);
+        auto range = rng.below(2) == 0 ? 256u : 1 + rng.below(8);
+        for (size_t n = 0; n != size; )
+        {
+            auto length = std::min<size_t>(1 + rng.below(64), size - n);
+            switch (n == 0 ? 0 : rng.below(3))
+            {
+            case 0:
+                for (; length != 0; --length)
+                    data[n++] = std::byte(rng.below(range));
+                break;
+            case 1:
+                std::fill_n(data.begin() + std::ptrdiff_t(n), length, std::byte(rng.below(range)));
+                n += length;
+                break;
+            default:
+                for (auto from = rng.below(uint32_t(n)); length != 0; --length)
+                    data[n++] = data[from++];
+                break;
+            }
+        }
+        return data;
+    }
+
+    // A stream of mostly valid codes, packed at the widths a decoder expects,
+    // with the occasional bad code, reset, or full table.
+    std::vector<std::byte> make_code_stream(wcdx::unit::random& rng)
+    {
+        std::vector<std::byte> output;
+        uint64_t bits = 0;
+        unsigned count = 0;
+        auto write = [&](unsigned code, unsigned width)
+        {
+            bits |= uint64_t(code) << count;
+            count += width;
+            for (; count >= 8; count -= 8, bits >>= 8)
+                output.push_back(std::byte(bits));
+        };
+
+        unsigned width = 9;
+        unsigned table_size = 0x102;
+        bool after_reset = true;
+        write(rng.below(50) == 0 ? rng.below(0x200) : 0x100, width);
+
+        auto code_count = rng.below(2) == 0 ? rng.below(64) : rng.below(6000);
+        for (unsigned n = 0; n != code_count; ++n)
+        {
+            auto kind = rng.below(1000);
+            unsigned code;
+            if (kind < 3)
+                code = rng.below(1u << width);
+            else if (kind < 10)
+                code = 0x100;
+            else if (kind < 20)
+                code = after_reset ? rng.below(0x100) : std::min(table_size, 0xFFFu);
+            else
+            {
+                code = after_reset ? rng.below(0x100) : rng.below(table_size);
+                if (code == 0x100 || code == 0x101)
+                    code = rng.below(0x100);
+            }
+
+            write(code, width);
+            if (code == 0x101)
+                break;
+            if (code == 0x100)
+            {
+                width = 9;
+                table_size = 0x102;
+                after_reset = true;
+                continue;
+            }
+
+            if (!after_reset && table_size != 0x1000)
+            {
+                if (++table_size == (1u << width) && width != 12)
+                    ++width;
+            }
+            after_reset = false;
+        }
+
+        if (rng.below(10) != 0)
+            write(0x101, width);
+        if (count != 0)
+            output.push_back(std::byte(bits));
+        return output;
+    }
+}
+
+UNIT_TEST(lzw_round_trip)
+{
+    wcdx::unit::random rng(0x4C5A57);
+    for (unsigned iteration = 0; iteration != 500; ++iteration)
+    {
+        auto size = iteration < 16 ? iteration : rng.below(2) == 0 ? rng.below(512) : rng.below(0x20000);
+        auto data = make_data(rng, size);
+        auto compressed = wcdx::resource::lzw_compress(stdext::array_view<const std::byte>(data.data(), data.size()));
+
+        UNIT_CHECK(baseline_decompress(compressed) == data);
+        auto decoded = library_decompress(compressed);
+        UNIT_CHECK(decoded.has_value());
+        UNIT_CHECK(*decoded == data);
+    }
+}
+
+// Every resource of a generated archive extracts to the same bytes through
+// the archive as through the baseline decoder.
+UNIT_TEST(lzw_archive_matches_baseline)
+{
+    wcdx::unit::random rng(0x415243);
+    for (unsigned iteration = 0; iteration != 20; ++iteration)
+    {
+        std::vector<std::vector<std::byte>> resources;
+        std::vector<std::byte> archive_data(4 + (4 * 16));
+        for (unsigned n = 0; n != 16; ++n)
+        {
+            resources.push_back(make_data(rng, rng.below(0x8000)));
+            auto& r = resources.back();
+            auto compressed = wcdx::resource::lzw_compress(stdext::array_view<const std::byte>(r.data(), r.size()));
+
+            auto offset = uint32_t(archive_data.size()) | (uint32_t(wcdx::resource::resource_type_compressed) << 24);
+            std::memcpy(&archive_data[4 + (4 * n)], &offset, 4);
+            auto size = uint32_t(r.size());
+            archive_data.insert(archive_data.end(), reinterpret_cast<const std::byte*>(&size), reinterpret_cast<const std::byte*>(&size) + 4);
+            archive_data.insert(archive_data.end(), compressed.begin(), compressed.end());
+        }
+        auto total = uint32_t(archive_data.size());
+        std::memcpy(archive_data.data(), &total, 4);
+
+        wcdx::resource::archive archive(stdext::array_view<const std::byte>(archive_data.data(), archive_data.size()));
+        UNIT_CHECK_EQUAL(archive.size(), resources.size());
+        for (size_t n = 0; n != archive.size(); ++n)
+        {
+            auto stored = archive.stored_data(n);
+            std::vector<std::byte> compressed(stored.data() + 4, stored.data() + stored.size());
+            UNIT_CHECK(baseline_decompress(compressed) == resources[n]);
+            UNIT_CHECK(archive.extract(n) == resources[n]);
+        }
+    }
+}
+
+UNIT_TEST(lzw_fuzz_matches_baseline)
+{
+    wcdx::unit::random rng(0x46555A5A);
+    unsigned compared = 0;
+    for (unsigned iteration = 0; iteration != 20000; ++iteration)
+    {
+        std::vector<std::byte> input;
+        if (rng.below(5) == 0)
+        {
+            input.resize(rng.below(64));
+            for (auto& b : input)
+                b = std::byte(rng.below(256));
+            if (input.size() >= 2 && rng.below(2) == 0)
+            {
+                input[0] = std::byte(0x00);     // a reset code
+                input[1] = std::byte(input[1] & std::byte(0xFE)) | std::byte(0x01);
+            }
+        }
+        else
+            input = make_code_stream(rng);
+
+        if (compare_with_baseline(input))
+            ++compared;
+    }
+
+    // Nearly every input must have been comparable.
+    UNIT_CHECK(compared > 19000);
+}
+
+UNIT_TEST(lzw_truncated_input)
+{
+    wcdx::unit::random rng(0x5452554E);
+    auto data = make_data(rng, 3000);
+    auto compressed = wcdx::resource::lzw_compress(stdext::array_view<const std::byte>(data.data(), data.size()));
+    for (size_t size = 0; size != compressed.size(); ++size)
+    {
+        std::vector<std::byte> truncated(compressed.begin(), compressed.begin() + std::ptrdiff_t(size));
+        UNIT_CHECK(!library_decompress(truncated).has_value());
+        UNIT_CHECK(compare_with_baseline(truncated));
+    }
+}
+
+UNIT_TEST(lzw_output_too_small)
+{
+    wcdx::unit::random rng(0x534D414C);
+    auto data = make_data(rng, 5000);
+    auto compressed = wcdx::resource::lzw_compress(stdext::array_view<const std::byte>(data.data(), data.size()));
+    for (size_t size : { size_t(0), size_t(1), data.size() / 2, data.size() - 1 })
+    {
+        std::vector<std::byte> output(size);
+        UNIT_CHECK_THROWS(std::length_error, wcdx::resource::lzw_decompress(stdext::array_view<const std::byte>(compressed.data(), compressed.size()),
+            stdext::array_view<std::byte>(output.data(), output.size())));
+    }
+}
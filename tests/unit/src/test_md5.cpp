@@ -0,0 +1,126 @@
+#include "unit.h"
+
+#include <hash/md5.h>
+
+#include <algorithm>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include <cstddef>
+#include <cstdint>
+
+
+namespace
+{
+    struct test_vector
+    {
+        std::string message;
+        const char* digest;
+    };
+
+    // The suite from RFC 1321, appendix A.5, and runs of 'a' whose padding
+    // falls on either side of the block boundaries.
+    std::vector<test_vector> test_vectors()
+    {
+        return
+        {
+            { "", "d41d8cd98f00b204e9800998ecf8427e" },
+            { "a", "0cc175b9c0f1b6a831c399e269772661" },
+            { "abc", "900150983cd24fb0d6963f7d28e17f72" },
+            { "message digest", "f96b697d7cb7938d525a2f31aaf161d0" },
+            { "abcdefghijklmnopqrstuvwxyz", "c3fcd3d76192e4007dfb496cca67e13b" },
+            { "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789", "d174ab98d277d9f5a5611c2c9f419d9f" },
+            { "12345678901234567890123456789012345678901234567890123456789012345678901234567890", "57edf4a22be3c955ac49da2e2107b67a" },
+            { std::string(55, 'a'), "ef1772b6dff9a122358552954ad0df65" },
+            { std::string(56, 'a'), "3b0c8ac703f828b04c6c197006d17218" },
+            { std::string(57, 'a'), "652b906d60af96844ebd21b674f35e93" },
+            { std::string(63, 'a'), "b06521f39153d618550606be297466d5" },
+            { std::string(64, 'a'), "014842d480b571495a4a0363793f7367" },
+            { std::string(65, 'a'), "c743a45e0d2e6a95cb859adae0248435" },
+            { std::string(119, 'a'), "8a7bd0732ed6a28ce75f6dabc90e1613" },
+            { std::string(120, 'a'), "5f61c0ccad4cac44c75ff505e1f1e537" },
+            { std::string(127, 'a'), "020406e1d05cdc2aa287641f7ae2cc39" },
+            { std::string(128, 'a'), "e510683b3f5ffe4093d021808bc6ff70" },
+            { std::string(129, 'a'), "b325dc1c6f5e7a2b7cf465b9feab7948" },
+            { std::string(1000, 'a'), "cabe45dcc9ae5b66ba86600cca6b8ba8" },
+        };
+    }
+
+    // The digest is the four state words, each written least significant
+    // byte first.
+    std::string to_hex(const wcdx::hash::md5_hash& hash)
+    {
+        static constexpr char digits[] = "0123456789abcdef";
+        std::string hex;
+        for (auto word : { hash.a, hash.b, hash.c, hash.d })
+        {
+            for (unsigned n = 0; n != 4; ++n)
+            {
+                auto byte = uint8_t(word >> (8 * n));
+                hex += digits[byte >> 4];
+                hex += digits[byte & 0xF];
+            }
+        }
+        return hex;
+    }
+
+    void check_digest(const wcdx::hash::md5_hash& hash, const char* expected, const std::string& message)
+    {
+        if (to_hex(hash) != expected)
+            wcdx::unit::fail(__FILE__, __LINE__, "MD5 of " + std::to_string(message.size()) + " bytes is " + to_hex(hash) + ", expected " + expected);
+    }
+}
+
+UNIT_TEST(md5_test_vectors)
+{
+    for (auto& v : test_vectors())
+    {
+        check_digest(wcdx::hash::md5_hash(v.message.data(), v.message.size()), v.digest, v.message);
+
+        wcdx::hash::md5_hasher hasher;
+        hasher.update(v.message.data(), v.message.size());
+        check_digest(hasher.finish(), v.digest, v.message);
+    }
+
+    std::string million(1000000, 'a');
+    check_digest(wcdx::hash::md5_hash(million.data(), million.size()), "7707d6ae4e027c70eea2a935c2296f21", million);
+}
+
+UNIT_TEST(md5_chunked_updates)
+{
+    // Splits at every point around the first two block boundaries, then odd
+    // sized chunks that straddle them in every phase.
+    for (auto& v : test_vectors())
+    {
+        for (size_t split = 0; split <= v.message.size() && split <= 130; ++split)
+        {
+            wcdx::hash::md5_hasher hasher;
+            hasher.update(v.message.data(), split);
+            hasher.update(v.message.data() + split, v.message.size() - split);
+            check_digest(hasher.finish(), v.digest, v.message);
+        }
+
+        for (size_t chunk : { 1, 3, 7, 13, 55, 63, 65, 127 })
+        {
+            wcdx::hash::md5_hasher hasher;
+            for (size_t offset = 0; offset < v.message.size(); offset += chunk)
+                hasher.update(v.message.data() + offset, std::min(chunk, v.message.size() - offset));
+            hasher.update(nullptr, 0);
+            check_digest(hasher.finish(), v.digest, v.message);
+        }
+    }
+}
+
+UNIT_TEST(md5_hash_comparison)
+{
+    wcdx::hash::md5_hash hash = { 1, 2, 3, 4 };
+    wcdx::hash::md5_hash same = { 1, 2, 3, 4 };
+    wcdx::hash::md5_hash greater = { 0, 0, 0, 5 };
+
+    UNIT_CHECK(hash == same);
+    UNIT_CHECK(hash != greater);
+    UNIT_CHECK(hash < greater && greater > hash);
+    UNIT_CHECK(hash <= same && hash >= same);
+    UNIT_CHECK_THROWS(std::invalid_argument, (wcdx::hash::md5_hash{ 1, 2, 3 }));
+}
@@ -0,0 +1,136 @@
+#include "unit.h"
+
+#include <parallel/parallel_for.h>
+
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <cstddef>
+
+
+namespace
+{
+    class indexed_failure : public std::runtime_error
+    {
+    public:
+        explicit indexed_failure(size_t index) : runtime_error("Failed at " + std::to_string(index)), index(index) { }
+
+        size_t index;
+    };
+}
+
+UNIT_TEST(parallel_for_each_index_visits_every_index_once)
+{
+    for (unsigned thread_count : { 0u, 1u, 3u, 64u })
+    {
+        std::vector<std::atomic<unsigned>> visits(1000);
+        wcdx::parallel::parallel_for_each_index(visits.size(), [&](size_t n) { ++visits[n]; }, thread_count);
+        for (auto& v : visits)
+            UNIT_CHECK_EQUAL(v.load(), 1u);
+    }
+
+    bool called = false;
+    wcdx::parallel::parallel_for_each_index(0, [&](size_t) { called = true; });
+    UNIT_CHECK(!called);
+}
+
+UNIT_TEST(parallel_for_each_index_reports_lowest_failure)
+{
+    // Serially, nothing past the first failure is started.
+    std::vector<size_t> started;
+    try
+    {
+        wcdx::parallel::parallel_for_each_index(100, [&](size_t n)
+        {
+            started.push_back(n);
+            if (n == 10 || n == 20)
+                throw indexed_failure(n);
+        }, 1);
+        UNIT_CHECK(false);
+    }
+    catch (const indexed_failure& e)
+    {
+        UNIT_CHECK_EQUAL(e.index, 10u);
+    }
+    UNIT_CHECK_EQUAL(started.size(), 11u);
+
+    // In parallel, a later index may fail first, but the lowest failure is
+    // still the one reported.
+    for (unsigned iteration = 0; iteration != 50; ++iteration)
+    {
+        try
+        {
+            wcdx::parallel::parallel_for_each_index(200, [&](size_t n)
+            {
+                if (n == 150)
+                    throw indexed_failure(n);
+                if (n == 40)
+                {
+                    std::this_thread::yield();
+                    throw indexed_failure(n);
+                }
+            }, 8);
+            UNIT_CHECK(false);
+        }
+        catch (const indexed_failure& e)
+        {
+            UNIT_CHECK_EQUAL(e.index, 40u);
+        }
+    }
+}
+
+UNIT_TEST(parallel_for_each_worker_keeps_state_per_thread)
+{
+    // Each body is made, used, and destroyed on one thread.
+    struct worker_state
+    {
+        std::thread::id owner = std::this_thread::get_id();
+        std::atomic<unsigned>* live;
+        std::atomic<bool>* wrong_thread;
+
+        explicit worker_state(std::atomic<unsigned>* live, std::atomic<bool>* wrong_thread) : live(live), wrong_thread(wrong_thread) { ++*live; }
+        ~worker_state()
+        {
+            if (std::this_thread::get_id() != owner)
+                *wrong_thread = true;
+            --*live;
+        }
+    };
+
+    std::atomic<unsigned> live = 0;
+    std::atomic<unsigned> made = 0;
+    std::atomic<bool> wrong_thread = false;
+    std::vector<std::atomic<unsigned>> visits(500);
+    wcdx::parallel::parallel_for_each_worker(visits.size(), [&]() -> std::function<void(size_t)>
+    {
+        ++made;
+        auto state = std::make_shared<worker_state>(&live, &wrong_thread);
+        return [&, state](size_t n)
+        {
+            if (std::this_thread::get_id() != state->owner)
+                wrong_thread = true;
+            ++visits[n];
+        };
+    }, 4);
+
+    for (auto& v : visits)
+        UNIT_CHECK_EQUAL(v.load(), 1u);
+    UNIT_CHECK(made >= 1 && made <= 4);
+    UNIT_CHECK_EQUAL(live.load(), 0u);
+    UNIT_CHECK(!wrong_thread);
+
+    // A body that can't be made fails the index that needed it.
+    try
+    {
+        wcdx::parallel::parallel_for_each_worker(10, []() -> std::function<void(size_t)> { throw indexed_failure(0); }, 1);
+        UNIT_CHECK(false);
+    }
+    catch (const indexed_failure&)
+    {
+    }
+}
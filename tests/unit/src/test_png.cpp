@@ -0,0 +1,469 @@
+#include "unit.h"
+
+#include <image/image.h>
+
+#include <stdext/array_view.h>
+#include <stdext/stream.h>
+
+#include <algorithm>
+#include <iterator>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+
+namespace
+{
+    // A straightforward inflater written from RFC 1950 and 1951, kept apart
+    // from the encoder so that the two don't share mistakes.
+    class inflater
+    {
+    public:
+        explicit inflater(const std::vector<std::byte>& input) noexcept : _input(input) { }
+
+    public:
+        std::vector<std::byte> inflate_zlib();
+
+    private:
+        struct huffman
+        {
+            uint16_t counts[16];
+            uint16_t symbols[288];
+        };
+
+        unsigned bits(unsigned count);
+        unsigned decode(const huffman& h);
+        static void build(huffman& h, const uint8_t* lengths, unsigned count);
+        void stored(std::vector<std::byte>& output);
+        void codes(std::vector<std::byte>& output, const huffman& literals, const huffman& distances);
+        void fixed(std::vector<std::byte>& output);
+        void dynamic(std::vector<std::byte>& output);
+
+    private:
+        const std::vector<std::byte>& _input;
+        size_t _position = 0;
+        uint32_t _bit_buffer = 0;
+        unsigned _bit_count = 0;
+    };
+
+    [[noreturn]] void bad_stream(const char* what)
+    {
+        throw wcdx::unit::test_failure(std::string("Invalid deflate stream: ") + what);
+    }
+
+    unsigned inflater::bits(unsigned count)
+    {
+        uint32_t value = _bit_buffer;
+        while (_bit_count < count)
+        {
+            if (_position == _input.size())
+                bad_stream("unexpected end");
+            value |= uint32_t(_input[_position++]) << _bit_count;
+            _bit_count += 8;
+        }
+
+        _bit_buffer = value >> count;
+        _bit_count -= count;
+        return value & ((1u << count) - 1);
+    }
+
+    unsigned inflater::decode(const huffman& h)
+    {
+        int code = 0;
+        int first = 0;
+        int index = 0;
+        for (unsigned length = 1; length != 16; ++length)
+        {
+            code |= int(bits(1));
+            int count = h.counts[length];
+            if (code - count < first)
+                return h.symbols[index + (code - first)];
+            index += count;
+            first = (first + count) << 1;
+            code <<= 1;
+        }
+        bad_stream("code out of range");
+    }
+
+    void inflater::build(huffman& h, const uint8_t* lengths, unsigned count)
+    {
+        std::fill(std::begin(h.counts), std::end(h.counts), uint16_t(0));
+        for (unsigned n = 0; n != count; ++n)
+            ++h.counts[lengths[n]];
+
+        uint16_t offsets[16];
+        offsets[1] = 0;
+        for (unsigned length = 1; length != 15; ++length)
+            offsets[length + 1] = uint16_t(offsets[length] + h.counts[length]);
+        for (unsigned n = 0; n != count; ++n)
+        {
+            if (lengths[n] != 0)
+                h.symbols[offsets[lengths[n]]++] = uint16_t(n);
+        }
+    }
+
+    void inflater::stored(std::vector<std::byte>& output)
+    {
+        _bit_buffer = 0;
+        _bit_count = 0;
+        if (_input.size() - _position < 4)
+            bad_stream("truncated stored block");
+
+        unsigned length = unsigned(_input[_position]) | (unsigned(_input[_position + 1]) << 8);
+        unsigned complement = unsigned(_input[_position + 2]) | (unsigned(_input[_position + 3]) << 8);
+        _position += 4;
+        if (length != (~complement & 0xFFFF))
+            bad_stream("stored length mismatch");
+        if (_input.size() - _position < length)
+            bad_stream("truncated stored block");
+
+        output.insert(output.end(), _input.begin() + std::ptrdiff_t(_position), _input.begin() + std::ptrdiff_t(_position + length));
+        _position += length;
+    }
+
+    void inflater::codes(std::vector<std::byte>& output, const huffman& literals, const huffman& distances)
+    {
+        static constexpr uint16_t length_base[29] =
+        {
+            3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31,
+            35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258
+        };
+        static constexpr uint8_t length_extra[29] =
+        {
+            0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2,
+            3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0
+        };
+        static constexpr uint16_t distance_base[30] =
+        {
+            1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193,
+            257, 385, 513, 769, 1025, 1537, 2049, 3073, 4097, 6145, 8193, 12289, 16385, 24577
+        };
+        static constexpr uint8_t distance_extra[30] =
+        {
+            0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6,
+            7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13
+        };
+
+        for (;;)
+        {
+            auto symbol = decode(literals);
+            if (symbol < 256)
+            {
+                output.push_back(std::byte(symbol));
+                continue;
+            }
+            if (symbol == 256)
+                return;
+
+            symbol -= 257;
+            if (symbol >= 29)
+                bad_stream("invalid length code");
+            auto length = length_base[symbol] + bits(length_extra[symbol]);
+
+            auto dcode = decode(distances);
+            if (dcode >= 30)
+                bad_stream("invalid distance code");
+            auto distance = distance_base[dcode] + bits(distance_extra[dcode]);
+            if (distance > output.size() || distance > 32768)
+                bad_stream("distance too far back");
+
+            for (auto n = output.size() - distance; length != 0; --length)
+                output.push_back(output[n++]);
+        }
+    }
+
+    void inflater::fixed(std::vector<std::byte>& output)
+    {
+        uint8_t lengths[288];
+        std::fill_n(lengths, 144, uint8_t(8));
+        std::fill_n(lengths + 144, 112, uint8_t(9));
+        std::fill_n(lengths + 256, 24, uint8_t(7));
+        std::fill_n(lengths + 280, 8, uint8_t(8));
+        huffman literals;
+        build(literals, lengths, 288);
+
+        std::fill_n(lengths, 30, uint8_t(5));
+        huffman distances;
+        build(distances, lengths, 30);
+
+        codes(output, literals, distances);
+    }
+
+    void inflater::dynamic(std::vector<std::byte>& output)
+    {
+        static constexpr uint8_t order[19] = { 16, 17, 18, 0, 8, 7, 9, 6, 10, 5, 11, 4, 12, 3, 13, 2, 14, 1, 15 };
+
+        auto literal_count = bits(5) + 257;
+        auto distance_count = bits(5) + 1;
+        auto length_count = bits(4) + 4;
+        if (literal_count > 286 || distance_count > 30)
+            bad_stream("too many codes");
+
+        uint8_t lengths[320] = { };
+        for (unsigned n = 0; n != length_count; ++n)
+            lengths[order[n]] = uint8_t(bits(3));
+        huffman length_code;
+        build(length_code, lengths, 19);
+
+        unsigned index = 0;
+        while (index < literal_count + distance_count)
+        {
+            auto symbol = decode(length_code);
+            if (symbol < 16)
+            {
+                lengths[index++] = uint8_t(symbol);
+                continue;
+            }
+
+            uint8_t value = 0;
+            unsigned repeat;
+            if (symbol == 16)
+            {
+                if (index == 0)
+                    bad_stream("repeat with no previous length");
+                value = lengths[index - 1];
+                repeat = 3 + bits(2);
+            }
+            else if (symbol == 17)
+                repeat = 3 + bits(3);
+            else
+                repeat = 11 + bits(7);
+
+            if (index + repeat > literal_count + distance_count)
+                bad_stream("too many lengths");
+            while (repeat-- != 0)
+                lengths[index++] = value;
+        }
+        if (lengths[256] == 0)
+            bad_stream("no end-of-block code");
+
+        huffman literals;
+        build(literals, lengths, literal_count);
+        huffman distances;
+        build(distances, lengths + literal_count, distance_count);
+        codes(output, literals, distances);
+    }
+
+    std::vector<std::byte> inflater::inflate_zlib()
+    {
+        if (_input.size() < 6)
+            bad_stream("too short");
+        auto cmf = unsigned(_input[0]);
+        auto flg = unsigned(_input[1]);
+        if ((cmf & 0x0F) != 8 || (cmf >> 4) > 7 || ((cmf << 8) | flg) % 31 != 0 || (flg & 0x20) != 0)
+            bad_stream("bad zlib header");
+        _position = 2;
+
+        std::vector<std::byte> output;
+        bool last;
+        do
+        {
+            last = bits(1) != 0;
+            switch (bits(2))
+            {
+            case 0:
+                stored(output);
+                break;
+            case 1:
+                fixed(output);
+                break;
+            case 2:
+                dynamic(output);
+                break;
+            default:
+                bad_stream("reserved block type");
+            }
+        } while (!last);
+
+        if (_input.size() - _position != 4)
+            bad_stream("missing or extra data after the last block");
+
+        uint32_t a = 1;
+        uint32_t b = 0;
+        for (auto byte : output)
+        {
+            a = (a + uint32_t(byte)) % 65521;
+            b = (b + a) % 65521;
+        }
+        uint32_t expected = (uint32_t(_input[_position]) << 24) | (uint32_t(_input[_position + 1]) << 16)
+            | (uint32_t(_input[_position + 2]) << 8) | uint32_t(_input[_position + 3]);
+        if (((b << 16) | a) != expected)
+            bad_stream("Adler-32 mismatch");
+
+        return output;
+    }
+
+    uint32_t get_u32(const std::byte* p) noexcept
+    {
+        return (uint32_t(p[0]) << 24) | (uint32_t(p[1]) << 16) | (uint32_t(p[2]) << 8) | uint32_t(p[3]);
+    }
+
+    uint32_t crc32(const std::byte* data, size_t size) noexcept
+    {
+        uint32_t crc = 0xFFFFFFFF;
+        for (size_t n = 0; n != size; ++n)
+        {
+            crc ^= uint32_t(data[n]);
+            for (unsigned bit = 0; bit != 8; ++bit)
+                crc = (crc >> 1) ^ (0xEDB88320 & (0 - (crc & 1)));
+        }
+        return ~crc;
+    }
+
+    // Encodes the pixels at the given level and decodes them again, checking
+    // the PNG structure along the way.
+    std::vector<std::byte> round_trip(unsigned width, unsigned height, const std::vector<std::byte>& pixels, wcdx::image::compression level)
+    {
+        std::vector<std::byte> palette(3 * 256);
+        for (size_t n = 0; n != palette.size(); ++n)
+            palette[n] = std::byte(n * 7);
+
+        stdext::memory_input_stream input(pixels.data(), pixels.size());
+        wcdx::unit::vector_output_stream output;
+        wcdx::image::write_image({ width, height }, stdext::array_view<const std::byte>(palette.data(), palette.size()), input, output, level);
+        auto& png = output.data();
+
+        constexpr unsigned char signature[] = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n' };
+        UNIT_CHECK(png.size() > sizeof(signature));
+        UNIT_CHECK(std::memcmp(png.data(), signature, sizeof(signature)) == 0);
+
+        std::vector<std::byte> compressed;
+        bool seen_end = false;
+        for (size_t position = sizeof(signature); position != png.size(); )
+        {
+            UNIT_CHECK(!seen_end);
+            UNIT_CHECK(png.size() - position >= 12);
+            auto size = get_u32(&png[position]);
+            UNIT_CHECK(png.size() - position - 12 >= size);
+
+            std::string type(reinterpret_cast<const char*>(&png[position + 4]), 4);
+            auto data = &png[position + 8];
+            UNIT_CHECK_EQUAL(get_u32(data + size), crc32(&png[position + 4], size + 4));
+            if (type == "IHDR")
+            {
+                UNIT_CHECK_EQUAL(size, 13u);
+                UNIT_CHECK_EQUAL(get_u32(data), width);
+                UNIT_CHECK_EQUAL(get_u32(data + 4), height);
+            }
+            else if (type == "IDAT")
+                compressed.insert(compressed.end(), data, data + size);
+            else if (type == "IEND")
+                seen_end = true;
+            position += 12 + size;
+        }
+        UNIT_CHECK(seen_end);
+
+        inflater inflate(compressed);
+        auto filtered = inflate.inflate_zlib();
+        UNIT_CHECK_EQUAL(filtered.size(), size_t(width + 1) * height);
+
+        std::vector<std::byte> decoded;
+        for (unsigned y = 0; y != height; ++y)
+        {
+            auto row = filtered.data() + (size_t(width + 1) * y);
+            UNIT_CHECK_EQUAL(unsigned(row[0]), 0u);
+            decoded.insert(decoded.end(), row + 1, row + 1 + width);
+        }
+        return decoded;
+    }
+
+    void check_all_levels(unsigned width, unsigned height, const std::vector<std::byte>& pixels)
+    {
+        using wcdx::image::compression;
+        for (auto level : { compression::none, compression::fast, compression::best })
+            UNIT_CHECK(round_trip(width, height, pixels, level) == pixels);
+    }
+}
+
+// Small images full of high indices are where a wrong fixed literal code
+// shows: their blocks are usually fixed Huffman, and indices from 144 up
+// use the 9-bit codes.
+UNIT_TEST(png_round_trip_every_index)
+{
+    for (unsigned first = 0; first < 256; first += 8)
+    {
+        std::vector<std::byte> pixels(16);
+        for (size_t n = 0; n != pixels.size(); ++n)
+            pixels[n] = std::byte(first + n);
+        check_all_levels(4, 4, pixels);
+        check_all_levels(16, 1, pixels);
+    }
+
+    std::vector<std::byte> pixels(256);
+    for (size_t n = 0; n != pixels.size(); ++n)
+        pixels[n] = std::byte(n);
+    check_all_levels(16, 16, pixels);
+
+    std::reverse(pixels.begin(), pixels.end());
+    check_all_levels(1, 256, pixels);
+}
+
+UNIT_TEST(png_round_trip_generated)
+{
+    wcdx::unit::random rng(0x504E47);
+    for (unsigned iteration = 0; iteration != 200; ++iteration)
+    {
+        unsigned width = 1 + rng.below(iteration < 150 ? 48 : 400);
+        unsigned height = 1 + rng.below(iteration < 150 ? 48 : 300);
+        std::vector<std::byte> pixels(size_t(width) * height);
+
+        // Noise, runs of one color, and copies of earlier data, in varying
+        // proportions, over a limited or a full range of indices.
+        auto range = rng.below(2) == 0 ? 256u : 1 + rng.below(16);
+        auto base = rng.below(256);
+        auto noise = rng.below(100);
+        for (size_t n = 0; n != pixels.size(); )
+        {
+            auto kind = rng.below(100);
+            auto length = std::min<size_t>(1 + rng.below(300), pixels.size() - n);
+            if (kind < noise || n == 0)
+            {
+                for (; length != 0; --length)
+                    pixels[n++] = std::byte(base + rng.below(range));
+            }
+            else if (kind < (noise + 100) / 2)
+            {
+                auto color = std::byte(base + rng.below(range));
+                for (; length != 0; --length)
+                    pixels[n++] = color;
+            }
+            else
+            {
+                auto from = rng.below(uint32_t(n));
+                for (; length != 0; --length)
+                    pixels[n++] = pixels[from++];
+            }
+        }
+
+        check_all_levels(width, height, pixels);
+    }
+}
+
+// Larger than a deflate block and an IDAT chunk, so that both are split.
+UNIT_TEST(png_round_trip_large)
+{
+    constexpr unsigned width = 640;
+    constexpr unsigned height = 480;
+    std::vector<std::byte> pixels(size_t(width) * height);
+    wcdx::unit::random rng(0x4C41524745);
+    for (size_t n = 0; n != pixels.size(); ++n)
+        pixels[n] = std::byte((n / 37) % 7 == 0 ? rng.below(256) : 128 + ((n / 911) % 128));
+    check_all_levels(width, height, pixels);
+}
+
+UNIT_TEST(png_rejects_empty_image)
+{
+    std::vector<std::byte> palette(3 * 256);
+    std::vector<std::byte> pixels(16);
+    for (auto descriptor : { wcdx::image::image_descriptor{ 0, 0 }, wcdx::image::image_descriptor{ 0, 16 }, wcdx::image::image_descriptor{ 16, 0 } })
+    {
+        stdext::memory_input_stream input(pixels.data(), pixels.size());
+        wcdx::unit::vector_output_stream output;
+        UNIT_CHECK_THROWS(std::runtime_error, wcdx::image::write_image(descriptor, stdext::array_view<const std::byte>(palette.data(), palette.size()), input, output));
+        UNIT_CHECK(output.data().empty());
+    }
+}
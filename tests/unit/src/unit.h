@@ -0,0 +1,104 @@
+#ifndef UNIT_UNIT_INCLUDED
+#define UNIT_UNIT_INCLUDED
+#pragma once
+
+#include <stdext/stream.h>
+
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include <cstddef>
+#include <cstdint>
+
+
+namespace wcdx::unit
+{
+    // Thrown by the check macros; the runner reports it and moves on to the
+    // next test.
+    class test_failure : public std::runtime_error
+    {
+        using runtime_error::runtime_error;
+    };
+
+    // Adds a test to the set run by main.  Used through UNIT_TEST.
+    class registrar
+    {
+    public:
+        registrar(const char* name, void (*run)());
+    };
+
+    [[noreturn]] void fail(const char* file, int line, const std::string& message);
+
+    template <class T, class U>
+    void check_equal(const T& actual, const U& expected, const char* expression, const char* file, int line)
+    {
+        if (actual == expected)
+            return;
+
+        std::ostringstream message;
+        message << expression << ": got " << +actual << ", expected " << +expected;
+        fail(file, line, message.str());
+    }
+
+    class vector_output_stream : public stdext::output_stream
+    {
+    public:
+        const std::vector<std::byte>& data() const noexcept { return _data; }
+
+    private:
+        size_t do_write(const std::byte* buffer, size_t size) override
+        {
+            _data.insert(_data.end(), buffer, buffer + size);
+            return size;
+        }
+
+    private:
+        std::vector<std::byte> _data;
+    };
+
+    // splitmix64, so that generated inputs are the same everywhere.
+    class random
+    {
+    public:
+        explicit random(uint64_t seed) noexcept : _state(seed) { }
+
+    public:
+        uint64_t next() noexcept
+        {
+            auto z = (_state += 0x9e3779b97f4a7c15);
+            z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9;
+            z = (z ^ (z >> 27)) * 0x94d049bb133111eb;
+            return z ^ (z >> 31);
+        }
+
+        // Uniform in [0, bound).
+        uint32_t below(uint32_t bound) noexcept { return uint32_t(((next() >> 32) * bound) >> 32); }
+
+    private:
+        uint64_t _state;
+    };
+}
+
+#define UNIT_TEST(name) \
+    static void name(); \
+    static const ::wcdx::unit::registrar name##_registrar(#name, name); \
+    static void name()
+
+#define UNIT_CHECK(condition) \
+    do { if (!(condition)) ::wcdx::unit::fail(__FILE__, __LINE__, #condition); } while (false)
+
+#define UNIT_CHECK_EQUAL(actual, expected) \
+    ::wcdx::unit::check_equal((actual), (expected), #actual " == " #expected, __FILE__, __LINE__)
+
+#define UNIT_CHECK_THROWS(exception, expression) \
+    do \
+    { \
+        bool unit_thrown = false; \
+        try { (void)(expression); } catch (const exception&) { unit_thrown = true; } \
+        if (!unit_thrown) \
+            ::wcdx::unit::fail(__FILE__, __LINE__, #expression " didn't throw " #exception); \
+    } while (false)
+
+#endif